@@ -0,0 +1,87 @@
+#include "alloc_check.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+// glibc の本来の実装（差し替えた malloc から呼ぶ）
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace {
+
+// 確保のたびに読むのでスレッドローカルの bool だけにする（確保を伴う初期化をしない）
+thread_local bool armed = false;
+std::atomic<uint64_t> allocations(0);
+std::atomic<size_t> first_size(0);
+
+inline void count(size_t size) {
+    if (armed) {
+        size_t expected = 0;
+        first_size.compare_exchange_strong(expected, size == 0 ? 1 : size, std::memory_order_relaxed);
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace
+
+extern "C" {
+
+void* malloc(size_t size) {
+    count(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+    count(n * size);
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    count(size);
+    return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    count(size);
+    return __libc_memalign(alignment, size);
+}
+
+}  // extern "C"
+
+void AllocCheck::arm() {
+    if (enabled_) {
+        armed = true;
+    }
+}
+
+void AllocCheck::disarm() {
+    armed = false;
+}
+
+uint64_t AllocCheck::allocations() const {
+    return ::allocations.load(std::memory_order_relaxed);
+}
+
+bool AllocCheck::report(std::ostream& os) const {
+    if (!enabled_) {
+        return true;
+    }
+    uint64_t n = allocations();
+    if (n == 0) {
+        os << "Alloc check: no heap allocations in the control loop" << std::endl;
+        return true;
+    }
+    os << "Alloc check FAILED: " << n << " heap allocation(s) in the control loop (first: "
+       << first_size.load(std::memory_order_relaxed) << " bytes)" << std::endl;
+    return false;
+}
+
+bool allocCheckFromEnv() {
+    const char* env = getenv("DXL_ALLOC_CHECK");
+    return env && strcmp(env, "1") == 0;
+}
@@ -0,0 +1,34 @@
+#ifndef ALLOC_CHECK_H_
+#define ALLOC_CHECK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+
+// 定常状態の制御周期でヒープ確保が起きていないかを調べるテストモード（DXL_ALLOC_CHECK=1）。
+// malloc / calloc / realloc / aligned_alloc を差し替え（operator new もこれを通る）、
+// arm() したスレッドでの確保だけを数える。無効のときは arm() しても何も数えない。
+class AllocCheck {
+public:
+    explicit AllocCheck(bool enabled) : enabled_(enabled) {}
+    ~AllocCheck() { disarm(); }
+
+    bool enabled() const { return enabled_; }
+
+    // 呼んだスレッドでの確保を数え始める / 止める
+    void arm();
+    void disarm();
+
+    uint64_t allocations() const;
+
+    // 結果を表示し、確保が1回でもあれば false（無効なら何も表示せず true）
+    bool report(std::ostream& os) const;
+
+private:
+    bool enabled_;
+};
+
+// DXL_ALLOC_CHECK=1 なら true
+bool allocCheckFromEnv();
+
+#endif  // ALLOC_CHECK_H_
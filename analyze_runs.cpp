@@ -0,0 +1,74 @@
+// 走行ログをまとめて解析し、1行1モーターの表にする
+//   ./analyze_runs [-j threads] [-d duration_s] [-m move_ticks] [-s band_deg] [-o summary.csv] [path ...]
+//   path はファイルかディレクトリ（直下の .csv / .bin を全部読む）。省略時は angle_current と current_data。
+// 追従誤差は calculateTargetPosition の線形軌道との差、整定は目標位置から band_deg 以内に入ったまま出なくなった時刻。
+#include "run_analysis.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char* argv[]) {
+    AnalysisOptions options;
+    int threads = 0;
+    std::string csv_path;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:d:m:s:o:")) != -1) {
+        switch (opt) {
+        case 'j': threads = atoi(optarg); break;
+        case 'd': options.duration = atof(optarg); break;
+        case 'm': options.move_ticks = atoi(optarg); break;
+        case 's': options.settle_band_deg = atof(optarg); break;
+        case 'o': csv_path = optarg; break;
+        default:
+            std::cerr << "Usage: " << argv[0]
+                      << " [-j threads] [-d duration_s] [-m move_ticks] [-s band_deg] [-o summary.csv] [path ...]\n";
+            return 1;
+        }
+    }
+    std::vector<std::string> args(argv + optind, argv + argc);
+    if (args.empty()) {
+        args = {"angle_current", "current_data"};
+    }
+
+    std::vector<std::string> paths = collectRunLogs(args);
+    if (paths.empty()) {
+        std::cerr << "No run logs found.\n";
+        return 1;
+    }
+
+    double start = nowSeconds();
+    std::vector<RunStats> results;
+    analyzeRuns(paths, options, threads, results);
+    double elapsed = nowSeconds() - start;
+
+    printRunTable(stdout, results);
+
+    size_t rows = 0, bytes = 0, failed = 0;
+    for (const RunStats& r : results) {
+        rows += r.rows;
+        bytes += r.bytes;
+        failed += r.ok ? 0 : 1;
+    }
+    printf("\n%zu files (%zu failed), %zu rows, %.1f MB in %.1f ms (%.0f files/s)\n", results.size(), failed, rows,
+           bytes / 1e6, elapsed * 1e3, results.size() / elapsed);
+
+    if (!csv_path.empty()) {
+        if (!writeRunCsv(csv_path, results)) {
+            std::cerr << "Failed to write " << csv_path << std::endl;
+            return 1;
+        }
+        printf("Summary written to %s\n", csv_path.c_str());
+    }
+    return failed == 0 ? 0 : 1;
+}
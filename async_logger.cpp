@@ -0,0 +1,87 @@
+#include "async_logger.h"
+
+#include <chrono>
+
+namespace {
+
+const size_t WRITE_BATCH = 256;
+const size_t FILE_BUFFER_SIZE = 1 << 16;
+const auto IDLE_WAIT = std::chrono::milliseconds(5);
+
+}  // namespace
+
+AsyncLogger::AsyncLogger(size_t capacity, DropPolicy policy)
+    : ring_(capacity),
+      policy_(policy),
+      file_(nullptr),
+      running_(false),
+      overflows_(0),
+      written_(0) {}
+
+AsyncLogger::~AsyncLogger() {
+    close();
+}
+
+bool AsyncLogger::open(const std::string& path, const std::string& header, SampleWriter writer) {
+    file_ = fopen(path.c_str(), "w");
+    if (!file_) {
+        return false;
+    }
+    setvbuf(file_, nullptr, _IOFBF, FILE_BUFFER_SIZE);
+    fwrite(header.data(), 1, header.size(), file_);  // バイナリヘッダも書けるようにfputsは使わない
+    writer_ = writer;
+    running_ = true;
+    thread_ = std::thread(&AsyncLogger::writerLoop, this);
+    return true;
+}
+
+bool AsyncLogger::log(const LogSample& sample) {
+    if (ring_.push(sample)) {
+        return true;
+    }
+    if (policy_ == DropPolicy::Block) {
+        while (!ring_.push(sample)) {
+            std::this_thread::yield();
+        }
+        return true;
+    }
+    overflows_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void AsyncLogger::close() {
+    if (thread_.joinable()) {
+        running_ = false;
+        thread_.join();
+    }
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+size_t AsyncLogger::drain() {
+    LogSample batch[WRITE_BATCH];
+    size_t total = 0;
+    size_t n;
+    while ((n = ring_.popBatch(batch, WRITE_BATCH)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            writer_(file_, batch[i]);
+        }
+        total += n;
+        written_.fetch_add(n, std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void AsyncLogger::writerLoop() {
+    while (running_) {
+        if (drain() > 0) {
+            fflush(file_);
+        } else {
+            std::this_thread::sleep_for(IDLE_WAIT);
+        }
+    }
+    drain();
+    fflush(file_);
+}
@@ -0,0 +1,74 @@
+#ifndef ASYNC_LOGGER_H_
+#define ASYNC_LOGGER_H_
+
+#include "spsc_ring.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+#define LOG_MAX_MOTORS                16
+#define LOG_CAPACITY_MARGIN           64
+
+// 1周期分の記録（固定長）
+struct LogSample {
+    double time;                       // 経過時間 [s]
+    uint8_t num_motors;
+    int32_t position[LOG_MAX_MOTORS];
+    int16_t current[LOG_MAX_MOTORS];
+    uint16_t stale;                    // 読めずに前回値を記録したモーター（ビット i がモーター i）
+};
+
+// duration_s の実行を period_s 周期で回したときの全サンプルが入る容量。
+// 書き出しスレッドが遅れても捨てずに済み、リングは構築時に一度だけ確保される。
+inline size_t logCapacityFor(double duration_s, double period_s) {
+    return static_cast<size_t>(duration_s / period_s) + LOG_CAPACITY_MARGIN;
+}
+
+// リングが満杯のときの扱い
+enum class DropPolicy {
+    DropNewest,  // 新しいサンプルを捨ててオーバーフロー数を数える（制御スレッドは待たない）
+    Block,       // 空くまで待つ（オフライン処理用。制御ループでは使わない）
+};
+
+// 制御スレッドからロック・メモリ確保なしでサンプルを受け取り、
+// 専用スレッドでまとめてファイルに書き出すロガー
+class AsyncLogger {
+public:
+    // 1サンプルを1行に整形して書く関数
+    typedef std::function<void(FILE*, const LogSample&)> SampleWriter;
+
+    AsyncLogger(size_t capacity, DropPolicy policy = DropPolicy::DropNewest);
+    ~AsyncLogger();
+
+    // ファイルを開いてヘッダ（テキスト行またはバイナリ）を書き、書き出しスレッドを開始する
+    bool open(const std::string& path, const std::string& header, SampleWriter writer);
+
+    // 制御スレッドから呼ぶ。捨てた場合は false
+    bool log(const LogSample& sample);
+
+    // 残りをすべて書き出してファイルを閉じる
+    void close();
+
+    uint64_t overflows() const { return overflows_.load(std::memory_order_relaxed); }
+    uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+    size_t capacity() const { return ring_.capacity(); }
+
+private:
+    void writerLoop();
+    size_t drain();
+
+    SpscRing<LogSample> ring_;
+    DropPolicy policy_;
+    FILE* file_;
+    SampleWriter writer_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+    std::atomic<uint64_t> overflows_;
+    std::atomic<uint64_t> written_;
+};
+
+#endif  // ASYNC_LOGGER_H_
@@ -0,0 +1,62 @@
+#include "axis_controller.h"
+
+#include <stdlib.h>
+#include <sstream>
+
+AxisController::AxisController(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                               const std::vector<uint8_t>& ids, ControlLaw& law)
+    : telemetry_(portHandler, packetHandler, ids),
+      law_(law),
+      ids_(ids),
+      target_(ids.size(), 0.0),
+      position_(ids.size(), 0.0),
+      feedforward_(ids.size(), 0.0),
+      goal_current_(ids.size(), 0),
+      computed_(ids.size(), 0) {}
+
+int AxisController::read() {
+    int dxl_comm_result = telemetry_.read();
+    for (size_t i = 0; i < ids_.size(); i++) {
+        position_[i] = telemetry_.position(i);
+    }
+    return dxl_comm_result;
+}
+
+void AxisController::compute(double dt) {
+    AxisState state;
+    state.n = ids_.size();
+    state.target = target_.data();
+    state.position = position_.data();
+    state.feedforward = feedforward_.data();
+    law_.compute(state, dt, computed_.data());
+    for (size_t i = 0; i < ids_.size(); i++) {
+        if (telemetry_.fresh(i)) {
+            goal_current_[i] = computed_[i];
+        }
+    }
+}
+
+int AxisController::write() {
+    return telemetry_.writeGoalCurrents(goal_current_.data());
+}
+
+std::vector<uint8_t> parseIdList(const std::string& text) {
+    std::vector<uint8_t> ids;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            ids.push_back(static_cast<uint8_t>(atoi(item.c_str())));
+        }
+    }
+    return ids;
+}
+
+std::vector<uint8_t> idListFromEnv(const char* name, const std::vector<uint8_t>& fallback) {
+    const char* value = getenv(name);
+    if (!value || !*value) {
+        return fallback;
+    }
+    std::vector<uint8_t> ids = parseIdList(value);
+    return ids.empty() ? fallback : ids;
+}
@@ -0,0 +1,76 @@
+#ifndef AXIS_CONTROLLER_H_
+#define AXIS_CONTROLLER_H_
+
+#include "control_law.h"
+#include "sync_telemetry.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// N関節ぶんの位置制御（出力は目標電流）。
+// 関節ごとの状態は項目ごとの連続配列（SoA）に持ち、制御則（ControlLaw）は全関節をまとめて計算する。
+// バス入出力は SyncTelemetry により 読み 1回・書き 1回 にまとめる。
+class AxisController {
+public:
+    AxisController(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                   const std::vector<uint8_t>& ids, ControlLaw& law);
+
+    size_t size() const { return ids_.size(); }
+    uint8_t id(size_t i) const { return ids_[i]; }
+
+    // 応答受信時間をモーターごとに trace へ記録する
+    void setTrace(CycleTrace* trace) { telemetry_.setTrace(trace); }
+
+    // 失敗したやり取りを monitor の方針で送り直し、IDごとに数える（SyncTelemetry::setMonitor）
+    void setMonitor(LinkMonitor* monitor) { telemetry_.setMonitor(monitor); }
+
+    // テレメトリの読み方（SyncTelemetry::configure）。周期の外で read() より前に呼ぶ
+    int configureTelemetry(TelemetryMode mode) { return telemetry_.configure(mode); }
+    TelemetryMode telemetryMode() const { return telemetry_.mode(); }
+    void printWireReport(std::ostream& os, int baudrate) const { telemetry_.printWireReport(os, baudrate); }
+
+    void setTarget(size_t i, double target) { target_[i] = target; }
+    double* targets() { return target_.data(); }
+
+    // 制御則の出力に足す目標電流の補正（軌道のフィードフォワード。PidLaw のときだけ効く）
+    void setFeedforward(size_t i, double current) { feedforward_[i] = current; }
+
+    // 全関節の現在値を読む（失敗した関節は前回値のまま）。戻り値は COMM_*
+    int read();
+
+    // 目標位置と現在位置から目標電流を計算する（バス入出力なし）。
+    // 直前の read() で読めなかった関節は、古い位置で計算せず前回の目標電流を保つ
+    void compute(double dt);
+
+    // 計算した目標電流を全関節へ送る。戻り値は COMM_*
+    int write();
+
+    int32_t position(size_t i) const { return telemetry_.position(i); }
+    int16_t current(size_t i) const { return telemetry_.current(i); }
+    int32_t velocity(size_t i) const { return telemetry_.velocity(i); }
+    uint8_t error(size_t i) const { return telemetry_.error(i); }
+    bool fresh(size_t i) const { return telemetry_.fresh(i); }
+    uint16_t staleMask() const { return telemetry_.staleMask(); }
+    int16_t goalCurrent(size_t i) const { return goal_current_[i]; }
+    // 送る前の目標電流（compute() のあとで上限をかけ直すときに使う）
+    int16_t* goalCurrents() { return goal_current_.data(); }
+
+private:
+    SyncTelemetry telemetry_;
+    ControlLaw& law_;
+    std::vector<uint8_t> ids_;
+
+    // 関節ごとの状態（すべて ids_ と同じ並び）
+    std::vector<double> target_;
+    std::vector<double> position_;
+    std::vector<double> feedforward_;
+    std::vector<int16_t> goal_current_;
+    std::vector<int16_t> computed_;      // 制御則の出力（読めた関節だけ goal_current_ に移す）
+};
+
+// "1,2,3" 形式のID列を読む。環境変数 name が無ければ fallback を使う
+std::vector<uint8_t> parseIdList(const std::string& text);
+std::vector<uint8_t> idListFromEnv(const char* name, const std::vector<uint8_t>& fallback);
+
+#endif  // AXIS_CONTROLLER_H_
@@ -0,0 +1,192 @@
+#include "baud_calibration.h"
+#include "control_table.h"
+#include "latency_histogram.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+
+
+#define CALIBRATION_ROUNDS            50
+#define MAX_ERROR_RATE                0.01 // これを超える速度は信頼できないとみなす
+#define BAUD_SETTLE_US                20000
+
+namespace {
+
+uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+bool pingAll(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+             const std::vector<uint8_t>& ids) {
+    for (uint8_t id : ids) {
+        uint16_t model = 0;
+        uint8_t dxl_error = 0;
+        if (packetHandler->ping(portHandler, id, &model, &dxl_error) != COMM_SUCCESS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 応答のないブロードキャストで全サーボのトルクを切り、Baud Rate を書く
+void broadcastBaudRate(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler, int baudrate) {
+    packetHandler->write1ByteTxOnly(portHandler, BROADCAST_ID, xm430::TorqueEnable::address, TORQUE_DISABLE);
+    packetHandler->write1ByteTxOnly(portHandler, BROADCAST_ID, xm430::BaudRate::address, baudRegisterValue(baudrate));
+    usleep(BAUD_SETTLE_US);
+}
+
+}  // namespace
+
+const std::vector<int>& baudCandidates() {
+    static const std::vector<int> candidates = {4500000, 4000000, 3000000, 2000000, 1000000, 115200, 57600};
+    return candidates;
+}
+
+uint8_t baudRegisterValue(int baudrate) {
+    switch (baudrate) {
+    case 9600: return 0;
+    case 57600: return 1;
+    case 115200: return 2;
+    case 1000000: return 3;
+    case 2000000: return 4;
+    case 3000000: return 5;
+    case 4000000: return 6;
+    case 4500000: return 7;
+    default: return 1;
+    }
+}
+
+int findBusBaudRate(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                    const std::vector<uint8_t>& ids, int preferred) {
+    if (portHandler->setBaudRate(preferred) && pingAll(portHandler, packetHandler, ids)) {
+        return preferred;
+    }
+    for (int baudrate : baudCandidates()) {
+        if (baudrate == preferred || !portHandler->setBaudRate(baudrate)) {
+            continue;
+        }
+        if (pingAll(portHandler, packetHandler, ids)) {
+            return baudrate;
+        }
+    }
+    return 0;
+}
+
+bool switchBaudRate(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                    const std::vector<uint8_t>& ids, int from, int to) {
+    // ポート側が対応していない速度へサーボだけ移すと戻れなくなるので先に確かめる
+    bool supported = portHandler->setBaudRate(to);
+    portHandler->setBaudRate(from);
+    if (!supported) {
+        return false;
+    }
+
+    broadcastBaudRate(portHandler, packetHandler, to);
+    portHandler->setBaudRate(to);  // ポートを閉じて新しい速度で開き直す
+    return pingAll(portHandler, packetHandler, ids);
+}
+
+void measureBus(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                const std::vector<uint8_t>& ids, int rounds, BaudCalibration& result) {
+    LatencyHistogram rtt;
+    int transactions = 0;
+    int failures = 0;
+    uint8_t data[xm430::Telemetry::length];  // 制御周期で読むのと同じ長さで測る
+    for (int r = 0; r < rounds; r++) {
+        for (uint8_t id : ids) {
+            uint8_t dxl_error = 0;
+            uint64_t t0 = nowNs();
+            int dxl_comm_result = packetHandler->readTxRx(portHandler, id, xm430::Telemetry::address, xm430::Telemetry::length, data, &dxl_error);
+            transactions++;
+            if (dxl_comm_result != COMM_SUCCESS) {
+                failures++;
+                continue;
+            }
+            rtt.record(nowNs() - t0);
+        }
+    }
+    result.baudrate = portHandler->getBaudRate();
+    result.measured = true;
+    result.rtt_p50_us = rtt.percentile(50) / 1e3;
+    result.rtt_p99_us = rtt.percentile(99) / 1e3;
+    result.error_rate = transactions > 0 ? static_cast<double>(failures) / transactions : 1.0;
+}
+
+bool restoreBaudRate(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                     const std::vector<uint8_t>& ids, int baudrate) {
+    // サーボがどの速度にいるか分からないので、開ける速度すべてで書き換えを送る
+    for (int candidate : baudCandidates()) {
+        if (portHandler->setBaudRate(candidate)) {
+            broadcastBaudRate(portHandler, packetHandler, baudrate);
+        }
+    }
+    if (!portHandler->setBaudRate(baudrate)) {
+        return false;
+    }
+    return pingAll(portHandler, packetHandler, ids);
+}
+
+bool configureBaudRate(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                       const std::vector<uint8_t>& ids, int default_baudrate, BaudCalibration& result) {
+    memset(&result, 0, sizeof(result));
+    result.baudrate = default_baudrate;
+
+    const char* value = getenv("DXL_BAUD");
+    if (!value || !*value) {
+        return portHandler->setBaudRate(default_baudrate);
+    }
+    std::string mode = value;
+
+    // 前回の実行で別の速度に切り替えたままのこともあるので、まず今の速度を探す
+    int current = findBusBaudRate(portHandler, packetHandler, ids, default_baudrate);
+    if (current == 0) {
+        std::cerr << "全IDが応答するボーレートが見つかりません。" << default_baudrate << " bps に戻します\n";
+        return restoreBaudRate(portHandler, packetHandler, ids, default_baudrate);
+    }
+
+    std::vector<int> targets;
+    if (mode == "auto") {
+        targets = baudCandidates();
+    } else {
+        targets.push_back(atoi(value));
+    }
+
+    for (int target : targets) {
+        if (target != current) {
+            // 対応していない速度は飛ばす
+            if (!portHandler->setBaudRate(target)) {
+                portHandler->setBaudRate(current);
+                if (mode != "auto") {
+                    std::cerr << target << " bps にはポートが対応していません\n";
+                }
+                continue;
+            }
+            portHandler->setBaudRate(current);
+            if (!switchBaudRate(portHandler, packetHandler, ids, current, target)) {
+                std::cerr << target << " bps への切り替えに失敗しました\n";
+                break;
+            }
+            current = target;
+        }
+        measureBus(portHandler, packetHandler, ids, CALIBRATION_ROUNDS, result);
+        std::cout << "Baudrate " << current << " bps: RTT p50 " << result.rtt_p50_us << " us, p99 "
+                  << result.rtt_p99_us << " us, error rate " << result.error_rate * 100.0 << " %" << std::endl;
+        if (result.error_rate <= MAX_ERROR_RATE) {
+            return true;
+        }
+    }
+
+    // どの候補も使えなければ既定の速度に戻す
+    std::cerr << "ボーレートの調整に失敗したため " << default_baudrate << " bps に戻します\n";
+    if (!restoreBaudRate(portHandler, packetHandler, ids, default_baudrate)) {
+        return false;
+    }
+    measureBus(portHandler, packetHandler, ids, CALIBRATION_ROUNDS, result);
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef BAUD_CALIBRATION_H_
+#define BAUD_CALIBRATION_H_
+
+#include "dynamixel_sdk.h"
+
+#include <stdint.h>
+#include <vector>
+
+#define DEFAULT_BAUDRATE              57600
+
+// ボーレート設定の結果（ログヘッダに記録する）
+struct BaudCalibration {
+    int baudrate;            // 使うことにした速度 [bps]
+    bool measured;           // 下の計測値が有効か
+    double rtt_p50_us;       // 1トランザクション（Read 1回）の往復時間
+    double rtt_p99_us;
+    double error_rate;       // 失敗したトランザクションの割合
+};
+
+// 候補の速度（速い順）
+const std::vector<int>& baudCandidates();
+
+// Baud Rate(8) レジスタの値 ↔ bps
+uint8_t baudRegisterValue(int baudrate);
+
+// 全IDが ping に応答する速度を preferred → 候補の順に探す。見つからなければ 0
+int findBusBaudRate(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                    const std::vector<uint8_t>& ids, int preferred);
+
+// ブロードキャストで全サーボの Baud Rate を書き換え、ポートを開き直して全IDの応答を確かめる。
+// EEPROM 領域なので事前にトルクを切る。ポートが to に対応していなければ何もせず false
+bool switchBaudRate(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                    const std::vector<uint8_t>& ids, int from, int to);
+
+// 今の速度で各IDへ Read を rounds 周繰り返し、往復時間と失敗率を測る
+void measureBus(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                const std::vector<uint8_t>& ids, int rounds, BaudCalibration& result);
+
+// どの速度にいても全サーボとポートを baudrate に戻す（フォールバック用）
+bool restoreBaudRate(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                     const std::vector<uint8_t>& ids, int baudrate);
+
+// 環境変数 DXL_BAUD に従ってポートとサーボの速度を決める（openPort() 後に呼ぶ）
+//   未設定        : default_baudrate で開くだけ（従来どおり）
+//   auto          : 速い候補から順に切り替えて測り、失敗率が許容内の最速の速度を使う
+//   <bps>         : その速度へ切り替える（57600 を指定すれば既定の速度に戻せる）
+// 失敗したときは default_baudrate に戻す。全IDと通信できなければ false
+bool configureBaudRate(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                       const std::vector<uint8_t>& ids, int default_baudrate, BaudCalibration& result);
+
+#endif  // BAUD_CALIBRATION_H_
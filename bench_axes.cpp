@@ -0,0 +1,106 @@
+// 関節数ごとの 制御計算時間 と 1周期（読み→計算→書き）の所要時間 を測る
+//   ./bench_axes                          （計算時間のみ）
+//   ./dxl_sim -p /tmp/ttyDXL -n 12 &
+//   ./bench_axes /tmp/ttyDXL 12 200       （バス込みの周期時間も）
+#include "dynamixel_sdk.h"
+#include "axis_controller.h"
+#include "control_table.h"
+#include "latency_histogram.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <iostream>
+#include <vector>
+
+#define BAUDRATE                      57600
+#define COMPUTE_ITERATIONS            200000
+
+static uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+static std::vector<uint8_t> firstIds(int n) {
+    std::vector<uint8_t> ids;
+    for (int i = 1; i <= n; i++) {
+        ids.push_back(static_cast<uint8_t>(i));
+    }
+    return ids;
+}
+
+// バスに触れずに compute() だけを繰り返し、1回あたりの時間 [ns] を返す
+static double measureCompute(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler, int n) {
+    PdLaw law(n, 5.0, 0.5, -500, 500);
+    AxisController axes(portHandler, packetHandler, firstIds(n), law);
+    int16_t sink = 0;
+    uint64_t t0 = nowNs();
+    for (int k = 0; k < COMPUTE_ITERATIONS; k++) {
+        for (int i = 0; i < n; i++) {
+            axes.setTarget(i, (k + i) & 1023);
+        }
+        axes.compute(0.01);
+        sink = static_cast<int16_t>(sink + axes.goalCurrent(k % n));
+    }
+    uint64_t t1 = nowNs();
+    if (sink == 12345) {
+        printf(" ");  // 最適化で消されないように結果を使う
+    }
+    return static_cast<double>(t1 - t0) / COMPUTE_ITERATIONS;
+}
+
+int main(int argc, char* argv[]) {
+    const char* device = argc > 1 ? argv[1] : nullptr;
+    int max_joints = argc > 2 ? atoi(argv[2]) : 12;
+    int cycles = argc > 3 ? atoi(argv[3]) : 200;
+
+    dynamixel::PortHandler* portHandler = dynamixel::PortHandler::getPortHandler(device ? device : "/dev/null");
+    dynamixel::PacketHandler* packetHandler = dynamixel::PacketHandler::getPacketHandler(PROTOCOL_VERSION);
+    bool bus = false;
+    if (device) {
+        bus = portHandler->openPort() && portHandler->setBaudRate(BAUDRATE);
+        if (!bus) {
+            std::cerr << "Failed to open " << device << ", measuring compute time only\n";
+        }
+    }
+
+    std::vector<int> joint_counts;
+    for (int n : {1, 2, 4, 6, 8, 12, 16, 24, 32}) {
+        if (n <= max_joints) joint_counts.push_back(n);
+    }
+    if (joint_counts.empty() || joint_counts.back() != max_joints) {
+        joint_counts.push_back(max_joints);
+    }
+
+    printf("baud=%d cycles=%d\n", BAUDRATE, bus ? cycles : 0);
+    printf("%6s %14s %12s %12s %12s %10s %8s\n",
+           "joints", "compute[ns]", "cycle p50", "cycle p99", "cycle max", "max Hz", "fail");
+    for (int n : joint_counts) {
+        double compute_ns = measureCompute(portHandler, packetHandler, n);
+        if (!bus) {
+            printf("%6d %14.1f %12s %12s %12s %10s %8s\n", n, compute_ns, "-", "-", "-", "-", "-");
+            continue;
+        }
+
+        PdLaw law(n, 5.0, 0.5, 0, 0);  // 電流0のまま回す（バスの往復だけを測る）
+        AxisController axes(portHandler, packetHandler, firstIds(n), law);
+        LatencyHistogram cycle_ns;
+        int failures = 0;
+        for (int c = 0; c < cycles; c++) {
+            uint64_t t0 = nowNs();
+            if (axes.read() != COMM_SUCCESS) failures++;
+            axes.compute(0.01);
+            if (axes.write() != COMM_SUCCESS) failures++;
+            cycle_ns.record(nowNs() - t0);
+        }
+        printf("%6d %14.1f %10.1fus %10.1fus %10.1fus %10.1f %8d\n", n, compute_ns,
+               cycle_ns.percentile(50) / 1e3, cycle_ns.percentile(99) / 1e3, cycle_ns.max() / 1e3,
+               1e9 / cycle_ns.mean(), failures);
+    }
+
+    if (bus) {
+        portHandler->closePort();
+    }
+    return 0;
+}
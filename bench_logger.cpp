@@ -0,0 +1,128 @@
+// ログ書き込みが制御周期に与える影響を測るマイクロベンチマーク
+//   1) AsyncLogger::log() 1回あたりの所要時間
+//   2) 1kHz の模擬制御ループの最悪周期時間（同期書き込み / 非同期書き込み × ディスク停滞あり / なし）
+//   ./bench_logger [output_dir=/tmp]
+#include "async_logger.h"
+#include "latency_histogram.h"
+#include "periodic_executor.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#define BENCH_PUSHES                  1000000
+#define BENCH_CYCLES                  3000
+#define BENCH_PERIOD                  0.001   // 1kHz
+#define STALL_EVERY                   500     // 何サンプルごとに書き込みが止まるか
+#define STALL_MS                      30      // 停滞時間
+
+static uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// ディスクの一時的な停滞を模擬する書き込み関数
+struct StallingWriter {
+    bool stall;
+    uint64_t count = 0;
+
+    void operator()(FILE* fp, const LogSample& sample) {
+        fprintf(fp, "%g,%d,%d,%d,%d\n", sample.time, sample.position[0], sample.current[0],
+                sample.position[1], sample.current[1]);
+        if (stall && ++count % STALL_EVERY == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(STALL_MS));
+        }
+    }
+};
+
+static LogSample makeSample(uint64_t i) {
+    LogSample sample;
+    sample.time = i * BENCH_PERIOD;
+    sample.num_motors = 2;
+    sample.position[0] = static_cast<int32_t>(2048 + i % 1024);
+    sample.current[0] = static_cast<int16_t>(i % 500);
+    sample.position[1] = static_cast<int32_t>(2048 - i % 1024);
+    sample.current[1] = static_cast<int16_t>(-(i % 500));
+    sample.stale = 0;
+    return sample;
+}
+
+// 制御計算の代わりに一定時間CPUを使う
+static void fakeControlWork() {
+    uint64_t until = nowNs() + 50000;
+    while (nowNs() < until) {
+    }
+}
+
+static void benchPushLatency(const std::string& dir) {
+    AsyncLogger logger(1 << 16);
+    logger.open(dir + "/bench_logger_push.csv", "", StallingWriter{false});
+    LatencyHistogram hist;
+    for (uint64_t i = 0; i < BENCH_PUSHES; i++) {
+        LogSample sample = makeSample(i);
+        uint64_t t0 = nowNs();
+        logger.log(sample);
+        hist.record(nowNs() - t0);
+    }
+    logger.close();
+    printf("push latency [ns]  p50: %llu  p99: %llu  p99.9: %llu  max: %llu  (dropped %llu of %d)\n",
+           (unsigned long long)hist.percentile(50), (unsigned long long)hist.percentile(99),
+           (unsigned long long)hist.percentile(99.9), (unsigned long long)hist.max(),
+           (unsigned long long)logger.overflows(), BENCH_PUSHES);
+}
+
+static void printLoop(const char* name, const PeriodicExecutor& executor, uint64_t dropped) {
+    printf("%-22s %10.1f %10.1f %10llu %10llu\n", name,
+           executor.bodyTime().percentile(99) / 1000.0, executor.bodyTime().max() / 1000.0,
+           (unsigned long long)executor.overruns(), (unsigned long long)dropped);
+}
+
+// 従来の current_control2 と同じく、制御ループ内で書き込み + flush する
+static void benchSyncLoop(const std::string& dir, bool stall) {
+    FILE* fp = fopen((dir + "/bench_logger_sync.csv").c_str(), "w");
+    StallingWriter writer{stall};
+    ExecutorConfig config;
+    config.period_s = BENCH_PERIOD;
+    PeriodicExecutor executor(config);
+    executor.run([&](const CycleInfo& cycle) {
+        fakeControlWork();
+        writer(fp, makeSample(cycle.cycle));
+        fflush(fp);
+        return cycle.cycle + 1 < BENCH_CYCLES;
+    });
+    fclose(fp);
+    printLoop(stall ? "sync, stalled disk" : "sync", executor, 0);
+}
+
+static void benchAsyncLoop(const std::string& dir, bool stall) {
+    AsyncLogger logger(4096);
+    logger.open(dir + "/bench_logger_async.csv", "", StallingWriter{stall});
+    ExecutorConfig config;
+    config.period_s = BENCH_PERIOD;
+    PeriodicExecutor executor(config);
+    executor.run([&](const CycleInfo& cycle) {
+        fakeControlWork();
+        logger.log(makeSample(cycle.cycle));
+        return cycle.cycle + 1 < BENCH_CYCLES;
+    });
+    logger.close();
+    printLoop(stall ? "async, stalled disk" : "async", executor, logger.overflows());
+}
+
+int main(int argc, char* argv[]) {
+    std::string dir = argc > 1 ? argv[1] : "/tmp";
+
+    benchPushLatency(dir);
+
+    printf("\n%d cycles at %.0f Hz, disk stall %d ms every %d samples\n",
+           BENCH_CYCLES, 1.0 / BENCH_PERIOD, STALL_MS, STALL_EVERY);
+    printf("%-22s %10s %10s %10s %10s\n", "mode", "p99[us]", "max[us]", "overruns", "dropped");
+    benchSyncLoop(dir, false);
+    benchSyncLoop(dir, true);
+    benchAsyncLoop(dir, false);
+    benchAsyncLoop(dir, true);
+    return 0;
+}
@@ -0,0 +1,139 @@
+// 同じ関節数を 1本 / 2本 / ... のシリアルポートに分けたときのループ周波数と、バス間の読み出し開始時刻の
+// ばらつき（skew）を比べる。関節は先頭から順にバスの数で均等に分ける（バス b には b 番目の塊のID）。
+// バスごとの I/O スレッドは BusGroup（DXL_BUS_CPUS で固定するCPUを変えられる）
+//   ./dxl_sim -p /tmp/ttyA -i 1,2,3,4,5,6 &
+//   ./dxl_sim -p /tmp/ttyB -i 1,2,3,4,5,6 &
+//   ./dxl_sim -p /tmp/ttyC -i 1,2,3,4,5,6 &
+//   ./bench_multibus 6 500 /tmp/ttyA /tmp/ttyB /tmp/ttyC
+#include "dynamixel_sdk.h"
+#include "control_table.h"
+#include "bus_group.h"
+#include "sync_telemetry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#define BAUDRATE                      57600
+
+struct BenchResult {
+    double mean_us;
+    double max_us;
+    int failures;
+    double delay_us;         // 返送遅延（先頭のバス）
+    LatencyHistogram skew;
+};
+
+// 先頭 buses 本のポートに関節を分け、1周期（揃えた Sync Read → Sync Write）を cycles 回まわす
+static bool runBuses(const std::vector<dynamixel::PortHandler*>& ports, dynamixel::PacketHandler* packetHandler,
+                     size_t buses, int num_motors, int cycles, TelemetryMode mode, BenchResult& result,
+                     size_t& largest) {
+    std::vector<std::unique_ptr<SyncTelemetry>> telemetry;
+    largest = 0;
+    int next = 1;
+    for (size_t b = 0; b < buses; b++) {
+        int count = num_motors / static_cast<int>(buses) + (static_cast<int>(b) < num_motors % static_cast<int>(buses) ? 1 : 0);
+        std::vector<uint8_t> ids;
+        for (int i = 0; i < count; i++) {
+            ids.push_back(static_cast<uint8_t>(next++));
+        }
+        largest = std::max(largest, ids.size());
+        telemetry.emplace_back(new SyncTelemetry(ports[b], packetHandler, ids));
+        if (telemetry.back()->configure(mode) != COMM_SUCCESS) {
+            std::cerr << "Failed to configure telemetry on bus " << b << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<std::vector<int16_t>> goal_currents(buses);
+    for (size_t b = 0; b < buses; b++) {
+        goal_currents[b].assign(telemetry[b]->size(), 0);
+    }
+    std::vector<int> failures(buses, 0);
+    auto read_phase = [&](size_t k) {
+        if (telemetry[k]->read() != COMM_SUCCESS) {
+            failures[k]++;
+        }
+    };
+    auto write_phase = [&](size_t k) {
+        if (telemetry[k]->writeGoalCurrents(goal_currents[k].data()) != COMM_SUCCESS) {
+            failures[k]++;
+        }
+    };
+
+    BusGroup group(busCpusFromEnv(buses), 0);
+    result.mean_us = 0.0;
+    result.max_us = 0.0;
+    for (int c = 0; c < cycles; c++) {
+        auto t0 = std::chrono::steady_clock::now();
+        group.run(read_phase, true);
+        group.run(write_phase, false);
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        result.mean_us += us / cycles;
+        if (us > result.max_us) result.max_us = us;
+    }
+    result.failures = 0;
+    for (int f : failures) {
+        result.failures += f;
+    }
+    result.delay_us = telemetry[0]->returnDelayUs();
+    result.skew = group.skew();
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " num_motors cycles device [device...]\n";
+        return 1;
+    }
+    int num_motors = atoi(argv[1]);
+    int cycles = atoi(argv[2]);
+    if (num_motors <= 0 || cycles <= 0) {
+        std::cerr << "num_motors and cycles must be positive\n";
+        return 1;
+    }
+
+    dynamixel::PacketHandler* packetHandler = dynamixel::PacketHandler::getPacketHandler(PROTOCOL_VERSION);
+    std::vector<dynamixel::PortHandler*> ports;
+    for (int a = 3; a < argc; a++) {
+        dynamixel::PortHandler* port = dynamixel::PortHandler::getPortHandler(argv[a]);
+        if (!port->openPort() || !port->setBaudRate(BAUDRATE)) {
+            std::cerr << "Failed to open " << argv[a] << std::endl;
+            return 1;
+        }
+        ports.push_back(port);
+    }
+
+    // DXL_TELEMETRY=block / indirect / fast（既定 fast。current_control2 と同じ）
+    TelemetryMode mode = telemetryModeFromEnv(TelemetryMode::Fast);
+    printf("motors=%d cycles=%d baud=%d telemetry=%s\n", num_motors, cycles, BAUDRATE, telemetryModeName(mode));
+    printf("%6s %12s %12s %12s %10s %10s %8s %10s %10s %10s %8s\n", "buses", "motors/bus", "mean[us]", "max[us]",
+           "loop Hz", "wire Hz", "speedup", "skew p50", "skew p99", "skew max", "fail");
+    double base_hz = 0.0;
+    for (size_t buses = 1; buses <= ports.size() && static_cast<int>(buses) <= num_motors; buses++) {
+        BenchResult result;
+        size_t largest = 0;
+        if (!runBuses(ports, packetHandler, buses, num_motors, cycles, mode, result, largest)) {
+            continue;
+        }
+        // 一番関節の多いバスが周期を決める
+        double wire_hz = maxLoopRateHz(telemetryWire(mode, largest), BAUDRATE, result.delay_us);
+        double hz = 1e6 / result.mean_us;
+        if (buses == 1) {
+            base_hz = hz;
+        }
+        printf("%6zu %12zu %12.1f %12.1f %10.1f %10.1f %7.2fx %10.1f %10.1f %10.1f %8d\n", buses, largest,
+               result.mean_us, result.max_us, hz, wire_hz, hz / base_hz,
+               buses > 1 ? result.skew.percentile(50) / 1e3 : 0.0, buses > 1 ? result.skew.percentile(99) / 1e3 : 0.0,
+               buses > 1 ? result.skew.max() / 1e3 : 0.0, result.failures);
+    }
+
+    for (dynamixel::PortHandler* port : ports) {
+        port->closePort();
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+// PIDカーネル（pid_kernel）の検証とマイクロベンチマーク
+//   1) AVX2 / SSE2 の結果がスカラー版とビット単位で一致するか（出力・内部状態とも。関節数・ゲイン・周期を乱数で振る）
+//   2) 1関節1回あたりの計算時間 [ns]
+//   ./bench_pid [steps=2000]
+// 一致しなければ終了コード 1。
+#include "pid_kernel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#define BENCH_UPDATES                 20000000   // 計測する関節更新の総数
+#define CONTROL_PERIOD                0.01
+
+static uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// 1組分のゲインと状態
+struct LaneSet {
+    std::vector<double> kp, ki, kd, tau, min_out, max_out, integral, derivative, previous, error;
+    std::vector<int16_t> out;
+
+    LaneSet(size_t n, std::mt19937_64& rng)
+        : kp(n), ki(n), kd(n), tau(n), min_out(n), max_out(n), integral(n), derivative(n), previous(n), error(n),
+          out(n) {
+        std::uniform_real_distribution<double> gain(0.0, 10.0);
+        std::uniform_int_distribution<int> limit(0, 2047);
+        for (size_t i = 0; i < n; i++) {
+            kp[i] = gain(rng);
+            ki[i] = gain(rng) * (i % 3 == 0 ? 0.0 : 20.0);   // 積分なしの関節も混ぜる
+            kd[i] = gain(rng) * 0.1;
+            tau[i] = i % 2 == 0 ? 0.0 : gain(rng) * 0.005;  // フィルタなし / あり
+            max_out[i] = limit(rng);
+            min_out[i] = i % 4 == 1 ? 0.0 : -limit(rng);      // 上下非対称（下限0）も混ぜる
+        }
+    }
+
+    PidLanes lanes() {
+        return {kp.size(),   kp.data(),       ki.data(),         kd.data(),       tau.data(),
+                min_out.data(), max_out.data(), integral.data(), derivative.data(), previous.data()};
+    }
+
+    bool same(const LaneSet& o) const {
+        size_t bytes = kp.size() * sizeof(double);
+        return memcmp(out.data(), o.out.data(), out.size() * sizeof(int16_t)) == 0 &&
+               memcmp(integral.data(), o.integral.data(), bytes) == 0 &&
+               memcmp(derivative.data(), o.derivative.data(), bytes) == 0 &&
+               memcmp(previous.data(), o.previous.data(), bytes) == 0 &&
+               memcmp(error.data(), o.error.data(), bytes) == 0;
+    }
+};
+
+// スカラー版と同じ入力を与え、毎ステップ出力と状態を比べる。一致しなかったステップ数を返す
+static int verify(PidIsa isa, size_t n, bool measurement, int steps, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    LaneSet reference(n, rng);
+    LaneSet candidate = reference;
+    std::vector<double> target(n), position(n), feedforward(n);
+    std::uniform_real_distribution<double> start(0.0, 4095.0);
+    std::uniform_real_distribution<double> ff(-100.0, 100.0);
+    std::normal_distribution<double> step(0.0, 20.0);
+    std::uniform_real_distribution<double> jitter(0.5, 1.5);
+    for (size_t i = 0; i < n; i++) {
+        position[i] = start(rng);
+        target[i] = start(rng);
+    }
+
+    int mismatches = 0;
+    for (int s = 0; s < steps; s++) {
+        for (size_t i = 0; i < n; i++) {
+            position[i] += std::round(step(rng));
+            target[i] += step(rng);
+            feedforward[i] = ff(rng);
+        }
+        // 周期の揺れと、時刻が進まない周期（dt = 0）も混ぜる
+        double dt = s % 97 == 5 ? 0.0 : CONTROL_PERIOD * jitter(rng);
+        double rate = s > 0 && dt > 0.0 ? 1.0 / dt : 0.0;
+        if (measurement) rate = -rate;
+        pidStepScalar(reference.lanes(), target.data(), position.data(), feedforward.data(), dt, rate, measurement,
+                      reference.out.data(), reference.error.data());
+        pidStep(isa, candidate.lanes(), target.data(), position.data(), feedforward.data(), dt, rate, measurement,
+                candidate.out.data(), candidate.error.data());
+        if (!candidate.same(reference)) {
+            mismatches++;
+            candidate = reference;  // 以降のステップも独立に比べる
+        }
+    }
+    return mismatches;
+}
+
+static double benchmark(PidIsa isa, size_t n) {
+    std::mt19937_64 rng(n);
+    LaneSet set(n, rng);
+    PidLanes lanes = set.lanes();
+    std::vector<double> target(n), position(n), feedforward(n, 0.0);
+    for (size_t i = 0; i < n; i++) {
+        target[i] = 2048.0 + i;
+        position[i] = 2000.0 + i;
+    }
+    size_t iterations = BENCH_UPDATES / n;
+    uint64_t t0 = nowNs();
+    for (size_t k = 0; k < iterations; k++) {
+        position[k % n] += (k & 1) ? 1.0 : -1.0;  // 毎回入力を変えて計算を省かせない
+        pidStep(isa, lanes, target.data(), position.data(), feedforward.data(), CONTROL_PERIOD, 1.0 / CONTROL_PERIOD,
+                false, set.out.data(), set.error.data());
+    }
+    uint64_t elapsed = nowNs() - t0;
+    return static_cast<double>(elapsed) / (iterations * n);
+}
+
+int main(int argc, char* argv[]) {
+    int steps = argc > 1 ? atoi(argv[1]) : 2000;
+    const PidIsa isas[] = {PidIsa::Scalar, PidIsa::Sse2, PidIsa::Avx2};
+    const size_t verify_sizes[] = {1, 2, 3, 4, 5, 7, 8, 9, 16, 33, 256};
+    const size_t bench_sizes[] = {2, 8, 16, 64, 256};
+
+    printf("default kernel: %s (%s below %d joints)\n\n", pidIsaName(pidIsa(PID_MIN_SIMD_LANES)),
+           pidIsaName(pidIsa(1)), PID_MIN_SIMD_LANES);
+
+    int failures = 0;
+    printf("bit-exact check against scalar (%d steps per case)\n", steps);
+    for (PidIsa isa : isas) {
+        if (isa == PidIsa::Scalar) continue;
+        if (!pidIsaSupported(isa)) {
+            printf("  %-6s not supported on this CPU\n", pidIsaName(isa));
+            continue;
+        }
+        int mismatches = 0;
+        for (size_t n : verify_sizes) {
+            for (bool measurement : {false, true}) {
+                mismatches += verify(isa, n, measurement, steps, n * 2 + measurement);
+            }
+        }
+        printf("  %-6s %s (%d mismatched steps)\n", pidIsaName(isa), mismatches == 0 ? "OK" : "MISMATCH", mismatches);
+        failures += mismatches;
+    }
+
+    printf("\nns per joint-update\n  %-6s", "joints");
+    for (size_t n : bench_sizes) printf(" %8zu", n);
+    printf("\n");
+    for (PidIsa isa : isas) {
+        if (!pidIsaSupported(isa)) continue;
+        printf("  %-6s", pidIsaName(isa));
+        for (size_t n : bench_sizes) printf(" %8.2f", benchmark(isa, n));
+        printf("\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
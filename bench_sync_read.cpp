@@ -0,0 +1,139 @@
+// 1周期あたりのバス往復回数・ワイヤ上のバイト数と到達ループ周波数を、従来方式と
+// Sync Read/Write 方式（block / indirect / fast）で比較する。wire Hz はバイト数と返送遅延だけから求めた上限
+//   ./dxl_sim -p /tmp/ttyDXL -i 1,2 &
+//   ./bench_sync_read /tmp/ttyDXL 2 500
+#include "dynamixel_sdk.h"
+#include "control_table.h"
+#include "dxl_protocol.h"
+#include "sync_telemetry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#define BAUDRATE                      57600
+
+struct BenchResult {
+    double mean_us;
+    double max_us;
+    int failures;
+};
+
+// current_control2 の従来ループ: モーターごとに位置・電流を個別に読み、目標電流を個別に書く
+static BenchResult runLegacy(dynamixel::PacketHandler* packetHandler, dynamixel::PortHandler* portHandler,
+                             const std::vector<uint8_t>& ids, int cycles) {
+    BenchResult result = {0.0, 0.0, 0};
+    for (int c = 0; c < cycles; c++) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (uint8_t id : ids) {
+            uint8_t dxl_error = 0;
+            int32_t position = 0;
+            int16_t current = 0;
+            if (packetHandler->read4ByteTxRx(portHandler, id, xm430::PresentPosition::address, (uint32_t*)&position, &dxl_error) != COMM_SUCCESS) {
+                result.failures++;
+            }
+            if (packetHandler->read2ByteTxRx(portHandler, id, xm430::PresentCurrent::address, (uint16_t*)&current, &dxl_error) != COMM_SUCCESS) {
+                result.failures++;
+            }
+        }
+        for (uint8_t id : ids) {
+            uint8_t dxl_error = 0;
+            if (packetHandler->write2ByteTxRx(portHandler, id, xm430::GoalCurrent::address, 0, &dxl_error) != COMM_SUCCESS) {
+                result.failures++;
+            }
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        result.mean_us += us / cycles;
+        if (us > result.max_us) result.max_us = us;
+    }
+    return result;
+}
+
+static BenchResult runSync(SyncTelemetry& telemetry, int cycles) {
+    BenchResult result = {0.0, 0.0, 0};
+    std::vector<int16_t> goal_currents(telemetry.size(), 0);
+    for (int c = 0; c < cycles; c++) {
+        auto t0 = std::chrono::steady_clock::now();
+        if (telemetry.read() != COMM_SUCCESS) {
+            result.failures++;
+        }
+        if (telemetry.writeGoalCurrents(goal_currents.data()) != COMM_SUCCESS) {
+            result.failures++;
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        result.mean_us += us / cycles;
+        if (us > result.max_us) result.max_us = us;
+    }
+    return result;
+}
+
+static void printResult(const char* name, int instructions, int statuses, size_t bytes, double wire_hz,
+                        const BenchResult& r) {
+    printf("%-8s %12d %12d %12zu %12.1f %12.1f %10.1f %10.1f %8d\n",
+           name, instructions, statuses, bytes, r.mean_us, r.max_us, 1e6 / r.mean_us, wire_hz, r.failures);
+}
+
+// 従来方式の1周期のバイト数（1台ごとに 位置の読み・電流の読み・目標電流の書き、それぞれ応答あり）
+static size_t legacyBytes(size_t count) {
+    const size_t read_request = dxl_proto::PACKET_OVERHEAD + 4;
+    const size_t write_request = dxl_proto::PACKET_OVERHEAD + 2 + xm430::GoalCurrent::width;
+    size_t per_motor = read_request + dxl_proto::STATUS_PACKET_OVERHEAD + xm430::PresentPosition::width +
+                       read_request + dxl_proto::STATUS_PACKET_OVERHEAD + xm430::PresentCurrent::width +
+                       write_request + dxl_proto::STATUS_PACKET_OVERHEAD;
+    return per_motor * count;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " device [num_motors=2] [cycles=500]\n";
+        return 1;
+    }
+    const char* device = argv[1];
+    int num_motors = argc > 2 ? atoi(argv[2]) : 2;
+    int cycles = argc > 3 ? atoi(argv[3]) : 500;
+
+    std::vector<uint8_t> ids;
+    for (int i = 1; i <= num_motors; i++) {
+        ids.push_back(static_cast<uint8_t>(i));
+    }
+
+    dynamixel::PortHandler* portHandler = dynamixel::PortHandler::getPortHandler(device);
+    dynamixel::PacketHandler* packetHandler = dynamixel::PacketHandler::getPacketHandler(PROTOCOL_VERSION);
+    if (!portHandler->openPort() || !portHandler->setBaudRate(BAUDRATE)) {
+        std::cerr << "Failed to open " << device << std::endl;
+        return 1;
+    }
+
+    SyncTelemetry telemetry(portHandler, packetHandler, ids);
+    int n = static_cast<int>(ids.size());
+
+    // 返送遅延は configure() で読む
+    if (telemetry.configure(TelemetryMode::Block) != COMM_SUCCESS) {
+        std::cerr << "Failed to read the return delay time" << std::endl;
+    }
+    double delay_us = telemetry.returnDelayUs();
+
+    BenchResult legacy = runLegacy(packetHandler, portHandler, ids, cycles);
+    size_t legacy_bytes = legacyBytes(ids.size());
+    double legacy_hz = 1e6 / (dxl_proto::wireTimeUs(legacy_bytes, BAUDRATE) + 3 * n * delay_us);
+
+    printf("motors=%d cycles=%d baud=%d return delay=%.0f us\n", n, cycles, BAUDRATE, delay_us);
+    printf("%-8s %12s %12s %12s %12s %12s %10s %10s %8s\n",
+           "mode", "instr/cycle", "status/cycle", "bytes/cycle", "mean[us]", "max[us]", "max Hz", "wire Hz", "fail");
+    printResult("legacy", 3 * n, 3 * n, legacy_bytes, legacy_hz, legacy);
+    for (TelemetryMode mode : {TelemetryMode::Block, TelemetryMode::Indirect, TelemetryMode::Fast}) {
+        if (telemetry.configure(mode) != COMM_SUCCESS || telemetry.mode() != mode) {
+            printf("%-8s (not available)\n", telemetryModeName(mode));
+            continue;
+        }
+        BenchResult sync = runSync(telemetry, cycles);
+        TelemetryWire wire = telemetryWire(mode, ids.size());
+        printResult(telemetryModeName(mode), 2, static_cast<int>(wire.status_packets), wire.total(),
+                    maxLoopRateHz(wire, BAUDRATE, delay_us), sync);
+    }
+
+    portHandler->closePort();
+    return 0;
+}
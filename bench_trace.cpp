@@ -0,0 +1,48 @@
+// CycleTrace のプローブ1回（時刻取得 + ヒストグラム + 追記）の所要時間を測る
+//   ./bench_trace [probes=1000000] [trace.json]
+// 目標は 1プローブ 100ns 未満。無効時（DXL_TRACE なし）のコストも表示する。
+#include "cycle_trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#define DEFAULT_PROBES                1000000
+#define PROBE_BUDGET_NS               100.0
+
+// probes 回 mark() を呼び、1回あたりの時間 [ns] を返す
+static double measure(CycleTrace& trace, int probes) {
+    uint64_t t0 = CycleTrace::now();
+    uint64_t t = trace.begin();
+    for (int i = 0; i < probes; i++) {
+        trace.setCycle(static_cast<uint32_t>(i / PHASE_COUNT));
+        t = trace.mark(static_cast<TracePhase>(i % PHASE_COUNT), t, static_cast<uint8_t>(1 + i % 4));
+    }
+    return static_cast<double>(CycleTrace::now() - t0) / probes;
+}
+
+int main(int argc, char* argv[]) {
+    int probes = argc > 1 ? atoi(argv[1]) : DEFAULT_PROBES;
+    std::vector<uint8_t> ids = {1, 2, 3, 4};
+
+    CycleTrace disabled(false, 0, ids);
+    double off_ns = measure(disabled, probes);
+
+    CycleTrace enabled(true, static_cast<size_t>(probes), ids);
+    double on_ns = measure(enabled, probes);
+
+    // バッファが一杯の後（ヒストグラムだけ更新）
+    double full_ns = measure(enabled, probes);
+
+    printf("probes=%d\n", probes);
+    printf("disabled          %8.1f ns/probe\n", off_ns);
+    printf("enabled           %8.1f ns/probe\n", on_ns);
+    printf("enabled (full)    %8.1f ns/probe\n", full_ns);
+    printf("budget            %8.1f ns/probe -> %s\n", PROBE_BUDGET_NS, on_ns < PROBE_BUDGET_NS ? "OK" : "OVER");
+
+    if (argc > 2) {
+        enabled.writeChromeTrace(argv[2]);
+    }
+    return on_ns < PROBE_BUDGET_NS ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+#include "binlog.h"
+#include "control_table.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+
+BinLogHeader makeBinLogHeader(BinLogLayout layout, const std::vector<uint8_t>& ids, double sample_rate_hz) {
+    BinLogHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINLOG_MAGIC, sizeof(header.magic));
+    header.version = BINLOG_VERSION;
+    header.header_size = sizeof(BinLogHeader);
+    header.num_motors = static_cast<uint32_t>(ids.size() < BINLOG_MAX_MOTORS ? ids.size() : BINLOG_MAX_MOTORS);
+    header.record_size = binLogRecordSize(header.num_motors);
+    for (uint32_t i = 0; i < header.num_motors; i++) {
+        header.ids[i] = ids[i];
+    }
+    header.addr_present_position = xm430::PresentPosition::address;
+    header.addr_present_current = xm430::PresentCurrent::address;
+    header.addr_goal_current = xm430::GoalCurrent::address;
+    header.addr_current_limit = xm430::CurrentLimit::address;
+    header.layout = layout;
+    header.sample_rate_hz = sample_rate_hz;
+    header.start_unix_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return header;
+}
+
+std::string binLogHeaderBytes(const BinLogHeader& header) {
+    return std::string(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void writeBinLogRecord(FILE* fp, const LogSample& sample) {
+    uint8_t record[binLogRecordSize(BINLOG_MAX_MOTORS)];
+    uint32_t n = sample.num_motors;
+    uint32_t size = binLogRecordSize(n);
+    memset(record, 0, size);
+    uint64_t t_ns = static_cast<uint64_t>(std::llround(sample.time * 1e9));
+    memcpy(record, &t_ns, 8);
+    memcpy(record + 8, sample.position, 4 * n);
+    memcpy(record + 8 + 4 * n, sample.current, 2 * n);
+    memcpy(record + 8 + 6 * n, &sample.stale, 2);
+    fwrite(record, 1, size, fp);
+}
+
+std::string csvHeader(BinLogLayout layout, uint32_t num_motors) {
+    if (layout == LAYOUT_CURRENT_DATA) {
+        return "Time (s),Current (mA),Position,Stale\n";
+    }
+    std::string header = "Time(s)";
+    for (uint32_t i = 1; i <= num_motors; i++) {
+        header += ",Position" + std::to_string(i) + ",Current" + std::to_string(i);
+    }
+    return header + ",Stale\n";
+}
+
+// 時刻の書式は従来の std::ofstream の既定（有効数字6桁）と同じ %g
+void writeCsvRow(FILE* fp, BinLogLayout layout, double time, const int32_t* position, const int16_t* current,
+                 uint16_t stale, uint32_t num_motors) {
+    if (layout == LAYOUT_CURRENT_DATA) {
+        fprintf(fp, "%g,%d,%d,%u\n", time, current[0], position[0], stale);
+        return;
+    }
+    fprintf(fp, "%g", time);
+    for (uint32_t i = 0; i < num_motors; i++) {
+        fprintf(fp, ",%d,%d", position[i], current[i]);
+    }
+    fprintf(fp, ",%u\n", stale);
+}
+
+bool openRunLog(AsyncLogger& logger, const std::string& base_path, const BinLogHeader& header, std::string& path) {
+    const char* format = getenv("DXL_LOG_FORMAT");
+    if (format && strcmp(format, "binary") == 0) {
+        path = base_path + ".bin";
+        return logger.open(path, binLogHeaderBytes(header), writeBinLogRecord);
+    }
+
+    BinLogLayout layout = static_cast<BinLogLayout>(header.layout);
+    uint32_t num_motors = header.num_motors;
+    path = base_path + ".csv";
+    return logger.open(path, csvHeader(layout, num_motors), [layout, num_motors](FILE* fp, const LogSample& sample) {
+        writeCsvRow(fp, layout, sample.time, sample.position, sample.current, sample.stale, num_motors);
+    });
+}
+
+BinLogReader::BinLogReader()
+    : map_(nullptr), map_size_(0), header_(nullptr), records_(nullptr), num_records_(0) {}
+
+BinLogReader::~BinLogReader() {
+    close();
+}
+
+bool BinLogReader::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error_ = "cannot open " + path + ": " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(BinLogHeader)) {
+        error_ = path + " is too short for a binary log header";
+        ::close(fd);
+        return false;
+    }
+    map_size_ = static_cast<size_t>(st.st_size);
+    map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        error_ = "mmap failed: " + std::string(strerror(errno));
+        return false;
+    }
+    madvise(map_, map_size_, MADV_SEQUENTIAL);
+
+    header_ = static_cast<const BinLogHeader*>(map_);
+    if (memcmp(header_->magic, BINLOG_MAGIC, sizeof(header_->magic)) != 0) {
+        error_ = path + " is not a binary log";
+        close();
+        return false;
+    }
+    if (header_->version > BINLOG_VERSION || header_->header_size < sizeof(BinLogHeader) ||
+        header_->header_size % 8 != 0 || header_->num_motors > BINLOG_MAX_MOTORS ||
+        header_->record_size != binLogRecordSize(header_->num_motors, header_->version)) {
+        error_ = path + " has an unsupported header (version " + std::to_string(header_->version) + ")";
+        close();
+        return false;
+    }
+
+    // 途中で切れた最後のレコードは無視する
+    records_ = static_cast<const uint8_t*>(map_) + header_->header_size;
+    num_records_ = (map_size_ - header_->header_size) / header_->record_size;
+    return true;
+}
+
+void BinLogReader::close() {
+    if (map_) {
+        munmap(map_, map_size_);
+    }
+    map_ = nullptr;
+    map_size_ = 0;
+    header_ = nullptr;
+    records_ = nullptr;
+    num_records_ = 0;
+}
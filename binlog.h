@@ -0,0 +1,119 @@
+#ifndef BINLOG_H_
+#define BINLOG_H_
+
+#include "async_logger.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// 走行ログのバイナリ形式（リトルエンディアン）
+//   [BinLogHeader][record 0][record 1]...
+//   record = uint64 t_ns | int32 position[num_motors] | int16 current[num_motors] | uint16 stale
+//            | 8バイト境界までパディング
+// ヘッダとレコード長は8の倍数なので、mmapした領域をそのまま型付きで参照できる。
+// stale（読めずに前回値を記録したモーターのビット）はバージョン2から。バージョン1のファイルも読める。
+#define BINLOG_MAGIC                  "DXLBLOG"
+#define BINLOG_VERSION                2
+#define BINLOG_MAX_MOTORS             LOG_MAX_MOTORS
+
+// 変換時に再現するCSVの列構成
+enum BinLogLayout : uint32_t {
+    LAYOUT_ANGLE_CURRENT = 0,  // angle_current/*.csv : Time(s),Position1,Current1,Position2,Current2
+    LAYOUT_CURRENT_DATA  = 1,  // current_data/*.csv  : Time (s),Current (mA),Position
+};
+
+struct BinLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint32_t num_motors;
+    uint8_t ids[BINLOG_MAX_MOTORS];
+    uint16_t addr_present_position;
+    uint16_t addr_present_current;
+    uint16_t addr_goal_current;
+    uint16_t addr_current_limit;
+    uint32_t layout;
+    uint32_t baudrate;
+    double sample_rate_hz;
+    double kp;
+    double ki;
+    double kd;
+    int32_t max_current;
+    int32_t min_current;
+    int64_t start_unix_ns;           // 記録開始時の実時刻
+    double rtt_p50_us;               // 起動時に測った1トランザクションの往復時間（0 なら未計測）
+    double rtt_p99_us;
+    double packet_error_rate;
+    uint8_t reserved[40];
+};
+
+static_assert(sizeof(BinLogHeader) % 8 == 0, "BinLogHeader must keep records 8-byte aligned");
+
+// マジック・サイズ・既定の制御テーブルアドレスを埋めたヘッダを作る（ゲイン等は呼び出し側で設定）
+BinLogHeader makeBinLogHeader(BinLogLayout layout, const std::vector<uint8_t>& ids, double sample_rate_hz);
+
+inline constexpr uint32_t binLogRecordSize(uint32_t num_motors, uint32_t version = BINLOG_VERSION) {
+    return (8 + 4 * num_motors + 2 * num_motors + (version >= 2 ? 2 : 0) + 7) & ~7u;
+}
+
+// AsyncLogger にバイナリで書くための関数群
+std::string binLogHeaderBytes(const BinLogHeader& header);
+void writeBinLogRecord(FILE* fp, const LogSample& sample);
+
+// 従来のCSV形式のヘッダ行と1行分。最後に Stale 列（stale を10進で）を足す
+std::string csvHeader(BinLogLayout layout, uint32_t num_motors);
+void writeCsvRow(FILE* fp, BinLogLayout layout, double time, const int32_t* position, const int16_t* current,
+                 uint16_t stale, uint32_t num_motors);
+
+// 環境変数 DXL_LOG_FORMAT=binary なら base_path + ".bin" にバイナリで、
+// それ以外は従来どおり base_path + ".csv" にCSVで書く。開いたパスを path に返す。
+bool openRunLog(AsyncLogger& logger, const std::string& base_path, const BinLogHeader& header, std::string& path);
+
+// mmap でファイルを開き、コピーせずにレコードを参照する読み出し器
+class BinLogReader {
+public:
+    struct Record {
+        uint64_t t_ns;
+        const int32_t* position;
+        const int16_t* current;
+        uint16_t stale;             // バージョン1のファイルでは 0
+    };
+
+    BinLogReader();
+    ~BinLogReader();
+    BinLogReader(const BinLogReader&) = delete;
+    BinLogReader& operator=(const BinLogReader&) = delete;
+
+    // 失敗時は false を返し、error() に理由を入れる
+    bool open(const std::string& path);
+    void close();
+
+    const BinLogHeader& header() const { return *header_; }
+    size_t size() const { return num_records_; }
+
+    Record record(size_t i) const {
+        const uint8_t* base = records_ + i * header_->record_size;
+        Record r;
+        r.t_ns = *reinterpret_cast<const uint64_t*>(base);
+        r.position = reinterpret_cast<const int32_t*>(base + 8);
+        r.current = reinterpret_cast<const int16_t*>(base + 8 + 4 * header_->num_motors);
+        r.stale = header_->version >= 2 ? *reinterpret_cast<const uint16_t*>(base + 8 + 6 * header_->num_motors) : 0;
+        return r;
+    }
+
+    const std::string& error() const { return error_; }
+
+private:
+    void* map_;
+    size_t map_size_;
+    const BinLogHeader* header_;
+    const uint8_t* records_;
+    size_t num_records_;
+    std::string error_;
+};
+
+#endif  // BINLOG_H_
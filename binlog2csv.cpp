@@ -0,0 +1,77 @@
+// バイナリ走行ログを従来のCSV形式に変換する
+//   ./binlog2csv run.bin [out.csv]        （省略時は拡張子を .csv に替えたパス）
+//   ./binlog2csv -i run.bin               （ヘッダ情報のみ表示）
+#include "binlog.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+
+static void printHeader(const BinLogHeader& h, size_t records) {
+    printf("version:        %u\n", h.version);
+    printf("layout:         %s\n", h.layout == LAYOUT_CURRENT_DATA ? "current_data" : "angle_current");
+    printf("motors:         %u (ids:", h.num_motors);
+    for (uint32_t i = 0; i < h.num_motors; i++) {
+        printf(" %u", h.ids[i]);
+    }
+    printf(")\n");
+    printf("addresses:      position %u, current %u, goal current %u, current limit %u\n",
+           h.addr_present_position, h.addr_present_current, h.addr_goal_current, h.addr_current_limit);
+    printf("sample rate:    %g Hz, baudrate %u\n", h.sample_rate_hz, h.baudrate);
+    if (h.rtt_p50_us > 0.0) {
+        printf("bus latency:    RTT p50 %.1f us, p99 %.1f us, error rate %.2f %%\n", h.rtt_p50_us, h.rtt_p99_us,
+               h.packet_error_rate * 100.0);
+    }
+    printf("gains:          kp %g, ki %g, kd %g, current [%d, %d]\n", h.kp, h.ki, h.kd, h.min_current, h.max_current);
+    printf("records:        %zu\n", records);
+}
+
+int main(int argc, char* argv[]) {
+    bool info_only = argc > 1 && strcmp(argv[1], "-i") == 0;
+    int arg = info_only ? 2 : 1;
+    if (argc <= arg) {
+        std::cerr << "Usage: " << argv[0] << " [-i] input.bin [output.csv]\n";
+        return 1;
+    }
+
+    std::string input = argv[arg];
+    BinLogReader reader;
+    if (!reader.open(input)) {
+        std::cerr << reader.error() << std::endl;
+        return 1;
+    }
+    const BinLogHeader& header = reader.header();
+    if (info_only) {
+        printHeader(header, reader.size());
+        return 0;
+    }
+
+    std::string output;
+    if (argc > arg + 1) {
+        output = argv[arg + 1];
+    } else {
+        size_t dot = input.rfind('.');
+        output = (dot == std::string::npos ? input : input.substr(0, dot)) + ".csv";
+    }
+
+    FILE* fp = fopen(output.c_str(), "w");
+    if (!fp) {
+        std::cerr << "Failed to open " << output << std::endl;
+        return 1;
+    }
+    static char buffer[1 << 16];
+    setvbuf(fp, buffer, _IOFBF, sizeof(buffer));
+
+    BinLogLayout layout = static_cast<BinLogLayout>(header.layout);
+    fputs(csvHeader(layout, header.num_motors).c_str(), fp);
+    for (size_t i = 0; i < reader.size(); i++) {
+        BinLogReader::Record record = reader.record(i);
+        writeCsvRow(fp, layout, record.t_ns * 1e-9, record.position, record.current, record.stale,
+                    header.num_motors);
+    }
+    fclose(fp);
+
+    std::cout << "Wrote " << reader.size() << " rows to " << output << std::endl;
+    return 0;
+}
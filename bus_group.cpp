@@ -0,0 +1,212 @@
+#include "bus_group.h"
+#include "axis_controller.h"  // parseIdList
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+static int64_t monotonicNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+std::vector<BusSpec> busSpecsFromEnv(const char* device, const std::vector<uint8_t>& ids) {
+    std::vector<BusSpec> specs;
+    const char* value = getenv("DXL_BUSES");
+    if (value && *value) {
+        std::stringstream ss(value);
+        std::string item;
+        while (std::getline(ss, item, ';')) {
+            size_t eq = item.find('=');
+            if (eq == std::string::npos || eq == 0) {
+                std::cerr << "Ignoring DXL_BUSES entry '" << item << "' (expected device=id,id,...)" << std::endl;
+                continue;
+            }
+            BusSpec spec;
+            spec.device = item.substr(0, eq);
+            spec.ids = parseIdList(item.substr(eq + 1));
+            spec.cpu = -1;
+            if (!spec.ids.empty()) {
+                specs.push_back(spec);
+            }
+        }
+    }
+    if (specs.empty()) {
+        specs.push_back({device, ids, -1});
+    }
+
+    if (specs.size() > 1) {
+        std::vector<int> cpus = busCpusFromEnv(specs.size());
+        for (size_t k = 0; k < specs.size(); k++) {
+            specs[k].cpu = cpus[k];
+        }
+    }
+    return specs;
+}
+
+std::vector<int> busCpusFromEnv(size_t count) {
+    std::vector<uint8_t> listed;
+    if (const char* list = getenv("DXL_BUS_CPUS")) {
+        listed = parseIdList(list);
+    }
+    unsigned int cores = std::thread::hardware_concurrency();
+    std::vector<int> cpus(count, -1);
+    for (size_t k = 0; k < count; k++) {
+        if (k < listed.size()) {
+            cpus[k] = listed[k];
+        } else if (cores > 0) {
+            cpus[k] = static_cast<int>((k + 1) % cores);
+        }
+    }
+    return cpus;
+}
+
+BusGroup::BusGroup(const std::vector<int>& cpus, int rt_priority)
+    : count_(cpus.size()),
+      alloc_check_(nullptr),
+      generation_(0),
+      pending_(0),
+      running_(true),
+      job_(nullptr),
+      context_(nullptr),
+      release_ns_(0),
+      started_ns_(cpus.size(), 0) {
+    if (count_ < 2) {
+        return;  // 1本なら呼んだスレッドで実行する
+    }
+    for (size_t k = 0; k < count_; k++) {
+        threads_.emplace_back(&BusGroup::workerLoop, this, k, cpus[k], rt_priority);
+    }
+}
+
+BusGroup::~BusGroup() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    start_cv_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void BusGroup::dispatch(Job job, void* context, bool align) {
+    if (threads_.empty()) {
+        if (count_ > 0) {
+            job(context, 0);
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = job;
+        context_ = context;
+        pending_ = count_;
+        release_ns_ = align ? monotonicNow() + BUS_RELEASE_LEAD_US * 1000LL : 0;
+        generation_++;
+    }
+    start_cv_.notify_all();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this] { return pending_ == 0; });
+    }
+    if (align) {
+        int64_t first = started_ns_[0];
+        int64_t last = started_ns_[0];
+        for (int64_t t : started_ns_) {
+            if (t < first) first = t;
+            if (t > last) last = t;
+        }
+        skew_.record(static_cast<uint64_t>(last - first));
+    }
+}
+
+void BusGroup::workerLoop(size_t k, int cpu, int rt_priority) {
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            std::cerr << "バス " << k << " のスレッドを CPU " << cpu << " に固定できませんでした: " << strerror(err)
+                      << std::endl;
+        }
+    }
+    if (rt_priority > 0) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = rt_priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0) {
+            std::cerr << "バス " << k << " のスレッドを SCHED_FIFO にできませんでした: " << strerror(err) << std::endl;
+        }
+    }
+
+    uint64_t seen = 0;
+    uint64_t jobs = 0;
+    while (true) {
+        Job job;
+        void* context;
+        int64_t release;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_cv_.wait(lock, [&] { return generation_ != seen || !running_; });
+            if (!running_) {
+                break;
+            }
+            seen = generation_;
+            job = job_;
+            context = context_;
+            release = release_ns_;
+        }
+        if (jobs == 1 && alloc_check_) {
+            alloc_check_->arm();  // 1回目の初回確保は数えない
+        }
+
+        // 共通の開始時刻の少し前までは眠り、残りは譲りながらスピンで待つ（起床の遅れをそろえる。
+        // CPU が足りずに同じコアを使うスレッドがあっても、スピンが相手を止めないよう sched_yield を挟む）
+        if (release != 0) {
+            int64_t wake = release - BUS_SPIN_US * 1000LL;
+            if (monotonicNow() < wake) {
+                struct timespec ts;
+                ts.tv_sec = static_cast<time_t>(wake / 1000000000LL);
+                ts.tv_nsec = static_cast<long>(wake % 1000000000LL);
+                while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+                }
+            }
+            while (monotonicNow() < release) {
+                sched_yield();
+            }
+        }
+        started_ns_[k] = monotonicNow();
+        job(context, k);
+        jobs++;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--pending_ == 0) {
+            done_cv_.notify_one();
+        }
+    }
+    if (alloc_check_) {
+        alloc_check_->disarm();
+    }
+}
+
+void BusGroup::printReport(std::ostream& os) const {
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(1);
+    os << "Buses: " << count_;
+    if (skew_.count() > 0) {
+        os << ", sampling skew [us]  p50: " << skew_.percentile(50) / 1e3 << "  p99: " << skew_.percentile(99) / 1e3
+           << "  max: " << skew_.max() / 1e3;
+    }
+    os << std::endl;
+    os.flags(flags);
+}
@@ -0,0 +1,90 @@
+#ifndef BUS_GROUP_H_
+#define BUS_GROUP_H_
+
+#include "alloc_check.h"
+#include "latency_histogram.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BUS_RELEASE_LEAD_US           200    // 揃えて始めるとき、各スレッドが起きるのを待つ余裕 [us]
+#define BUS_SPIN_US                   50     // 開始時刻のこれだけ前からはスピンで待つ [us]
+
+// 1本のシリアルポートとそこにつながるID
+struct BusSpec {
+    std::string device;
+    std::vector<uint8_t> ids;
+    int cpu;                // I/O スレッドを固定するCPU（-1 なら固定しない）
+};
+
+// 環境変数 DXL_BUSES="/dev/ttyUSB0=1,2;/dev/ttyUSB1=3,4" でバスごとのIDを決める。無ければ device に ids 全部。
+// DXL_BUS_CPUS="2,3" でバスごとのCPUを決める（無ければ バス k → CPU (k + 1) % CPU数。2本以上のときだけ使う）
+std::vector<BusSpec> busSpecsFromEnv(const char* device, const std::vector<uint8_t>& ids);
+
+// count 本のバスの I/O スレッドを固定するCPU（DXL_BUS_CPUS、無ければ バス k → CPU (k + 1) % CPU数）
+std::vector<int> busCpusFromEnv(size_t count);
+
+// 複数のバスで同じ処理を同時に行う I/O スレッドの組（バスごとに1本、それぞれのCPUに固定）。
+//   - run(fn) は全バスで fn(k)（k はバスの番号）を同時に実行し、全部終わるまで待つ。
+//     align = true なら、全スレッドが共通の開始時刻（BUS_RELEASE_LEAD_US 先）まで待ってから始めるので、
+//     各バスの Sync Read がほぼ同時に出る。その開始時刻のばらつき（最大 - 最小）を skew() に記録する
+//   - バスが1本なら run() は呼んだスレッドでそのまま実行する（スレッドを作らず、待ちも入らない）
+// run() は1つのスレッド（制御スレッド）からだけ呼ぶこと。run() の中ではヒープ確保をしない。
+class BusGroup {
+public:
+    // cpus の数だけバスを持つ。rt_priority が 1〜99 なら I/O スレッドも SCHED_FIFO にする
+    BusGroup(const std::vector<int>& cpus, int rt_priority);
+    ~BusGroup();
+    BusGroup(const BusGroup&) = delete;
+    BusGroup& operator=(const BusGroup&) = delete;
+
+    size_t size() const { return count_; }
+
+    // I/O スレッドでも2回目以降の run() のヒープ確保を数える（最初の run() より前に呼ぶ）
+    void setAllocCheck(AllocCheck* alloc_check) { alloc_check_ = alloc_check; }
+
+    template <class Fn>
+    void run(Fn& fn, bool align) {
+        dispatch(&call<Fn>, &fn, align);
+    }
+
+    // align した run() での各バスの開始時刻のばらつき [ns]
+    const LatencyHistogram& skew() const { return skew_; }
+
+    // バス数と開始時刻のばらつき p50/p99/max を表示する
+    void printReport(std::ostream& os) const;
+
+private:
+    using Job = void (*)(void*, size_t);
+
+    template <class Fn>
+    static void call(void* fn, size_t k) {
+        (*static_cast<Fn*>(fn))(k);
+    }
+
+    void dispatch(Job job, void* context, bool align);
+    void workerLoop(size_t k, int cpu, int rt_priority);
+
+    size_t count_;
+    AllocCheck* alloc_check_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    uint64_t generation_;              // run() ごとに増える
+    size_t pending_;                   // まだ終わっていないバス
+    bool running_;
+    Job job_;
+    void* context_;
+    int64_t release_ns_;               // 揃えて始める時刻（0 なら起きたらすぐ）
+    std::vector<int64_t> started_ns_;  // バスごとの開始時刻
+    LatencyHistogram skew_;
+};
+
+#endif  // BUS_GROUP_H_
@@ -0,0 +1,117 @@
+#include "bus_pipeline.h"
+
+#include <string.h>
+#include <time.h>
+#include <iomanip>
+
+namespace {
+
+double monotonicSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+}  // namespace
+
+BusPipeline::BusPipeline(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                         const std::vector<uint8_t>& ids)
+    : telemetry_(portHandler, packetHandler, ids),
+      ids_(ids),
+      next_command_seq_(1),
+      running_(false),
+      alloc_check_(nullptr),
+      monitor_(nullptr),
+      bus_cycles_(0),
+      comm_failures_(0),
+      bus_seconds_(0.0) {}
+
+BusPipeline::~BusPipeline() {
+    stop();
+}
+
+void BusPipeline::start(AllocCheck* alloc_check) {
+    if (running_) {
+        return;
+    }
+    alloc_check_ = alloc_check;
+    running_ = true;
+    thread_ = std::thread(&BusPipeline::busLoop, this);
+}
+
+void BusPipeline::stop() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void BusPipeline::command(const int16_t* goal_currents, double sample_time) {
+    PipelineCommand cmd;
+    cmd.seq = next_command_seq_++;
+    cmd.sample_time = sample_time;
+    memcpy(cmd.goal_current, goal_currents, sizeof(int16_t) * ids_.size());
+    cmd.issued_time = monotonicSeconds();
+    commands_.publish(cmd);
+}
+
+void BusPipeline::busLoop() {
+    PipelineSample sample;
+    memset(&sample, 0, sizeof(sample));
+    PipelineCommand cmd;
+    double started = monotonicSeconds();
+
+    while (running_.load(std::memory_order_relaxed)) {
+        if (bus_cycles_ == 1 && alloc_check_) {
+            alloc_check_->arm();  // 1周目の初回確保は数えない
+        }
+        if (monitor_) {
+            monitor_->beginCycle(0);  // バス周期には期限が無いので、送り直しは回数だけで決める
+        }
+
+        // 新しい指令があるときだけ書く（目標電流はサーボ側に保持される）
+        if (commands_.fetch(cmd)) {
+            if (telemetry_.writeGoalCurrents(cmd.goal_current) != COMM_SUCCESS) {
+                comm_failures_++;
+            }
+            double sent = monotonicSeconds();
+            command_latency_.record(static_cast<uint64_t>((sent - cmd.issued_time) * 1e9));
+            if (cmd.sample_time > 0.0) {
+                sense_to_actuate_.record(static_cast<uint64_t>((sent - cmd.sample_time) * 1e9));
+            }
+        }
+
+        sample.comm_result = telemetry_.read();
+        if (sample.comm_result != COMM_SUCCESS) {
+            comm_failures_++;
+        }
+        sample.stale = telemetry_.staleMask();
+        sample.link_lost = monitor_ && !monitor_->endCycle();
+        sample.time = monotonicSeconds();
+        sample.seq++;
+        for (size_t i = 0; i < ids_.size(); i++) {
+            sample.current[i] = telemetry_.current(i);
+            sample.velocity[i] = telemetry_.velocity(i);
+            sample.position[i] = telemetry_.position(i);
+        }
+        samples_.publish(sample);
+        bus_cycles_++;
+    }
+    bus_seconds_ = monotonicSeconds() - started;
+    if (alloc_check_) {
+        alloc_check_->disarm();
+    }
+}
+
+void BusPipeline::printReport(std::ostream& os) const {
+    auto us = [](uint64_t ns) { return ns / 1000.0; };
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(1);
+    os << "Bus cycles: " << bus_cycles_ << " (" << (bus_seconds_ > 0 ? bus_cycles_ / bus_seconds_ : 0.0)
+       << " Hz), comm failures: " << comm_failures_ << "\n";
+    os << "Command->actuation [us]  p50: " << us(command_latency_.percentile(50))
+       << "  p99: " << us(command_latency_.percentile(99)) << "  max: " << us(command_latency_.max()) << "\n";
+    os << "Sense->actuation   [us]  p50: " << us(sense_to_actuate_.percentile(50))
+       << "  p99: " << us(sense_to_actuate_.percentile(99)) << "  max: " << us(sense_to_actuate_.max()) << std::endl;
+    os.flags(flags);
+}
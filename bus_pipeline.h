@@ -0,0 +1,93 @@
+#ifndef BUS_PIPELINE_H_
+#define BUS_PIPELINE_H_
+
+#include "dynamixel_sdk.h"
+#include "alloc_check.h"
+#include "latency_histogram.h"
+#include "mailbox.h"
+#include "sync_telemetry.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#define PIPELINE_MAX_MOTORS           16
+
+// バススレッドが読んだ最新のテレメトリ
+struct PipelineSample {
+    uint64_t seq;                               // 0 はまだ一度も読めていない
+    double time;                                // 読み終えた時刻（CLOCK_MONOTONIC）[s]
+    int comm_result;
+    uint16_t stale;                             // 読めずに前回値のままのモーター（ビット i が i 番目）
+    bool link_lost;                             // LinkMonitor の連続失敗の上限に達した
+    int16_t current[PIPELINE_MAX_MOTORS];
+    int32_t velocity[PIPELINE_MAX_MOTORS];
+    int32_t position[PIPELINE_MAX_MOTORS];
+};
+
+// 制御スレッドが出した最新の目標電流
+struct PipelineCommand {
+    uint64_t seq;
+    double sample_time;                         // 計算に使ったサンプルの時刻
+    double issued_time;                         // publish した時刻
+    int16_t goal_current[PIPELINE_MAX_MOTORS];
+};
+
+// PortHandler を専有するバススレッドで Sync Write（新しい指令があるときだけ）と Sync Read を休みなく回し、
+// 制御スレッドとは LatestMailbox で最新値だけをやり取りする（IDは PIPELINE_MAX_MOTORS 個まで）。
+// 制御計算とログ処理がバス転送と重なるぶん周期は縮むが、指令は次のバス周期まで待たされる（1周期遅れ）。
+class BusPipeline {
+public:
+    BusPipeline(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                const std::vector<uint8_t>& ids);
+    ~BusPipeline();
+
+    // バススレッドを開始する。以後 stop() まで PortHandler に触れてはいけない。
+    // alloc_check を渡すと、バススレッドも2周目以降のヒープ確保を数える
+    void start(AllocCheck* alloc_check = nullptr);
+
+    // バス周期ごとに monitor で送り直しと失敗の数えを行う（start() の前に呼ぶ。stop() まではバススレッドだけが触る）
+    void setMonitor(LinkMonitor* monitor) { monitor_ = monitor; telemetry_.setMonitor(monitor); }
+    void stop();
+
+    // 新しいサンプルが届いていれば sample に入れて true
+    bool latest(PipelineSample& sample) { return samples_.fetch(sample); }
+
+    // 目標電流を出す（goal_currents はIDの並び順）
+    void command(const int16_t* goal_currents, double sample_time);
+
+    size_t size() const { return ids_.size(); }
+
+    // 以下は stop() のあとに読むこと
+    uint64_t busCycles() const { return bus_cycles_; }
+    uint64_t commFailures() const { return comm_failures_; }
+    double busSeconds() const { return bus_seconds_; }
+    const LatencyHistogram& commandLatency() const { return command_latency_; }
+    const LatencyHistogram& senseToActuate() const { return sense_to_actuate_; }
+
+    // バス周波数と 指令→送信完了 / 計測→送信完了 の遅延を表示する
+    void printReport(std::ostream& os) const;
+
+private:
+    void busLoop();
+
+    SyncTelemetry telemetry_;
+    std::vector<uint8_t> ids_;
+    LatestMailbox<PipelineSample> samples_;
+    LatestMailbox<PipelineCommand> commands_;
+    uint64_t next_command_seq_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+    AllocCheck* alloc_check_;
+    LinkMonitor* monitor_;
+
+    uint64_t bus_cycles_;
+    uint64_t comm_failures_;
+    double bus_seconds_;
+    LatencyHistogram command_latency_;
+    LatencyHistogram sense_to_actuate_;
+};
+
+#endif  // BUS_PIPELINE_H_
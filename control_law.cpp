@@ -0,0 +1,125 @@
+#include "control_law.h"
+
+PdLaw::PdLaw(size_t n, double kp, double kd, int16_t min_current, int16_t max_current, Derivative derivative)
+    : derivative_(derivative),
+      kp_(n, kp),
+      kd_(n, kd),
+      min_current_(n, min_current),
+      max_current_(n, max_current),
+      error_(n, 0.0),
+      previous_(n, 0.0),
+      has_previous_(false) {}
+
+void PdLaw::setGains(size_t i, double kp, double kd, int16_t min_current, int16_t max_current) {
+    kp_[i] = kp;
+    kd_[i] = kd;
+    min_current_[i] = min_current;
+    max_current_[i] = max_current;
+}
+
+void PdLaw::reset() {
+    for (size_t i = 0; i < previous_.size(); i++) {
+        previous_[i] = 0.0;
+        error_[i] = 0.0;
+    }
+    has_previous_ = false;
+}
+
+void PdLaw::compute(const AxisState& state, double dt, int16_t* goal_current) {
+    // 分岐のない単純なループにしてコンパイラのベクトル化に任せる
+    const size_t n = state.n;
+    const double inv_dt = dt > 0.0 ? 1.0 / dt : 0.0;
+    const double* __restrict target = state.target;
+    const double* __restrict position = state.position;
+    const double* __restrict kp = kp_.data();
+    const double* __restrict kd = kd_.data();
+    const double* __restrict min_current = min_current_.data();
+    const double* __restrict max_current = max_current_.data();
+    double* __restrict error = error_.data();
+    double* __restrict previous = previous_.data();
+    int16_t* __restrict out = goal_current;
+
+    if (derivative_ == Derivative::Error) {
+        // 前回誤差の初期値は 0（従来の current_control2 と同じ）
+        for (size_t i = 0; i < n; i++) {
+            double e = target[i] - position[i];
+            double output = kp[i] * e + kd[i] * (e - previous[i]) * inv_dt;
+            output = output < max_current[i] ? output : max_current[i];
+            output = output > min_current[i] ? output : min_current[i];
+            out[i] = static_cast<int16_t>(output);
+            previous[i] = e;
+            error[i] = e;
+        }
+    } else {
+        // 初回は速度 0 とみなす
+        const double rate = has_previous_ ? inv_dt : 0.0;
+        for (size_t i = 0; i < n; i++) {
+            double e = target[i] - position[i];
+            double velocity = (position[i] - previous[i]) * rate;
+            double output = kp[i] * e - kd[i] * velocity;
+            output = output < max_current[i] ? output : max_current[i];
+            output = output > min_current[i] ? output : min_current[i];
+            out[i] = static_cast<int16_t>(output);
+            previous[i] = position[i];
+            error[i] = e;
+        }
+    }
+    has_previous_ = true;
+}
+
+PidLaw::PidLaw(size_t n, const Gains& gains, PdLaw::Derivative derivative)
+    : mode_(derivative),
+      isa_(pidIsa(n)),
+      kp_(n, gains.kp),
+      ki_(n, gains.ki),
+      kd_(n, gains.kd),
+      tau_(n, gains.tau),
+      min_current_(n, gains.min_current),
+      max_current_(n, gains.max_current),
+      integral_(n, 0.0),
+      derivative_(n, 0.0),
+      previous_(n, 0.0),
+      error_(n, 0.0),
+      zero_feedforward_(n, 0.0),
+      has_previous_(false) {}
+
+void PidLaw::setGains(size_t i, const Gains& gains) {
+    // 直前の出力 kp*e + kd*d + i を保つように積分を付け替える
+    integral_[i] += (kp_[i] - gains.kp) * error_[i] + (kd_[i] - gains.kd) * derivative_[i];
+    double hi = gains.max_current > 0 ? gains.max_current : 0.0;
+    double lo = gains.min_current < 0 ? gains.min_current : 0.0;
+    integral_[i] = integral_[i] < hi ? integral_[i] : hi;
+    integral_[i] = integral_[i] > lo ? integral_[i] : lo;
+    kp_[i] = gains.kp;
+    ki_[i] = gains.ki;
+    kd_[i] = gains.kd;
+    tau_[i] = gains.tau;
+    min_current_[i] = gains.min_current;
+    max_current_[i] = gains.max_current;
+}
+
+void PidLaw::reset() {
+    for (size_t i = 0; i < integral_.size(); i++) {
+        integral_[i] = 0.0;
+        derivative_[i] = 0.0;
+        previous_[i] = 0.0;
+        error_[i] = 0.0;
+    }
+    has_previous_ = false;
+}
+
+void PidLaw::compute(const AxisState& state, double dt, int16_t* goal_current) {
+    // 初回は微分を 0 とみなす。dt が 0 以下（時刻が進んでいない）なら微分・積分とも据え置く
+    const bool measurement = mode_ == PdLaw::Derivative::Measurement;
+    if (dt < 0.0) {
+        dt = 0.0;
+    }
+    double rate = has_previous_ && dt > 0.0 ? 1.0 / dt : 0.0;
+    if (measurement) {
+        rate = -rate;
+    }
+    const double* feedforward = state.feedforward ? state.feedforward : zero_feedforward_.data();
+    pidStep(isa_, lanes(), state.target, state.position, feedforward, dt, rate, measurement, goal_current,
+            error_.data());
+    has_previous_ = true;
+}
@@ -0,0 +1,125 @@
+#ifndef CONTROL_LAW_H_
+#define CONTROL_LAW_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "pid_kernel.h"
+
+// 制御則への入力（関節ごとの連続配列。並びは AxisController のIDの並び）
+struct AxisState {
+    size_t n;
+    const double* target;     // 目標位置
+    const double* position;   // 現在位置
+    const double* feedforward = nullptr;  // 目標電流に足す補正（PidLaw だけが使う。nullptr なら 0）
+};
+
+// 目標位置と現在位置から目標電流を求める制御則の共通インターフェース。
+// compute() は制御周期ごとに呼ばれるので、中でメモリ確保や入出力をしないこと。
+class ControlLaw {
+public:
+    virtual ~ControlLaw() {}
+
+    // 内部状態（前回値など）を消す
+    virtual void reset() = 0;
+
+    // dt は前回の compute() からの経過時間 [s]
+    virtual void compute(const AxisState& state, double dt, int16_t* goal_current) = 0;
+};
+
+// 位置PD制御。出力は [min_current, max_current] に制限する
+class PdLaw : public ControlLaw {
+public:
+    enum class Derivative {
+        Error,        // 誤差の変化率（current_control2）
+        Measurement,  // 位置の変化率にマイナスを掛ける（current.cpp。目標の段差で跳ねない）
+    };
+
+    PdLaw(size_t n, double kp, double kd, int16_t min_current, int16_t max_current,
+          Derivative derivative = Derivative::Error);
+
+    void setGains(size_t i, double kp, double kd, int16_t min_current, int16_t max_current);
+
+    void reset() override;
+    void compute(const AxisState& state, double dt, int16_t* goal_current) override;
+
+    // 直近の compute() の誤差
+    double error(size_t i) const { return error_[i]; }
+
+private:
+    Derivative derivative_;
+    std::vector<double> kp_;
+    std::vector<double> kd_;
+    std::vector<double> min_current_;
+    std::vector<double> max_current_;
+    std::vector<double> error_;
+    std::vector<double> previous_;   // 前回の誤差または位置
+    bool has_previous_;
+};
+
+// 位置PID制御（積分のアンチワインドアップ・微分の一次ローパスつき）。全関節を pid_kernel で一度に計算する。
+// 出力は [min_current, max_current] に制限する（上下非対称でもよい）。
+class PidLaw : public ControlLaw {
+public:
+    struct Gains {
+        double kp;
+        double ki;
+        double kd;
+        double tau;            // 微分フィルタの時定数 [s]（0 ならフィルタなし）
+        int16_t min_current;
+        int16_t max_current;
+    };
+
+    PidLaw(size_t n, const Gains& gains, PdLaw::Derivative derivative = PdLaw::Derivative::Measurement);
+
+    // 運転中に変えても出力が跳ねないよう、P・D 項の変化分を積分に移す（バンプレス切り替え）
+    void setGains(size_t i, const Gains& gains);
+
+    void reset() override;
+    void compute(const AxisState& state, double dt, int16_t* goal_current) override;
+
+    double error(size_t i) const { return error_[i]; }
+    double integral(size_t i) const { return integral_[i]; }
+    PidIsa isa() const { return isa_; }
+
+private:
+    PidLanes lanes() {
+        return {kp_.size(),          kp_.data(),          ki_.data(),       kd_.data(),
+                tau_.data(),         min_current_.data(), max_current_.data(),
+                integral_.data(),    derivative_.data(),  previous_.data()};
+    }
+
+    PdLaw::Derivative mode_;
+    PidIsa isa_;
+    std::vector<double> kp_;
+    std::vector<double> ki_;
+    std::vector<double> kd_;
+    std::vector<double> tau_;
+    std::vector<double> min_current_;
+    std::vector<double> max_current_;
+    std::vector<double> integral_;
+    std::vector<double> derivative_;
+    std::vector<double> previous_;
+    std::vector<double> error_;
+    std::vector<double> zero_feedforward_;
+    bool has_previous_;
+};
+
+// 常に一定の目標電流を出す（current_control）
+class ConstantCurrentLaw : public ControlLaw {
+public:
+    explicit ConstantCurrentLaw(int16_t current) : current_(current) {}
+
+    void reset() override {}
+    void compute(const AxisState& state, double, int16_t* goal_current) override {
+        for (size_t i = 0; i < state.n; i++) {
+            goal_current[i] = current_;
+        }
+    }
+
+private:
+    int16_t current_;
+};
+
+#endif  // CONTROL_LAW_H_
@@ -0,0 +1,222 @@
+#include "control_runtime.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <iostream>
+
+namespace {
+
+const int64_t NSEC_PER_SEC = 1000000000LL;
+const int MAX_EVENTS = 4 + RUNTIME_MAX_HANGUP;
+
+int64_t monotonicNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+// glibc 2.35 より前には epoll_pwait2 の関数が無いので、システムコールを直接呼ぶ
+int epollPwait2(int epoll_fd, struct epoll_event* events, int max_events, const struct timespec* timeout) {
+#ifdef SYS_epoll_pwait2
+    return static_cast<int>(syscall(SYS_epoll_pwait2, epoll_fd, events, max_events, timeout, nullptr, 0));
+#else
+    (void)epoll_fd;
+    (void)events;
+    (void)max_events;
+    (void)timeout;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+void sleepUntil(int64_t deadline_ns) {
+    struct timespec wake = {static_cast<time_t>(deadline_ns / NSEC_PER_SEC),
+                            static_cast<long>(deadline_ns % NSEC_PER_SEC)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) == EINTR) {
+    }
+}
+
+const char* signalName(int signo) {
+    switch (signo) {
+    case SIGINT: return "SIGINT";
+    case SIGTERM: return "SIGTERM";
+    case SIGHUP: return "SIGHUP";
+    default: return "signal";
+    }
+}
+
+bool addFd(int epoll_fd, int fd, uint32_t events) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+}  // namespace
+
+ControlRuntime::ControlRuntime()
+    : epoll_fd_(-1),
+      signal_fd_(-1),
+      timer_fd_(-1),
+      use_pwait2_(false),
+      hangup_count_(0),
+      stop_reason_(nullptr) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &mask, &old_mask_);
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    signal_fd_ = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (epoll_fd_ < 0 || signal_fd_ < 0 || !addFd(epoll_fd_, signal_fd_, EPOLLIN)) {
+        std::cerr << "epoll / signalfd の準備に失敗しました: " << strerror(errno) << std::endl;
+        if (epoll_fd_ >= 0) close(epoll_fd_);
+        epoll_fd_ = -1;
+        return;
+    }
+    // 通常のファイルやリダイレクトされた /dev/null は epoll に入らない（その場合は見ない）
+    addFd(epoll_fd_, STDIN_FILENO, EPOLLIN);
+
+    struct epoll_event events[MAX_EVENTS];
+    struct timespec zero = {0, 0};
+    use_pwait2_ = epollPwait2(epoll_fd_, events, MAX_EVENTS, &zero) >= 0 || errno != ENOSYS;
+    if (!use_pwait2_) {
+        timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timer_fd_ < 0 || !addFd(epoll_fd_, timer_fd_, EPOLLIN)) {
+            std::cerr << "timerfd の準備に失敗しました: " << strerror(errno) << std::endl;
+            close(epoll_fd_);
+            epoll_fd_ = -1;
+        }
+    }
+}
+
+ControlRuntime::~ControlRuntime() {
+    // 受け取っていないシグナルを読み捨ててからマスクを戻す（戻した途端に既定の動作で落ちないように）
+    if (signal_fd_ >= 0) {
+        struct signalfd_siginfo info;
+        while (read(signal_fd_, &info, sizeof(info)) == static_cast<ssize_t>(sizeof(info))) {
+        }
+        close(signal_fd_);
+    }
+    if (timer_fd_ >= 0) close(timer_fd_);
+    if (epoll_fd_ >= 0) close(epoll_fd_);
+    pthread_sigmask(SIG_SETMASK, &old_mask_, nullptr);
+}
+
+void ControlRuntime::watchHangup(int fd, const char* name) {
+    if (epoll_fd_ < 0 || fd < 0 || hangup_count_ >= RUNTIME_MAX_HANGUP) {
+        return;
+    }
+    // events = 0 でも EPOLLHUP / EPOLLERR は必ず報告される
+    if (addFd(epoll_fd_, fd, 0)) {
+        hangup_fd_[hangup_count_] = fd;
+        hangup_name_[hangup_count_] = name;
+        hangup_count_++;
+    }
+}
+
+void ControlRuntime::requestStop(const char* reason) {
+    if (!stop_reason_) {
+        snprintf(reason_, sizeof(reason_), "%s", reason);
+        stop_reason_ = reason_;
+    }
+}
+
+bool ControlRuntime::armTimer(int64_t deadline_ns) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = static_cast<time_t>(deadline_ns / NSEC_PER_SEC);
+    spec.it_value.tv_nsec = static_cast<long>(deadline_ns % NSEC_PER_SEC);
+    return timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) == 0;
+}
+
+void ControlRuntime::dispatch(int64_t timeout_ns) {
+    struct epoll_event events[MAX_EVENTS];
+    int n;
+    if (use_pwait2_) {
+        struct timespec timeout;
+        timeout.tv_sec = static_cast<time_t>(timeout_ns / NSEC_PER_SEC);
+        timeout.tv_nsec = static_cast<long>(timeout_ns % NSEC_PER_SEC);
+        n = epollPwait2(epoll_fd_, events, MAX_EVENTS, timeout_ns < 0 ? nullptr : &timeout);
+    } else {
+        n = epoll_wait(epoll_fd_, events, MAX_EVENTS, timeout_ns == 0 ? 0 : -1);
+    }
+    for (int k = 0; k < n; k++) {
+        int fd = events[k].data.fd;
+        if (fd == signal_fd_) {
+            struct signalfd_siginfo info;
+            while (read(signal_fd_, &info, sizeof(info)) == static_cast<ssize_t>(sizeof(info))) {
+                requestStop(signalName(static_cast<int>(info.ssi_signo)));
+            }
+        } else if (fd == STDIN_FILENO) {
+            char buf[256];
+            ssize_t r = read(STDIN_FILENO, buf, sizeof(buf));
+            if (r > 0) {
+                requestStop("key pressed");
+            } else if (r == 0) {
+                epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, STDIN_FILENO, nullptr);  // EOF。以後は見ない
+            }
+        } else if (fd == timer_fd_) {
+            uint64_t expirations;
+            ssize_t r = read(timer_fd_, &expirations, sizeof(expirations));
+            (void)r;
+        } else if (events[k].events & (EPOLLHUP | EPOLLERR)) {
+            for (int h = 0; h < hangup_count_; h++) {
+                if (hangup_fd_[h] != fd) {
+                    continue;
+                }
+                char reason[64];
+                snprintf(reason, sizeof(reason), "%s hung up", hangup_name_[h]);
+                requestStop(reason);
+                epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+                hangup_fd_[h] = -1;
+            }
+        }
+    }
+}
+
+bool ControlRuntime::poll() {
+    if (epoll_fd_ >= 0 && !stop_reason_) {
+        dispatch(0);
+    }
+    return !stop_reason_;
+}
+
+bool ControlRuntime::waitUntil(int64_t deadline_ns) {
+    if (epoll_fd_ < 0) {
+        sleepUntil(deadline_ns);
+        return !stop_reason_;
+    }
+    while (!stop_reason_) {
+        int64_t remaining = deadline_ns - monotonicNow();
+        if (remaining <= 0) {
+            // 遅れているときは待たずに届いているものだけ見る（周期超過のときだけ1回増える）
+            dispatch(0);
+            break;
+        }
+        if (use_pwait2_) {
+            dispatch(remaining);
+        } else if (armTimer(deadline_ns)) {
+            dispatch(-1);
+        } else {
+            sleepUntil(deadline_ns);
+            dispatch(0);
+            break;
+        }
+        if (monotonicNow() >= deadline_ns) {
+            break;
+        }
+    }
+    return !stop_reason_;
+}
@@ -0,0 +1,57 @@
+#ifndef CONTROL_RUNTIME_H_
+#define CONTROL_RUNTIME_H_
+
+#include <signal.h>
+#include <stdint.h>
+
+#define RUNTIME_MAX_HANGUP            8      // watchHangup() で見られる fd の数
+
+// 制御プログラムの待ち合わせ（周期の待ち・キーボード・シグナル・ポートの切断）を1つの epoll にまとめる。
+//   - SIGINT / SIGTERM / SIGHUP はマスクして signalfd で受ける。main の最初（スレッドを作る前）に作ること
+//     （マスクは以後に作るスレッドに継承されるので、どのスレッドにも非同期には届かない）
+//   - 標準入力に何か届いたら停止（端末が通常モードなら Enter、setTerminalMode(true) なら任意のキー）。
+//     EOF になったら以後は見ない
+//   - watchHangup() で渡した fd（シリアルポート）が切断・エラーになったら停止
+// 周期の待ちは epoll_pwait2 のナノ秒タイムアウトで行うので、何も起きなければ1周期のシステムコールは
+// clock_nanosleep と同じ1回だけ。epoll_pwait2 の無いカーネルでは timerfd で待つ（設定と読み出しの分2回増える）。
+class ControlRuntime {
+public:
+    ControlRuntime();
+    ~ControlRuntime();
+    ControlRuntime(const ControlRuntime&) = delete;
+    ControlRuntime& operator=(const ControlRuntime&) = delete;
+
+    bool ok() const { return epoll_fd_ >= 0; }
+
+    // fd の切断（EPOLLHUP / EPOLLERR）を停止要求として扱う。読み込み可能になっても起こさない。
+    // RUNTIME_MAX_HANGUP 個まで（バスごとに1つ）。name は停止要求の理由に使うので、ランタイムより長く生かすこと
+    void watchHangup(int fd, const char* name);
+
+    // CLOCK_MONOTONIC の deadline_ns まで待つ。その間（または待つ前）に停止要求が来たら false
+    bool waitUntil(int64_t deadline_ns);
+
+    // 待たずに届いているイベントだけを処理する。停止要求があれば false
+    bool poll();
+
+    void requestStop(const char* reason);
+    bool stopRequested() const { return stop_reason_ != nullptr; }
+    const char* stopReason() const { return stop_reason_ ? stop_reason_ : ""; }
+
+private:
+    // イベントを1回待って処理する。timeout_ns < 0 なら無期限、0 なら待たない
+    void dispatch(int64_t timeout_ns);
+    bool armTimer(int64_t deadline_ns);
+
+    int epoll_fd_;
+    int signal_fd_;
+    int timer_fd_;            // epoll_pwait2 が使えないときだけ作る
+    bool use_pwait2_;
+    int hangup_fd_[RUNTIME_MAX_HANGUP];
+    const char* hangup_name_[RUNTIME_MAX_HANGUP];
+    int hangup_count_;
+    sigset_t old_mask_;
+    const char* stop_reason_;
+    char reason_[64];
+};
+
+#endif  // CONTROL_RUNTIME_H_
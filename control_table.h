@@ -0,0 +1,13 @@
+#ifndef CONTROL_TABLE_H_
+#define CONTROL_TABLE_H_
+
+// XM430（Protocol 2.0）の設定値。レジスタのアドレス・幅は xm430_registers.h の型付き定義を使う。
+#include "xm430_registers.h"
+
+#define PROTOCOL_VERSION              2.0
+
+#define TORQUE_ENABLE                 1
+#define TORQUE_DISABLE                0
+#define CURRENT_CONTROL_MODE          0
+
+#endif  // CONTROL_TABLE_H_
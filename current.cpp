@@ -1,219 +1,320 @@
 #include <iostream>
-#include <vector>
 #include <chrono>
-#include <unistd.h>
 #include <iomanip>
-#include <fstream>
-#include <ctime>
-#include <termios.h>
-#include <fcntl.h>
-#include "dynamixel_sdk.h"
+#include <stdlib.h>
+#include <string.h>
+#include "dxl_bus.h"
+#include "alloc_check.h"
+#include "control_law.h"
+#include "control_runtime.h"
+#include "event_log.h"
+#include "feedforward.h"
+#include "run_util.h"
+#include "periodic_executor.h"
+#include "async_logger.h"
+#include "binlog.h"
+#include "bus_pipeline.h"
+#include "health_monitor.h"
+#include "latency_histogram.h"
+#include "link_monitor.h"
+#include "stream_stats.h"
+#include "trajectory.h"
 
-#define PROTOCOL_VERSION 2.0
 #define DEVICENAME "/dev/ttyUSB0" // ポート名
 #define BAUDRATE 57600             // ボーレート
 #define DXL_ID 1
 
-// 制御テーブルアドレス
-#define ADDR_OPERATING_MODE 11   // 動作モード
-#define ADDR_TORQUE_ENABLE 64    // トルクの有効/無効
-#define ADDR_CURRENT_LIMIT 38    // 電流制限
-#define ADDR_GOAL_CURRENT 102    // 目標電流
-#define ADDR_PRESENT_CURRENT 126 // 現在の電流
-#define ADDR_PRESENT_POSITION 132 // 現在の角度
-
-#define OPERATING_MODE_CURRENT 0 // 電流制御モード
-#define TORQUE_ENABLE 1
-#define TORQUE_DISABLE 0
-
 #define P_GAIN 1.0               // Pゲイン
+#define I_GAIN 0.0               // Iゲイン
 #define D_GAIN 0.1               // Dゲイン
+#define D_FILTER_TAU 0.03        // 微分フィルタの時定数（3周期。周期の揺れで微分が跳ねないようにする）
 #define MAX_CURRENT 20           // 最大電流（20 mA）
 #define TARGET_POSITION 1024     // 目標角度（エンコーダ値で90度相当）
 #define DURATION 3.0             // 制御の持続時間（3秒）
-
-using namespace dynamixel;
-
-struct DataRecord {
-    double time;
-    int16_t current;
-    int32_t position;
-};
-
-// 現在時刻を取得し、YYYYMMDDHHMMSS形式の文字列を返す関数
-std::string getCurrentTimestamp() {
-    auto now = std::chrono::system_clock::now();
-    auto in_time_t = std::chrono::system_clock::to_time_t(now);
-    std::tm buf;
-    localtime_r(&in_time_t, &buf);
-
-    std::ostringstream oss;
-    oss << std::put_time(&buf, "%Y%m%d%H%M%S");
-    return oss.str();
-}
-
-// キーボード入力を非ブロッキングで監視する関数
-int kbhit(void) {
-    struct termios oldt, newt;
-    int ch;
-    int oldf;
-
-    tcgetattr(STDIN_FILENO, &oldt);
-    newt = oldt;
-    newt.c_lflag &= ~(ICANON | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
-
-    oldf = fcntl(STDIN_FILENO, F_GETFL, 0);
-    fcntl(STDIN_FILENO, F_SETFL, oldf | O_NONBLOCK);
-
-    ch = getchar();
-
-    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
-    fcntl(STDIN_FILENO, F_SETFL, oldf);
-
-    if (ch != EOF) {
-        ungetc(ch, stdin);
-        return 1;
-    }
-
-    return 0;
-}
+#define CONTROL_PERIOD 0.01      // 制御周期（100Hz）
+#define MAX_EVENTS 256           // 制御ループ中に記録する通信エラーの上限
 
 int main() {
-    PortHandler *portHandler = PortHandler::getPortHandler(DEVICENAME);
-    PacketHandler *packetHandler = PacketHandler::getPacketHandler(PROTOCOL_VERSION);
+    // キー入力・Ctrl-C（SIGINT）・SIGTERM・ポートの切断を周期の待ちと一緒に受ける（スレッドを作る前に用意する）
+    ControlRuntime runtime;
 
-    if (!portHandler->openPort()) {
+    DxlBus bus;
+    if (!bus.open(DEVICENAME, {DXL_ID}, BAUDRATE)) {
         std::cerr << "Failed to open port!" << std::endl;
         return 1;
     }
-
-    if (!portHandler->setBaudRate(BAUDRATE)) {
-        std::cerr << "Failed to set baudrate!" << std::endl;
+    const BaudCalibration& baud = bus.baud();
+    runtime.watchHangup(bus.fd(), "serial port");
+
+    // 失敗したやり取りは周期の残り時間に収まる範囲で送り直し、読めなければ前回値で続ける。
+    // DXL_FAIL_LIMIT 周期（既定 5）続けて読めなければ安全停止する（DXL_RETRIES で送り直す上限を変えられる）
+    LinkMonitor link({DXL_ID}, retryConfigFromEnv());
+    bus.setMonitor(&link);
+
+    // データはリングに積み、専用スレッドで書き出す（3秒 × 100Hz ぶんを最初に確保する）
+    // （DXL_LOG_FORMAT=binary でバイナリ形式。binlog2csv で同じCSVに戻せる）
+    BinLogHeader log_header = makeBinLogHeader(LAYOUT_CURRENT_DATA, {DXL_ID}, 1.0 / CONTROL_PERIOD);
+    log_header.baudrate = baud.baudrate;
+    log_header.rtt_p50_us = baud.rtt_p50_us;
+    log_header.rtt_p99_us = baud.rtt_p99_us;
+    log_header.packet_error_rate = baud.error_rate;
+    log_header.kp = P_GAIN;
+    log_header.ki = I_GAIN;
+    log_header.kd = D_GAIN;
+    log_header.max_current = MAX_CURRENT;
+    log_header.min_current = -MAX_CURRENT;
+    AsyncLogger logger(logCapacityFor(DURATION, CONTROL_PERIOD));
+    std::string filename;
+    if (!openRunLog(logger, "./current_data/" + currentTimestamp() + "_data", log_header, filename)) {
+        std::cerr << "Failed to open file for writing!" << std::endl;
         return 1;
     }
 
-    uint8_t error = 0;
-    int dxl_comm_result = packetHandler->write1ByteTxRx(portHandler, DXL_ID, ADDR_OPERATING_MODE, OPERATING_MODE_CURRENT, &error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-    } else if (error != 0) {
-        std::cerr << packetHandler->getRxPacketError(error) << std::endl;
-    } else {
+    DxlMotor motor(bus, DXL_ID);
+    if (motor.setOperatingMode(CURRENT_CONTROL_MODE)) {
         std::cout << "Operating mode set to Current Control Mode." << std::endl;
     }
 
-    dxl_comm_result = packetHandler->write1ByteTxRx(portHandler, DXL_ID, ADDR_TORQUE_ENABLE, TORQUE_ENABLE, &error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-    } else if (error != 0) {
-        std::cerr << packetHandler->getRxPacketError(error) << std::endl;
-    } else {
-        std::cout << "Torque enabled." << std::endl;
+    // 電流制限を設定（20 mA）。EEPROM なのでトルクを入れる前に書く
+    if (!motor.setCurrentLimit(MAX_CURRENT)) {
+        return 1;
     }
 
-    // 電流制限を設定（20 mA）
-    int16_t current_limit = MAX_CURRENT; // 最大電流を20mAに設定
-    dxl_comm_result = packetHandler->write2ByteTxRx(portHandler, DXL_ID, ADDR_CURRENT_LIMIT, current_limit, &error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-        return 1;
+    // ここから先はどの経路で抜けても目標電流0・トルクOFFにする
+    MotorGuard guard(bus, {DXL_ID});
+    if (motor.setTorque(true)) {
+        std::cout << "Torque enabled." << std::endl;
     }
 
-    // データ記録用
-    std::vector<DataRecord> data_log;
-    auto start_time = std::chrono::steady_clock::now(); // 計測開始時間
     int32_t initial_position = 0;
-    dxl_comm_result = packetHandler->read4ByteTxRx(portHandler, DXL_ID, ADDR_PRESENT_POSITION, (uint32_t*)&initial_position, &error);
-
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
+    if (!motor.readPosition(initial_position)) {
         return 1;
     }
 
-    int32_t previous_position = initial_position;
-    double previous_time = 0.0;
-
-    while (true) {
-        // キーボード入力があればループを抜ける
-        if (kbhit()) {
-            std::cout << "Key pressed! Stopping the motor." << std::endl;
-            break;
-        }
-
-        auto current_time = std::chrono::steady_clock::now();
-        double elapsed_time = std::chrono::duration<double>(current_time - start_time).count();
-
-        // 3秒経過したらループを抜ける
-        if (elapsed_time >= DURATION) {
-            std::cout << "3 seconds elapsed. Stopping the motor." << std::endl;
-            break;
-        }
-
-        // 目標角度との差を計算
-        int32_t target_position = initial_position + static_cast<int32_t>(TARGET_POSITION * (elapsed_time / DURATION));
-        if (target_position > initial_position + TARGET_POSITION) {
-            target_position = initial_position + TARGET_POSITION; // 90度を超えないように
-        }
-
-        int32_t present_position = 0;
-        dxl_comm_result = packetHandler->read4ByteTxRx(portHandler, DXL_ID, ADDR_PRESENT_POSITION, (uint32_t*)&present_position, &error);
-        if (dxl_comm_result != COMM_SUCCESS) {
-            std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-            break;
-        }
-
-        // 角度の差と速度（角度の変化率）を計算
-        int32_t position_error = target_position - present_position;
-        double velocity = (present_position - previous_position) / (elapsed_time - previous_time);
-
-        // PD制御による電流指令を計算
-        int16_t goal_current = static_cast<int16_t>(P_GAIN * position_error - D_GAIN * velocity);
-        if (goal_current > MAX_CURRENT) goal_current = MAX_CURRENT;
-        if (goal_current < -MAX_CURRENT) goal_current = -MAX_CURRENT;
-
-        // 電流指令を送信
-        dxl_comm_result = packetHandler->write2ByteTxRx(portHandler, DXL_ID, ADDR_GOAL_CURRENT, goal_current, &error);
-        if (dxl_comm_result != COMM_SUCCESS) {
-            std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-            break;
-        }
-
-        // 現在の電流を取得
-        int16_t present_current = 0;
-        dxl_comm_result = packetHandler->read2ByteTxRx(portHandler, DXL_ID, ADDR_PRESENT_CURRENT, (uint16_t*)&present_current, &error);
-        if (dxl_comm_result != COMM_SUCCESS) {
-            std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-            break;
-        }
-
-        // データを記録
-        data_log.push_back({elapsed_time, present_current, present_position});
-
-        // 次のループに備えて更新
-        previous_position = present_position;
-        previous_time = elapsed_time;
-
-        usleep(10000); // 10ms待機（100Hz）
+    // 目標角度（3秒かけて90度。終点を超えないよう表の最後の点に留まる）
+    // DXL_TRAJECTORY=linear（既定）/ minjerk / trapezoid / spline / <file.traj> で軌道の形を選ぶ
+    // DXL_FEEDFORWARD=<model.txt>（fit_feedforward の出力）があれば、その電流を表に入れておく
+    std::vector<FeedforwardModel> feedforward_models;
+    if (!feedforwardFromEnv(1, feedforward_models)) {
+        return 1;
     }
-
-    // トルクを無効化してモータを停止
-    dxl_comm_result = packetHandler->write1ByteTxRx(portHandler, DXL_ID, ADDR_TORQUE_ENABLE, TORQUE_DISABLE, &error);
-    portHandler->closePort();
-
-    // データをCSVファイルに保存
-    std::string filename = "./current_data/" + getCurrentTimestamp() + "_data.csv";
-    std::ofstream file(filename);
-    if (file.is_open()) {
-        file << "Time (s),Current (mA),Position\n";
-        for (const auto &record : data_log) {
-            file << record.time << "," << record.current << "," << record.position << "\n";
+    std::unique_ptr<Trajectory> trajectory =
+        trajectoryFromEnv({TARGET_POSITION}, DURATION, feedforward_models, {static_cast<double>(initial_position)});
+    if (!trajectory) {
+        return 1;
+    }
+    TrajectoryPoint point;
+    double feedforward = 0.0;
+    auto targetPosition = [&](double elapsed_time) {
+        trajectory->lookup(elapsed_time, &point);
+        feedforward = point.feedforward;
+        return initial_position + point.position;
+    };
+
+    // PID制御による電流指令（D項は位置の変化率をローパスに通して取る）
+    PidLaw law(1, {P_GAIN, I_GAIN, D_GAIN, D_FILTER_TAU, -MAX_CURRENT, MAX_CURRENT}, PdLaw::Derivative::Measurement);
+    double target = 0.0;
+    double position = 0.0;
+    AxisState state = {1, &target, &position, &feedforward};
+    int16_t goal_current = 0;
+
+    // DXL_PIPELINE=1 ならバス入出力を専用スレッドに任せ、制御ループは最新値の受け渡しだけを行う
+    const char* pipeline_env = getenv("DXL_PIPELINE");
+    bool pipelined = pipeline_env && strcmp(pipeline_env, "1") == 0;
+
+    // 100Hzの固定周期で実行（usleepと違い、I/O時間が周期に上乗せされない）
+    PeriodicExecutor executor(executorConfigFromEnv(CONTROL_PERIOD));
+    executor.setRuntime(&runtime);
+    LatencyHistogram sense_to_actuate;  // 位置を読み終えてから電流指令を送り終えるまで
+    double last_elapsed = 0.0;
+
+    // ループ中の通信エラーは固定長の記録に溜め、ループを抜けてから表示する
+    EventLog events(MAX_EVENTS);
+    bus.setEventLog(&events);
+
+    // DXL_ALLOC_CHECK=1 なら、2周目以降にヒープ確保が起きたら失敗にする
+    AllocCheck alloc_check(allocCheckFromEnv());
+
+    // 電流・追従誤差・処理時間をループの中で集計し、端末なら状態行を出す
+    // （DXL_STOP_CURRENT / DXL_STOP_ERROR_DEG / DXL_STOP_CYCLE_MS を超えたら安全停止）
+    LoopStats stats({DXL_ID}, streamLimitsFromEnv());
+    const double deg_per_tick = 360.0 / 4096.0;
+    auto endCycle = [&](std::chrono::steady_clock::time_point body_start, const CycleInfo& cycle) {
+        stats.addCycle(std::chrono::duration<double>(std::chrono::steady_clock::now() - body_start).count(),
+                       cycle.period_s);
+        stats.printStatus(cycle.elapsed_s);
+        if (!stats.check()) {
+            runtime.requestStop(stats.stopReason());
+            return false;
         }
-        file.close();
-        std::cout << "Data saved to " << filename << std::endl;
+        return true;
+    };
+
+    if (pipelined) {
+        BusPipeline pipeline(bus.port(), bus.packet(), {DXL_ID});
+        pipeline.setMonitor(&link);
+        PipelineSample sample;
+        sample.seq = 0;
+        double previous_sample_time = 0.0;
+
+        pipeline.start(&alloc_check);
+        executor.run([&](const CycleInfo& cycle) {
+            auto body_start = std::chrono::steady_clock::now();
+            if (cycle.cycle == 1) {
+                alloc_check.arm();  // 1周目の初回確保は数えない
+            }
+
+            double elapsed_time = cycle.elapsed_s;
+            last_elapsed = elapsed_time;
+            if (elapsed_time >= DURATION) {
+                std::cout << "3 seconds elapsed. Stopping the motor." << std::endl;
+                return false;
+            }
+
+            // 新しいサンプルが無ければ前回の指令をそのまま出し直す
+            bool fresh = pipeline.latest(sample);
+            if (sample.seq == 0) {
+                return true;  // まだ一度も読めていない
+            }
+            if (fresh && sample.link_lost) {
+                runtime.requestStop(link.escalation());  // バススレッドが publish より前に書いた理由なので読んでよい
+                return false;
+            }
+            if (fresh && sample.stale) {
+                events.record(DXL_ID, "Sync Read", sample.comm_result, 0);
+            }
+            if (fresh && !sample.stale) {
+                target = targetPosition(elapsed_time);
+                position = sample.position[0];
+                law.compute(state, sample.time - previous_sample_time, &goal_current);
+                stats.addJoint(0, sample.current[0], (target - position) * deg_per_tick, sample.time - previous_sample_time);
+                previous_sample_time = sample.time;
+            }
+            pipeline.command(&goal_current, sample.time);
+
+            LogSample log_sample;
+            log_sample.time = elapsed_time;
+            log_sample.num_motors = 1;
+            log_sample.current[0] = sample.current[0];
+            log_sample.position[0] = sample.position[0];
+            log_sample.stale = sample.stale;
+            logger.log(log_sample);
+            return endCycle(body_start, cycle);
+        });
+        pipeline.stop();
+        alloc_check.disarm();
+        stats.endStatus();
+        executor.printReport(std::cout);
+        pipeline.printReport(std::cout);
+        sense_to_actuate = pipeline.senseToActuate();
     } else {
-        std::cerr << "Failed to open file for writing!" << std::endl;
+        double previous_time = 0.0;
+        int32_t present_position = initial_position;  // 読めなかった周期はこの値のまま
+        int16_t present_current = 0;
+        // 周期の空き時間に電圧・温度・エラー状態を読み、過熱・過負荷なら電流の上限を下げる
+        // （パイプライン時はバススレッドがポートを持つので監視しない）
+        HealthMonitor health(bus.port(), {DXL_ID}, healthConfigFromEnv(MAX_CURRENT));
+        executor.run([&](const CycleInfo& cycle) {
+            auto body_start = std::chrono::steady_clock::now();
+            if (cycle.cycle == 1) {
+                alloc_check.arm();  // 1周目の初回確保は数えない
+            }
+
+            double elapsed_time = cycle.elapsed_s;
+            last_elapsed = elapsed_time;
+
+            // 3秒経過したらループを抜ける
+            if (elapsed_time >= DURATION) {
+                std::cout << "3 seconds elapsed. Stopping the motor." << std::endl;
+                return false;
+            }
+
+            // 位置が読めなければ古い位置で計算せず、前回の指令をサーボに保たせる
+            link.beginCycle(cycle);
+            bool position_fresh = motor.readPosition(present_position);
+            if (bus.lastError() & STATUS_ERROR_ALERT) {
+                health.notifyAlert(0);
+            }
+            if (position_fresh) {
+                auto sensed = std::chrono::steady_clock::now();
+
+                // PID制御による電流指令を計算して送信
+                target = targetPosition(elapsed_time);
+                position = present_position;
+                law.compute(state, elapsed_time - previous_time, &goal_current);
+                health.limitGoalCurrents(&goal_current);
+                previous_time = elapsed_time;
+                if (motor.setGoalCurrent(goal_current)) {
+                    sense_to_actuate.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - sensed).count());
+                }
+            }
+
+            // 現在の電流を取得（読めなければ前回値）
+            bool current_fresh = motor.readCurrent(present_current);
+            if (current_fresh) {
+                health.observeCurrent(0, present_current, cycle.period_s);
+            }
+            if (position_fresh && current_fresh) {
+                stats.addJoint(0, present_current, (target - position) * deg_per_tick, cycle.period_s);
+            }
+
+            // データを記録（前回値のままの周期は stale を立てる）
+            LogSample sample;
+            sample.time = elapsed_time;
+            sample.num_motors = 1;
+            sample.current[0] = present_current;
+            sample.position[0] = present_position;
+            sample.stale = position_fresh && current_fresh ? 0 : 1;
+            logger.log(sample);
+
+            // 同じモーターが続けて読めなければ安全停止
+            if (!link.endCycle()) {
+                runtime.requestStop(link.escalation());
+                return false;
+            }
+
+            // 余った時間で監視の読み出しを1回（過熱・ハードウェアエラーなら安全停止）
+            if (!health.step(cycle)) {
+                runtime.requestStop(health.stopReason());
+                return false;
+            }
+            return endCycle(body_start, cycle);
+        });
+        alloc_check.disarm();
+        stats.endStatus();
+        executor.printReport(std::cout);
+        health.printReport(std::cout);
+        std::cout << std::fixed << std::setprecision(1)
+                  << "Sense->actuation   [us]  p50: " << sense_to_actuate.percentile(50) / 1e3
+                  << "  p99: " << sense_to_actuate.percentile(99) / 1e3
+                  << "  max: " << sense_to_actuate.max() / 1e3 << std::endl;
+    }
+    if (runtime.stopRequested()) {
+        std::cout << "Stopped: " << runtime.stopReason() << std::endl;
+    }
+    if (last_elapsed > 0.0) {
+        std::cout << std::fixed << std::setprecision(1) << (pipelined ? "Pipelined" : "Serial")
+                  << " control loop: " << executor.cycles() / last_elapsed << " Hz (baseline 100.0 Hz)" << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    stats.printReport(std::cout);
+    link.printReport(std::cout, bus.packet());
+    bus.setEventLog(nullptr);
+    bus.setMonitor(nullptr);
+    events.print(std::cerr, bus.packet());
+    bool no_allocations = alloc_check.report(std::cout);
+
+    // 目標電流を0にしてトルクを無効化（ポートは bus のデストラクタで閉じる）
+    guard.release();
+
+    // 残りのデータを書き出して閉じる
+    logger.close();
+    std::cout << "Data saved to " << filename << " (" << logger.written() << " samples";
+    if (logger.overflows() > 0) {
+        std::cout << ", dropped " << logger.overflows();
     }
+    std::cout << ")" << std::endl;
 
-    return 0;
+    return no_allocations ? 0 : 1;
 }
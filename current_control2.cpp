@@ -1,170 +1,68 @@
-#include "dynamixel_sdk.h"  // Uses Dynamixel SDK library
+#include "dxl_bus.h"  // ポート・モーター・後片付け（libdxlctrl）
+#include "alloc_check.h"
+#include "axis_controller.h"
+#include "bus_group.h"
+#include "control_law.h"
+#include "control_runtime.h"
+#include "cycle_trace.h"
+#include "event_log.h"
+#include "feedforward.h"
+#include "health_monitor.h"
+#include "link_monitor.h"
+#include "periodic_executor.h"
+#include "run_config.h"
+#include "stream_stats.h"
+#include "async_logger.h"
+#include "binlog.h"
+#include "trajectory.h"
 #include <stdio.h>
-#include <termios.h>
-#include <unistd.h>
-#include <fstream>
 #include <chrono>
 #include <string>
 #include <iostream>
 #include <filesystem>
-#include <thread>
-#include <atomic>
 #include <limits>
 #include <cmath>
+#include <vector>
+#include <memory>
+#include <algorithm>
 
-// 制御用のアドレスなど
-#define ADDR_OPERATING_MODE           11                    
-#define ADDR_GOAL_CURRENT             102                   
-#define ADDR_PRESENT_POSITION         132                   
-#define ADDR_PRESENT_CURRENT          126                   
-#define ADDR_TORQUE_ENABLE            64
-#define ADDR_TORQUE_LIMIT             40 // Torque Limitのアドレス（公式Control Tableを確認）
-
-#define PROTOCOL_VERSION              2.0                   
-#define DXL_ID1                       1                     
-#define DXL_ID2                       2                     
+#define DXL_IDS                       {1, 2}                // 環境変数 DXL_IDS=1,2,3,... で上書きできる
 #define BAUDRATE                      57600
 #define DEVICENAME                    "/dev/ttyUSB0"        
-
-#define TORQUE_ENABLE                 1                     
-#define TORQUE_DISABLE                0                     
-#define CURRENT_CONTROL_MODE          0
-
-//エラーを表示
-
-
-std::atomic<bool> stop_flag(false);  // モーター停止フラグ
-
-// エラーコードをビットごとに解析して表示する関数
-void printDxlError(uint8_t error) {
-    if (error == 0) return;
-    std::cerr << "エラー内容: ";
-    if (error & 0x01) std::cerr << "Input Voltage Error ";
-    if (error & 0x02) std::cerr << "Angle Limit Error ";
-    if (error & 0x04) std::cerr << "Overheating Error ";
-    if (error & 0x08) std::cerr << "Range Error ";
-    if (error & 0x10) std::cerr << "Checksum Error ";
-    if (error & 0x20) std::cerr << "Overload Error ";
-    if (error & 0x40) std::cerr << "Instruction Error ";
-    
-    std::cerr << std::endl;
-}
-
-// モーターの位置と電流を取得する関数
-void getMotorData(dynamixel::PacketHandler* packetHandler, dynamixel::PortHandler* portHandler, int id, int32_t& position, int16_t& current) {
-    uint8_t dxl_error = 0;
-    int dxl_comm_result;
-
-    // 現在位置の取得
-    dxl_comm_result = packetHandler->read4ByteTxRx(portHandler, id, ADDR_PRESENT_POSITION, (uint32_t*)&position, &dxl_error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << "Motor " << id << " の位置取得に失敗しました: " << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-    }
-    if (dxl_error != 0) {
-        std::cerr << "Motor " << id << " RxPacketError (Position): " << static_cast<int>(dxl_error) << std::endl;
-        printDxlError(dxl_error);
-    }
-
-    // 現在電流の取得
-    dxl_comm_result = packetHandler->read2ByteTxRx(portHandler, id, ADDR_PRESENT_CURRENT, (uint16_t*)&current, &dxl_error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << "Motor " << id << " の電流取得に失敗しました: " << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-    }
-    if (dxl_error != 0) {
-        std::cerr << "Motor " << id << " RxPacketError (Current): " << static_cast<int>(dxl_error) << std::endl;
-        printDxlError(dxl_error);
-    }
-}
+#define MAX_EVENTS                    256                   // 制御ループ中に記録する通信エラーの上限
+
+// 1本のシリアルポートとそこにつながる関節の制御一式（バスごとに I/O スレッドが読み書きする）
+struct BusLane {
+    BusSpec spec;
+    size_t first = 0;                          // 全関節の並びでの先頭の番号
+    DxlBus bus;
+    std::unique_ptr<LinkMonitor> link;
+    std::unique_ptr<MotorGuard> guard;
+    std::unique_ptr<PidLaw> law;
+    std::unique_ptr<AxisController> axes;
+    std::unique_ptr<HealthMonitor> health;
+    int read_result = COMM_SUCCESS;            // その周期の Sync Read / Sync Write の結果
+    int write_result = COMM_SUCCESS;
+    bool link_ok = true;                       // false なら安全停止（続けて読めない関節がある / 監視が止めた）
+    bool health_ok = true;
+};
 
 // モーターの設定を行う関数
-bool setupMotor(dynamixel::PacketHandler* packetHandler, dynamixel::PortHandler* portHandler, int id) {
-    uint8_t dxl_error = 0;
-    int dxl_comm_result;
+bool setupMotor(DxlBus& bus, uint8_t id, int16_t current_limit) {
+    DxlMotor motor(bus, id);
 
-    std::cout << "Setting up motor ID: " << id << std::endl;
+    std::cout << "Setting up motor ID: " << static_cast<int>(id) << std::endl;
 
     // 1. トルクを無効化
-    dxl_comm_result = packetHandler->write1ByteTxRx(portHandler, id, ADDR_TORQUE_ENABLE, TORQUE_DISABLE, &dxl_error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << "Motor " << id << " のTorque Disableに失敗しました: " 
-                  << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-        return false;
-    }
-    if (dxl_error != 0) {
-        std::cerr << "Motor " << id << " RxPacketError (Torque Disable): " << static_cast<int>(dxl_error) << std::endl;
-        printDxlError(dxl_error);
-        return false;
-    }
-
     // 2. オペレーティングモードの設定を電流制御モードに変更
-    dxl_comm_result = packetHandler->write1ByteTxRx(portHandler, id, ADDR_OPERATING_MODE, CURRENT_CONTROL_MODE, &dxl_error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << "Motor " << id << " のオペレーティングモード設定に失敗しました: " 
-                  << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-        return false;
-    }
-    if (dxl_error != 0) {
-        std::cerr << "Motor " << id << " RxPacketError (Operating Mode): " << static_cast<int>(dxl_error) << std::endl;
-        printDxlError(dxl_error);
-        return false;
-    }
-
     // 3. Goal Currentを0に設定
-    dxl_comm_result = packetHandler->write2ByteTxRx(portHandler, id, ADDR_GOAL_CURRENT, 0, &dxl_error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << "Motor " << id << " のGoal Current設定に失敗しました: " 
-                  << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-        return false;
-    }
-    if (dxl_error != 0) {
-        std::cerr << "Motor " << id << " RxPacketError (Goal Current): " << static_cast<int>(dxl_error) << std::endl;
-        printDxlError(dxl_error);
-        return false;
-    }
-
-    // 4. Torque Limitの設定（例: 最大電流500に変更）
-    dxl_comm_result = packetHandler->write2ByteTxRx(portHandler, id, ADDR_TORQUE_LIMIT, 500, &dxl_error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << "Motor " << id << " のTorque Limit設定に失敗しました: " 
-                  << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-        return false;
-    }
-    if (dxl_error != 0) {
-        std::cerr << "Motor " << id << " RxPacketError (Torque Limit): " << static_cast<int>(dxl_error) << std::endl;
-        printDxlError(dxl_error);
-        return false;
-    }
-
+    // 4. Current Limit（38）の設定（全走行で一番大きい上限。EEPROM なのでトルクOFFのうちに書く）
     // 5. トルクの有効化
-    dxl_comm_result = packetHandler->write1ByteTxRx(portHandler, id, ADDR_TORQUE_ENABLE, TORQUE_ENABLE, &dxl_error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << "Motor " << id << " のトルク有効化に失敗しました: " 
-                  << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-        return false;
-    }
-    if (dxl_error != 0) {
-        std::cerr << "Motor " << id << " RxPacketError (Torque Enable): " << static_cast<int>(dxl_error) << std::endl;
-        printDxlError(dxl_error);
-        return false;
-    }
-
-    return true;
-}
-
-// キーボード入力を監視するスレッド
-void monitorInput() {
-    std::cout << "Press Enter to stop the motors...\n";
-    std::cin.get();  // Enterキーを押すのを待つ
-    stop_flag = true;
-}
-
-// 目標位置の線形軌道生成関数
-int32_t calculateTargetPosition(int32_t start_pos, int32_t goal_pos, double t, double duration) {
-    if (t >= duration) {
-        return goal_pos;
-    }
-    double ratio = t / duration;
-    return static_cast<int32_t>(start_pos + ratio * (goal_pos - start_pos));
+    return motor.setTorque(false)
+        && motor.setOperatingMode(CURRENT_CONTROL_MODE)
+        && motor.setGoalCurrent(0)
+        && motor.setCurrentLimit(current_limit)
+        && motor.setTorque(true);
 }
 
 int main() {
@@ -174,193 +72,464 @@ int main() {
     std::cin >> user_input;
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');  // 入力バッファのクリア
 
+    // Enter・Ctrl-C（SIGINT）・SIGTERM・ポートの切断を周期の待ちと一緒に受ける（スレッドを作る前に用意する）
+    ControlRuntime runtime;
+
     std::string directory = "angle_current";
-    std::string filename = "angle_current_" + user_input + ".csv";
+    std::string basename = "angle_current_" + user_input;
     std::filesystem::create_directory(directory); 
-    std::ofstream file(directory + "/" + filename);
-    file << "Time(s),Position1,Current1,Position2,Current2\n";
 
-    // Dynamixelの初期化
-    dynamixel::PortHandler *portHandler = dynamixel::PortHandler::getPortHandler(DEVICENAME);
-    dynamixel::PacketHandler *packetHandler = dynamixel::PacketHandler::getPacketHandler(PROTOCOL_VERSION);
+    double default_dt = controlPeriodFromEnv(0.01); // 制御ループの周期（10ms。DXL_PERIOD_MS で変えられる）
+
+    // 走行の条件の既定値。DXL_CONFIG=<file.ini> があれば [run] で上書きし、[sweep] の全組み合わせを
+    // ポートを開き直さず・モーターを設定し直さずに続けて走らせる（走行ごとにログ1本と、一覧 <name>_index.csv）
+    RunConfig defaults;
+    defaults.ids = idListFromEnv("DXL_IDS", DXL_IDS);  // 制御する関節（ログに残すのは先頭 LOG_MAX_MOTORS 個まで）
+    defaults.duration = 1.0;      // 1秒で動作を完了させる
+    defaults.amplitude_deg = 90;  // 偶数番目は+90度、奇数番目は反対方向に90度動かす
+
+    // PID制御のパラメータ（初期値を低めに設定）
+    defaults.kp = 5.0; // 比例ゲイン
+    defaults.kd = 0.5; // 微分ゲイン
+    defaults.ki = 0.0; // 積分ゲイン（積分は出力が飽和している間は溜めない）
+    defaults.tf = 0.0; // 微分フィルタの時定数 [s]（0 ならフィルタなし）
+
+    // 電流の最大値（XM430-W350の場合、範囲は -2048 ~ +2047）
+    defaults.max_current = 500;
+    defaults.min_current = 0;
 
-    if (!portHandler->openPort()) {
-        std::cerr << "Failed to open port!\n";
+    std::vector<RunConfig> runs;
+    if (!runConfigsFromEnv(defaults, runs)) {
         return 0;
     }
+    std::vector<uint8_t> ids = runs[0].ids;
+    int16_t current_limit = 0;
+    double total_duration = 0.0;
+    for (const RunConfig& run : runs) {
+        current_limit = std::max<int16_t>(current_limit, std::max<int16_t>(std::abs(run.max_current), std::abs(run.min_current)));
+        total_duration += run.duration;
+    }
 
-    if (!portHandler->setBaudRate(BAUDRATE)) {
-        std::cerr << "Failed to set baudrate!\n";
-        portHandler->closePort();
-        return 0;
+    // 関節を複数のシリアルポートに分けられる（DXL_BUSES="/dev/ttyUSB0=1,2;/dev/ttyUSB1=3,4"）。
+    // バスごとに I/O スレッドを1本ずつ別のCPUに固定し（DXL_BUS_CPUS）、各バスの Sync Read を同時に出す。
+    // 周期はバスの数ではなく一番遅いバスで決まるので、バスを足すほど同じ関節数で周期を短くできる
+    std::vector<BusSpec> specs = busSpecsFromEnv(DEVICENAME, ids);
+    std::vector<std::unique_ptr<BusLane>> lanes;
+    ids.clear();
+    for (const BusSpec& spec : specs) {
+        std::unique_ptr<BusLane> lane(new BusLane);
+        lane->spec = spec;
+        lane->first = ids.size();
+        ids.insert(ids.end(), spec.ids.begin(), spec.ids.end());
+        lanes.push_back(std::move(lane));
     }
+    const size_t num_logged = std::min(ids.size(), static_cast<size_t>(LOG_MAX_MOTORS));
 
-    // モータのセットアップ（電流制御モード）
-    if (!setupMotor(packetHandler, portHandler, DXL_ID1) ||
-        !setupMotor(packetHandler, portHandler, DXL_ID2)) {
-        std::cerr << "Failed to initialize motors.\n";
-        portHandler->closePort();
-        return 0;
+    // Dynamixelの初期化（DXL_LOW_LATENCY / DXL_BAUD を反映）
+    for (std::unique_ptr<BusLane>& lane : lanes) {
+        if (!lane->bus.open(lane->spec.device.c_str(), lane->spec.ids, BAUDRATE)) {
+            std::cerr << "Failed to open port " << lane->spec.device << "!\n";
+            return 0;
+        }
+        runtime.watchHangup(lane->bus.fd(), lane->spec.device.c_str());
+
+        // 失敗したやり取りは周期の残り時間に収まる範囲で、読めなかったIDだけ送り直す。読めなかった関節は前回値で続け、
+        // DXL_FAIL_LIMIT 周期（既定 5）続けて読めなければ安全停止する（DXL_RETRIES で送り直す上限を変えられる）
+        lane->link.reset(new LinkMonitor(lane->spec.ids, retryConfigFromEnv()));
+        lane->bus.setMonitor(lane->link.get());
     }
+    const BaudCalibration& baud = lanes[0]->bus.baud();
+
+    std::vector<int32_t> start_positions(ids.size());
+    int dxl_comm_result = COMM_SUCCESS;
+    for (std::unique_ptr<BusLane>& lane : lanes) {
+        DxlBus& bus = lane->bus;
+        const std::vector<uint8_t>& lane_ids = lane->spec.ids;
+
+        // モータのセットアップ（電流制御モード）。途中で失敗しても全モーターを止めてから抜ける
+        lane->guard.reset(new MotorGuard(bus, lane_ids));
+        for (uint8_t id : lane_ids) {
+            if (!setupMotor(bus, id, current_limit)) {
+                std::cerr << "Failed to initialize motors.\n";
+                return 0;
+            }
+        }
 
-    // 初期位置の取得
-    int32_t start_position1, start_position2;
-    int16_t current1, current2;
-    getMotorData(packetHandler, portHandler, DXL_ID1, start_position1, current1);
-    getMotorData(packetHandler, portHandler, DXL_ID2, start_position2, current2);
+        // バス上の全関節の電流・速度・位置を1回のSync Readで取得し、目標電流を1回のSync Writeで送る
+        lane->law.reset(new PidLaw(lane_ids.size(),
+                                   {runs[0].kp, runs[0].ki, runs[0].kd, runs[0].tf, runs[0].min_current, runs[0].max_current},
+                                   PdLaw::Derivative::Error));
+        lane->axes.reset(new AxisController(bus.port(), bus.packet(), lane_ids, *lane->law));
+        lane->axes->setMonitor(lane->link.get());
 
-    // 目標位置の設定
-    int32_t goal_position1 = start_position1 + static_cast<int32_t>((4096.0 / 360.0) * 90);  // 90度動かす
-    int32_t goal_position2 = start_position2 - static_cast<int32_t>((4096.0 / 360.0) * 90);  // 反対方向に90度動かす
+        // 周期の空き時間に電圧・温度・Hardware Error Status を1IDずつ読む。温度か電流の実効値が高ければ
+        // 目標電流の上限を下げ、温度が DXL_TEMP_STOP（既定 75degC）に達するかエラーが立ったら安全停止する
+        lane->health.reset(new HealthMonitor(bus.port(), lane_ids, healthConfigFromEnv(current_limit)));
 
-    auto start_time = std::chrono::system_clock::now();
-    std::thread inputThread(monitorInput);
+        // 電流と位置だけを Indirect Data に詰めて読み、全IDが対応していれば Fast Sync Read で応答を1つにまとめる
+        // （DXL_TELEMETRY=block / indirect / fast。既定 fast。古いファームウェアがあれば indirect）
+        dxl_comm_result = lane->axes->configureTelemetry(telemetryModeFromEnv(TelemetryMode::Fast));
+        if (dxl_comm_result != COMM_SUCCESS) {
+            std::cerr << "テレメトリの設定に失敗しました（Sync Read のまま続けます）: "
+                      << bus.packet()->getTxRxResult(dxl_comm_result) << std::endl;
+        }
+
+        // 初期位置の取得（読めないまま 0 を基準に動かすと大きく振れるので、その場合は止める）
+        dxl_comm_result = lane->axes->read();
+        if (dxl_comm_result != COMM_SUCCESS) {
+            std::cerr << "初期位置の取得に失敗しました: " << bus.packet()->getTxRxResult(dxl_comm_result) << std::endl;
+            return 0;
+        }
+        for (size_t i = 0; i < lane_ids.size(); i++) {
+            start_positions[lane->first + i] = lane->axes->position(i);
+        }
+    }
 
-    double duration = 1.0; // 1秒で動作を完了させる
-    double dt = 0.01; // 制御ループの周期（10ms）
+    // DXL_FEEDFORWARD=<model.txt>（fit_feedforward の出力）があれば、モデルの電流を軌道の表に入れて PD に足す
+    std::vector<FeedforwardModel> feedforward_models;
+    if (!feedforwardFromEnv(ids.size(), feedforward_models)) {
+        return 0;
+    }
+    std::vector<TrajectoryPoint> points(ids.size());
 
-    // PID制御のパラメータ（初期値を低めに設定）
-    double Kp = 5.0; // 比例ゲイン
-    double Kd = 0.5; // 微分ゲイン
+    // ループ中の通信エラーは固定長の記録に溜め、ループを抜けてから表示する
+    EventLog events(MAX_EVENTS);
 
-    // 前回の誤差を保存する変数
-    double previous_error1 = 0.0, previous_error2 = 0.0;
+    // DXL_ALLOC_CHECK=1 なら、2周目以降にヒープ確保が起きたら失敗にする
+    AllocCheck alloc_check(allocCheckFromEnv());
 
-    // 電流の最大値（XM430-W350の場合、範囲は -2048 ~ +2047）
-    const int16_t MAX_CURRENT = 500;
-    const int16_t MIN_CURRENT = 0;
+    // DXL_TRACE=1 / DXL_TRACE=<path.json> なら周期の区間ごとの時間を測る（1周期あたり 区間数 + ID数 件）。
+    // IDごとの時間はバスが1本のときだけ（I/O スレッドからは記録しない）
+    std::string trace_path;
+    CycleTrace trace(traceFromEnv(trace_path), logCapacityFor(total_duration, default_dt) * (PHASE_COUNT + ids.size()), ids);
+    if (trace.enabled() && lanes.size() == 1) {
+        lanes[0]->axes->setTrace(&trace);
+    }
+    uint64_t cycle_end = 0;
 
-    while (true) {
-        if (stop_flag) {
-            std::cout << "Stop flag detected. Exiting loop.\n";
-            break;
+    // バスごとの I/O スレッド（DXL_RT_PRIORITY があれば I/O スレッドも同じ優先度にする）
+    std::vector<int> cpus;
+    for (const BusSpec& spec : specs) {
+        cpus.push_back(spec.cpu);
+    }
+    BusGroup group(cpus, executorConfigFromEnv(default_dt).rt_priority);
+    group.setAllocCheck(&alloc_check);
+
+    // 周期の前半（全バスで開始時刻を揃えて読む）と後半（書いてから監視の読み出し）。k はバスの番号
+    const CycleInfo* current_cycle = nullptr;
+    auto read_phase = [&](size_t k) {
+        BusLane& lane = *lanes[k];
+        lane.link->beginCycle(*current_cycle);
+        lane.read_result = lane.axes->read();
+    };
+    auto write_phase = [&](size_t k) {
+        BusLane& lane = *lanes[k];
+        lane.write_result = lane.axes->write();
+        lane.link_ok = lane.link->endCycle();
+        lane.health_ok = lane.link_ok && lane.health->step(*current_cycle);
+    };
+
+    // 次の走行の前に、前の走行の終わりの位置から最初の開始位置へ等速で戻す（ログには残さない）
+    std::vector<int32_t> home = start_positions;
+    std::vector<int32_t> from(ids.size());
+    auto return_home = [&](const RunConfig& run, double dt) {
+        for (std::unique_ptr<BusLane>& lane : lanes) {
+            for (size_t i = 0; i < lane->axes->size(); i++) {
+                from[lane->first + i] = lane->axes->position(i);
+            }
+        }
+        PeriodicExecutor executor(executorConfigFromEnv(dt));
+        executor.setRuntime(&runtime);
+        executor.run([&](const CycleInfo& cycle) {
+            if (cycle.elapsed_s > run.return_s) {
+                return false;
+            }
+            current_cycle = &cycle;
+            group.run(read_phase, true);
+            for (std::unique_ptr<BusLane>& lane : lanes) {
+                AxisController& axes = *lane->axes;
+                for (size_t i = 0; i < axes.size(); i++) {
+                    size_t j = lane->first + i;
+                    axes.setTarget(i, calculateTargetPosition(from[j], home[j], cycle.elapsed_s, run.return_s));
+                    axes.setFeedforward(i, 0.0);
+                }
+                axes.compute(cycle.period_s);
+                lane->health->limitGoalCurrents(axes.goalCurrents());
+            }
+            group.run(write_phase, false);
+            for (std::unique_ptr<BusLane>& lane : lanes) {
+                if (!lane->link_ok) {
+                    runtime.requestStop(lane->link->escalation());
+                    return false;
+                }
+                if (!lane->health_ok) {
+                    runtime.requestStop(lane->health->stopReason());
+                    return false;
+                }
+            }
+            return true;
+        });
+    };
+
+    RunIndex index;
+    std::string index_path = directory + "/" + basename + "_index.csv";
+    if (runs.size() > 1) {
+        if (!index.open(index_path)) {
+            std::cerr << "Failed to open " << index_path << std::endl;
+            return 0;
         }
+        std::cout << "Sweep: " << runs.size() << " runs, index " << index_path << std::endl;
+    }
 
-        auto now = std::chrono::system_clock::now();
-        double elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time).count() / 1000.0;
+    // 関節ごとの電流・追従誤差と処理時間をループの中で集計し、端末なら状態行を出す。
+    // DXL_STOP_CURRENT / DXL_STOP_ERROR_DEG / DXL_STOP_CYCLE_MS を超えたら安全停止する（既定はどれも判定しない）
+    const StreamLimits stream_limits = streamLimitsFromEnv();
+    const double deg_per_tick = 360.0 / 4096.0;
 
-        if (elapsed > duration) {
-            break; // 1秒経過したらループを抜ける
+    std::cout << "Press Enter to stop the motors...\n";
+    for (size_t r = 0; r < runs.size() && !runtime.stopRequested(); r++) {
+        RunConfig& run = runs[r];
+        double dt = run.period_ms > 0.0 ? run.period_ms * 1e-3 : default_dt;
+        run.period_ms = dt * 1e3;
+        if (runs.size() > 1) {
+            std::cout << "Run " << r + 1 << "/" << runs.size() << ": " << run.label << std::endl;
         }
 
-        // 目標位置の計算
-        int32_t target_position1 = calculateTargetPosition(start_position1, goal_position1, elapsed, duration);
-        int32_t target_position2 = calculateTargetPosition(start_position2, goal_position2, elapsed, duration);
-
-        // 現在の位置を取得
-        int32_t present_position1, present_position2;
-        getMotorData(packetHandler, portHandler, DXL_ID1, present_position1, current1);
-        getMotorData(packetHandler, portHandler, DXL_ID2, present_position2, current2);
-
-        // 位置誤差の計算
-        double error1 = static_cast<double>(target_position1 - present_position1);
-        double error2 = static_cast<double>(target_position2 - present_position2);
-
-        // PD制御計算
-        double derivative1 = (error1 - previous_error1) / dt;
-        double derivative2 = (error2 - previous_error2) / dt;
-
-        double output_current1 = Kp * error1 + Kd * derivative1;
-        double output_current2 = Kp * error2 + Kd * derivative2;
-
-        previous_error1 = error1;
-        previous_error2 = error2;
-
-        // 電流の制限
-        int16_t goal_current1 = static_cast<int16_t>(
-            std::max(
-                std::min(output_current1, static_cast<double>(MAX_CURRENT)),
-                static_cast<double>(MIN_CURRENT)
-            )
-        );
-        int16_t goal_current2 = static_cast<int16_t>(
-            std::max(
-                std::min(output_current2, static_cast<double>(MAX_CURRENT)),
-                static_cast<double>(MIN_CURRENT)
-            )
-        );
-
-        // ゴール電流を送信
-        int dxl_comm_result;
-        uint8_t dxl_error_code;
-
-        dxl_comm_result = packetHandler->write2ByteTxRx(portHandler, DXL_ID1, ADDR_GOAL_CURRENT, goal_current1, &dxl_error_code);
-        if (dxl_comm_result != COMM_SUCCESS) {
-            std::cerr << "Motor1 のゴール電流送信に失敗しました: " 
-                      << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
+        // 走行ごとのゲインと電流の上限。戻すときは逆向きにも電流を出せるよう上限を正負対称にする。
+        // 積分・微分の状態は戻す前と走行の始めに捨てる
+        PidLaw::Gains gains = {run.kp, run.ki, run.kd, run.tf, run.min_current, run.max_current};
+        PidLaw::Gains return_gains = gains;
+        return_gains.min_current = static_cast<int16_t>(-current_limit);
+        return_gains.max_current = current_limit;
+        auto set_gains = [&](const PidLaw::Gains& g) {
+            for (std::unique_ptr<BusLane>& lane : lanes) {
+                for (size_t i = 0; i < lane->spec.ids.size(); i++) {
+                    lane->law->setGains(i, g);
+                }
+                lane->law->reset();
+            }
+        };
+        if (r > 0 && run.return_s > 0.0) {
+            set_gains(return_gains);
+            return_home(run, dt);
+            if (runtime.stopRequested()) {
+                break;
+            }
         }
-        if (dxl_error_code != 0) {
-            std::cerr << "Motor1 RxPacketError: " << static_cast<int>(dxl_error_code) << std::endl;
-            printDxlError(dxl_error_code);
+        set_gains(gains);
+        for (std::unique_ptr<BusLane>& lane : lanes) {
+            for (size_t i = 0; i < lane->axes->size(); i++) {
+                start_positions[lane->first + i] = lane->axes->position(i);
+            }
         }
 
-        dxl_comm_result = packetHandler->write2ByteTxRx(portHandler, DXL_ID2, ADDR_GOAL_CURRENT, goal_current2, &dxl_error_code);
-        if (dxl_comm_result != COMM_SUCCESS) {
-            std::cerr << "Motor2 のゴール電流送信に失敗しました: " 
-                      << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-        }
-        if (dxl_error_code != 0) {
-            std::cerr << "Motor2 RxPacketError: " << static_cast<int>(dxl_error_code) << std::endl;
-            printDxlError(dxl_error_code);
+        // 目標位置の設定（偶数番目は+、奇数番目は反対方向に amplitude_deg 度動かす）
+        std::vector<double> distances(ids.size());
+        for (size_t i = 0; i < ids.size(); i++) {
+            int32_t offset = static_cast<int32_t>((4096.0 / 360.0) * run.amplitude_deg);
+            distances[i] = i % 2 == 0 ? offset : -offset;
         }
 
-        // データの記録
-        file << elapsed << "," << present_position1 << "," << current1 << "," 
-             << present_position2 << "," << current2 << "\n";
-        file.flush();
-
-        // 制御ループの周期待機
-        std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(dt * 1000)));
-    }
-
-    // 目標電流をゼロに設定してモータを停止
-    int dxl_comm_result_stop;
-    uint8_t dxl_error_code_stop;
+        // 目標軌道の表を先に作っておき、ループでは時刻で引くだけにする
+        // （DXL_TRAJECTORY=linear（既定）/ minjerk / trapezoid / spline / <file.traj>）
+        std::vector<double> origins(start_positions.begin(), start_positions.end());
+        std::unique_ptr<Trajectory> trajectory = trajectoryFromEnv(distances, run.duration, feedforward_models, origins);
+        if (!trajectory) {
+            return 0;
+        }
+        double duration = std::max(run.duration, trajectory->duration());
+
+        // ファイル書き込みは専用スレッドで行い、制御ループはリングに積むだけにする
+        // （DXL_LOG_FORMAT=binary でバイナリ形式。binlog2csv で同じCSVに戻せる）
+        BinLogHeader log_header = makeBinLogHeader(LAYOUT_ANGLE_CURRENT, ids, 1.0 / dt);
+        log_header.baudrate = baud.baudrate;
+        log_header.rtt_p50_us = baud.rtt_p50_us;
+        log_header.rtt_p99_us = baud.rtt_p99_us;
+        log_header.packet_error_rate = baud.error_rate;
+        log_header.kp = run.kp;
+        log_header.ki = run.ki;
+        log_header.kd = run.kd;
+        log_header.max_current = run.max_current;
+        log_header.min_current = run.min_current;
+        AsyncLogger logger(logCapacityFor(duration, dt));
+        RunResult result;
+        std::string run_basename = runs.size() > 1 ? basename + "_" + std::to_string(r + 1) + "_" + run.label : basename;
+        if (!openRunLog(logger, directory + "/" + run_basename, log_header, result.log_path)) {
+            std::cerr << "Failed to open log file!\n";
+            return 0;
+        }
 
-    dxl_comm_result_stop = packetHandler->write2ByteTxRx(portHandler, DXL_ID1, ADDR_GOAL_CURRENT, 0, &dxl_error_code_stop);
-    if (dxl_comm_result_stop != COMM_SUCCESS) {
-        std::cerr << "Motor1 のゴール電流停止送信に失敗しました: " 
-                  << packetHandler->getTxRxResult(dxl_comm_result_stop) << std::endl;
-    }
-    if (dxl_error_code_stop != 0) {
-        std::cerr << "Motor1 RxPacketError (Stop): " << static_cast<int>(dxl_error_code_stop) << std::endl;
-        printDxlError(dxl_error_code_stop);
-    }
+        // 追従誤差（読んだ位置 - その周期の目標位置）とバスの送受信回数。周期やフィードフォワードを変えたときの比較用
+        double error_sq_sum = 0.0;
+        double error_max = 0.0;
+        uint64_t error_samples = 0;
+        uint64_t transactions = 0;
+        cycle_end = 0;
+        LoopStats stats(ids, stream_limits);
+
+        // 絶対時刻で起床する固定周期実行（I/O時間が周期に上乗せされない）
+        PeriodicExecutor executor(executorConfigFromEnv(dt));
+        executor.setRuntime(&runtime);
+        executor.run([&](const CycleInfo& cycle) {
+            auto body_start = std::chrono::steady_clock::now();
+            trace.setCycle(static_cast<uint32_t>(cycle.cycle));
+            uint64_t t = cycle_end ? trace.mark(PHASE_WAIT, cycle_end) : trace.begin();
+            if (cycle.cycle == 1) {
+                alloc_check.arm();  // 1周目の初回確保は数えない
+            }
+            double elapsed = cycle.elapsed_s;
+
+            if (elapsed > duration) {
+                return false; // 1秒経過したらループを抜ける
+            }
+
+            // 現在の位置と電流を取得（読めなかった関節は前回値を使い、指令も前回のまま保つ）
+            current_cycle = &cycle;
+            group.run(read_phase, true);
+            transactions += lanes.size();
+            t = trace.mark(PHASE_READ, t);
+            for (std::unique_ptr<BusLane>& lane : lanes) {
+                AxisController& axes = *lane->axes;
+                for (size_t i = 0; i < axes.size(); i++) {
+                    if (!axes.fresh(i)) {
+                        events.record(axes.id(i), "Sync Read", lane->read_result, 0);
+                    } else if (axes.error(i) != 0) {
+                        events.record(axes.id(i), "Sync Read", COMM_SUCCESS, axes.error(i));
+                    }
+                    if (axes.fresh(i)) {
+                        lane->health->observeCurrent(i, axes.current(i), cycle.period_s);
+                        if (axes.error(i) & STATUS_ERROR_ALERT) {
+                            lane->health->notifyAlert(i);
+                        }
+                    }
+                }
+            }
+
+            // 目標位置とフィードフォワード電流を軌道の表から引き、PID制御計算と電流の制限を行う
+            // （バスごとの関節をSIMDでまとめて計算。周期は実行器の周期。Degrade時は伸びた周期を使う）
+            trajectory->lookup(elapsed, points.data());
+            for (std::unique_ptr<BusLane>& lane : lanes) {
+                AxisController& axes = *lane->axes;
+                for (size_t i = 0; i < axes.size(); i++) {
+                    size_t j = lane->first + i;
+                    axes.setTarget(i, start_positions[j] + points[j].position);
+                    axes.setFeedforward(i, points[j].feedforward);
+                    if (axes.fresh(i)) {
+                        double signed_error = start_positions[j] + points[j].position - axes.position(i);
+                        double error = std::fabs(signed_error);
+                        error_sq_sum += error * error;
+                        error_max = std::max(error_max, error);
+                        error_samples++;
+                        stats.addJoint(j, axes.current(i), signed_error * deg_per_tick, cycle.period_s);
+                    }
+                }
+                axes.compute(cycle.period_s);
+                lane->health->limitGoalCurrents(axes.goalCurrents());
+            }
+            t = trace.mark(PHASE_COMPUTE, t);
+
+            // ゴール電流をバスごとに1回のSync Writeで送信し、続けて監視の読み出し（時間が余っていれば1回）
+            group.run(write_phase, false);
+            transactions += lanes.size();
+            for (std::unique_ptr<BusLane>& lane : lanes) {
+                if (lane->write_result != COMM_SUCCESS) {
+                    events.record(BROADCAST_ID, "ゴール電流送信", lane->write_result, 0);
+                }
+            }
+            t = trace.mark(PHASE_WRITE, t);
+
+            // データの記録
+            LogSample sample;
+            sample.time = elapsed;
+            sample.num_motors = static_cast<uint8_t>(num_logged);
+            sample.stale = 0;
+            for (std::unique_ptr<BusLane>& lane : lanes) {
+                AxisController& axes = *lane->axes;
+                for (size_t i = 0; i < axes.size() && lane->first + i < num_logged; i++) {
+                    sample.position[lane->first + i] = axes.position(i);
+                    sample.current[lane->first + i] = axes.current(i);
+                }
+                if (lane->first < 16) {
+                    sample.stale |= static_cast<uint16_t>(axes.staleMask() << lane->first);
+                }
+            }
+            logger.log(sample);
+            cycle_end = trace.mark(PHASE_LOG, t);
+
+            // 同じ関節が続けて読めなければ安全停止。過熱・ハードウェアエラーでも安全停止
+            for (std::unique_ptr<BusLane>& lane : lanes) {
+                if (!lane->link_ok) {
+                    runtime.requestStop(lane->link->escalation());
+                    return false;
+                }
+                if (!lane->health_ok) {
+                    runtime.requestStop(lane->health->stopReason());
+                    return false;
+                }
+            }
+
+            // 電流のスパイク・追従誤差の発散・処理時間の伸びで安全停止。状態行は低い頻度で書き直す
+            stats.addCycle(std::chrono::duration<double>(std::chrono::steady_clock::now() - body_start).count(),
+                           cycle.period_s);
+            stats.printStatus(elapsed);
+            if (!stats.check()) {
+                runtime.requestStop(stats.stopReason());
+                return false;
+            }
+            return true;
+        });
+        alloc_check.disarm();
+        stats.endStatus();
+        if (runtime.stopRequested()) {
+            result.stop_reason = runtime.stopReason();
+            std::cout << "Stopped: " << runtime.stopReason() << std::endl;
+        }
+        executor.printReport(std::cout);
+        result.cycles = executor.cycles();
+        result.overruns = executor.overruns();
+        if (error_samples > 0) {
+            result.rms_deg = std::sqrt(error_sq_sum / error_samples) * deg_per_tick;
+            result.max_deg = error_max * deg_per_tick;
+            printf("Tracking RMS %.3f deg, max %.3f deg over %llu cycles, %llu bus transactions\n", result.rms_deg,
+                   result.max_deg, static_cast<unsigned long long>(executor.cycles()),
+                   static_cast<unsigned long long>(transactions));
+        }
+        stats.printReport(std::cout);
 
-    dxl_comm_result_stop = packetHandler->write2ByteTxRx(portHandler, DXL_ID2, ADDR_GOAL_CURRENT, 0, &dxl_error_code_stop);
-    if (dxl_comm_result_stop != COMM_SUCCESS) {
-        std::cerr << "Motor2 のゴール電流停止送信に失敗しました: " 
-                  << packetHandler->getTxRxResult(dxl_comm_result_stop) << std::endl;
+        logger.close();
+        if (logger.overflows() > 0) {
+            std::cerr << "ログバッファが溢れ、" << logger.overflows() << " サンプルを破棄しました\n";
+        }
+        index.add(r + 1, run, result);
     }
-    if (dxl_error_code_stop != 0) {
-        std::cerr << "Motor2 RxPacketError (Stop): " << static_cast<int>(dxl_error_code_stop) << std::endl;
-        printDxlError(dxl_error_code_stop);
+    lanes[0]->axes->setTrace(nullptr);
+    for (std::unique_ptr<BusLane>& lane : lanes) {
+        if (lanes.size() > 1) {
+            std::cout << "[" << lane->spec.device << "]" << std::endl;
+        }
+        lane->axes->printWireReport(std::cout, lane->bus.baud().baudrate);
+        lane->link->printReport(std::cout, lane->bus.packet());
+        lane->health->printReport(std::cout);
     }
-
-    // トルクの無効化と後片付け
-    dxl_comm_result_stop = packetHandler->write1ByteTxRx(portHandler, DXL_ID1, ADDR_TORQUE_ENABLE, TORQUE_DISABLE, &dxl_error_code_stop);
-    if (dxl_comm_result_stop != COMM_SUCCESS) {
-        std::cerr << "Motor1 のトルク無効化に失敗しました: " 
-                  << packetHandler->getTxRxResult(dxl_comm_result_stop) << std::endl;
+    group.printReport(std::cout);
+    trace.printSummary(std::cout);
+    if (!trace_path.empty()) {
+        if (trace.writeChromeTrace(trace_path)) {
+            std::cout << "Trace written to " << trace_path << std::endl;
+        } else {
+            std::cerr << "Failed to write trace to " << trace_path << std::endl;
+        }
     }
-    if (dxl_error_code_stop != 0) {
-        std::cerr << "Motor1 RxPacketError (Torque Disable): " << static_cast<int>(dxl_error_code_stop) << std::endl;
-        printDxlError(dxl_error_code_stop);
+    events.print(std::cerr, lanes[0]->bus.packet());
+    for (std::unique_ptr<BusLane>& lane : lanes) {
+        lane->axes->setMonitor(nullptr);
+        lane->bus.setMonitor(nullptr);
     }
+    bool no_allocations = alloc_check.report(std::cout);
 
-    dxl_comm_result_stop = packetHandler->write1ByteTxRx(portHandler, DXL_ID2, ADDR_TORQUE_ENABLE, TORQUE_DISABLE, &dxl_error_code_stop);
-    if (dxl_comm_result_stop != COMM_SUCCESS) {
-        std::cerr << "Motor2 のトルク無効化に失敗しました: " 
-                  << packetHandler->getTxRxResult(dxl_comm_result_stop) << std::endl;
+    // 目標電流をゼロに設定してからトルクを無効化
+    for (std::unique_ptr<BusLane>& lane : lanes) {
+        lane->guard->release();
     }
-    if (dxl_error_code_stop != 0) {
-        std::cerr << "Motor2 RxPacketError (Torque Disable): " << static_cast<int>(dxl_error_code_stop) << std::endl;
-        printDxlError(dxl_error_code_stop);
-    }
-
-    stop_flag = true;
-    inputThread.join();
-    file.close();
-    portHandler->closePort();
-    return 0;
+    return no_allocations ? 0 : 1;
 }
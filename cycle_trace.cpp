@@ -0,0 +1,108 @@
+#include "cycle_trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iomanip>
+
+CycleTrace::CycleTrace(bool enabled, size_t capacity, const std::vector<uint8_t>& ids)
+    : enabled_(enabled),
+      cycle_(0),
+      events_(enabled ? capacity : 0),
+      count_(0),
+      dropped_(0),
+      ids_(ids),
+      motor_hist_(enabled ? ids.size() : 0) {
+    for (int i = 0; i < 256; i++) {
+        motor_index_[i] = -1;
+    }
+    for (size_t i = 0; i < ids_.size(); i++) {
+        motor_index_[ids_[i]] = static_cast<int16_t>(i);
+    }
+}
+
+const char* CycleTrace::phaseName(TracePhase phase) {
+    switch (phase) {
+    case PHASE_WAIT:      return "Wait";
+    case PHASE_READ:      return "Read";
+    case PHASE_RX_STATUS: return "RxStatus";
+    case PHASE_COMPUTE:   return "Compute";
+    case PHASE_WRITE:     return "Write";
+    case PHASE_LOG:       return "Log";
+    default:              return "?";
+    }
+}
+
+void CycleTrace::printSummary(std::ostream& os) const {
+    if (!enabled_) {
+        return;
+    }
+    auto row = [&os](const std::string& name, const LatencyHistogram& h) {
+        os << std::left << std::setw(16) << name << std::right
+           << std::setw(8) << h.count()
+           << std::setw(11) << h.percentile(50) / 1e3
+           << std::setw(11) << h.percentile(99) / 1e3
+           << std::setw(11) << h.max() / 1e3
+           << std::setw(11) << h.mean() / 1e3 << "\n";
+    };
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(1);
+    os << std::left << std::setw(16) << "phase" << std::right << std::setw(8) << "count"
+       << std::setw(11) << "p50[us]" << std::setw(11) << "p99[us]" << std::setw(11) << "max[us]"
+       << std::setw(11) << "mean[us]" << "\n";
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        if (phase_hist_[p].count() > 0) {
+            row(phaseName(static_cast<TracePhase>(p)), phase_hist_[p]);
+        }
+    }
+    for (size_t i = 0; i < motor_hist_.size(); i++) {
+        if (motor_hist_[i].count() > 0) {
+            row("  RxStatus id " + std::to_string(ids_[i]), motor_hist_[i]);
+        }
+    }
+    if (dropped_ > 0) {
+        os << "(trace buffer full: " << dropped_ << " events counted in histograms only)\n";
+    }
+    os.flags(flags);
+    os.flush();
+}
+
+bool CycleTrace::writeChromeTrace(const std::string& path) const {
+    if (!enabled_) {
+        return true;
+    }
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        return false;
+    }
+    // 完了イベント（ph:"X"）。ts/dur はマイクロ秒。モーター別の区間は ID ごとの行（tid）に分ける
+    uint64_t origin = count_ > 0 ? events_[0].begin_ns : 0;
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"control cycle\"}}");
+    for (uint8_t id : ids_) {
+        fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"motor %d\"}}",
+                id, id);
+    }
+    for (size_t i = 0; i < count_; i++) {
+        const TraceEvent& event = events_[i];
+        int tid = event.id == TRACE_NO_ID ? 0 : event.id;
+        fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"args\":{\"cycle\":%u}}",
+                phaseName(static_cast<TracePhase>(event.phase)), tid,
+                (event.begin_ns - origin) / 1e3, event.duration_ns / 1e3, event.cycle);
+    }
+    fprintf(fp, "\n]}\n");
+    return fclose(fp) == 0;
+}
+
+bool traceFromEnv(std::string& json_path) {
+    json_path.clear();
+    const char* env = getenv("DXL_TRACE");
+    if (!env || env[0] == '\0' || strcmp(env, "0") == 0) {
+        return false;
+    }
+    if (strcmp(env, "1") != 0) {
+        json_path = env;
+    }
+    return true;
+}
@@ -0,0 +1,112 @@
+#ifndef CYCLE_TRACE_H_
+#define CYCLE_TRACE_H_
+
+#include "latency_histogram.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// 1周期の中の区間
+enum TracePhase : uint8_t {
+    PHASE_WAIT,        // 前の周期の終わりから起床まで（スリープ + 起床遅れ）
+    PHASE_READ,        // Sync Read 全体
+    PHASE_RX_STATUS,   // Sync Read のうち1台分の応答受信（モーターID別）
+    PHASE_COMPUTE,     // 目標位置と制御則の計算
+    PHASE_WRITE,       // Sync Write
+    PHASE_LOG,         // ログのリングへの積み込み
+    PHASE_COUNT,
+};
+
+// 区間1つ分の記録（固定長）
+struct TraceEvent {
+    uint64_t begin_ns;
+    uint32_t duration_ns;
+    uint32_t cycle;
+    uint8_t phase;
+    uint8_t id;           // モーター別でない区間は TRACE_NO_ID
+};
+
+#define TRACE_NO_ID                   0xFF
+
+// 制御周期の区間ごとの所要時間を測る（DXL_TRACE で有効化）。
+// 時刻は CLOCK_MONOTONIC_RAW（vDSO なのでシステムコールにならない）。
+// 記録は構築時に確保した配列に追記するだけで、ロックもメモリ確保もしない。1つのスレッドからだけ使うこと
+// （スレッドごとに別の CycleTrace を持つ）。配列が一杯になってもヒストグラムへの集計は続ける。
+// 終了時に区間別・モーターID別のヒストグラムを表にし、Chrome の trace event 形式の JSON に書き出せる。
+class CycleTrace {
+public:
+    CycleTrace(bool enabled, size_t capacity, const std::vector<uint8_t>& ids);
+
+    bool enabled() const { return enabled_; }
+
+    static uint64_t now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    }
+
+    // 以降の記録に付ける周期番号
+    void setCycle(uint32_t cycle) { cycle_ = cycle; }
+
+    // begin から今までを phase として記録し、今の時刻を返す（次の区間の begin に使える）。
+    // 無効のときは何もせず 0 を返す
+    uint64_t mark(TracePhase phase, uint64_t begin, uint8_t id = TRACE_NO_ID) {
+        if (!enabled_) {
+            return 0;
+        }
+        uint64_t end = now();
+        record(phase, begin, end, id);
+        return end;
+    }
+
+    // 区間の始まりの時刻（無効なら 0）
+    uint64_t begin() const { return enabled_ ? now() : 0; }
+
+    uint64_t dropped() const { return dropped_; }
+
+    // 区間別・モーターID別の p50 / p99 / max を表にする
+    void printSummary(std::ostream& os) const;
+
+    // chrome://tracing や Perfetto で開ける JSON を書く
+    bool writeChromeTrace(const std::string& path) const;
+
+    static const char* phaseName(TracePhase phase);
+
+private:
+    void record(TracePhase phase, uint64_t begin, uint64_t end, uint8_t id) {
+        uint64_t duration = end - begin;
+        phase_hist_[phase].record(duration);
+        if (id != TRACE_NO_ID && motor_index_[id] >= 0) {
+            motor_hist_[motor_index_[id]].record(duration);
+        }
+        if (count_ < events_.size()) {
+            TraceEvent& event = events_[count_++];
+            event.begin_ns = begin;
+            event.duration_ns = static_cast<uint32_t>(duration);
+            event.cycle = cycle_;
+            event.phase = phase;
+            event.id = id;
+        } else {
+            dropped_++;
+        }
+    }
+
+    bool enabled_;
+    uint32_t cycle_;
+    std::vector<TraceEvent> events_;
+    size_t count_;
+    uint64_t dropped_;
+    LatencyHistogram phase_hist_[PHASE_COUNT];
+    std::vector<uint8_t> ids_;
+    int16_t motor_index_[256];
+    std::vector<LatencyHistogram> motor_hist_;   // PHASE_RX_STATUS をIDごとに
+};
+
+// DXL_TRACE=1 なら表だけ、DXL_TRACE=<path> なら表に加えて JSON を path に書く
+bool traceFromEnv(std::string& json_path);
+
+#endif  // CYCLE_TRACE_H_
@@ -0,0 +1,229 @@
+#include "dxl_bus.h"
+#include "low_latency_port.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <iostream>
+
+void printDxlError(uint8_t error) {
+    if (error == 0) return;
+    std::cerr << "エラー内容: ";
+    // Protocol 2.0: 下位7ビットがエラー番号、0x80 は Hardware Error Status(70) が立っている知らせ
+    switch (error & 0x7F) {
+    case 0: break;
+    case 1: std::cerr << "Result Fail "; break;
+    case 2: std::cerr << "Instruction Error "; break;
+    case 3: std::cerr << "CRC Error "; break;
+    case 4: std::cerr << "Data Range Error "; break;
+    case 5: std::cerr << "Data Length Error "; break;
+    case 6: std::cerr << "Data Limit Error "; break;
+    case 7: std::cerr << "Access Error "; break;
+    default: std::cerr << "Unknown Error " << (error & 0x7F) << " "; break;
+    }
+    if (error & 0x80) std::cerr << "Hardware Error Alert ";
+
+    std::cerr << std::endl;
+}
+
+static int64_t monotonicNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// SDK のポートは fd を公開しないので、開いているデバイスを /proc/self/fd から探す（最後に開いたものを返す）
+static int findDeviceFd(const char* device) {
+    char target[PATH_MAX];
+    if (!realpath(device, target)) {
+        return -1;
+    }
+    DIR* dir = opendir("/proc/self/fd");
+    if (!dir) {
+        return -1;
+    }
+    int found = -1;
+    while (struct dirent* entry = readdir(dir)) {
+        char path[PATH_MAX];
+        ssize_t len = readlinkat(dirfd(dir), entry->d_name, path, sizeof(path) - 1);
+        if (len <= 0) {
+            continue;
+        }
+        path[len] = '\0';
+        int fd = atoi(entry->d_name);
+        if (strcmp(path, target) == 0 && fd > found) {
+            found = fd;
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
+DxlBus::DxlBus()
+    : port_(nullptr),
+      fd_(-1),
+      packet_(dynamixel::PacketHandler::getPacketHandler(PROTOCOL_VERSION)),
+      events_(nullptr),
+      monitor_(nullptr),
+      baud_(),
+      last_result_(COMM_SUCCESS),
+      last_error_(0) {}
+
+DxlBus::~DxlBus() {
+    close();
+}
+
+bool DxlBus::open(const char* device, const std::vector<uint8_t>& ids, int baudrate) {
+    port_ = createPortHandler(device);  // DXL_LOW_LATENCY=1 で低遅延設定のポート
+    io_.reset(new PacketIo(port_));
+    if (!port_->openPort()) {
+        std::cerr << "Failed to open port " << device << std::endl;
+        return false;
+    }
+    // DXL_BAUD=auto なら最速の信頼できる速度へ切り替える（DXL_BAUD=57600 で元に戻す）
+    if (!configureBaudRate(port_, packet_, ids, baudrate, baud_)) {
+        std::cerr << "Failed to set baudrate!" << std::endl;
+        port_->closePort();
+        return false;
+    }
+    fd_ = findDeviceFd(device);
+    return true;
+}
+
+void DxlBus::close() {
+    io_.reset();
+    fd_ = -1;
+    if (port_) {
+        port_->closePort();
+        delete port_;
+        port_ = nullptr;
+    }
+}
+
+bool DxlBus::check(uint8_t id, const char* what) {
+    if (last_result_ == COMM_SUCCESS && last_error_ == 0) {
+        return true;
+    }
+    if (events_) {
+        events_->record(id, what, last_result_, last_error_);
+        return false;
+    }
+    if (last_result_ != COMM_SUCCESS) {
+        std::cerr << "Motor " << static_cast<int>(id) << " の通信に失敗しました (" << what << "): "
+                  << packet_->getTxRxResult(last_result_) << std::endl;
+        return false;
+    }
+    std::cerr << "Motor " << static_cast<int>(id) << " RxPacketError (" << what << "): "
+              << static_cast<int>(last_error_) << std::endl;
+    printDxlError(last_error_);
+    return false;
+}
+
+template <class Attempt>
+bool DxlBus::transact(uint8_t id, const char* what, Attempt attempt) {
+    int retries = 0;
+    while (true) {
+        int64_t start = monotonicNow();
+        last_error_ = 0;
+        last_result_ = attempt();
+        if (!monitor_) {
+            break;
+        }
+        monitor_->attempt(id, last_result_, retries > 0);
+        if (last_result_ == COMM_SUCCESS) {
+            break;
+        }
+        if (!monitor_->shouldRetry(last_result_, retries, monotonicNow() - start)) {
+            monitor_->fail(id);
+            break;
+        }
+        retries++;
+    }
+    return check(id, what);
+}
+
+bool DxlBus::write1(uint8_t id, uint16_t address, uint8_t value, const char* what) {
+    return transact(id, what, [&] { return io_->write(id, address, &value, 1, &last_error_); });
+}
+
+bool DxlBus::write2(uint8_t id, uint16_t address, uint16_t value, const char* what) {
+    uint8_t data[2] = {DXL_LOBYTE(value), DXL_HIBYTE(value)};
+    return transact(id, what, [&] { return io_->write(id, address, data, sizeof(data), &last_error_); });
+}
+
+bool DxlBus::write4(uint8_t id, uint16_t address, uint32_t value, const char* what) {
+    uint8_t data[4] = {DXL_LOBYTE(DXL_LOWORD(value)), DXL_HIBYTE(DXL_LOWORD(value)),
+                       DXL_LOBYTE(DXL_HIWORD(value)), DXL_HIBYTE(DXL_HIWORD(value))};
+    return transact(id, what, [&] { return io_->write(id, address, data, sizeof(data), &last_error_); });
+}
+
+bool DxlBus::read1(uint8_t id, uint16_t address, uint8_t* value, const char* what) {
+    return transact(id, what, [&] { return io_->read(id, address, 1, value, &last_error_); });
+}
+
+bool DxlBus::read2(uint8_t id, uint16_t address, uint16_t* value, const char* what) {
+    uint8_t data[2] = {0, 0};
+    bool ok = transact(id, what, [&] { return io_->read(id, address, sizeof(data), data, &last_error_); });
+    if (last_result_ == COMM_SUCCESS) {
+        *value = DXL_MAKEWORD(data[0], data[1]);
+    }
+    return ok;
+}
+
+bool DxlBus::read4(uint8_t id, uint16_t address, uint32_t* value, const char* what) {
+    uint8_t data[4] = {0, 0, 0, 0};
+    bool ok = transact(id, what, [&] { return io_->read(id, address, sizeof(data), data, &last_error_); });
+    if (last_result_ == COMM_SUCCESS) {
+        *value = DXL_MAKEDWORD(DXL_MAKEWORD(data[0], data[1]), DXL_MAKEWORD(data[2], data[3]));
+    }
+    return ok;
+}
+
+bool DxlMotor::setOperatingMode(uint8_t mode) {
+    return write<xm430::OperatingMode>(mode);
+}
+
+bool DxlMotor::setTorque(bool enable) {
+    return write<xm430::TorqueEnable>(enable ? TORQUE_ENABLE : TORQUE_DISABLE);
+}
+
+bool DxlMotor::setCurrentLimit(uint16_t limit) {
+    return write<xm430::CurrentLimit>(limit);
+}
+
+bool DxlMotor::setGoalCurrent(int16_t current) {
+    return write<xm430::GoalCurrent>(current);
+}
+
+bool DxlMotor::readPosition(int32_t& position) {
+    return read<xm430::PresentPosition>(position);
+}
+
+bool DxlMotor::readCurrent(int16_t& current) {
+    return read<xm430::PresentCurrent>(current);
+}
+
+MotorGuard::MotorGuard(DxlBus& bus, const std::vector<uint8_t>& ids) : bus_(bus), ids_(ids), released_(false) {}
+
+MotorGuard::~MotorGuard() {
+    release();
+}
+
+void MotorGuard::release() {
+    if (released_ || !bus_.port()) {
+        return;
+    }
+    released_ = true;
+    // 片方が失敗しても残りのモーターは必ず止める
+    for (uint8_t id : ids_) {
+        for (int k = 0; k < MOTOR_GUARD_RETRIES && !DxlMotor(bus_, id).setGoalCurrent(0); k++) {
+        }
+    }
+    for (uint8_t id : ids_) {
+        for (int k = 0; k < MOTOR_GUARD_RETRIES && !DxlMotor(bus_, id).setTorque(false); k++) {
+        }
+    }
+}
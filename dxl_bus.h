@@ -0,0 +1,150 @@
+#ifndef DXL_BUS_H_
+#define DXL_BUS_H_
+
+#include "dynamixel_sdk.h"
+#include "baud_calibration.h"
+#include "control_table.h"
+#include "event_log.h"
+#include "link_monitor.h"
+#include "packet_io.h"
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+// エラーコードをビットごとに解析して表示する
+void printDxlError(uint8_t error);
+
+// 1本のバス（ポート + パケットハンドラ）。各プログラムのポートを開く手順をまとめたもの。
+// 読み書きは失敗すると内容を std::cerr に出して false を返す（what は表示用の操作名）。
+// 読み書きは PacketIo の固定バッファで行うので、制御周期中に呼んでもヒープ確保をしない。
+// 制御ループ中は setEventLog() で失敗を EventLog に記録させ、iostream での整形を避ける。
+// setMonitor() すると、失敗したやり取りを monitor の方針で送り直し、IDごとに数える（報告は送り直しても通らなかったときだけ）。
+class DxlBus {
+public:
+    DxlBus();
+    ~DxlBus();
+    DxlBus(const DxlBus&) = delete;
+    DxlBus& operator=(const DxlBus&) = delete;
+
+    // ポートを開いて速度を設定する（DXL_LOW_LATENCY / DXL_BAUD を反映する）
+    bool open(const char* device, const std::vector<uint8_t>& ids, int baudrate);
+    void close();
+
+    dynamixel::PortHandler* port() { return port_; }
+    // 開いたシリアルポートの fd（ControlRuntime::watchHangup 用。見つからなければ -1）
+    int fd() const { return fd_; }
+    dynamixel::PacketHandler* packet() { return packet_; }
+    const BaudCalibration& baud() const { return baud_; }
+
+    // events が nullptr でなければ、失敗は std::cerr ではなく events に記録する
+    void setEventLog(EventLog* events) { events_ = events; }
+
+    // monitor が nullptr でなければ、失敗したやり取りを送り直し、結果を monitor に数える
+    void setMonitor(LinkMonitor* monitor) { monitor_ = monitor; }
+
+    // 型付きの読み書き。幅（1/2/4バイト）はレジスタの型からコンパイル時に決まる
+    //   bus.read<xm430::PresentPosition>(id, position);   // position は int32_t
+    template <class Reg>
+    bool read(uint8_t id, typename Reg::value_type& value);
+    template <class Reg>
+    bool write(uint8_t id, typename Reg::value_type value);
+
+    // アドレス直指定の読み書き（制御テーブル外や実験用）
+    bool write1(uint8_t id, uint16_t address, uint8_t value, const char* what);
+    bool write2(uint8_t id, uint16_t address, uint16_t value, const char* what);
+    bool write4(uint8_t id, uint16_t address, uint32_t value, const char* what);
+    bool read1(uint8_t id, uint16_t address, uint8_t* value, const char* what);
+    bool read2(uint8_t id, uint16_t address, uint16_t* value, const char* what);
+    bool read4(uint8_t id, uint16_t address, uint32_t* value, const char* what);
+
+    // 直近のやり取りの結果（COMM_*）とエラーバイト
+    int lastResult() const { return last_result_; }
+    uint8_t lastError() const { return last_error_; }
+
+private:
+    // attempt() でやり取りを1回行い、monitor_ があれば方針どおりに送り直す。結果は last_result_ / last_error_
+    template <class Attempt>
+    bool transact(uint8_t id, const char* what, Attempt attempt);
+    bool check(uint8_t id, const char* what);
+
+    dynamixel::PortHandler* port_;
+    int fd_;
+    dynamixel::PacketHandler* packet_;
+    std::unique_ptr<PacketIo> io_;
+    EventLog* events_;
+    LinkMonitor* monitor_;
+    BaudCalibration baud_;
+    int last_result_;
+    uint8_t last_error_;
+};
+
+template <class Reg>
+bool DxlBus::read(uint8_t id, typename Reg::value_type& value) {
+    if constexpr (Reg::width == 1) {
+        return read1(id, Reg::address, reinterpret_cast<uint8_t*>(&value), Reg::name);
+    } else if constexpr (Reg::width == 2) {
+        return read2(id, Reg::address, reinterpret_cast<uint16_t*>(&value), Reg::name);
+    } else {
+        return read4(id, Reg::address, reinterpret_cast<uint32_t*>(&value), Reg::name);
+    }
+}
+
+template <class Reg>
+bool DxlBus::write(uint8_t id, typename Reg::value_type value) {
+    static_assert(Reg::writable, "register is read-only");
+    if constexpr (Reg::width == 1) {
+        return write1(id, Reg::address, static_cast<uint8_t>(value), Reg::name);
+    } else if constexpr (Reg::width == 2) {
+        return write2(id, Reg::address, static_cast<uint16_t>(value), Reg::name);
+    } else {
+        return write4(id, Reg::address, static_cast<uint32_t>(value), Reg::name);
+    }
+}
+
+// バス上の1台のモーター
+class DxlMotor {
+public:
+    DxlMotor(DxlBus& bus, uint8_t id) : bus_(bus), id_(id) {}
+
+    uint8_t id() const { return id_; }
+
+    template <class Reg>
+    bool read(typename Reg::value_type& value) { return bus_.read<Reg>(id_, value); }
+    template <class Reg>
+    bool write(typename Reg::value_type value) { return bus_.write<Reg>(id_, value); }
+
+    bool setOperatingMode(uint8_t mode);
+    bool setTorque(bool enable);
+    bool setCurrentLimit(uint16_t limit);
+    bool setGoalCurrent(int16_t current);
+    bool readPosition(int32_t& position);
+    bool readCurrent(int16_t& current);
+
+private:
+    DxlBus& bus_;
+    uint8_t id_;
+};
+
+// 生きている間モーターを動かしてよい範囲を表す。
+// どの経路でスコープを抜けても（早期 return を含む）目標電流を 0 にしてからトルクを切る。
+// 1回の取りこぼしで止め損ねないよう、失敗したモーターには MOTOR_GUARD_RETRIES 回まで送り直す。
+#define MOTOR_GUARD_RETRIES           3
+
+class MotorGuard {
+public:
+    MotorGuard(DxlBus& bus, const std::vector<uint8_t>& ids);
+    ~MotorGuard();
+    MotorGuard(const MotorGuard&) = delete;
+    MotorGuard& operator=(const MotorGuard&) = delete;
+
+    // 後片付けを今すぐ行う（2回目以降は何もしない）
+    void release();
+
+private:
+    DxlBus& bus_;
+    std::vector<uint8_t> ids_;
+    bool released_;
+};
+
+#endif  // DXL_BUS_H_
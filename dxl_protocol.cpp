@@ -0,0 +1,159 @@
+#include "dxl_protocol.h"
+
+#include <string.h>
+#include <array>
+
+namespace dxl_proto {
+
+namespace {
+
+// CRCテーブル（多項式0x8005）をコンパイル時に生成
+constexpr std::array<uint16_t, 256> makeCrcTable() {
+    std::array<uint16_t, 256> table{};
+    for (int i = 0; i < 256; i++) {
+        uint16_t crc = static_cast<uint16_t>(i << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x8005) : static_cast<uint16_t>(crc << 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint16_t, 256> CRC_TABLE = makeCrcTable();
+
+// 長さフィールド以降を書き込む共通処理（bodyはインストラクション以降、CRCを除く）
+size_t finishPacket(uint8_t* buf, uint8_t id, const uint8_t* body, size_t body_len) {
+    buf[0] = 0xFF;
+    buf[1] = 0xFF;
+    buf[2] = 0xFD;
+    buf[3] = 0x00;
+    buf[POS_ID] = id;
+
+    // FF FF FD の直後に FD を挿入する
+    size_t out = POS_INSTRUCTION;
+    for (size_t i = 0; i < body_len; i++) {
+        buf[out++] = body[i];
+        if (out - POS_INSTRUCTION >= 3 && body[i] == 0xFD && buf[out - 2] == 0xFF && buf[out - 3] == 0xFF) {
+            buf[out++] = 0xFD;
+        }
+    }
+
+    size_t length = out - POS_INSTRUCTION + 2;  // インストラクション〜CRC
+    buf[POS_LENGTH_L] = static_cast<uint8_t>(length & 0xFF);
+    buf[POS_LENGTH_H] = static_cast<uint8_t>(length >> 8);
+
+    uint16_t crc = updateCRC(0, buf, out);
+    buf[out++] = static_cast<uint8_t>(crc & 0xFF);
+    buf[out++] = static_cast<uint8_t>(crc >> 8);
+    return out;
+}
+
+}  // namespace
+
+uint16_t updateCRC(uint16_t crc_accum, const uint8_t* data, size_t size) {
+    for (size_t j = 0; j < size; j++) {
+        uint8_t i = static_cast<uint8_t>(((crc_accum >> 8) ^ data[j]) & 0xFF);
+        crc_accum = static_cast<uint16_t>((crc_accum << 8) ^ CRC_TABLE[i]);
+    }
+    return crc_accum;
+}
+
+size_t buildPacket(uint8_t* buf, uint8_t id, uint8_t instruction, const uint8_t* params, size_t param_len) {
+    uint8_t body[PACKET_MAX_LEN];
+    body[0] = instruction;
+    if (param_len > 0) {
+        memcpy(body + 1, params, param_len);
+    }
+    return finishPacket(buf, id, body, param_len + 1);
+}
+
+size_t buildStatusPacket(uint8_t* buf, uint8_t id, uint8_t error, const uint8_t* data, size_t data_len) {
+    uint8_t body[PACKET_MAX_LEN];
+    body[0] = STATUS;
+    body[1] = error;
+    if (data_len > 0) {
+        memcpy(body + 2, data, data_len);
+    }
+    return finishPacket(buf, id, body, data_len + 2);
+}
+
+PacketParser::PacketParser() : len_(0), consumed_(0), crc_errors_(0) {}
+
+bool PacketParser::feed(const uint8_t* data, size_t len) {
+    if (consumed_ > 0) {
+        memmove(buf_, buf_ + consumed_, len_ - consumed_);
+        len_ -= consumed_;
+        consumed_ = 0;
+    }
+    size_t room = sizeof(buf_) - len_;
+    bool fits = len <= room;
+    if (!fits) {
+        len = room;
+    }
+    memcpy(buf_ + len_, data, len);
+    len_ += len;
+    return fits;
+}
+
+bool PacketParser::next(Packet& packet) {
+    if (consumed_ > 0) {
+        memmove(buf_, buf_ + consumed_, len_ - consumed_);
+        len_ -= consumed_;
+        consumed_ = 0;
+    }
+
+    while (true) {
+        // ヘッダ FF FF FD 00 を探す
+        size_t start = 0;
+        while (start + 4 <= len_ &&
+               !(buf_[start] == 0xFF && buf_[start + 1] == 0xFF && buf_[start + 2] == 0xFD && buf_[start + 3] == 0x00)) {
+            start++;
+        }
+        if (start > 0) {
+            memmove(buf_, buf_ + start, len_ - start);
+            len_ -= start;
+        }
+        if (len_ < POS_INSTRUCTION + 1) {
+            return false;
+        }
+
+        size_t length = buf_[POS_LENGTH_L] | (buf_[POS_LENGTH_H] << 8);
+        size_t total = length + POS_INSTRUCTION;
+        if (length < 3 || total > PACKET_MAX_LEN) {
+            // 壊れた長さ。ヘッダ1バイト分ずらして探し直す
+            memmove(buf_, buf_ + 1, len_ - 1);
+            len_ -= 1;
+            continue;
+        }
+        if (len_ < total) {
+            return false;
+        }
+
+        uint16_t crc = updateCRC(0, buf_, total - 2);
+        if ((buf_[total - 2] | (buf_[total - 1] << 8)) != crc) {
+            crc_errors_++;
+            memmove(buf_, buf_ + 1, len_ - 1);
+            len_ -= 1;
+            continue;
+        }
+
+        // スタッフィング解除（FF FF FD FD → FF FF FD）
+        size_t n = 0;
+        for (size_t i = POS_PARAMETER; i < total - 2; i++) {
+            if (i >= POS_INSTRUCTION + 3 && buf_[i] == 0xFD && buf_[i - 1] == 0xFD && buf_[i - 2] == 0xFF && buf_[i - 3] == 0xFF) {
+                continue;
+            }
+            params_[n++] = buf_[i];
+        }
+
+        packet.id = buf_[POS_ID];
+        packet.instruction = buf_[POS_INSTRUCTION];
+        packet.params = params_;
+        packet.param_len = n;
+        consumed_ = total;
+        return true;
+    }
+}
+
+}  // namespace dxl_proto
@@ -0,0 +1,92 @@
+#ifndef DXL_PROTOCOL_H_
+#define DXL_PROTOCOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Dynamixel Protocol 2.0 のパケット組み立て・解析（SDKを介さずにバスを扱う場面用）
+namespace dxl_proto {
+
+// インストラクション
+enum Instruction : uint8_t {
+    PING           = 0x01,
+    READ           = 0x02,
+    WRITE          = 0x03,
+    STATUS         = 0x55,
+    SYNC_READ      = 0x82,
+    SYNC_WRITE     = 0x83,
+    FAST_SYNC_READ = 0x8A,
+    BULK_READ      = 0x92,
+    BULK_WRITE     = 0x93,
+};
+
+const uint8_t ID_BROADCAST = 0xFE;
+
+// ヘッダ(4) + ID(1) + 長さ(2) + インストラクション(1) + CRC(2)
+const size_t PACKET_OVERHEAD = 10;
+const size_t PACKET_MAX_LEN  = 1024;
+// ステータスパケット: PACKET_OVERHEAD + エラー(1)
+const size_t STATUS_PACKET_OVERHEAD = 11;
+// Fast Sync Read の応答: ヘッダ(4) + ID(1) + 長さ(2) + インストラクション(1)、1台ごとに エラー + ID + CRC(2)
+// （最後の1台の CRC がパケットの CRC を兼ねる）
+const size_t FAST_STATUS_OVERHEAD  = 8;
+const size_t FAST_SEGMENT_OVERHEAD = 4;
+
+// パケット内の位置
+const size_t POS_ID          = 4;
+const size_t POS_LENGTH_L    = 5;
+const size_t POS_LENGTH_H    = 6;
+const size_t POS_INSTRUCTION = 7;
+const size_t POS_ERROR       = 8;  // ステータスパケットのみ
+const size_t POS_PARAMETER   = 8;
+
+// CRC-16 (IBM, 多項式0x8005)。SDKのupdateCRCと同じ値になる
+uint16_t updateCRC(uint16_t crc_accum, const uint8_t* data, size_t size);
+
+// パラメータにヘッダ・長さ・CRCを付けてbufに書き込み、パケット長を返す。
+// パラメータ中の FF FF FD はバイトスタッフィングする。bufは PACKET_MAX_LEN 以上。
+size_t buildPacket(uint8_t* buf, uint8_t id, uint8_t instruction, const uint8_t* params, size_t param_len);
+
+// ステータスパケット（エラーバイト + データ）を組み立てる
+size_t buildStatusPacket(uint8_t* buf, uint8_t id, uint8_t error, const uint8_t* data, size_t data_len);
+
+// 受信バイト列から1パケットずつ取り出すストリームパーサ
+struct Packet {
+    uint8_t id;
+    uint8_t instruction;
+    const uint8_t* params;  // スタッフィング解除済み
+    size_t param_len;
+};
+
+class PacketParser {
+public:
+    PacketParser();
+
+    // バイト列を追加する。溢れた分は捨てて false を返す
+    bool feed(const uint8_t* data, size_t len);
+
+    // 完成したパケットが取り出せれば true。packet.params は次の next()/feed() まで有効
+    bool next(Packet& packet);
+
+    // 溜まっているバイト列を捨てる（新しいやり取りを始めるとき）
+    void reset() { len_ = 0; consumed_ = 0; }
+
+    // CRC不一致で捨てたパケット数
+    uint32_t crcErrors() const { return crc_errors_; }
+
+private:
+    uint8_t buf_[PACKET_MAX_LEN * 2];
+    size_t len_;
+    size_t consumed_;  // 直前に返したパケットの長さ（次回呼び出しで捨てる）
+    uint8_t params_[PACKET_MAX_LEN];
+    uint32_t crc_errors_;
+};
+
+// 通信速度[bps]と長さ[byte]からワイヤ上の転送時間[us]を求める（8N1 = 10bit/byte）
+inline double wireTimeUs(size_t bytes, int baudrate) {
+    return bytes * 10.0 * 1e6 / baudrate;
+}
+
+}  // namespace dxl_proto
+
+#endif  // DXL_PROTOCOL_H_
@@ -0,0 +1,692 @@
+// 擬似端末(PTY)上で動作する Dynamixel Protocol 2.0 サーボシミュレータ
+// 実機なしで通信周期や制御ループの挙動を測るために使う。
+//   ./dxl_sim -p /tmp/ttyDXL -i 1,2          （ID 1, 2）
+//   ./dxl_sim -p /tmp/ttyDXL -n 20 -b 1000000 （ID 1〜20, 1Mbps）
+//   ./dxl_sim -i 1,2 -e 0.02,0.01,1.0         （1秒後から応答の2%をCRC化け、1%を返さない）
+// 起動後、-p のパスを DEVICENAME の代わりに開けばよい。
+//
+// - ping / read / write / sync read / fast sync read / sync write / bulk read / bulk write に応答する
+// - Indirect Address 1〜28 (168..) で指したバイトを Indirect Data 1〜28 (224..) から読み書きできる
+// - -F version でファームウェアの版を変える（既定 45。FAST_SYNC_READ_FIRMWARE より古いと Fast Sync Read に応答しない）
+// - 各バイトはボーレート（Baud Rate(8) レジスタ）どおりの時間をかけて送受信し、
+//   Return Delay Time(9) だけ待ってから応答する
+// - ホスト側ポートの速度がサーボのボーレートと異なるときは応答しない（実機と同じく化けて届かない）
+// - -t heat で巻線の発熱を模擬する（電流 1A あたり heat [degC/s] で上がり、THERMAL_TAU で室温に戻る）。
+//   Temperature Limit(31) に達すると Hardware Error Status(70) の Overheating を立ててトルクを切り、
+//   以後のステータスパケットに Alert ビット（0x80）を付ける（実機と同じく、Reboot するまで戻らない）
+// - -e corrupt[,drop[,after]] で、起動から after 秒後以降の応答を確率 corrupt で化けさせ（CRCの1バイトを反転）、
+//   確率 drop で返さない（ノイズの多い配線の模擬。乱数は毎回同じ系列）
+// - 電流制御モードでは 目標電流 → トルク → 慣性・粘性・クーロン摩擦 の簡単な力学で位置と速度を更新する
+#include "dxl_protocol.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <signal.h>
+#include <time.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sstream>
+
+#define CONTROL_TABLE_SIZE            1024
+
+// 制御テーブルアドレス（XM430）
+#define ADDR_MODEL_NUMBER             0
+#define ADDR_FIRMWARE_VERSION         6
+#define ADDR_ID                       7
+#define ADDR_BAUD_RATE                8
+#define ADDR_RETURN_DELAY_TIME        9
+#define ADDR_OPERATING_MODE           11
+#define ADDR_TEMPERATURE_LIMIT        31
+#define ADDR_CURRENT_LIMIT            38
+#define ADDR_TORQUE_ENABLE            64
+#define ADDR_STATUS_RETURN_LEVEL      68
+#define ADDR_HARDWARE_ERROR_STATUS    70
+#define ADDR_GOAL_CURRENT             102
+#define ADDR_PRESENT_CURRENT          126
+#define ADDR_PRESENT_VELOCITY         128
+#define ADDR_PRESENT_POSITION         132
+#define ADDR_PRESENT_INPUT_VOLTAGE    144
+#define ADDR_PRESENT_TEMPERATURE      146
+#define ADDR_INDIRECT_ADDRESS_1       168
+#define ADDR_INDIRECT_DATA_1          224
+#define INDIRECT_SLOTS                28
+#define ADDR_TORQUE_ENABLE_END        64    // これより前は EEPROM 領域（トルクON中は書き込み不可）
+#define ADDR_READ_ONLY_BEGIN          120   // Realtime Tick 〜 Present Temperature は読み取り専用
+#define ADDR_READ_ONLY_END            147
+
+#define XM430_W350_MODEL_NUMBER       1020
+#define DEFAULT_FIRMWARE_VERSION      45
+#define FAST_SYNC_READ_FIRMWARE       45    // Fast Sync Read に応答する版
+#define CURRENT_CONTROL_MODE          0
+
+// ステータスパケットのエラー番号
+#define ERRNUM_INSTRUCTION            0x02
+#define ERRNUM_DATA_LENGTH            0x05
+#define ERRNUM_DATA_LIMIT             0x06
+#define ERRNUM_ACCESS                 0x07
+
+// 力学モデル（XM430-W350 出力軸換算。粘性項は逆起電力を含み、無負荷 46rpm 程度で頭打ちになる）
+#define CURRENT_UNIT_A                0.00269  // Goal/Present Current の1単位 [A]
+#define TORQUE_CONSTANT               1.78     // [Nm/A]
+#define INERTIA                       0.015    // [kg m^2]
+#define VISCOUS_FRICTION              0.85     // [Nm s/rad]
+#define COULOMB_FRICTION              0.05     // [Nm]
+#define POSITION_PER_RAD              (4096.0 / (2.0 * M_PI))
+#define VELOCITY_UNIT_RPM             0.229
+#define DYNAMICS_STEP                 0.0005   // 積分刻み [s]
+
+// 発熱モデル
+#define AMBIENT_TEMPERATURE           30.0     // [degC]
+#define THERMAL_TAU                   60.0     // 室温に戻る時定数 [s]
+#define HW_ERROR_OVERHEATING          0x04
+#define STATUS_ALERT                  0x80
+
+using namespace dxl_proto;
+
+static volatile sig_atomic_t g_running = 1;
+
+static void onSignal(int) {
+    g_running = 0;
+}
+
+static double monotonicSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// 指定時刻まで待つ。nanosleep の粒度より細かい部分はスピンで合わせる
+static void waitUntil(double deadline) {
+    double remaining = deadline - monotonicSeconds();
+    if (remaining > 200e-6) {
+        double target = deadline - 100e-6;
+        struct timespec ts;
+        ts.tv_sec = static_cast<time_t>(target);
+        ts.tv_nsec = static_cast<long>((target - ts.tv_sec) * 1e9);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+    }
+    while (monotonicSeconds() < deadline) {
+    }
+}
+
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = static_cast<uint8_t>(v & 0xFF);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = static_cast<uint8_t>((v >> (8 * i)) & 0xFF);
+    }
+}
+
+static uint16_t get16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+// Baud Rate(8) の設定値 → bps
+static int baudFromRegister(uint8_t value) {
+    static const int table[] = {9600, 57600, 115200, 1000000, 2000000, 3000000, 4000000, 4500000};
+    return value < 8 ? table[value] : 57600;
+}
+
+static uint8_t registerFromBaud(int baudrate) {
+    for (uint8_t v = 0; v < 8; v++) {
+        if (baudFromRegister(v) == baudrate) {
+            return v;
+        }
+    }
+    return 1;
+}
+
+static int baudFromSpeed(speed_t speed) {
+    switch (speed) {
+    case B9600: return 9600;
+    case B57600: return 57600;
+    case B115200: return 115200;
+    case B1000000: return 1000000;
+    case B2000000: return 2000000;
+    case B3000000: return 3000000;
+    case B4000000: return 4000000;
+    default: return 0;
+    }
+}
+
+class SimServo {
+public:
+    SimServo(uint8_t id, int baudrate, double heat)
+        : theta_(0.0), omega_(0.0), temperature_(AMBIENT_TEMPERATURE), heat_(heat), last_update_(monotonicSeconds()) {
+        memset(table_, 0, sizeof(table_));
+        put16(table_ + ADDR_MODEL_NUMBER, XM430_W350_MODEL_NUMBER);
+        table_[ADDR_FIRMWARE_VERSION] = DEFAULT_FIRMWARE_VERSION;
+        table_[ADDR_ID] = id;
+        table_[ADDR_BAUD_RATE] = registerFromBaud(baudrate);
+        table_[ADDR_RETURN_DELAY_TIME] = 250;
+        table_[ADDR_OPERATING_MODE] = 3;
+        table_[ADDR_TEMPERATURE_LIMIT] = 80;
+        put16(table_ + ADDR_CURRENT_LIMIT, 1193);
+        table_[ADDR_STATUS_RETURN_LEVEL] = 2;
+        put16(table_ + ADDR_PRESENT_INPUT_VOLTAGE, 120);
+        table_[ADDR_PRESENT_TEMPERATURE] = 30;
+        // Indirect Address の出荷時の値は Indirect Data 自身を指す
+        for (int k = 0; k < INDIRECT_SLOTS; k++) {
+            put16(table_ + ADDR_INDIRECT_ADDRESS_1 + 2 * k, static_cast<uint16_t>(ADDR_INDIRECT_DATA_1 + k));
+        }
+        // 初期位置は中央付近にIDごとに少しずらして置く
+        theta_ = (2048.0 + 16.0 * id) / POSITION_PER_RAD;
+        updatePresent(0);
+    }
+
+    uint8_t id() const { return table_[ADDR_ID]; }
+    int baudrate() const { return baudFromRegister(table_[ADDR_BAUD_RATE]); }
+    double returnDelay() const { return table_[ADDR_RETURN_DELAY_TIME] * 2e-6; }
+    uint8_t statusReturnLevel() const { return table_[ADDR_STATUS_RETURN_LEVEL]; }
+    uint8_t firmware() const { return table_[ADDR_FIRMWARE_VERSION]; }
+    void setFirmware(uint8_t version) { table_[ADDR_FIRMWARE_VERSION] = version; }
+    // ハードウェアエラーがあればステータスパケットのエラーバイトに Alert ビットを立てる
+    uint8_t alert() const { return table_[ADDR_HARDWARE_ERROR_STATUS] != 0 ? STATUS_ALERT : 0; }
+
+    // 現在時刻まで力学を進める
+    void advance(double now) {
+        double goal = 0.0;
+        bool driven = table_[ADDR_TORQUE_ENABLE] != 0 && table_[ADDR_OPERATING_MODE] == CURRENT_CONTROL_MODE;
+        int16_t current = 0;
+        if (driven) {
+            int16_t limit = static_cast<int16_t>(get16(table_ + ADDR_CURRENT_LIMIT));
+            current = static_cast<int16_t>(get16(table_ + ADDR_GOAL_CURRENT));
+            if (current > limit) current = limit;
+            if (current < -limit) current = static_cast<int16_t>(-limit);
+            goal = current * CURRENT_UNIT_A * TORQUE_CONSTANT;
+        }
+        while (last_update_ + DYNAMICS_STEP <= now) {
+            double friction = VISCOUS_FRICTION * omega_;
+            if (fabs(omega_) > 1e-6) {
+                friction += (omega_ > 0 ? COULOMB_FRICTION : -COULOMB_FRICTION);
+            } else if (fabs(goal) <= COULOMB_FRICTION) {
+                friction = goal;  // 静止摩擦で止まったまま
+            }
+            omega_ += (goal - friction) / INERTIA * DYNAMICS_STEP;
+            theta_ += omega_ * DYNAMICS_STEP;
+            double amps = current * CURRENT_UNIT_A;
+            temperature_ += (heat_ * amps * amps - (temperature_ - AMBIENT_TEMPERATURE) / THERMAL_TAU) * DYNAMICS_STEP;
+            last_update_ += DYNAMICS_STEP;
+        }
+        if (temperature_ >= table_[ADDR_TEMPERATURE_LIMIT]) {
+            table_[ADDR_HARDWARE_ERROR_STATUS] |= HW_ERROR_OVERHEATING;
+            table_[ADDR_TORQUE_ENABLE] = 0;
+        }
+        updatePresent(table_[ADDR_TORQUE_ENABLE] != 0 ? current : 0);
+    }
+
+    // 読み出し。範囲外なら false
+    bool read(uint16_t address, uint16_t length, const uint8_t** data) {
+        if (address + length > CONTROL_TABLE_SIZE) {
+            return false;
+        }
+        // Indirect Data は指している先の今の値を写してから返す
+        forEachIndirect(address, length, [this](uint16_t data_address, uint16_t target) {
+            table_[data_address] = table_[target];
+        });
+        *data = table_ + address;
+        return true;
+    }
+
+    // 書き込み。エラー番号を返す（0 なら成功）
+    uint8_t write(uint16_t address, const uint8_t* data, size_t length) {
+        if (address + length > CONTROL_TABLE_SIZE) {
+            return ERRNUM_DATA_LIMIT;
+        }
+        if (address < ADDR_READ_ONLY_END && address + length > ADDR_READ_ONLY_BEGIN) {
+            return ERRNUM_ACCESS;
+        }
+        if (address < ADDR_TORQUE_ENABLE_END && table_[ADDR_TORQUE_ENABLE] != 0) {
+            return ERRNUM_ACCESS;  // トルクON中はEEPROM領域を書き換えられない
+        }
+        memcpy(table_ + address, data, length);
+        // Indirect Data への書き込みは指している先へ
+        forEachIndirect(address, length, [this](uint16_t data_address, uint16_t target) {
+            if (target < ADDR_READ_ONLY_BEGIN || target >= ADDR_READ_ONLY_END) {
+                table_[target] = table_[data_address];
+            }
+        });
+        return 0;
+    }
+
+private:
+    // [address, address + length) に入る Indirect Data のバイトごとに fn(そのアドレス, 指している先) を呼ぶ
+    template <class Fn>
+    void forEachIndirect(uint16_t address, size_t length, Fn fn) {
+        for (int k = 0; k < INDIRECT_SLOTS; k++) {
+            uint16_t data_address = static_cast<uint16_t>(ADDR_INDIRECT_DATA_1 + k);
+            if (data_address < address || data_address >= address + length) {
+                continue;
+            }
+            uint16_t target = get16(table_ + ADDR_INDIRECT_ADDRESS_1 + 2 * k);
+            bool self = target >= ADDR_INDIRECT_DATA_1 && target < ADDR_INDIRECT_DATA_1 + INDIRECT_SLOTS;
+            if (!self && target < CONTROL_TABLE_SIZE) {
+                fn(data_address, target);
+            }
+        }
+    }
+
+    void updatePresent(int16_t current) {
+        put16(table_ + ADDR_PRESENT_CURRENT, static_cast<uint16_t>(current));
+        double rpm = omega_ * 60.0 / (2.0 * M_PI);
+        put32(table_ + ADDR_PRESENT_VELOCITY, static_cast<uint32_t>(static_cast<int32_t>(lround(rpm / VELOCITY_UNIT_RPM))));
+        put32(table_ + ADDR_PRESENT_POSITION, static_cast<uint32_t>(static_cast<int32_t>(lround(theta_ * POSITION_PER_RAD))));
+        table_[ADDR_PRESENT_TEMPERATURE] = static_cast<uint8_t>(lround(temperature_));
+    }
+
+    uint8_t table_[CONTROL_TABLE_SIZE];
+    double theta_;        // [rad]
+    double omega_;        // [rad/s]
+    double temperature_;  // [degC]
+    double heat_;         // 1A あたりの温度上昇 [degC/s]
+    double last_update_;  // [s]
+};
+
+struct SimStats {
+    uint64_t instructions = 0;
+    uint64_t status_packets = 0;
+    uint64_t bytes_rx = 0;
+    uint64_t bytes_tx = 0;
+    uint64_t baud_mismatch = 0;
+    uint64_t corrupted = 0;
+    uint64_t dropped = 0;
+};
+
+// 応答に入れる故障
+struct SimFaults {
+    double corrupt = 0.0;     // CRCを化けさせる確率
+    double drop = 0.0;        // 返さない確率
+    double after = 0.0;       // 起動からこの秒数が過ぎてから入れる
+    double started = 0.0;
+};
+
+// 半二重バスの時間経過を模擬する
+class SimBus {
+public:
+    SimBus(int master_fd, int slave_fd, const SimFaults& faults)
+        : fd_(master_fd), slave_fd_(slave_fd), free_at_(0.0), faults_(faults) {}
+
+    // ホスト側ポートに設定されている速度 [bps]（不明なら 0）
+    int hostBaudrate() const {
+        struct termios tio;
+        if (tcgetattr(slave_fd_, &tio) != 0) {
+            return 0;
+        }
+        return baudFromSpeed(cfgetospeed(&tio));
+    }
+
+    // インストラクションパケットを受信し終えた時刻を求める
+    double receive(size_t bytes, int baudrate, double arrived) {
+        stats.instructions++;
+        stats.bytes_rx += bytes;
+        double start = arrived > free_at_ ? arrived : free_at_;
+        free_at_ = start + wireTimeUs(bytes, baudrate) * 1e-6;
+        return free_at_;
+    }
+
+    // 返送遅延のあと、ボーレートどおりの時間をかけて送る
+    void sendStatus(const SimServo& servo, uint8_t error, const uint8_t* data, size_t data_len) {
+        uint8_t packet[PACKET_MAX_LEN];
+        size_t len = buildStatusPacket(packet, servo.id(), error | servo.alert(), data, data_len);
+        send(packet, len, servo.returnDelay(), servo.baudrate());
+    }
+
+    // Fast Sync Read の応答。params は [エラー][ID][データ][CRC 2] の繰り返し（最後の CRC を除く）。
+    // 1台目の返送遅延のあと、各台が続けて送るので全体で1つのパケットになる
+    void sendFastStatus(const SimServo& first, const uint8_t* params, size_t param_len) {
+        uint8_t packet[PACKET_MAX_LEN];
+        size_t len = buildPacket(packet, ID_BROADCAST, STATUS, params, param_len);
+        send(packet, len, first.returnDelay(), first.baudrate());
+    }
+
+    SimStats stats;
+
+private:
+    void send(uint8_t* packet, size_t len, double return_delay, int baudrate) {
+        free_at_ += return_delay + wireTimeUs(len, baudrate) * 1e-6;
+        if (faults_.corrupt > 0.0 || faults_.drop > 0.0) {
+            if (monotonicSeconds() - faults_.started >= faults_.after) {
+                double r = drand48();
+                if (r < faults_.drop) {
+                    stats.dropped++;
+                    return;  // 返さない（バスの時間だけは過ぎる）
+                }
+                if (r < faults_.drop + faults_.corrupt) {
+                    packet[len - 1] ^= 0xFF;
+                    stats.corrupted++;
+                }
+            }
+        }
+        waitUntil(free_at_);
+        size_t sent = 0;
+        while (sent < len) {
+            ssize_t n = write(fd_, packet + sent, len - sent);
+            if (n <= 0) {
+                return;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        stats.status_packets++;
+        stats.bytes_tx += len;
+    }
+
+    int fd_;
+    int slave_fd_;
+    double free_at_;  // バスが空く時刻
+    SimFaults faults_;
+};
+
+class SimServoSet {
+public:
+    SimServoSet(const std::vector<uint8_t>& ids, int baudrate, double heat) {
+        for (uint8_t id : ids) {
+            servos_.emplace_back(id, baudrate, heat);
+        }
+    }
+
+    SimServo* find(uint8_t id) {
+        for (auto& servo : servos_) {
+            if (servo.id() == id) {
+                return &servo;
+            }
+        }
+        return nullptr;
+    }
+
+    void advance(double now) {
+        for (auto& servo : servos_) {
+            servo.advance(now);
+        }
+    }
+
+    std::vector<SimServo>& all() { return servos_; }
+
+private:
+    std::vector<SimServo> servos_;
+};
+
+static void handlePacket(SimBus& bus, SimServoSet& servos, const Packet& packet, double arrived) {
+    // 1本のバス上の全サーボは同じボーレートで動く前提。ホストと合わなければ誰も応答しない
+    int baudrate = servos.all().empty() ? 57600 : servos.all()[0].baudrate();
+    int host_baudrate = bus.hostBaudrate();
+    if (host_baudrate != 0 && host_baudrate != baudrate) {
+        bus.stats.baud_mismatch++;
+        return;
+    }
+
+    double received = bus.receive(packet.param_len + PACKET_OVERHEAD, baudrate, arrived);
+    waitUntil(received);
+    servos.advance(monotonicSeconds());
+
+    const uint8_t* p = packet.params;
+    const uint8_t* data = nullptr;
+    switch (packet.instruction) {
+    case PING: {
+        SimServo* servo = servos.find(packet.id);
+        if (servo) {
+            servo->read(ADDR_MODEL_NUMBER, 3, &data);
+            bus.sendStatus(*servo, 0, data, 3);
+        }
+        break;
+    }
+    case READ: {
+        SimServo* servo = servos.find(packet.id);
+        if (!servo) {
+            break;
+        }
+        if (packet.param_len != 4) {
+            bus.sendStatus(*servo, ERRNUM_DATA_LENGTH, nullptr, 0);
+            break;
+        }
+        uint16_t length = get16(p + 2);
+        if (!servo->read(get16(p), length, &data)) {
+            bus.sendStatus(*servo, ERRNUM_DATA_LIMIT, nullptr, 0);
+            break;
+        }
+        bus.sendStatus(*servo, 0, data, length);
+        break;
+    }
+    case WRITE: {
+        if (packet.param_len < 3) {
+            break;
+        }
+        uint16_t address = get16(p);
+        for (auto& servo : servos.all()) {
+            if (packet.id != ID_BROADCAST && servo.id() != packet.id) {
+                continue;
+            }
+            uint8_t error = servo.write(address, p + 2, packet.param_len - 2);
+            if (packet.id != ID_BROADCAST && servo.statusReturnLevel() >= 2) {
+                bus.sendStatus(servo, error, nullptr, 0);
+            }
+        }
+        break;
+    }
+    case SYNC_READ: {
+        if (packet.param_len < 5) {
+            break;
+        }
+        uint16_t address = get16(p);
+        uint16_t length = get16(p + 2);
+        // 指定順に各サーボが順番に応答する
+        for (size_t i = 4; i < packet.param_len; i++) {
+            SimServo* servo = servos.find(p[i]);
+            if (servo && servo->read(address, length, &data)) {
+                bus.sendStatus(*servo, 0, data, length);
+            }
+        }
+        break;
+    }
+    case FAST_SYNC_READ: {
+        if (packet.param_len < 5) {
+            break;
+        }
+        uint16_t address = get16(p);
+        uint16_t length = get16(p + 2);
+        // 前の台の区間に続けて送るので、1台でも欠けるか古いファームウェアならパケットが完成しない（応答しない）
+        uint8_t params[PACKET_MAX_LEN];
+        size_t n = 0;
+        SimServo* first = nullptr;
+        bool complete = true;
+        for (size_t i = 4; i < packet.param_len && complete; i++) {
+            SimServo* servo = servos.find(p[i]);
+            complete = servo && servo->firmware() >= FAST_SYNC_READ_FIRMWARE &&
+                       servo->read(address, length, &data) &&
+                       n + FAST_SEGMENT_OVERHEAD + length <= sizeof(params) - PACKET_OVERHEAD;
+            if (!complete) {
+                break;
+            }
+            if (!first) {
+                first = servo;
+            }
+            params[n] = servo->alert();
+            params[n + 1] = servo->id();
+            memcpy(params + n + 2, data, length);
+            // 途中の CRC はホストが確かめないので、その台の区間だけで計算する（最後の台の分はパケットの CRC）
+            put16(params + n + 2 + length, updateCRC(0, params + n, 2 + length));
+            n += FAST_SEGMENT_OVERHEAD + length;
+        }
+        if (complete && first) {
+            bus.sendFastStatus(*first, params, n - 2);
+        }
+        break;
+    }
+    case SYNC_WRITE: {
+        if (packet.param_len < 4) {
+            break;
+        }
+        uint16_t address = get16(p);
+        uint16_t length = get16(p + 2);
+        for (size_t i = 4; i + 1 + length <= packet.param_len; i += 1 + length) {
+            SimServo* servo = servos.find(p[i]);
+            if (servo) {
+                servo->write(address, p + i + 1, length);
+            }
+        }
+        break;
+    }
+    case BULK_READ: {
+        for (size_t i = 0; i + 5 <= packet.param_len; i += 5) {
+            SimServo* servo = servos.find(p[i]);
+            uint16_t length = get16(p + i + 3);
+            if (servo && servo->read(get16(p + i + 1), length, &data)) {
+                bus.sendStatus(*servo, 0, data, length);
+            }
+        }
+        break;
+    }
+    case BULK_WRITE: {
+        size_t i = 0;
+        while (i + 5 <= packet.param_len) {
+            uint16_t length = get16(p + i + 3);
+            if (i + 5 + length > packet.param_len) {
+                break;
+            }
+            SimServo* servo = servos.find(p[i]);
+            if (servo) {
+                servo->write(get16(p + i + 1), p + i + 5, length);
+            }
+            i += 5 + length;
+        }
+        break;
+    }
+    default: {
+        SimServo* servo = servos.find(packet.id);
+        if (servo) {
+            bus.sendStatus(*servo, ERRNUM_INSTRUCTION, nullptr, 0);
+        }
+        break;
+    }
+    }
+}
+
+static std::vector<uint8_t> parseIds(const std::string& text) {
+    std::vector<uint8_t> ids;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            ids.push_back(static_cast<uint8_t>(std::stoi(item)));
+        }
+    }
+    return ids;
+}
+
+int main(int argc, char* argv[]) {
+    std::string link_path = "/tmp/ttyDXL";
+    std::vector<uint8_t> ids = {1, 2};
+    int baudrate = 57600;
+    SimFaults faults;
+    double heat = 0.0;
+    int firmware = DEFAULT_FIRMWARE_VERSION;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:i:n:b:e:t:F:")) != -1) {
+        switch (opt) {
+        case 'p': link_path = optarg; break;
+        case 'i': ids = parseIds(optarg); break;
+        case 'n':
+            ids.clear();
+            for (int id = 1; id <= atoi(optarg) && id < ID_BROADCAST; id++) {
+                ids.push_back(static_cast<uint8_t>(id));
+            }
+            break;
+        case 'b': baudrate = atoi(optarg); break;
+        case 't': heat = atof(optarg); break;
+        case 'F': firmware = atoi(optarg); break;
+        case 'e':
+            if (sscanf(optarg, "%lf,%lf,%lf", &faults.corrupt, &faults.drop, &faults.after) < 1) {
+                std::cerr << "Invalid -e " << optarg << " (expected corrupt[,drop[,after]])\n";
+                return 1;
+            }
+            break;
+        default:
+            std::cerr << "Usage: " << argv[0]
+                      << " [-p link_path] [-i id1,id2,... | -n count] [-b baudrate] [-t heat] [-F firmware]"
+                      << " [-e corrupt[,drop[,after]]]\n";
+            return 1;
+        }
+    }
+
+    int master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_fd < 0 || grantpt(master_fd) != 0 || unlockpt(master_fd) != 0) {
+        perror("posix_openpt");
+        return 1;
+    }
+    const char* slave_name = ptsname(master_fd);
+
+    // スレーブ側を生の端末にして開いたままにしておく（クライアントが閉じても EIO にならない）
+    int slave_fd = open(slave_name, O_RDWR | O_NOCTTY);
+    if (slave_fd < 0) {
+        perror("open slave");
+        return 1;
+    }
+    struct termios tio;
+    tcgetattr(slave_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave_fd, TCSANOW, &tio);
+
+    unlink(link_path.c_str());
+    if (symlink(slave_name, link_path.c_str()) != 0) {
+        perror("symlink");
+        return 1;
+    }
+
+    SimServoSet servos(ids, baudrate, heat);
+    for (auto& servo : servos.all()) {
+        servo.setFirmware(static_cast<uint8_t>(firmware));
+    }
+
+    // read() を中断させたいので SA_RESTART は付けない
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    std::cout << "Simulating " << ids.size() << " servo(s) at " << baudrate << " bps on "
+              << link_path << " -> " << slave_name << std::endl;
+
+    srand48(1);
+    faults.started = monotonicSeconds();
+    SimBus bus(master_fd, slave_fd, faults);
+    PacketParser parser;
+    uint8_t buf[256];
+    while (g_running) {
+        ssize_t n = read(master_fd, buf, sizeof(buf));
+        if (n <= 0) {
+            continue;
+        }
+        double arrived = monotonicSeconds();
+        parser.feed(buf, static_cast<size_t>(n));
+        Packet packet;
+        while (parser.next(packet)) {
+            if (packet.instruction == STATUS) {
+                continue;
+            }
+            handlePacket(bus, servos, packet, arrived);
+        }
+    }
+
+    std::cout << "instructions: " << bus.stats.instructions << ", status packets: " << bus.stats.status_packets
+              << ", bytes rx/tx: " << bus.stats.bytes_rx << "/" << bus.stats.bytes_tx
+              << ", crc errors: " << parser.crcErrors() << ", baud mismatches: " << bus.stats.baud_mismatch;
+    if (bus.stats.corrupted > 0 || bus.stats.dropped > 0) {
+        std::cout << ", injected corrupt/drop: " << bus.stats.corrupted << "/" << bus.stats.dropped;
+    }
+    std::cout << std::endl;
+
+    unlink(link_path.c_str());
+    close(slave_fd);
+    close(master_fd);
+    return 0;
+}
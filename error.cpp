@@ -1,119 +1,95 @@
 #include <iostream>
-#include <vector>
-#include <chrono>        // 時間計測のためのインクルード
-#include <unistd.h>      // usleep関数のためのインクルード
-#include <iomanip>       // 日時フォーマットのためのインクルード
-#include <fstream>       // ファイル出力のためのインクルード
-#include <ctime>         // 現在時刻の取得
-#include "dynamixel_sdk.h" // Dynamixel SDKのヘッダファイル
-
-#define PROTOCOL_VERSION 2.0
+#include "dxl_bus.h"             // ポート・モーター・後片付け（libdxlctrl）
+#include "alloc_check.h"
+#include "control_runtime.h"
+#include "event_log.h"
+#include "run_util.h"
+#include "periodic_executor.h" // 固定周期実行
+#include "async_logger.h"
+#include "binlog.h"
+
 #define DEVICENAME "/dev/ttyUSB0" // ポート名
 #define BAUDRATE 57600             // ボーレート
 #define DXL_ID 1
 
-// 制御テーブルアドレス
-#define ADDR_OPERATING_MODE 11   // 動作モード
-#define ADDR_TORQUE_ENABLE 64    // トルクの有効/無効
-#define ADDR_CURRENT_LIMIT 38    // 電流制限
-#define ADDR_GOAL_CURRENT 102    // 目標電流
-#define ADDR_PRESENT_CURRENT 126 // 現在の電流
-#define ADDR_PRESENT_POSITION 132 // 現在の角度
-
-#define OPERATING_MODE_CURRENT 0 // 電流制御モードを0に設定
-#define TORQUE_ENABLE 1
-#define TORQUE_DISABLE 0
-
 // 90度に相当するエンコーダの値
 #define TARGET_POSITION 1024   // 90度相当
 #define DURATION 3.0           // 3秒間
-
-using namespace dynamixel;
-
-// データ記録用の構造体
-struct DataRecord {
-    double time;         // 時間 (秒)
-    int16_t current;     // 電流 (mA)
-    int32_t position;    // 角度 (位置データ)
-};
-
-// 現在時刻を取得し、YYYYMMDDHHMMSS形式の文字列を返す関数
-std::string getCurrentTimestamp() {
-    auto now = std::chrono::system_clock::now();
-    auto in_time_t = std::chrono::system_clock::to_time_t(now);
-    std::tm buf;
-    localtime_r(&in_time_t, &buf);
-
-    std::ostringstream oss;
-    oss << std::put_time(&buf, "%Y%m%d%H%M%S");
-    return oss.str();
-}
+#define CONTROL_PERIOD 0.01    // 制御周期（100Hz）
+#define MAX_EVENTS 256         // 制御ループ中に記録する通信エラーの上限
 
 int main() {
-    PortHandler *portHandler = PortHandler::getPortHandler(DEVICENAME);
-    PacketHandler *packetHandler = PacketHandler::getPacketHandler(PROTOCOL_VERSION);
+    // Ctrl-C（SIGINT）・SIGTERM・ポートの切断でもループを抜けて後片付けを通す（スレッドを作る前に用意する）
+    ControlRuntime runtime;
 
-    if (!portHandler->openPort()) {
+    DxlBus bus;
+    if (!bus.open(DEVICENAME, {DXL_ID}, BAUDRATE)) {
         std::cerr << "Failed to open port!" << std::endl;
         return 1;
     }
-
-    if (!portHandler->setBaudRate(BAUDRATE)) {
-        std::cerr << "Failed to set baudrate!" << std::endl;
+    const BaudCalibration& baud = bus.baud();
+    runtime.watchHangup(bus.fd(), "serial port");
+
+    // データはリングに積み、専用スレッドで書き出す（3秒 × 100Hz ぶんを最初に確保する）
+    // （DXL_LOG_FORMAT=binary でバイナリ形式。binlog2csv で同じCSVに戻せる）
+    BinLogHeader log_header = makeBinLogHeader(LAYOUT_CURRENT_DATA, {DXL_ID}, 1.0 / CONTROL_PERIOD);
+    log_header.baudrate = baud.baudrate;
+    log_header.rtt_p50_us = baud.rtt_p50_us;
+    log_header.rtt_p99_us = baud.rtt_p99_us;
+    log_header.packet_error_rate = baud.error_rate;
+    AsyncLogger logger(logCapacityFor(DURATION, CONTROL_PERIOD));
+    std::string filename;
+    if (!openRunLog(logger, "./current_data/" + currentTimestamp() + "_data", log_header, filename)) {
+        std::cerr << "Failed to open file for writing!" << std::endl;
         return 1;
     }
 
-    uint8_t error = 0;
-    int dxl_comm_result = packetHandler->write1ByteTxRx(portHandler, DXL_ID, ADDR_OPERATING_MODE, OPERATING_MODE_CURRENT, &error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-    } else if (error != 0) {
-        std::cerr << packetHandler->getRxPacketError(error) << std::endl;
-    } else {
+    DxlMotor motor(bus, DXL_ID);
+    if (motor.setOperatingMode(CURRENT_CONTROL_MODE)) {
         std::cout << "Operating mode set to Current Control Mode." << std::endl;
     }
 
-    dxl_comm_result = packetHandler->write1ByteTxRx(portHandler, DXL_ID, ADDR_TORQUE_ENABLE, TORQUE_ENABLE, &error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-    } else if (error != 0) {
-        std::cerr << packetHandler->getRxPacketError(error) << std::endl;
-    } else {
-        std::cout << "Torque enabled." << std::endl;
+    // 電流制限を設定（10 mA）。EEPROM なのでトルクを入れる前に書く
+    if (!motor.setCurrentLimit(10)) {
+        return 1;
     }
 
-    // 電流制限を設定（10 mA）
-    int16_t current_limit = 10; // mA
-    dxl_comm_result = packetHandler->write2ByteTxRx(portHandler, DXL_ID, ADDR_CURRENT_LIMIT, current_limit, &error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-        return 1;
+    // ここから先はどの経路で抜けても目標電流0・トルクOFFにする
+    MotorGuard guard(bus, {DXL_ID});
+    if (motor.setTorque(true)) {
+        std::cout << "Torque enabled." << std::endl;
     }
 
     // 目標電流を設定（3 mA）
-    int16_t goal_current = 3; // mA
-    dxl_comm_result = packetHandler->write2ByteTxRx(portHandler, DXL_ID, ADDR_GOAL_CURRENT, goal_current, &error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
+    if (!motor.setGoalCurrent(3)) {
         return 1;
     }
 
-    // データ記録用
-    std::vector<DataRecord> data_log;
-    auto start_time = std::chrono::steady_clock::now(); // 計測開始時間
-
     // 3秒間の制御ループ（線形に角度を変化）
     int32_t initial_position = 0;
-    dxl_comm_result = packetHandler->read4ByteTxRx(portHandler, DXL_ID, ADDR_PRESENT_POSITION, (uint32_t*)&initial_position, &error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
+    if (!motor.readPosition(initial_position)) {
         return 1;
     }
 
-    for (int i = 0; i < 300; i++) { // 3秒間、100Hzのループ
+    // ループ中の通信エラーは固定長の記録に溜め、ループを抜けてから表示する
+    EventLog events(MAX_EVENTS);
+    bus.setEventLog(&events);
+
+    // DXL_ALLOC_CHECK=1 なら、2周目以降にヒープ確保が起きたら失敗にする
+    AllocCheck alloc_check(allocCheckFromEnv());
+
+    PeriodicExecutor executor(executorConfigFromEnv(CONTROL_PERIOD));
+    executor.setRuntime(&runtime);
+    executor.run([&](const CycleInfo& cycle) { // 3秒間、100Hzのループ
+        if (cycle.cycle == 1) {
+            alloc_check.arm();  // 1周目の初回確保は数えない
+        }
+        if (cycle.cycle >= 300) {
+            return false;
+        }
+
         // 経過時間の計測
-        auto current_time = std::chrono::steady_clock::now();
-        double elapsed_time = std::chrono::duration<double>(current_time - start_time).count();
+        double elapsed_time = cycle.elapsed_s;
 
         // 目標位置の計算 (線形に0度から90度まで変化)
         int32_t target_position = initial_position + static_cast<int32_t>(TARGET_POSITION * (elapsed_time / DURATION));
@@ -122,72 +98,52 @@ int main() {
         }
 
         // 目標位置に基づいた電流設定
-        dxl_comm_result = packetHandler->write4ByteTxRx(portHandler, DXL_ID, ADDR_PRESENT_POSITION, target_position, &error);
-        if (dxl_comm_result != COMM_SUCCESS) {
-            std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-            break;
-        } else if (error != 0) {
-            std::cerr << packetHandler->getRxPacketError(error) << std::endl;
-            break;
+        if (!bus.write4(DXL_ID, xm430::PresentPosition::address, target_position, "目標位置の書き込み")) {
+            return false;
         }
 
         // 現在の電流を取得
         int16_t present_current = 0;
-        dxl_comm_result = packetHandler->read2ByteTxRx(portHandler, DXL_ID, ADDR_PRESENT_CURRENT, (uint16_t*)&present_current, &error);
-        if (dxl_comm_result != COMM_SUCCESS) {
-            std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-            break;
-        } else if (error != 0) {
-            std::cerr << packetHandler->getRxPacketError(error) << std::endl;
-            break;
+        if (!motor.readCurrent(present_current)) {
+            return false;
         }
 
         // 現在の角度（位置）を取得
         int32_t present_position = 0;
-        dxl_comm_result = packetHandler->read4ByteTxRx(portHandler, DXL_ID, ADDR_PRESENT_POSITION, (uint32_t*)&present_position, &error);
-        if (dxl_comm_result != COMM_SUCCESS) {
-            std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-            break;
-        } else if (error != 0) {
-            std::cerr << packetHandler->getRxPacketError(error) << std::endl;
-            break;
+        if (!motor.readPosition(present_position)) {
+            return false;
         }
 
         // データを記録
-        data_log.push_back({elapsed_time, present_current, present_position});
-
-        // 10ms待機（100Hz）
-        usleep(10000);
-    }
-
-    // トルクを無効化してモータを停止
-    dxl_comm_result = packetHandler->write1ByteTxRx(portHandler, DXL_ID, ADDR_TORQUE_ENABLE, TORQUE_DISABLE, &error);
-    if (dxl_comm_result != COMM_SUCCESS) {
-        std::cerr << packetHandler->getTxRxResult(dxl_comm_result) << std::endl;
-    } else if (error != 0) {
-        std::cerr << packetHandler->getRxPacketError(error) << std::endl;
-    } else {
-        std::cout << "Torque disabled. Motor stopped." << std::endl;
+        LogSample sample;
+        sample.time = elapsed_time;
+        sample.num_motors = 1;
+        sample.current[0] = present_current;
+        sample.position[0] = present_position;
+        sample.stale = 0;
+        logger.log(sample);
+        return true;
+    });
+    alloc_check.disarm();
+    if (runtime.stopRequested()) {
+        std::cout << "Stopped: " << runtime.stopReason() << std::endl;
     }
-
-    portHandler->closePort();
-
-    // タイムスタンプを取得し、ファイル名を生成
-    std::string timestamp = getCurrentTimestamp();
-    std::string filename = "./current_data/" + timestamp + "_data.csv";
-
-    // CSVファイルにデータを保存
-    std::ofstream file(filename);
-    if (file.is_open()) {
-        file << "Time (s),Current (mA),Position\n";
-        for (const auto &record : data_log) {
-            file << record.time << "," << record.current << "," << record.position << "\n";
-        }
-        file.close();
-        std::cout << "Data saved to " << filename << std::endl;
-    } else {
-        std::cerr << "Failed to open file for writing!" << std::endl;
+    executor.printReport(std::cout);
+    bus.setEventLog(nullptr);
+    events.print(std::cerr, bus.packet());
+    bool no_allocations = alloc_check.report(std::cout);
+
+    // 目標電流を0にしてトルクを無効化（ポートは bus のデストラクタで閉じる）
+    guard.release();
+    std::cout << "Torque disabled. Motor stopped." << std::endl;
+
+    // 残りのデータを書き出して閉じる
+    logger.close();
+    std::cout << "Data saved to " << filename << " (" << logger.written() << " samples";
+    if (logger.overflows() > 0) {
+        std::cout << ", dropped " << logger.overflows();
     }
+    std::cout << ")" << std::endl;
 
-    return 0;
+    return no_allocations ? 0 : 1;
 }
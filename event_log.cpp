@@ -0,0 +1,54 @@
+#include "event_log.h"
+
+#include <time.h>
+#include <iomanip>
+
+static double monotonicSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+EventLog::EventLog(size_t capacity) : events_(capacity), count_(0), dropped_(0), start_(monotonicSeconds()) {}
+
+void EventLog::record(uint8_t id, const char* what, int comm_result, uint8_t error) {
+    if (count_ >= events_.size()) {
+        dropped_++;
+        return;
+    }
+    ControlEvent& event = events_[count_++];
+    event.time = monotonicSeconds() - start_;
+    event.what = what;
+    event.comm_result = comm_result;
+    event.id = id;
+    event.error = error;
+}
+
+void EventLog::print(std::ostream& os, dynamixel::PacketHandler* packetHandler) const {
+    if (count_ == 0 && dropped_ == 0) {
+        return;
+    }
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < count_; i++) {
+        const ControlEvent& event = events_[i];
+        os << "[" << event.time << " s] ";
+        if (event.id == BROADCAST_ID) {
+            os << "All motors ";
+        } else {
+            os << "Motor " << static_cast<int>(event.id) << " ";
+        }
+        os << event.what << ": ";
+        if (event.comm_result != COMM_SUCCESS) {
+            os << packetHandler->getTxRxResult(event.comm_result);
+        } else {
+            os << "RxPacketError " << static_cast<int>(event.error) << " (" << packetHandler->getRxPacketError(event.error) << ")";
+        }
+        os << "\n";
+    }
+    if (dropped_ > 0) {
+        os << "(他 " << dropped_ << " 件は記録しきれずに捨てました)\n";
+    }
+    os.flags(flags);
+    os.flush();
+}
@@ -0,0 +1,41 @@
+#ifndef EVENT_LOG_H_
+#define EVENT_LOG_H_
+
+#include "dynamixel_sdk.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+// 制御ループ中の通信エラー1件（固定長）
+struct ControlEvent {
+    double time;          // EventLog を作ってからの経過時間 [s]
+    const char* what;     // 操作名（文字列リテラルなど寿命の長いものだけ）
+    int comm_result;      // COMM_*
+    uint8_t id;           // 全IDにかかわるもの（Sync Read/Write）は BROADCAST_ID
+    uint8_t error;        // ステータスパケットのエラーバイト
+};
+
+// 制御ループ中のエラーを iostream で整形せず、固定長の記録として溜めておく。
+// 容量は構築時に確保し、溢れた分は数だけ数える。表示はループを抜けてから print() で行う。
+// 1つのスレッドからだけ使うこと。
+class EventLog {
+public:
+    explicit EventLog(size_t capacity);
+
+    void record(uint8_t id, const char* what, int comm_result, uint8_t error);
+
+    size_t size() const { return count_; }
+    uint64_t dropped() const { return dropped_; }
+
+    void print(std::ostream& os, dynamixel::PacketHandler* packetHandler) const;
+
+private:
+    std::vector<ControlEvent> events_;
+    size_t count_;
+    uint64_t dropped_;
+    double start_;
+};
+
+#endif  // EVENT_LOG_H_
@@ -0,0 +1,246 @@
+#include "feedforward.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// 時刻 t[i - w .. i + w] の位置に p(s) = c0 + c1 s + c2 s^2 （s = t - t[i]）を当てはめ、v = c1, a = 2 c2 を返す
+bool localQuadratic(const double* t, const int32_t* position, size_t i, size_t w, double& v, double& a) {
+    double s_pow[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
+    double sy[3] = {0.0, 0.0, 0.0};
+    for (size_t j = i - w; j <= i + w; j++) {
+        double s = t[j] - t[i];
+        double y = static_cast<double>(position[j] - position[i]);
+        double sk = 1.0;
+        for (int k = 0; k < 5; k++) {
+            s_pow[k] += sk;
+            if (k < 3) sy[k] += sk * y;
+            sk *= s;
+        }
+    }
+    // [S0 S1 S2; S1 S2 S3; S2 S3 S4] c = sy をクラメルの公式で解く
+    double m[3][3] = {{s_pow[0], s_pow[1], s_pow[2]}, {s_pow[1], s_pow[2], s_pow[3]}, {s_pow[2], s_pow[3], s_pow[4]}};
+    auto det3 = [](const double (&x)[3][3]) {
+        return x[0][0] * (x[1][1] * x[2][2] - x[1][2] * x[2][1]) - x[0][1] * (x[1][0] * x[2][2] - x[1][2] * x[2][0]) +
+               x[0][2] * (x[1][0] * x[2][1] - x[1][1] * x[2][0]);
+    };
+    double det = det3(m);
+    if (!(fabs(det) > 0.0)) {
+        return false;
+    }
+    double c[3];
+    for (int k = 1; k < 3; k++) {
+        double mk[3][3];
+        for (int r = 0; r < 3; r++) {
+            for (int col = 0; col < 3; col++) {
+                mk[r][col] = col == k ? sy[r] : m[r][col];
+            }
+        }
+        c[k] = det3(mk) / det;
+    }
+    v = c[1];
+    a = 2.0 * c[2];
+    return true;
+}
+
+// 対称正定値の n x n を コレスキー分解で解く（m と b は壊す）
+bool choleskySolve(double (&m)[FF_PARAMS][FF_PARAMS], double (&b)[FF_PARAMS], int n) {
+    for (int j = 0; j < n; j++) {
+        double d = m[j][j];
+        for (int k = 0; k < j; k++) d -= m[j][k] * m[j][k];
+        if (!(d > 0.0)) {
+            return false;
+        }
+        m[j][j] = sqrt(d);
+        for (int i = j + 1; i < n; i++) {
+            double s = m[i][j];
+            for (int k = 0; k < j; k++) s -= m[i][k] * m[j][k];
+            m[i][j] = s / m[j][j];
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        double s = b[i];
+        for (int k = 0; k < i; k++) s -= m[i][k] * b[k];
+        b[i] = s / m[i][i];
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        double s = b[i];
+        for (int k = i + 1; k < n; k++) s -= m[k][i] * b[k];
+        b[i] = s / m[i][i];
+    }
+    return true;
+}
+
+}  // namespace
+
+FeedforwardFit::FeedforwardFit(size_t joints, bool gravity) : normal_(joints), gravity_(gravity) {}
+
+size_t FeedforwardFit::addRun(size_t joint, const double* t, const int32_t* position, const int16_t* current,
+                              size_t n) {
+    if (joint >= normal_.size() || n < 2 * FF_WINDOW + 1) {
+        return 0;
+    }
+    Normal& ne = normal_[joint];
+    size_t used = 0;
+    for (size_t i = FF_WINDOW; i + FF_WINDOW < n; i++) {
+        double v, a;
+        if (!localQuadratic(t, position, i, FF_WINDOW, v, a)) {
+            continue;
+        }
+        double theta = position[i] * (2.0 * M_PI / 4096.0);
+        double sign = v > FF_SIGN_DEADBAND ? 1.0 : (v < -FF_SIGN_DEADBAND ? -1.0 : 0.0);
+        double x[FF_PARAMS] = {v, a, sign, gravity_ ? sin(theta) : 0.0, gravity_ ? cos(theta) : 0.0};
+        double b = current[i];
+        for (int r = 0; r < FF_PARAMS; r++) {
+            for (int c = 0; c < FF_PARAMS; c++) {
+                ne.ata[r][c] += x[r] * x[c];
+            }
+            ne.atb[r] += x[r] * b;
+        }
+        ne.btb += b * b;
+        ne.sum_b += b;
+        ne.moving += sign != 0.0;
+        used++;
+    }
+    ne.samples += used;
+    ne.runs += used > 0;
+    return used;
+}
+
+void FeedforwardFit::merge(const FeedforwardFit& other) {
+    for (size_t j = 0; j < normal_.size() && j < other.normal_.size(); j++) {
+        Normal& ne = normal_[j];
+        const Normal& o = other.normal_[j];
+        for (int r = 0; r < FF_PARAMS; r++) {
+            for (int c = 0; c < FF_PARAMS; c++) {
+                ne.ata[r][c] += o.ata[r][c];
+            }
+            ne.atb[r] += o.atb[r];
+        }
+        ne.btb += o.btb;
+        ne.sum_b += o.sum_b;
+        ne.samples += o.samples;
+        ne.moving += o.moving;
+        ne.runs += o.runs;
+    }
+}
+
+bool FeedforwardFit::solve(size_t joint, FeedforwardModel& model, FeedforwardReport& report) const {
+    model = FeedforwardModel();
+    report = FeedforwardReport();
+    if (joint >= normal_.size()) {
+        return false;
+    }
+    const Normal& ne = normal_[joint];
+    report.runs = ne.runs;
+    report.samples = ne.samples;
+    report.moving = ne.moving;
+    if (ne.moving < FF_MIN_MOVING) {
+        return false;
+    }
+
+    // 列ごとの大きさを揃えてから解く（速度と sin/cos で桁が大きく違う）
+    double scale[FF_PARAMS];
+    double m[FF_PARAMS][FF_PARAMS];
+    double coef[FF_PARAMS];
+    for (int r = 0; r < FF_PARAMS; r++) {
+        scale[r] = ne.ata[r][r] > 0.0 ? sqrt(ne.ata[r][r]) : 1.0;
+    }
+    for (int r = 0; r < FF_PARAMS; r++) {
+        for (int c = 0; c < FF_PARAMS; c++) {
+            m[r][c] = ne.ata[r][c] / (scale[r] * scale[c]) + (r == c ? FF_RIDGE : 0.0);
+        }
+        coef[r] = ne.atb[r] / scale[r];
+    }
+    if (!choleskySolve(m, coef, FF_PARAMS)) {
+        return false;
+    }
+    for (int r = 0; r < FF_PARAMS; r++) {
+        coef[r] /= scale[r];
+    }
+
+    // 残差平方和 = b'b - 2 c'A'b + c'A'A c
+    double sse = ne.btb;
+    for (int r = 0; r < FF_PARAMS; r++) {
+        sse -= 2.0 * coef[r] * ne.atb[r];
+        for (int c = 0; c < FF_PARAMS; c++) {
+            sse += coef[r] * ne.ata[r][c] * coef[c];
+        }
+    }
+    sse = sse > 0.0 ? sse : 0.0;
+    double n = static_cast<double>(ne.samples);
+    double sst = ne.btb - ne.sum_b * ne.sum_b / n;
+    report.r2 = sst > 0.0 ? 1.0 - sse / sst : 0.0;
+    report.residual_rms = sqrt(sse / n);
+
+    model.kv = coef[0];
+    model.ka = coef[1];
+    model.kc = coef[2];
+    model.gs = coef[3];
+    model.gc = coef[4];
+    return true;
+}
+
+bool saveFeedforward(const std::string& path, const std::vector<FeedforwardModel>& models) {
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        return false;
+    }
+    fprintf(fp, "# joint kv ka kc gs gc\n");
+    for (size_t j = 0; j < models.size(); j++) {
+        const FeedforwardModel& m = models[j];
+        fprintf(fp, "%zu %.9g %.9g %.9g %.9g %.9g\n", j + 1, m.kv, m.ka, m.kc, m.gs, m.gc);
+    }
+    return fclose(fp) == 0;
+}
+
+bool loadFeedforward(const std::string& path, std::vector<FeedforwardModel>& models) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    models.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) {
+            line.erase(hash);
+        }
+        std::istringstream ss(line);
+        size_t joint;
+        FeedforwardModel m;
+        if (!(ss >> joint)) {
+            continue;
+        }
+        if (joint == 0 || !(ss >> m.kv >> m.ka >> m.kc >> m.gs >> m.gc)) {
+            return false;
+        }
+        if (models.size() < joint) {
+            models.resize(joint);
+        }
+        models[joint - 1] = m;
+    }
+    return true;
+}
+
+bool feedforwardFromEnv(size_t joints, std::vector<FeedforwardModel>& models) {
+    models.clear();
+    const char* env = getenv("DXL_FEEDFORWARD");
+    if (!env || !*env) {
+        return true;
+    }
+    if (!loadFeedforward(env, models)) {
+        std::cerr << "Failed to read feedforward model: " << env << std::endl;
+        return false;
+    }
+    if (models.size() < joints) {
+        std::cerr << "Feedforward model has " << models.size() << " joints, the rest get none" << std::endl;
+    }
+    models.resize(joints);
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef FEEDFORWARD_H_
+#define FEEDFORWARD_H_
+
+#include "trajectory.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// 走行ログ（位置と Present Current）から関節ごとの FeedforwardModel を最小二乗で推定する。
+//   電流 = kv * v + ka * a + kc * sign(v) + gs * sin(θ) + gc * cos(θ)
+// v, a は前後 FF_WINDOW 標本の局所2次近似で求める（時刻の間隔は不揃いでよい）。
+// 正規方程式（5x5）を走行ごとに足し込むだけなので、何本のログでも記憶量は変わらない。
+#define FF_PARAMS                     5
+#define FF_WINDOW                     2       // 片側の標本数（5点で近似）
+#define FF_SIGN_DEADBAND              20.0    // これより遅い [tick/s] ときは sign(v) = 0 とみなす
+#define FF_MIN_MOVING                 50      // 動いている標本がこれ未満なら推定しない
+#define FF_RIDGE                      1e-9    // 正規化した正規方程式の対角に足す値（励起の無い項を0に寄せる）
+
+struct FeedforwardReport {
+    size_t runs = 0;
+    size_t samples = 0;
+    size_t moving = 0;          // |v| > FF_SIGN_DEADBAND の標本
+    double r2 = 0.0;            // 決定係数
+    double residual_rms = 0.0;  // 残差の二乗平均平方根 [Goal Current の生の値]
+};
+
+class FeedforwardFit {
+public:
+    // gravity = false なら gs, gc は推定せず0にする
+    explicit FeedforwardFit(size_t joints, bool gravity = true);
+
+    size_t joints() const { return normal_.size(); }
+
+    // 1本のログの1関節分を足す。使った標本数を返す
+    size_t addRun(size_t joint, const double* t, const int32_t* position, const int16_t* current, size_t n);
+
+    // 別スレッドで集めた分をまとめる（関節数は同じであること）
+    void merge(const FeedforwardFit& other);
+
+    // 標本が足りなければ false（model は0のまま）
+    bool solve(size_t joint, FeedforwardModel& model, FeedforwardReport& report) const;
+
+private:
+    struct Normal {
+        double ata[FF_PARAMS][FF_PARAMS] = {};
+        double atb[FF_PARAMS] = {};
+        double btb = 0.0;
+        double sum_b = 0.0;
+        size_t samples = 0;
+        size_t moving = 0;
+        size_t runs = 0;
+    };
+
+    std::vector<Normal> normal_;
+    bool gravity_;
+};
+
+// モデルファイル（1行1関節： joint kv ka kc gs gc、joint は1から、# 以降は注釈）
+bool saveFeedforward(const std::string& path, const std::vector<FeedforwardModel>& models);
+bool loadFeedforward(const std::string& path, std::vector<FeedforwardModel>& models);
+
+// 環境変数 DXL_FEEDFORWARD=<file> のモデルを joints 関節分読む（ファイルに無い関節は補正なし）。
+// 未設定なら models を空にして true、読めなければ std::cerr に出して false
+bool feedforwardFromEnv(size_t joints, std::vector<FeedforwardModel>& models);
+
+#endif  // FEEDFORWARD_H_
@@ -0,0 +1,126 @@
+// 走行ログから関節ごとのフィードフォワードモデル（粘性・慣性・クーロン摩擦・重力）を推定する
+//   ./fit_feedforward [-j threads] [-g] [-o feedforward.txt] [path ...]
+//   path はファイルかディレクトリ（直下の .csv / .bin を全部読む）。省略時は angle_current。
+//   関節はログのモーター列の順（1列目が joint 1）。-g で重力項（gs, gc）を推定しない。
+// 出力ファイルは DXL_FEEDFORWARD=feedforward.txt で current_control2 / current に渡す。
+#include "feedforward.h"
+#include "run_analysis.h"
+#include "xm430_registers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = 0;
+    bool gravity = true;
+    std::string model_path = "feedforward.txt";
+    int opt;
+    while ((opt = getopt(argc, argv, "j:go:")) != -1) {
+        switch (opt) {
+        case 'j': threads = atoi(optarg); break;
+        case 'g': gravity = false; break;
+        case 'o': model_path = optarg; break;
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-j threads] [-g] [-o feedforward.txt] [path ...]\n";
+            return 1;
+        }
+    }
+    std::vector<std::string> args(argv + optind, argv + argc);
+    if (args.empty()) {
+        args = {"angle_current"};
+    }
+    std::vector<std::string> paths = collectRunLogs(args);
+    if (paths.empty()) {
+        std::cerr << "No run logs found.\n";
+        return 1;
+    }
+    if (threads <= 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    threads = static_cast<int>(std::min<size_t>(threads, paths.size()));
+
+    // ワーカーごとに正規方程式を足し込み、最後にまとめる
+    double start = nowSeconds();
+    std::vector<FeedforwardFit> fits(threads, FeedforwardFit(LOG_MAX_MOTORS, gravity));
+    std::vector<RunStats> results(paths.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&](int w) {
+        RunAnalyzer analyzer{AnalysisOptions()};
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            if (!analyzer.load(paths[i], results[i])) {
+                continue;
+            }
+            for (uint32_t m = 0; m < results[i].num_motors; m++) {
+                fits[w].addRun(m, analyzer.times().data(), analyzer.positions(m).data(), analyzer.currents(m).data(),
+                               analyzer.times().size());
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int w = 1; w < threads; w++) {
+        workers.emplace_back(worker, w);
+    }
+    worker(0);
+    for (std::thread& t : workers) {
+        t.join();
+    }
+    for (int w = 1; w < threads; w++) {
+        fits[0].merge(fits[w]);
+    }
+    double elapsed = nowSeconds() - start;
+
+    size_t failed = 0;
+    uint32_t joints = 0;
+    for (const RunStats& r : results) {
+        if (!r.ok) {
+            std::cerr << r.path << ": " << r.error << std::endl;
+            failed++;
+        } else {
+            joints = std::max(joints, r.num_motors);
+        }
+    }
+
+    std::vector<FeedforwardModel> models(joints);
+    bool all_ok = joints > 0;
+    printf("%-5s %5s %8s %8s %12s %12s %10s %10s %10s %7s %12s\n", "joint", "runs", "samples", "moving", "kv",
+           "ka", "kc", "gs", "gc", "R2", "resid[mA]");
+    for (uint32_t j = 0; j < joints; j++) {
+        FeedforwardReport report;
+        bool ok = fits[0].solve(j, models[j], report);
+        if (ok) {
+            printf("%-5u %5zu %8zu %8zu %12.6g %12.6g %10.4g %10.4g %10.4g %7.3f %12.2f\n", j + 1, report.runs,
+                   report.samples, report.moving, models[j].kv, models[j].ka, models[j].kc, models[j].gs,
+                   models[j].gc, report.r2, report.residual_rms * xm430::PresentCurrent::unit);
+        } else {
+            printf("%-5u %5zu %8zu %8zu  insufficient excitation (need %d moving samples)\n", j + 1, report.runs,
+                   report.samples, report.moving, FF_MIN_MOVING);
+            all_ok = false;
+        }
+    }
+    printf("\n%zu files (%zu failed) in %.1f ms\n", paths.size(), failed, elapsed * 1e3);
+
+    if (joints == 0) {
+        std::cerr << "No usable logs.\n";
+        return 1;
+    }
+    if (!saveFeedforward(model_path, models)) {
+        std::cerr << "Failed to write " << model_path << std::endl;
+        return 1;
+    }
+    printf("Model written to %s\n", model_path.c_str());
+    return all_ok && failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,316 @@
+#include "health_monitor.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <iomanip>
+#include <iostream>
+
+// 読み出しの往復でワイヤ上の時間に足す分（USBシリアルの受信遅延）[us]
+#define HEALTH_LATENCY_ALLOWANCE_US   2000.0
+// 要求パケットの長さ（ヘッダ4 + ID + 長さ2 + 命令 + アドレス2 + 長さ2 + CRC2）
+#define HEALTH_READ_REQUEST_LEN       14
+
+static int64_t monotonicNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// value が warn 以下なら 1、stop 以上なら HEALTH_MIN_SCALE、その間は直線
+static double derate(double value, double warn, double stop) {
+    if (value <= warn) {
+        return 1.0;
+    }
+    if (value >= stop) {
+        return HEALTH_MIN_SCALE;
+    }
+    return 1.0 - (value - warn) / (stop - warn) * (1.0 - HEALTH_MIN_SCALE);
+}
+
+static const char* alertName(HealthAlertKind kind) {
+    switch (kind) {
+    case HealthAlertKind::HardwareError: return "hardware error";
+    case HealthAlertKind::Temperature: return "temperature [degC]";
+    case HealthAlertKind::Voltage: return "input voltage [V]";
+    case HealthAlertKind::Overload: return "load (rms / limit)";
+    }
+    return "";
+}
+
+HealthConfig healthConfigFromEnv(double current_limit) {
+    HealthConfig config;
+    config.current_limit = current_limit;
+    if (const char* value = getenv("DXL_TEMP_WARN")) {
+        config.temp_warn = atof(value);
+    }
+    if (const char* value = getenv("DXL_TEMP_STOP")) {
+        config.temp_stop = atof(value);
+    }
+    if (config.temp_stop <= config.temp_warn) {
+        std::cerr << "DXL_TEMP_STOP must be above DXL_TEMP_WARN; using " << HEALTH_TEMP_WARN << " / "
+                  << HEALTH_TEMP_STOP << std::endl;
+        config.temp_warn = HEALTH_TEMP_WARN;
+        config.temp_stop = HEALTH_TEMP_STOP;
+    }
+    return config;
+}
+
+void printHardwareError(std::ostream& os, uint8_t status) {
+    static const struct {
+        uint8_t bit;
+        const char* name;
+    } names[] = {
+        {HW_ERROR_INPUT_VOLTAGE, "Input Voltage"},
+        {HW_ERROR_OVERHEATING, "Overheating"},
+        {HW_ERROR_MOTOR_ENCODER, "Motor Encoder"},
+        {HW_ERROR_ELECTRICAL_SHOCK, "Electrical Shock"},
+        {HW_ERROR_OVERLOAD, "Overload"},
+    };
+    const char* separator = "";
+    for (const auto& entry : names) {
+        if (status & entry.bit) {
+            os << separator << entry.name;
+            separator = ", ";
+        }
+    }
+    if (*separator == '\0') {
+        os << "none";
+    }
+}
+
+HealthMonitor::HealthMonitor(dynamixel::PortHandler* portHandler, const std::vector<uint8_t>& ids,
+                             const HealthConfig& config)
+    : io_(portHandler),
+      config_(config),
+      ids_(ids),
+      stats_(ids.size()),
+      warned_(ids.size(), 0),
+      load_sq_(ids.size(), 0.0),
+      next_(0),
+      priority_(-1),
+      reads_(0),
+      skipped_(0),
+      start_(monotonicNow() * 1e-9),
+      alerts_(HEALTH_MAX_ALERTS),
+      alert_count_(0),
+      alerts_dropped_(0) {
+    for (HealthStats& s : stats_) {
+        s.voltage_min = INFINITY;
+        s.voltage_max = -INFINITY;
+        s.temperature_max = -INFINITY;
+        s.scale = 1.0;
+        s.scale_min = 1.0;
+    }
+    // 最初の見積もりはワイヤ上の時間（長い方の読み出し）に受信遅延を足したもの
+    double wire_us = dxl_proto::wireTimeUs(HEALTH_READ_REQUEST_LEN + 11 + Supply::length, portHandler->getBaudRate());
+    estimate_ns_ = static_cast<int64_t>((wire_us + HEALTH_LATENCY_ALLOWANCE_US) * 1e3);
+    stop_reason_[0] = '\0';
+}
+
+void HealthMonitor::observeCurrent(size_t i, int16_t current, double dt) {
+    if (config_.current_limit <= 0.0) {
+        return;
+    }
+    double x = current / config_.current_limit;
+    double alpha = dt / HEALTH_LOAD_TAU;
+    load_sq_[i] += (x * x - load_sq_[i]) * (alpha < 1.0 ? alpha : 1.0);
+    HealthStats& s = stats_[i];
+    s.load = sqrt(load_sq_[i]);
+    if (s.load > s.load_max) {
+        s.load_max = s.load;
+    }
+    updateScale(i);
+}
+
+void HealthMonitor::updateScale(size_t i) {
+    HealthStats& s = stats_[i];
+    double by_temperature = s.samples > 0 ? derate(s.temperature, config_.temp_warn, config_.temp_stop) : 1.0;
+    double by_load = derate(s.load, config_.load_warn, 1.0);
+    s.scale = by_temperature < by_load ? by_temperature : by_load;
+    if (s.scale < s.scale_min) {
+        s.scale_min = s.scale;
+    }
+
+    // 状態に入ったときに1回だけ警告を記録する（抜けたら次に入ったときにまた記録する）
+    const uint8_t temperature_bit = 1u << static_cast<int>(HealthAlertKind::Temperature);
+    const uint8_t load_bit = 1u << static_cast<int>(HealthAlertKind::Overload);
+    if (s.samples > 0 && s.temperature > config_.temp_warn) {
+        if (!(warned_[i] & temperature_bit)) {
+            alert(i, HealthAlertKind::Temperature, s.temperature);
+        }
+    } else {
+        warned_[i] &= static_cast<uint8_t>(~temperature_bit);
+    }
+    if (s.load > config_.load_warn) {
+        if (!(warned_[i] & load_bit)) {
+            alert(i, HealthAlertKind::Overload, s.load);
+        }
+    } else {
+        warned_[i] &= static_cast<uint8_t>(~load_bit);
+    }
+}
+
+void HealthMonitor::limitGoalCurrents(int16_t* goal_currents) const {
+    if (config_.current_limit <= 0.0) {
+        return;
+    }
+    for (size_t i = 0; i < ids_.size(); i++) {
+        if (stats_[i].scale >= 1.0) {
+            continue;
+        }
+        int16_t limit = static_cast<int16_t>(config_.current_limit * stats_[i].scale);
+        if (goal_currents[i] > limit) {
+            goal_currents[i] = limit;
+        } else if (goal_currents[i] < -limit) {
+            goal_currents[i] = static_cast<int16_t>(-limit);
+        }
+    }
+}
+
+bool HealthMonitor::step(const CycleInfo& cycle) {
+    if (stopRequested()) {
+        return false;
+    }
+    if (ids_.empty()) {
+        return true;
+    }
+    int64_t now = monotonicNow();
+    if (now + estimate_ns_ > cycle.deadline_ns) {
+        skipped_++;  // 次の周期に食い込むので今回は読まない
+        return true;
+    }
+
+    size_t i;
+    bool hardware;
+    if (priority_ >= 0) {
+        i = static_cast<size_t>(priority_);
+        hardware = true;
+        priority_ = -1;
+    } else {
+        i = next_ / 2;
+        hardware = next_ % 2 == 1;
+        next_ = (next_ + 1) % (2 * ids_.size());
+    }
+    bool ok = hardware ? readHardwareError(i) : readSupply(i);
+    reads_++;
+    if (ok) {
+        // 長くかかったときはすぐ合わせ、短いときはゆっくり縮める
+        int64_t took = monotonicNow() - now;
+        estimate_ns_ = took > estimate_ns_ ? took : estimate_ns_ - (estimate_ns_ - took) / 8;
+    } else {
+        stats_[i].read_failures++;
+    }
+    return !stopRequested();
+}
+
+bool HealthMonitor::readSupply(size_t i) {
+    uint8_t data[Supply::length];
+    uint8_t error = 0;
+    if (io_.read(ids_[i], Supply::address, Supply::length, data, &error) != COMM_SUCCESS) {
+        return false;
+    }
+    if (error & STATUS_ERROR_ALERT) {
+        priority_ = static_cast<int>(i);
+    }
+
+    HealthStats& s = stats_[i];
+    s.samples++;
+    s.voltage = xm430::toUnit<xm430::PresentInputVoltage>(Supply::decode<xm430::PresentInputVoltage>(data));
+    s.temperature = xm430::toUnit<xm430::PresentTemperature>(Supply::decode<xm430::PresentTemperature>(data));
+    if (s.voltage < s.voltage_min) s.voltage_min = s.voltage;
+    if (s.voltage > s.voltage_max) s.voltage_max = s.voltage;
+    if (s.temperature > s.temperature_max) s.temperature_max = s.temperature;
+
+    const uint8_t voltage_bit = 1u << static_cast<int>(HealthAlertKind::Voltage);
+    if (s.voltage < config_.voltage_min || s.voltage > config_.voltage_max) {
+        if (!(warned_[i] & voltage_bit)) {
+            alert(i, HealthAlertKind::Voltage, s.voltage);
+        }
+    } else {
+        warned_[i] &= static_cast<uint8_t>(~voltage_bit);
+    }
+    updateScale(i);
+    if (s.temperature >= config_.temp_stop) {
+        requestStop(i, "reached the temperature stop");
+    }
+    return true;
+}
+
+bool HealthMonitor::readHardwareError(size_t i) {
+    uint8_t status = 0;
+    uint8_t error = 0;
+    if (io_.read(ids_[i], xm430::HardwareErrorStatus::address, 1, &status, &error) != COMM_SUCCESS) {
+        return false;
+    }
+    HealthStats& s = stats_[i];
+    s.hardware_error = status;
+    if (status != 0) {
+        if (status & ~s.hardware_seen) {
+            alert(i, HealthAlertKind::HardwareError, status);
+        }
+        s.hardware_seen |= status;
+        requestStop(i, "reported a hardware error");  // サーボ側はすでにトルクを切っている
+    }
+    return true;
+}
+
+void HealthMonitor::alert(size_t i, HealthAlertKind kind, double value) {
+    warned_[i] |= static_cast<uint8_t>(1u << static_cast<int>(kind));
+    if (alert_count_ >= alerts_.size()) {
+        alerts_dropped_++;
+        return;
+    }
+    HealthAlert& a = alerts_[alert_count_++];
+    a.time = monotonicNow() * 1e-9 - start_;
+    a.id = ids_[i];
+    a.kind = kind;
+    a.value = value;
+}
+
+void HealthMonitor::requestStop(size_t i, const char* what) {
+    if (!stopRequested()) {
+        snprintf(stop_reason_, sizeof(stop_reason_), "motor %d %s", static_cast<int>(ids_[i]), what);
+    }
+}
+
+void HealthMonitor::printReport(std::ostream& os) const {
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(1);
+    os << "Health reads: " << reads_ << " (skipped " << skipped_ << " cycles without spare time, estimate "
+       << estimate_ns_ / 1e3 << " us)\n";
+    for (size_t i = 0; i < ids_.size(); i++) {
+        const HealthStats& s = stats_[i];
+        os << "Health ID " << static_cast<int>(ids_[i]) << ": ";
+        if (s.samples == 0) {
+            os << "no samples";
+        } else {
+            os << s.voltage << " V (" << s.voltage_min << "-" << s.voltage_max << "), " << s.temperature
+               << " degC (max " << s.temperature_max << ")";
+        }
+        os << std::setprecision(2) << ", load " << s.load << " (max " << s.load_max << "), limit x" << s.scale
+           << " (min " << s.scale_min << ")" << std::setprecision(1) << ", hardware error: ";
+        printHardwareError(os, s.hardware_seen);
+        if (s.read_failures > 0) {
+            os << ", " << s.read_failures << " failed reads";
+        }
+        os << "\n";
+    }
+    for (size_t k = 0; k < alert_count_; k++) {
+        const HealthAlert& a = alerts_[k];
+        os << "[" << std::setprecision(3) << a.time << " s] Motor " << static_cast<int>(a.id) << " "
+           << alertName(a.kind) << ": ";
+        if (a.kind == HealthAlertKind::HardwareError) {
+            printHardwareError(os, static_cast<uint8_t>(a.value));
+        } else {
+            os << std::setprecision(2) << a.value;
+        }
+        os << "\n";
+    }
+    if (alerts_dropped_ > 0) {
+        os << "(他 " << alerts_dropped_ << " 件の警告は記録しきれずに捨てました)\n";
+    }
+    os.flags(flags);
+    os.flush();
+}
@@ -0,0 +1,141 @@
+#ifndef HEALTH_MONITOR_H_
+#define HEALTH_MONITOR_H_
+
+#include "dynamixel_sdk.h"
+#include "packet_io.h"
+#include "periodic_executor.h"
+#include "xm430_registers.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+#define HEALTH_TEMP_WARN              65.0   // これを超えたら電流の上限を下げ始める [degC]
+#define HEALTH_TEMP_STOP              75.0   // ここで安全停止する（XM430 の Temperature Limit 既定 80 より手前）[degC]
+#define HEALTH_VOLTAGE_MIN            10.0   // 入力電圧の下限・上限（外れたら警告のみ）[V]
+#define HEALTH_VOLTAGE_MAX            14.8
+#define HEALTH_LOAD_WARN              0.7    // 電流の実効値がこの割合（上限比）を超えたら上限を下げ始める
+#define HEALTH_LOAD_TAU               1.0    // 電流の実効値を取る時定数 [s]
+#define HEALTH_MIN_SCALE              0.3    // 上限を下げるときの最小の割合
+#define HEALTH_MAX_ALERTS             64
+
+// Hardware Error Status(70) のビット
+#define HW_ERROR_INPUT_VOLTAGE        0x01
+#define HW_ERROR_OVERHEATING          0x04
+#define HW_ERROR_MOTOR_ENCODER        0x08
+#define HW_ERROR_ELECTRICAL_SHOCK     0x10
+#define HW_ERROR_OVERLOAD             0x20
+
+// ステータスパケットのエラーバイトの Alert ビット（どれかの Hardware Error Status が立っている）
+#define STATUS_ERROR_ALERT            0x80
+
+struct HealthConfig {
+    double temp_warn = HEALTH_TEMP_WARN;
+    double temp_stop = HEALTH_TEMP_STOP;
+    double voltage_min = HEALTH_VOLTAGE_MIN;
+    double voltage_max = HEALTH_VOLTAGE_MAX;
+    double load_warn = HEALTH_LOAD_WARN;
+    double current_limit = 0.0;     // 目標電流の上限（生の値）。0 なら電流による制限はしない
+};
+
+// 環境変数 DXL_TEMP_WARN / DXL_TEMP_STOP [degC] で上書きした設定を返す（current_limit は呼び出し側で入れる）
+HealthConfig healthConfigFromEnv(double current_limit);
+
+// Hardware Error Status のビットを "Overheating, Overload" のように os へ書く
+void printHardwareError(std::ostream& os, uint8_t status);
+
+// 監視値の記録1件（固定長）
+enum class HealthAlertKind : uint8_t {
+    HardwareError,  // Hardware Error Status が立った（value = ビット）
+    Temperature,    // temp_warn を超えた（value = 温度）
+    Voltage,        // 入力電圧が範囲外（value = 電圧）
+    Overload,       // 電流の実効値が load_warn を超えた（value = 上限比）
+};
+
+struct HealthAlert {
+    double time;      // HealthMonitor を作ってからの経過時間 [s]
+    uint8_t id;
+    HealthAlertKind kind;
+    double value;
+};
+
+// IDごとの監視値
+struct HealthStats {
+    uint64_t samples;          // 読めた回数（電圧・温度）
+    uint64_t read_failures;
+    double voltage;            // 直近 [V]
+    double voltage_min;
+    double voltage_max;
+    double temperature;        // 直近 [degC]
+    double temperature_max;
+    uint8_t hardware_error;    // 直近の Hardware Error Status
+    uint8_t hardware_seen;     // 一度でも立ったビット
+    double load;               // 電流の実効値（上限比）
+    double load_max;
+    double scale;              // 今の電流上限の割合（1.0 なら制限なし）
+    double scale_min;
+};
+
+// サーボの健康状態（Hardware Error Status(70) / Present Input Voltage(144) / Present Temperature(146)）を
+// 制御周期の空き時間に1回ずつ読んで回る監視。
+//   - step() は周期の最後（目標電流を送ったあと）に呼ぶ。次の周期の期限までに読み終わる見込みがあるときだけ
+//     1回読むので、制御に使う読み書きが後ろにずれることはない。読む順は ID ごとに 電圧・温度 → エラー状態 の巡回
+//   - ステータスパケットに Alert ビットが付いていたら notifyAlert() で知らせると、そのIDのエラー状態を先に読む
+//   - 温度が temp_warn を超えるか、電流の実効値が load_warn を超えると、電流の上限を HEALTH_MIN_SCALE まで
+//     直線的に下げる（limitGoalCurrents()）。temp_stop に達するか Hardware Error Status が立ったら停止を求める
+// 1つのスレッドからだけ使うこと。構築後はヒープ確保をしない。
+class HealthMonitor {
+public:
+    HealthMonitor(dynamixel::PortHandler* portHandler, const std::vector<uint8_t>& ids, const HealthConfig& config);
+
+    // 周期ごとの電流（ids の並び、生の値）。電流の実効値を更新する
+    void observeCurrent(size_t i, int16_t current, double dt);
+
+    // ステータスパケットのエラーバイトに Alert ビットがあった
+    void notifyAlert(size_t i) { priority_ = static_cast<int>(i); }
+
+    // 空き時間があれば監視のための読み出しを1回行う。停止すべき状態なら false（理由は stopReason()）
+    bool step(const CycleInfo& cycle);
+
+    // 目標電流を今の上限（current_limit × 割合）に収める（goal_currents は ids の並び）
+    void limitGoalCurrents(int16_t* goal_currents) const;
+
+    double scale(size_t i) const { return stats_[i].scale; }
+    const HealthStats& stats(size_t i) const { return stats_[i]; }
+    uint64_t reads() const { return reads_; }
+    uint64_t skipped() const { return skipped_; }
+    bool stopRequested() const { return stop_reason_[0] != '\0'; }
+    const char* stopReason() const { return stop_reason_; }
+
+    // IDごとの電圧・温度・エラー・負荷・上限の割合と、記録した警告を表示する
+    void printReport(std::ostream& os) const;
+
+private:
+    using Supply = xm430::RegisterBlock<xm430::PresentInputVoltage, xm430::PresentTemperature>;
+
+    bool readSupply(size_t i);
+    bool readHardwareError(size_t i);
+    void updateScale(size_t i);
+    void alert(size_t i, HealthAlertKind kind, double value);
+    void requestStop(size_t i, const char* what);
+
+    PacketIo io_;
+    HealthConfig config_;
+    std::vector<uint8_t> ids_;
+    std::vector<HealthStats> stats_;
+    std::vector<uint8_t> warned_;      // 警告を出したもののビット（同じ状態が続く間は1回だけ記録する）
+    std::vector<double> load_sq_;      // (電流 / 上限)^2 の指数移動平均
+    size_t next_;                      // 巡回の位置（ID数 × 2 通り）
+    int priority_;                     // 先にエラー状態を読むID（無ければ -1）
+    int64_t estimate_ns_;              // 1回の読み出しにかかる時間の見積もり
+    uint64_t reads_;
+    uint64_t skipped_;                 // 空き時間が足りずに見送った周期
+    double start_;
+    std::vector<HealthAlert> alerts_;
+    size_t alert_count_;
+    uint64_t alerts_dropped_;
+    char stop_reason_[64];
+};
+
+#endif  // HEALTH_MONITOR_H_
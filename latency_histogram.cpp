@@ -0,0 +1,49 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+
+void LatencyHistogram::reset() {
+    counts_.fill(0);
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+    min_ = UINT64_MAX;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+    min_ = std::min(min_, other.min_);
+}
+
+uint64_t LatencyHistogram::upperBoundOf(int index) {
+    if (index < SUB_BUCKETS) {
+        return static_cast<uint64_t>(index);
+    }
+    int magnitude = (index - SUB_BUCKETS) / HALF_SUB_BUCKETS + SUB_BUCKET_BITS;
+    uint64_t sub = static_cast<uint64_t>((index - SUB_BUCKETS) % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS);
+    int shift = magnitude - (SUB_BUCKET_BITS - 1);
+    return ((sub + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(p / 100.0 * count_ + 0.5);
+    if (target < 1) target = 1;
+    if (target > count_) target = count_;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += counts_[i];
+        if (seen >= target) {
+            return std::min(upperBoundOf(i), max_);
+        }
+    }
+    return max_;
+}
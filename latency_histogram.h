@@ -0,0 +1,59 @@
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+#include <stdint.h>
+#include <array>
+
+// HDRヒストグラム風の対数-線形バケット（相対誤差 1/64 以下）。ナノ秒単位の値を想定。
+// record() はメモリ確保なし・分岐数個なので制御ループ内で呼んでよい。
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 7;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;       // 128
+    static const int HALF_SUB_BUCKETS = SUB_BUCKETS / 2;        // 64
+    static const int BUCKET_COUNT = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * HALF_SUB_BUCKETS;
+
+    LatencyHistogram() { reset(); }
+
+    void reset();
+
+    void record(uint64_t value) {
+        counts_[indexOf(value)]++;
+        count_++;
+        sum_ += value;
+        if (value > max_) max_ = value;
+        if (value < min_) min_ = value;
+    }
+
+    // 別のヒストグラムを足し合わせる
+    void merge(const LatencyHistogram& other);
+
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+
+    // p は 0〜100。該当バケットの上端を返す（最大値は超えない）
+    uint64_t percentile(double p) const;
+
+private:
+    static int indexOf(uint64_t value) {
+        if (value < static_cast<uint64_t>(SUB_BUCKETS)) {
+            return static_cast<int>(value);
+        }
+        int magnitude = 63 - __builtin_clzll(value);
+        int shift = magnitude - (SUB_BUCKET_BITS - 1);
+        return SUB_BUCKETS + (magnitude - SUB_BUCKET_BITS) * HALF_SUB_BUCKETS +
+               static_cast<int>((value >> shift) - HALF_SUB_BUCKETS);
+    }
+
+    static uint64_t upperBoundOf(int index);
+
+    std::array<uint64_t, BUCKET_COUNT> counts_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t max_;
+    uint64_t min_;
+};
+
+#endif  // LATENCY_HISTOGRAM_H_
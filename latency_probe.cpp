@@ -0,0 +1,118 @@
+// ポートの低遅延設定の前後で1トランザクションの往復時間を測り、ヒストグラムを表示する
+//   ./latency_probe /dev/ttyUSB0 1 500 57600
+// 前半は SDK の既定のポート、後半は LowLatencyPortHandler（latency_timer=1 など）で測る。
+#include "dynamixel_sdk.h"
+#include "control_table.h"
+#include "latency_histogram.h"
+#include "low_latency_port.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <iostream>
+#include <vector>
+
+
+// 表示用の区間 [ms]。16ms の latency timer の段差が見えるように対数で区切る
+static const double BIN_EDGES_MS[] = {0.25, 0.5, 1, 2, 4, 8, 16, 32, 64};
+static const int NUM_BINS = sizeof(BIN_EDGES_MS) / sizeof(BIN_EDGES_MS[0]) + 1;
+
+struct ProbeResult {
+    LatencyHistogram rtt;
+    int bins[NUM_BINS];
+    int failures;
+};
+
+static uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+static bool probe(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler, uint8_t id,
+                  int count, int baudrate, ProbeResult& result) {
+    for (int i = 0; i < NUM_BINS; i++) {
+        result.bins[i] = 0;
+    }
+    result.failures = 0;
+    if (!portHandler->openPort() || !portHandler->setBaudRate(baudrate)) {
+        return false;
+    }
+    uint8_t data[xm430::Telemetry::length];
+    for (int i = 0; i < count; i++) {
+        uint8_t dxl_error = 0;
+        uint64_t t0 = nowNs();
+        int dxl_comm_result = packetHandler->readTxRx(portHandler, id, xm430::Telemetry::address, xm430::Telemetry::length, data, &dxl_error);
+        uint64_t ns = nowNs() - t0;
+        if (dxl_comm_result != COMM_SUCCESS) {
+            result.failures++;
+            continue;
+        }
+        result.rtt.record(ns);
+        int bin = 0;
+        while (bin < NUM_BINS - 1 && ns / 1e6 >= BIN_EDGES_MS[bin]) {
+            bin++;
+        }
+        result.bins[bin]++;
+    }
+    portHandler->closePort();
+    return true;
+}
+
+static void printResult(const char* title, const ProbeResult& r) {
+    auto us = [](uint64_t ns) { return ns / 1000.0; };
+    printf("%s\n", title);
+    printf("  RTT [us]  p50: %.1f  p90: %.1f  p99: %.1f  max: %.1f  (failures: %d)\n",
+           us(r.rtt.percentile(50)), us(r.rtt.percentile(90)), us(r.rtt.percentile(99)), us(r.rtt.max()), r.failures);
+    int peak = 1;
+    for (int i = 0; i < NUM_BINS; i++) {
+        if (r.bins[i] > peak) peak = r.bins[i];
+    }
+    for (int i = 0; i < NUM_BINS; i++) {
+        char label[32];
+        if (i == NUM_BINS - 1) {
+            snprintf(label, sizeof(label), ">= %g ms", BIN_EDGES_MS[i - 1]);
+        } else {
+            snprintf(label, sizeof(label), "<  %g ms", BIN_EDGES_MS[i]);
+        }
+        printf("  %-10s %6d ", label, r.bins[i]);
+        for (int k = 0; k < r.bins[i] * 50 / peak; k++) {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " device [id=1] [count=500] [baudrate=57600]\n";
+        return 1;
+    }
+    const char* device = argv[1];
+    uint8_t id = static_cast<uint8_t>(argc > 2 ? atoi(argv[2]) : 1);
+    int count = argc > 3 ? atoi(argv[3]) : 500;
+    int baudrate = argc > 4 ? atoi(argv[4]) : 57600;
+
+    dynamixel::PacketHandler* packetHandler = dynamixel::PacketHandler::getPacketHandler(PROTOCOL_VERSION);
+
+    ProbeResult before;
+    dynamixel::PortHandler* defaultPort = dynamixel::PortHandler::getPortHandler(device);
+    if (!probe(defaultPort, packetHandler, id, count, baudrate, before)) {
+        std::cerr << "Failed to open " << device << std::endl;
+        return 1;
+    }
+
+    ProbeResult after;
+    LowLatencyPortHandler tunedPort(device, portTuningFromEnv());
+    if (!probe(&tunedPort, packetHandler, id, count, baudrate, after)) {
+        std::cerr << "Failed to open " << device << " with low-latency settings" << std::endl;
+        return 1;
+    }
+
+    printf("device=%s id=%d count=%d baud=%d\n", device, id, count, baudrate);
+    printResult("[before] SDK default port", before);
+    printf("[after]  ASYNC_LOW_LATENCY: %s, latency_timer: %d -> %d ms\n",
+           tunedPort.lowLatencyApplied() ? "on" : "n/a", tunedPort.originalLatencyTimer(), tunedPort.latencyTimer());
+    printResult("[after]  LowLatencyPortHandler", after);
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "link_monitor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <iomanip>
+#include <iostream>
+
+static int64_t monotonicNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+RetryConfig retryConfigFromEnv() {
+    RetryConfig config;
+    if (const char* value = getenv("DXL_RETRIES")) {
+        int retries = atoi(value);
+        if (retries >= 0) {
+            config.max_retries = retries;
+        } else {
+            std::cerr << "Ignoring DXL_RETRIES=" << value << std::endl;
+        }
+    }
+    if (const char* value = getenv("DXL_FAIL_LIMIT")) {
+        int limit = atoi(value);
+        if (limit > 0) {
+            config.fail_limit = limit;
+        } else {
+            std::cerr << "Ignoring DXL_FAIL_LIMIT=" << value << std::endl;
+        }
+    }
+    return config;
+}
+
+bool isTransientFailure(int comm_result) {
+    return comm_result == COMM_RX_TIMEOUT || comm_result == COMM_RX_CORRUPT || comm_result == COMM_RX_FAIL ||
+           comm_result == COMM_TX_FAIL;
+}
+
+LinkMonitor::LinkMonitor(const std::vector<uint8_t>& ids, const RetryConfig& config)
+    : config_(config),
+      ids_(ids),
+      counters_(ids.size()),
+      failed_(ids.size(), 0),
+      deadline_ns_(0) {
+    for (int16_t& index : index_) {
+        index = -1;
+    }
+    for (size_t i = 0; i < ids_.size(); i++) {
+        index_[ids_[i]] = static_cast<int16_t>(i);
+    }
+    escalation_[0] = '\0';
+}
+
+void LinkMonitor::beginCycle(int64_t deadline_ns) {
+    deadline_ns_ = deadline_ns;
+    for (uint8_t& failed : failed_) {
+        failed = 0;
+    }
+}
+
+void LinkMonitor::beginCycle(const CycleInfo& cycle) {
+    beginCycle(cycle.deadline_ns - static_cast<int64_t>(cycle.period_s * config_.reserve * 1e9));
+}
+
+void LinkMonitor::attempt(uint8_t id, int comm_result, bool retry) {
+    if (id == BROADCAST_ID) {
+        for (size_t i = 0; i < ids_.size(); i++) {
+            count(i, comm_result, retry);
+        }
+    } else if (index_[id] >= 0) {
+        count(static_cast<size_t>(index_[id]), comm_result, retry);
+    }
+}
+
+void LinkMonitor::count(size_t i, int comm_result, bool retry) {
+    LinkCounters& c = counters_[i];
+    c.attempts++;
+    if (retry) {
+        c.retries++;
+    }
+    if (comm_result == COMM_SUCCESS) {
+        if (retry) {
+            c.recovered++;
+        }
+    } else {
+        c.failures++;
+        c.last_failure = comm_result;
+    }
+}
+
+bool LinkMonitor::shouldRetry(int comm_result, int retries, int64_t attempt_ns) const {
+    if (!isTransientFailure(comm_result) || retries >= config_.max_retries) {
+        return false;
+    }
+    // 同じだけ時間がかかっても期限に間に合うときだけ（タイムアウトなら待った分がそのまま次の見積もり）
+    return deadline_ns_ == 0 || monotonicNow() + attempt_ns <= deadline_ns_;
+}
+
+void LinkMonitor::fail(uint8_t id) {
+    if (id == BROADCAST_ID) {
+        for (uint8_t& failed : failed_) {
+            failed = 1;
+        }
+    } else if (index_[id] >= 0) {
+        failed_[index_[id]] = 1;
+    }
+}
+
+bool LinkMonitor::endCycle() {
+    for (size_t i = 0; i < ids_.size(); i++) {
+        LinkCounters& c = counters_[i];
+        c.cycles++;
+        if (!failed_[i]) {
+            c.consecutive = 0;
+            continue;
+        }
+        c.failed_cycles++;
+        c.consecutive++;
+        if (c.consecutive > c.max_consecutive) {
+            c.max_consecutive = c.consecutive;
+        }
+        if (c.consecutive >= static_cast<uint32_t>(config_.fail_limit) && !escalated()) {
+            snprintf(escalation_, sizeof(escalation_), "motor %d failed %u cycles in a row",
+                     static_cast<int>(ids_[i]), c.consecutive);
+        }
+    }
+    return !escalated();
+}
+
+void LinkMonitor::printReport(std::ostream& os, dynamixel::PacketHandler* packetHandler) const {
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < ids_.size(); i++) {
+        const LinkCounters& c = counters_[i];
+        double rate = c.attempts > 0 ? 100.0 * c.failures / c.attempts : 0.0;
+        os << "Link ID " << static_cast<int>(ids_[i]) << ": " << c.attempts << " transactions, " << c.failures
+           << " failed (" << rate << "%), " << c.retries << " retries (" << c.recovered << " recovered), "
+           << c.failed_cycles << "/" << c.cycles << " cycles held, longest run " << c.max_consecutive;
+        if (c.failures > 0) {
+            os << ", last: " << packetHandler->getTxRxResult(c.last_failure);
+        }
+        os << "\n";
+    }
+    os.flags(flags);
+    os.flush();
+}
@@ -0,0 +1,92 @@
+#ifndef LINK_MONITOR_H_
+#define LINK_MONITOR_H_
+
+#include "dynamixel_sdk.h"
+#include "periodic_executor.h"
+
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+#define RETRY_MAX_RETRIES             2      // 1回のやり取りを送り直す上限（初回を含めず）
+#define RETRY_FAIL_LIMIT              5      // 同じIDがこの周期数続けて読めなければ安全停止
+#define RETRY_RESERVE                 0.25   // 再試行に使わず、計算・書き込み・ログのために残す周期の割合
+
+struct RetryConfig {
+    int max_retries = RETRY_MAX_RETRIES;
+    int fail_limit = RETRY_FAIL_LIMIT;
+    double reserve = RETRY_RESERVE;
+};
+
+// 環境変数 DXL_RETRIES（送り直す上限。0 で再試行なし）/ DXL_FAIL_LIMIT で上書きした設定を返す
+RetryConfig retryConfigFromEnv();
+
+// 送り直せば通る見込みのある失敗か（タイムアウト・CRC不一致・送信失敗）。
+// ステータスパケットのエラーバイトはサーボ側の判断なので送り直さない
+bool isTransientFailure(int comm_result);
+
+// IDごとの通信の成否
+struct LinkCounters {
+    uint64_t cycles;           // endCycle() の回数
+    uint64_t attempts;         // やり取りの回数（再試行を含む）
+    uint64_t failures;         // そのうち失敗した回数
+    uint64_t retries;          // 再試行した回数
+    uint64_t recovered;        // 再試行で通った回数
+    uint64_t failed_cycles;    // 再試行しても通らず、前回値のままにした周期
+    uint32_t consecutive;      // 今続いている失敗周期の数
+    uint32_t max_consecutive;
+    int last_failure;          // 最後の失敗の COMM_*
+};
+
+// 周期ごとのやり取りの再試行を決め、IDごとの失敗を数える。
+//   - 失敗したやり取りは、同じ時間がもう1回かかっても周期の期限（beginCycle() で渡す）に間に合うときだけ
+//     max_retries 回まで送り直す。期限 0（周期の外の設定時など）なら回数だけで決める
+//   - 送り直しても通らなかったIDは、その周期は失敗として前回値のまま扱う
+//   - 同じIDが fail_limit 周期続けて失敗したら endCycle() が false を返す（呼び出し側で安全停止する）
+// 1つのスレッドからだけ使うこと。周期中に呼ぶものはヒープ確保をしない。
+class LinkMonitor {
+public:
+    LinkMonitor(const std::vector<uint8_t>& ids, const RetryConfig& config);
+
+    const RetryConfig& config() const { return config_; }
+    size_t size() const { return ids_.size(); }
+
+    // 周期の始め。deadline_ns（CLOCK_MONOTONIC）までに終わる再試行だけを許す
+    void beginCycle(int64_t deadline_ns);
+    // 周期の情報から、終わりに RETRY_RESERVE 分を残した期限を求めて beginCycle() する
+    void beginCycle(const CycleInfo& cycle);
+
+    // やり取り1回の結果を記録する（retry は送り直しなら true）。BROADCAST_ID なら全ID
+    void attempt(uint8_t id, int comm_result, bool retry);
+    // 失敗したやり取りを送り直すか。attempt_ns は失敗したやり取りにかかった時間、retries は送り直した回数
+    bool shouldRetry(int comm_result, int retries, int64_t attempt_ns) const;
+    // 送り直しても通らなかった（この周期は前回値のまま）。BROADCAST_ID なら全ID
+    void fail(uint8_t id);
+
+    // 周期の終わり。fail_limit に達したIDがあれば false（理由は escalation()）
+    bool endCycle();
+
+    // 今の周期で失敗したか
+    bool failed(size_t i) const { return failed_[i] != 0; }
+    bool escalated() const { return escalation_[0] != '\0'; }
+    const char* escalation() const { return escalation_; }
+
+    uint8_t id(size_t i) const { return ids_[i]; }
+    const LinkCounters& counters(size_t i) const { return counters_[i]; }
+
+    // IDごとの失敗率・再試行・最長の連続失敗を表示する
+    void printReport(std::ostream& os, dynamixel::PacketHandler* packetHandler) const;
+
+private:
+    void count(size_t i, int comm_result, bool retry);
+
+    RetryConfig config_;
+    std::vector<uint8_t> ids_;
+    int16_t index_[256];               // ID → ids_ の位置（無ければ -1）
+    std::vector<LinkCounters> counters_;
+    std::vector<uint8_t> failed_;
+    int64_t deadline_ns_;
+    char escalation_[64];
+};
+
+#endif  // LINK_MONITOR_H_
@@ -0,0 +1,256 @@
+#include "low_latency_port.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/serial.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <iostream>
+
+#define DEFAULT_LATENCY_TIMER_MS      16    // 読めないときは FTDI の既定値を仮定する
+
+namespace {
+
+double monotonicMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec * 1e-6;
+}
+
+speed_t baudFlag(int baudrate) {
+    switch (baudrate) {
+    case 9600: return B9600;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 1000000: return B1000000;
+    case 2000000: return B2000000;
+    case 3000000: return B3000000;
+    case 4000000: return B4000000;
+    default: return B0;
+    }
+}
+
+int readIntFile(const std::string& path) {
+    FILE* fp = fopen(path.c_str(), "r");
+    if (!fp) {
+        return -1;
+    }
+    int value = -1;
+    if (fscanf(fp, "%d", &value) != 1) {
+        value = -1;
+    }
+    fclose(fp);
+    return value;
+}
+
+bool writeIntFile(const std::string& path, int value) {
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        return false;
+    }
+    bool ok = fprintf(fp, "%d\n", value) > 0;
+    return fclose(fp) == 0 && ok;
+}
+
+}  // namespace
+
+PortTuning portTuningFromEnv() {
+    PortTuning tuning;
+    if (const char* value = getenv("DXL_LATENCY_TIMER")) {
+        tuning.latency_timer_ms = atoi(value);
+    }
+    if (const char* value = getenv("DXL_TIMEOUT_MARGIN")) {
+        tuning.timeout_margin_ms = atof(value);
+    }
+    return tuning;
+}
+
+LowLatencyPortHandler::LowLatencyPortHandler(const char* port_name, const PortTuning& tuning)
+    : tuning_(tuning),
+      socket_fd_(-1),
+      baudrate_(DEFAULT_BAUDRATE_),
+      packet_start_time_(0.0),
+      packet_timeout_(0.0),
+      tx_time_per_byte_(0.0),
+      original_latency_timer_(-1),
+      latency_timer_(-1),
+      low_latency_applied_(false),
+      tuned_(false) {
+    is_using_ = false;
+    setPortName(port_name);
+}
+
+LowLatencyPortHandler::~LowLatencyPortHandler() {
+    closePort();
+}
+
+bool LowLatencyPortHandler::openPort() {
+    return setBaudRate(baudrate_);
+}
+
+void LowLatencyPortHandler::closePort() {
+    if (socket_fd_ != -1) {
+        close(socket_fd_);
+    }
+    socket_fd_ = -1;
+}
+
+void LowLatencyPortHandler::clearPort() {
+    tcflush(socket_fd_, TCIFLUSH);
+}
+
+void LowLatencyPortHandler::setPortName(const char* port_name) {
+    strncpy(port_name_, port_name, sizeof(port_name_) - 1);
+    port_name_[sizeof(port_name_) - 1] = '\0';
+}
+
+char* LowLatencyPortHandler::getPortName() {
+    return port_name_;
+}
+
+bool LowLatencyPortHandler::setBaudRate(const int baudrate) {
+    closePort();
+    baudrate_ = baudrate;
+    return setupPort(baudrate);
+}
+
+int LowLatencyPortHandler::getBaudRate() {
+    return baudrate_;
+}
+
+int LowLatencyPortHandler::getBytesAvailable() {
+    int bytes_available = 0;
+    ioctl(socket_fd_, FIONREAD, &bytes_available);
+    return bytes_available;
+}
+
+int LowLatencyPortHandler::readPort(uint8_t* packet, int length) {
+    return read(socket_fd_, packet, length);
+}
+
+int LowLatencyPortHandler::writePort(uint8_t* packet, int length) {
+    return write(socket_fd_, packet, length);
+}
+
+void LowLatencyPortHandler::setPacketTimeout(uint16_t packet_length) {
+    // 応答の転送時間 + USBの遅延（送りと受けで2回）+ 余裕
+    int latency = latency_timer_ >= 0 ? latency_timer_ : DEFAULT_LATENCY_TIMER_MS;
+    packet_start_time_ = monotonicMs();
+    packet_timeout_ = tx_time_per_byte_ * packet_length + 2.0 * latency + tuning_.timeout_margin_ms;
+}
+
+void LowLatencyPortHandler::setPacketTimeout(double msec) {
+    packet_start_time_ = monotonicMs();
+    packet_timeout_ = msec;
+}
+
+bool LowLatencyPortHandler::isPacketTimeout() {
+    if (monotonicMs() - packet_start_time_ > packet_timeout_) {
+        packet_timeout_ = 0;
+        return true;
+    }
+    return false;
+}
+
+bool LowLatencyPortHandler::setupPort(int baudrate) {
+    socket_fd_ = open(port_name_, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (socket_fd_ < 0) {
+        std::cerr << "[LowLatencyPortHandler] " << port_name_ << " を開けません: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    speed_t flag = baudFlag(baudrate);
+    bool custom = flag == B0;
+
+    struct termios newtio;
+    memset(&newtio, 0, sizeof(newtio));
+    newtio.c_cflag = (custom ? B38400 : flag) | CS8 | CLOCAL | CREAD;
+    newtio.c_iflag = IGNPAR;
+    newtio.c_oflag = 0;
+    newtio.c_lflag = 0;
+    newtio.c_cc[VTIME] = 0;
+    newtio.c_cc[VMIN] = 0;
+    tcflush(socket_fd_, TCIFLUSH);
+    tcsetattr(socket_fd_, TCSANOW, &newtio);
+
+    struct serial_struct serinfo;
+    bool have_serial = ioctl(socket_fd_, TIOCGSERIAL, &serinfo) == 0;
+    if (custom) {
+        // 4.5Mbps などは B38400 + カスタム分周で指定する（SDK と同じ方法）
+        if (!have_serial || serinfo.baud_base <= 0) {
+            closePort();
+            return false;
+        }
+        serinfo.flags &= ~ASYNC_SPD_MASK;
+        serinfo.flags |= ASYNC_SPD_CUST;
+        serinfo.custom_divisor = serinfo.baud_base / baudrate;
+        if (ioctl(socket_fd_, TIOCSSERIAL, &serinfo) < 0) {
+            closePort();
+            return false;
+        }
+    }
+
+    tx_time_per_byte_ = (1000.0 / baudrate) * 10.0;
+    applyTuning();
+    return true;
+}
+
+void LowLatencyPortHandler::applyTuning() {
+    // ASYNC_LOW_LATENCY は開き直すたびに立てる
+    low_latency_applied_ = false;
+    if (tuning_.low_latency) {
+        struct serial_struct serinfo;
+        if (ioctl(socket_fd_, TIOCGSERIAL, &serinfo) == 0) {
+            serinfo.flags |= ASYNC_LOW_LATENCY;
+            low_latency_applied_ = ioctl(socket_fd_, TIOCSSERIAL, &serinfo) == 0;
+        }
+    }
+
+    // latency_timer は最初に開いたときだけ読み書きする
+    if (tuned_) {
+        return;
+    }
+    tuned_ = true;
+    std::string path = latencyTimerPath();
+    original_latency_timer_ = path.empty() ? -1 : readIntFile(path);
+    latency_timer_ = original_latency_timer_;
+    if (original_latency_timer_ >= 0 && tuning_.latency_timer_ms >= 0 &&
+        tuning_.latency_timer_ms != original_latency_timer_) {
+        if (writeIntFile(path, tuning_.latency_timer_ms)) {
+            latency_timer_ = readIntFile(path);
+        } else {
+            std::cerr << "[LowLatencyPortHandler] " << path << " に書き込めません（root 権限か udev ルールが必要）: "
+                      << strerror(errno) << std::endl;
+        }
+    }
+    if (!low_latency_applied_ && latency_timer_ < 0) {
+        std::cerr << "[LowLatencyPortHandler] " << port_name_
+                  << " はUSBシリアルではないため低遅延設定を行いません" << std::endl;
+    }
+}
+
+std::string LowLatencyPortHandler::latencyTimerPath() const {
+    // /dev/serial/by-id/... などのリンクをたどって ttyUSB0 の名前を得る
+    char resolved[PATH_MAX];
+    if (!realpath(port_name_, resolved)) {
+        return "";
+    }
+    const char* base = strrchr(resolved, '/');
+    base = base ? base + 1 : resolved;
+    std::string path = std::string("/sys/bus/usb-serial/devices/") + base + "/latency_timer";
+    return access(path.c_str(), R_OK) == 0 ? path : "";
+}
+
+dynamixel::PortHandler* createPortHandler(const char* port_name) {
+    const char* value = getenv("DXL_LOW_LATENCY");
+    if (value && strcmp(value, "1") == 0) {
+        return new LowLatencyPortHandler(port_name, portTuningFromEnv());
+    }
+    return dynamixel::PortHandler::getPortHandler(port_name);
+}
@@ -0,0 +1,72 @@
+#ifndef LOW_LATENCY_PORT_H_
+#define LOW_LATENCY_PORT_H_
+
+#include "dynamixel_sdk.h"
+
+#include <stdint.h>
+#include <string>
+
+// ポートの低遅延設定
+struct PortTuning {
+    bool low_latency = true;         // TIOCSSERIAL で ASYNC_LOW_LATENCY を立てる
+    int latency_timer_ms = 1;        // USBシリアルの latency_timer に書く値（-1 なら変更しない）
+    double timeout_margin_ms = 1.5;  // パケット長から求めた時間に足す余裕（返送遅延 500us を含む）
+};
+
+// 環境変数から設定を読む
+//   DXL_LATENCY_TIMER=<ms>  latency_timer に書く値（既定 1、-1 で変更しない）
+//   DXL_TIMEOUT_MARGIN=<ms> 受信タイムアウトの余裕（既定 1.5）
+PortTuning portTuningFromEnv();
+
+// SDK の PortHandlerLinux と同じ手順でポートを開き、加えて
+//   - ASYNC_LOW_LATENCY（ドライバ側の受信バッファリングを止める）
+//   - latency_timer（FTDI の既定 16ms を短くする。sysfs に書くので値はデバイスに残る）
+//   - VMIN=0 / VTIME=0（SDK は非ブロッキングで読むので最小値のまま）
+// を設定する。受信タイムアウトは SDK の固定値（16ms×2 + 2ms）ではなく、
+// パケット長とボーレート、実際の latency_timer から1トランザクションごとに求める。
+class LowLatencyPortHandler : public dynamixel::PortHandler {
+public:
+    LowLatencyPortHandler(const char* port_name, const PortTuning& tuning);
+    ~LowLatencyPortHandler() override;
+
+    bool openPort() override;
+    void closePort() override;
+    void clearPort() override;
+    void setPortName(const char* port_name) override;
+    char* getPortName() override;
+    bool setBaudRate(const int baudrate) override;
+    int getBaudRate() override;
+    int getBytesAvailable() override;
+    int readPort(uint8_t* packet, int length) override;
+    int writePort(uint8_t* packet, int length) override;
+    void setPacketTimeout(uint16_t packet_length) override;
+    void setPacketTimeout(double msec) override;
+    bool isPacketTimeout() override;
+
+    // 開いたときに読めた latency_timer の元の値と現在値（読めなければ -1）
+    int originalLatencyTimer() const { return original_latency_timer_; }
+    int latencyTimer() const { return latency_timer_; }
+    bool lowLatencyApplied() const { return low_latency_applied_; }
+
+private:
+    bool setupPort(int baudrate);
+    void applyTuning();
+    std::string latencyTimerPath() const;
+
+    PortTuning tuning_;
+    int socket_fd_;
+    int baudrate_;
+    char port_name_[100];
+    double packet_start_time_;
+    double packet_timeout_;
+    double tx_time_per_byte_;
+    int original_latency_timer_;
+    int latency_timer_;
+    bool low_latency_applied_;
+    bool tuned_;
+};
+
+// DXL_LOW_LATENCY=1 なら LowLatencyPortHandler、それ以外は SDK の既定のポートを返す
+dynamixel::PortHandler* createPortHandler(const char* port_name);
+
+#endif  // LOW_LATENCY_PORT_H_
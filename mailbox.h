@@ -0,0 +1,51 @@
+#ifndef MAILBOX_H_
+#define MAILBOX_H_
+
+#include <stdint.h>
+#include <atomic>
+
+// 単一の書き手から単一の読み手へ「最新値だけ」を渡すロックフリーの受け渡し箱。
+// 書き手用・読み手用のバッファに受け渡し用の1枚を加えた3枚を入れ替えて使うので、
+// どちらの側も相手を待たず、読み手は常に書き終わった最新の値だけを見る（古い値は上書きされる）。
+// T はコピーでメモリ確保しない型（固定長の構造体）にすること。
+template <typename T>
+class LatestMailbox {
+public:
+    LatestMailbox() : back_(0), middle_(1), front_(2) {}
+
+    LatestMailbox(const LatestMailbox&) = delete;
+    LatestMailbox& operator=(const LatestMailbox&) = delete;
+
+    // 書き手スレッドからのみ呼ぶ
+    void publish(const T& value) {
+        slots_[back_].value = value;
+        uint8_t previous = middle_.exchange(static_cast<uint8_t>(back_ | FRESH_BIT), std::memory_order_acq_rel);
+        back_ = previous & INDEX_MASK;
+    }
+
+    // 読み手スレッドからのみ呼ぶ。前回から新しい値が届いていれば value に入れて true
+    bool fetch(T& value) {
+        if ((middle_.load(std::memory_order_relaxed) & FRESH_BIT) == 0) {
+            return false;
+        }
+        uint8_t previous = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = previous & INDEX_MASK;
+        value = slots_[front_].value;
+        return true;
+    }
+
+private:
+    static const uint8_t INDEX_MASK = 0x03;
+    static const uint8_t FRESH_BIT = 0x04;
+
+    struct alignas(64) Slot {
+        T value;
+    };
+
+    Slot slots_[3];
+    alignas(64) uint8_t back_;                // 書き手だけが触る
+    alignas(64) std::atomic<uint8_t> middle_;  // 受け渡し用の番号と新着フラグ
+    alignas(64) uint8_t front_;               // 読み手だけが触る
+};
+
+#endif  // MAILBOX_H_
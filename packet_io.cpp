@@ -0,0 +1,185 @@
+#include "packet_io.h"
+
+#include <string.h>
+
+// ヘッダ(4) + ID + 長さ(2) + インストラクション + エラー + CRC(2)。SDK と同じ見積もり
+#define STATUS_OVERHEAD               11
+
+static void putWord(uint8_t* p, uint16_t value) {
+    p[0] = DXL_LOBYTE(value);
+    p[1] = DXL_HIBYTE(value);
+}
+
+int PacketIo::txPacket(uint8_t id, uint8_t instruction, size_t param_len) {
+    if (param_len + dxl_proto::PACKET_OVERHEAD > dxl_proto::PACKET_MAX_LEN) {
+        return COMM_TX_ERROR;
+    }
+    // 前のやり取りの残りを捨ててから送る
+    port_->clearPort();
+    parser_.reset();
+    size_t len = dxl_proto::buildPacket(tx_, id, instruction, params_, param_len);
+    if (port_->writePort(tx_, static_cast<int>(len)) != static_cast<int>(len)) {
+        return COMM_TX_FAIL;
+    }
+    return COMM_SUCCESS;
+}
+
+int PacketIo::readStatus(uint8_t id, uint16_t length, uint8_t* data, uint8_t* error) {
+    uint32_t crc_errors = parser_.crcErrors();
+    dxl_proto::Packet packet;
+    while (true) {
+        while (parser_.next(packet)) {
+            if (packet.instruction != dxl_proto::STATUS || packet.id != id) {
+                continue;
+            }
+            if (packet.param_len < 1u + length) {
+                return COMM_RX_CORRUPT;
+            }
+            if (error) {
+                *error = packet.params[0];
+            }
+            memcpy(data, packet.params + 1, length);
+            return COMM_SUCCESS;
+        }
+        if (port_->isPacketTimeout()) {
+            return parser_.crcErrors() != crc_errors ? COMM_RX_CORRUPT : COMM_RX_TIMEOUT;
+        }
+        int n = port_->readPort(rx_, sizeof(rx_));
+        if (n > 0) {
+            parser_.feed(rx_, static_cast<size_t>(n));
+        }
+    }
+}
+
+int PacketIo::nextStatus(uint16_t length, uint8_t* id, uint8_t* data, uint8_t* error) {
+    uint32_t crc_errors = parser_.crcErrors();
+    dxl_proto::Packet packet;
+    while (true) {
+        while (parser_.next(packet)) {
+            if (packet.instruction != dxl_proto::STATUS || packet.param_len != 1u + length) {
+                continue;
+            }
+            *id = packet.id;
+            if (error) {
+                *error = packet.params[0];
+            }
+            memcpy(data, packet.params + 1, length);
+            return COMM_SUCCESS;
+        }
+        if (parser_.crcErrors() != crc_errors) {
+            return COMM_RX_CORRUPT;
+        }
+        if (port_->isPacketTimeout()) {
+            return COMM_RX_TIMEOUT;
+        }
+        int n = port_->readPort(rx_, sizeof(rx_));
+        if (n > 0) {
+            parser_.feed(rx_, static_cast<size_t>(n));
+        }
+    }
+}
+
+int PacketIo::read(uint8_t id, uint16_t address, uint16_t length, uint8_t* data, uint8_t* error) {
+    putWord(params_, address);
+    putWord(params_ + 2, length);
+    int result = txPacket(id, dxl_proto::READ, 4);
+    if (result != COMM_SUCCESS) {
+        return result;
+    }
+    port_->setPacketTimeout(static_cast<uint16_t>(length + STATUS_OVERHEAD));
+    return readStatus(id, length, data, error);
+}
+
+int PacketIo::write(uint8_t id, uint16_t address, const uint8_t* data, uint16_t length, uint8_t* error) {
+    if (length + 2u > sizeof(params_)) {
+        return COMM_TX_ERROR;
+    }
+    putWord(params_, address);
+    memcpy(params_ + 2, data, length);
+    int result = txPacket(id, dxl_proto::WRITE, 2 + length);
+    if (result != COMM_SUCCESS) {
+        return result;
+    }
+    port_->setPacketTimeout(static_cast<uint16_t>(STATUS_OVERHEAD));
+    uint8_t none[1];
+    return readStatus(id, 0, none, error);
+}
+
+int PacketIo::syncReadTx(uint16_t address, uint16_t length, const uint8_t* ids, size_t count) {
+    if (count + 4 > sizeof(params_)) {
+        return COMM_TX_ERROR;
+    }
+    putWord(params_, address);
+    putWord(params_ + 2, length);
+    memcpy(params_ + 4, ids, count);
+    int result = txPacket(dxl_proto::ID_BROADCAST, dxl_proto::SYNC_READ, 4 + count);
+    if (result != COMM_SUCCESS) {
+        return result;
+    }
+    // 全IDの応答が揃うまでの時間（SDK の syncReadTx と同じ）
+    port_->setPacketTimeout(static_cast<uint16_t>((STATUS_OVERHEAD + length) * count));
+    return COMM_SUCCESS;
+}
+
+int PacketIo::fastSyncReadTx(uint16_t address, uint16_t length, const uint8_t* ids, size_t count) {
+    // 応答全体の長さ（1つのパケットなので受信側の上限に収まること）
+    const size_t status_len = dxl_proto::FAST_STATUS_OVERHEAD + count * (length + dxl_proto::FAST_SEGMENT_OVERHEAD);
+    if (count + 4 > sizeof(params_) || status_len > dxl_proto::PACKET_MAX_LEN) {
+        return COMM_TX_ERROR;
+    }
+    putWord(params_, address);
+    putWord(params_ + 2, length);
+    memcpy(params_ + 4, ids, count);
+    int result = txPacket(dxl_proto::ID_BROADCAST, dxl_proto::FAST_SYNC_READ, 4 + count);
+    if (result != COMM_SUCCESS) {
+        return result;
+    }
+    port_->setPacketTimeout(static_cast<uint16_t>(status_len));
+    return COMM_SUCCESS;
+}
+
+int PacketIo::readFastStatus(uint16_t length, size_t count, uint8_t* ids, uint8_t* errors, uint8_t* data,
+                             size_t stride) {
+    // パラメータは [エラー][ID][データ][CRC 2] の繰り返し（最後の1台の CRC はパケットの CRC になる）
+    const size_t segment = length + dxl_proto::FAST_SEGMENT_OVERHEAD;
+    const size_t expected = count * segment - 2;
+    uint32_t crc_errors = parser_.crcErrors();
+    dxl_proto::Packet packet;
+    while (true) {
+        while (parser_.next(packet)) {
+            if (packet.instruction != dxl_proto::STATUS || packet.id != dxl_proto::ID_BROADCAST) {
+                continue;
+            }
+            if (packet.param_len != expected) {
+                return COMM_RX_CORRUPT;
+            }
+            for (size_t k = 0; k < count; k++) {
+                const uint8_t* p = packet.params + k * segment;
+                errors[k] = p[0];
+                ids[k] = p[1];
+                memcpy(data + k * stride, p + 2, length);
+            }
+            return COMM_SUCCESS;
+        }
+        if (parser_.crcErrors() != crc_errors) {
+            return COMM_RX_CORRUPT;
+        }
+        if (port_->isPacketTimeout()) {
+            return COMM_RX_TIMEOUT;
+        }
+        int n = port_->readPort(rx_, sizeof(rx_));
+        if (n > 0) {
+            parser_.feed(rx_, static_cast<size_t>(n));
+        }
+    }
+}
+
+int PacketIo::syncWriteTxOnly(uint16_t address, uint16_t length, const uint8_t* param, size_t param_len) {
+    if (param_len + 4 > sizeof(params_)) {
+        return COMM_TX_ERROR;
+    }
+    putWord(params_, address);
+    putWord(params_ + 2, length);
+    memcpy(params_ + 4, param, param_len);
+    return txPacket(dxl_proto::ID_BROADCAST, dxl_proto::SYNC_WRITE, 4 + param_len);
+}
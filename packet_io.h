@@ -0,0 +1,54 @@
+#ifndef PACKET_IO_H_
+#define PACKET_IO_H_
+
+#include "dynamixel_sdk.h"
+#include "dxl_protocol.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 制御周期中に使うパケット送受信。SDK の PacketHandler は1回ごとにパケットを malloc するので、
+// 送信・受信バッファを構築時に持っておき、dxl_proto で組み立て・解析する（周期中のヒープ確保なし）。
+// タイムアウトの決め方は SDK（Protocol 2.0）と同じ。戻り値はすべて COMM_*。
+class PacketIo {
+public:
+    explicit PacketIo(dynamixel::PortHandler* port) : port_(port) {}
+    PacketIo(const PacketIo&) = delete;
+    PacketIo& operator=(const PacketIo&) = delete;
+
+    // 1台から length バイト読む / 書く（応答を待つ）
+    int read(uint8_t id, uint16_t address, uint16_t length, uint8_t* data, uint8_t* error);
+    int write(uint8_t id, uint16_t address, const uint8_t* data, uint16_t length, uint8_t* error);
+
+    // Sync Read の要求を送る。応答は readStatus() で ids の順に受け取る
+    int syncReadTx(uint16_t address, uint16_t length, const uint8_t* ids, size_t count);
+    int readStatus(uint8_t id, uint16_t length, uint8_t* data, uint8_t* error);
+
+    // Sync Read の応答を届いた順に1つ受け取り、送り主を id に返す（途中の1台が化けても後続を捨てない）。
+    // CRC不一致のパケットを捨てた時点で COMM_RX_CORRUPT を返すので、残りを待つかは呼び出し側が crcErrors() で決める
+    int nextStatus(uint16_t length, uint8_t* id, uint8_t* data, uint8_t* error);
+
+    // これまでにCRC不一致で捨てたパケット数
+    uint32_t crcErrors() const { return parser_.crcErrors(); }
+
+    // Fast Sync Read の要求を送る。応答は全IDぶんを1つにまとめたステータスパケット（readFastStatus() で受け取る）
+    int fastSyncReadTx(uint16_t address, uint16_t length, const uint8_t* ids, size_t count);
+    // Fast Sync Read の応答を受け取り、要求順に ids[k] / errors[k] / data[k * stride] へ振り分ける。
+    // 1つのパケットなので、途中の1台が欠けても化けても全IDが失敗になる
+    int readFastStatus(uint16_t length, size_t count, uint8_t* ids, uint8_t* errors, uint8_t* data, size_t stride);
+
+    // Sync Write（応答なし）。param は [ID][length バイト] の繰り返し
+    int syncWriteTxOnly(uint16_t address, uint16_t length, const uint8_t* param, size_t param_len);
+
+private:
+    // params_ の先頭 param_len バイトをパラメータにして送る
+    int txPacket(uint8_t id, uint8_t instruction, size_t param_len);
+
+    dynamixel::PortHandler* port_;
+    uint8_t params_[dxl_proto::PACKET_MAX_LEN];
+    uint8_t tx_[dxl_proto::PACKET_MAX_LEN];
+    uint8_t rx_[dxl_proto::PACKET_MAX_LEN];
+    dxl_proto::PacketParser parser_;
+};
+
+#endif  // PACKET_IO_H_
@@ -0,0 +1,184 @@
+#include "periodic_executor.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+
+const int64_t NSEC_PER_SEC = 1000000000LL;
+
+int64_t toNs(const struct timespec& ts) {
+    return static_cast<int64_t>(ts.tv_sec) * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+struct timespec toTimespec(int64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(ns / NSEC_PER_SEC);
+    ts.tv_nsec = static_cast<long>(ns % NSEC_PER_SEC);
+    return ts;
+}
+
+int64_t monotonicNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return toNs(ts);
+}
+
+}  // namespace
+
+ExecutorConfig executorConfigFromEnv(double period_s) {
+    ExecutorConfig config;
+    config.period_s = period_s;
+    if (const char* value = getenv("DXL_RT_PRIORITY")) {
+        config.rt_priority = atoi(value);
+    }
+    if (const char* value = getenv("DXL_CPU")) {
+        config.cpu = atoi(value);
+    }
+    if (const char* value = getenv("DXL_OVERRUN_POLICY")) {
+        std::string policy = value;
+        if (policy == "catchup") {
+            config.policy = OverrunPolicy::CatchUp;
+        } else if (policy == "degrade") {
+            config.policy = OverrunPolicy::Degrade;
+        } else {
+            config.policy = OverrunPolicy::Skip;
+        }
+    }
+    return config;
+}
+
+double controlPeriodFromEnv(double period_s) {
+    if (const char* value = getenv("DXL_PERIOD_MS")) {
+        double ms = atof(value);
+        if (ms > 0.0) {
+            return ms * 1e-3;
+        }
+        std::cerr << "Ignoring DXL_PERIOD_MS=" << value << std::endl;
+    }
+    return period_s;
+}
+
+PeriodicExecutor::PeriodicExecutor(const ExecutorConfig& config)
+    : config_(config),
+      runtime_(nullptr),
+      period_ns_(static_cast<int64_t>(config.period_s * NSEC_PER_SEC)),
+      cycles_(0),
+      overruns_(0),
+      skipped_(0) {}
+
+void PeriodicExecutor::applyRealtimeSettings() {
+    if (config_.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(config_.cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            std::cerr << "CPU " << config_.cpu << " への固定に失敗しました: " << strerror(err) << std::endl;
+        }
+    }
+
+    if (config_.rt_priority > 0) {
+        // ページフォルトによる遅延を避ける
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+            std::cerr << "mlockall に失敗しました: " << strerror(errno) << std::endl;
+        }
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = config_.rt_priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0) {
+            std::cerr << "SCHED_FIFO の設定に失敗しました（通常優先度で続行）: " << strerror(err) << std::endl;
+        }
+    }
+}
+
+void PeriodicExecutor::run(const std::function<bool(const CycleInfo&)>& body) {
+    applyRealtimeSettings();
+
+    const int64_t start_ns = monotonicNow();
+    int64_t deadline_ns = start_ns;
+    int64_t scheduled_ns = 0;  // 開始からの予定時刻
+
+    while (true) {
+        if (runtime_) {
+            if (!runtime_->waitUntil(deadline_ns)) {
+                break;  // 停止要求（理由は runtime_->stopReason()）
+            }
+        } else {
+            struct timespec wake = toTimespec(deadline_ns);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) == EINTR) {
+            }
+        }
+
+        int64_t woke_ns = monotonicNow();
+        int64_t lateness = woke_ns - deadline_ns;
+        jitter_.record(static_cast<uint64_t>(lateness > 0 ? lateness : 0));
+
+        CycleInfo info;
+        info.cycle = cycles_;
+        info.scheduled_s = scheduled_ns * 1e-9;
+        info.elapsed_s = (woke_ns - start_ns) * 1e-9;
+        info.period_s = period_ns_ * 1e-9;
+        info.lateness_ns = lateness;
+        info.deadline_ns = deadline_ns + period_ns_;
+
+        bool keep_running = body(info);
+        int64_t done_ns = monotonicNow();
+        body_time_.record(static_cast<uint64_t>(done_ns - woke_ns));
+        cycles_++;
+        if (!keep_running) {
+            break;
+        }
+
+        deadline_ns += period_ns_;
+        scheduled_ns += period_ns_;
+        if (done_ns <= deadline_ns) {
+            continue;
+        }
+
+        // 次の期限を過ぎてしまった
+        overruns_++;
+        switch (config_.policy) {
+        case OverrunPolicy::Skip: {
+            int64_t missed = (done_ns - deadline_ns) / period_ns_ + 1;
+            deadline_ns += missed * period_ns_;
+            scheduled_ns += missed * period_ns_;
+            skipped_ += static_cast<uint64_t>(missed);
+            break;
+        }
+        case OverrunPolicy::CatchUp:
+            // 期限はそのまま。次回は待たずに実行される
+            break;
+        case OverrunPolicy::Degrade: {
+            int64_t max_period_ns = static_cast<int64_t>(config_.max_period_s * NSEC_PER_SEC);
+            int64_t degraded = static_cast<int64_t>(period_ns_ * config_.degrade_factor);
+            period_ns_ = degraded < max_period_ns ? degraded : max_period_ns;
+            deadline_ns = done_ns + period_ns_;
+            scheduled_ns = done_ns + period_ns_ - start_ns;
+            break;
+        }
+        }
+    }
+}
+
+void PeriodicExecutor::printReport(std::ostream& os) const {
+    auto us = [](uint64_t ns) { return ns / 1000.0; };
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(1);
+    os << "Cycles: " << cycles_ << ", overruns: " << overruns_ << ", skipped: " << skipped_
+       << ", period: " << period_ns_ / 1e6 << " ms\n";
+    os << "Wakeup jitter [us]  p50: " << us(jitter_.percentile(50)) << "  p99: " << us(jitter_.percentile(99))
+       << "  max: " << us(jitter_.max()) << "\n";
+    os << "Cycle body   [us]  p50: " << us(body_time_.percentile(50)) << "  p99: " << us(body_time_.percentile(99))
+       << "  max: " << us(body_time_.max()) << std::endl;
+    os.flags(flags);
+}
@@ -0,0 +1,81 @@
+#ifndef PERIODIC_EXECUTOR_H_
+#define PERIODIC_EXECUTOR_H_
+
+#include "control_runtime.h"
+#include "latency_histogram.h"
+
+#include <stdint.h>
+#include <functional>
+#include <iosfwd>
+
+// 周期超過時の扱い
+enum class OverrunPolicy {
+    Skip,     // 過ぎた周期は飛ばし、次の周期境界に合わせる
+    CatchUp,  // 遅れた分を詰めて連続実行し、元の時刻系列に追いつく
+    Degrade,  // 周期を degrade_factor 倍に伸ばす（max_period_s まで）
+};
+
+struct ExecutorConfig {
+    double period_s = 0.01;          // 制御周期 [s]
+    OverrunPolicy policy = OverrunPolicy::Skip;
+    int rt_priority = 0;             // 1〜99 で SCHED_FIFO（要権限）。0 なら通常スケジューリング
+    int cpu = -1;                    // 0 以上なら実行スレッドをそのCPUに固定
+    double degrade_factor = 1.5;
+    double max_period_s = 0.1;
+};
+
+// 環境変数 DXL_RT_PRIORITY / DXL_CPU / DXL_OVERRUN_POLICY(skip|catchup|degrade) で上書きした設定を返す
+ExecutorConfig executorConfigFromEnv(double period_s);
+
+// 環境変数 DXL_PERIOD_MS があればその周期 [s]、無ければ period_s を返す
+// （ログの容量なども周期から決めるプログラム用。executorConfigFromEnv より先に呼ぶ）
+double controlPeriodFromEnv(double period_s);
+
+struct CycleInfo {
+    uint64_t cycle;        // 0 から数えた実行回数
+    double scheduled_s;    // 開始からの予定時刻 [s]
+    double elapsed_s;      // 開始からの実際の経過時間 [s]
+    double period_s;       // 現在の周期 [s]
+    int64_t lateness_ns;   // 予定時刻からの起床遅れ [ns]
+    int64_t deadline_ns;   // この周期の期限（次の起床予定。CLOCK_MONOTONIC）[ns]
+};
+
+// CLOCK_MONOTONIC の絶対時刻で clock_nanosleep する固定周期実行器。
+// 周期 = 処理時間 + 待ち時間 にならないので、I/O 時間が変動しても周期がずれない。
+class PeriodicExecutor {
+public:
+    explicit PeriodicExecutor(const ExecutorConfig& config);
+
+    // body が false を返すまで周期実行する（runtime を渡していれば、停止要求が来たときも抜ける）
+    void run(const std::function<bool(const CycleInfo&)>& body);
+
+    // 周期の待ちを runtime の epoll で行い、待っている間にキーボード・シグナル・ポートの切断を受ける。
+    // nullptr（既定）なら clock_nanosleep で待つ
+    void setRuntime(ControlRuntime* runtime) { runtime_ = runtime; }
+
+    uint64_t cycles() const { return cycles_; }
+    uint64_t overruns() const { return overruns_; }
+    uint64_t skipped() const { return skipped_; }
+    double period() const { return period_ns_ * 1e-9; }
+
+    // 起床遅れ（ジッタ）と処理時間のヒストグラム [ns]
+    const LatencyHistogram& jitter() const { return jitter_; }
+    const LatencyHistogram& bodyTime() const { return body_time_; }
+
+    // 周期・超過回数・ジッタ p50/p99/max を表示する
+    void printReport(std::ostream& os) const;
+
+private:
+    void applyRealtimeSettings();
+
+    ExecutorConfig config_;
+    ControlRuntime* runtime_;
+    int64_t period_ns_;
+    uint64_t cycles_;
+    uint64_t overruns_;
+    uint64_t skipped_;
+    LatencyHistogram jitter_;
+    LatencyHistogram body_time_;
+};
+
+#endif  // PERIODIC_EXECUTOR_H_
@@ -0,0 +1,199 @@
+#include "pid_kernel.h"
+
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PID_HAVE_X86 1
+#endif
+
+// 1関節分。SIMD 版の端数処理もこれを使うので、演算の順番は SIMD 版と揃えておくこと
+static inline void pidLane(const PidLanes& l, size_t i, const double* target, const double* position,
+                           const double* feedforward, double dt, double rate, bool measurement, int16_t* out,
+                           double* error) {
+    double e = target[i] - position[i];
+    double x = measurement ? position[i] : e;
+    double raw = (x - l.previous[i]) * rate;
+    double denom = l.tau[i] + dt;
+    denom = denom > DBL_MIN ? denom : DBL_MIN;
+    double alpha = dt / denom;
+    double d = l.derivative[i];
+    d = d + alpha * (raw - d);
+    double integral = l.integral[i] + l.ki[i] * e * dt;
+    double pd = l.kp[i] * e + l.kd[i] * d + feedforward[i];
+    double hi = l.max_out[i] - pd;
+    hi = hi > 0.0 ? hi : 0.0;
+    double lo = l.min_out[i] - pd;
+    lo = lo < 0.0 ? lo : 0.0;
+    integral = integral < hi ? integral : hi;
+    integral = integral > lo ? integral : lo;
+    double u = pd + integral;
+    u = u < l.max_out[i] ? u : l.max_out[i];
+    u = u > l.min_out[i] ? u : l.min_out[i];
+    out[i] = static_cast<int16_t>(u);
+    l.integral[i] = integral;
+    l.derivative[i] = d;
+    l.previous[i] = x;
+    error[i] = e;
+}
+
+void pidStepScalar(const PidLanes& lanes, const double* target, const double* position, const double* feedforward,
+                   double dt, double rate, bool measurement, int16_t* out, double* error) {
+    for (size_t i = 0; i < lanes.n; i++) {
+        pidLane(lanes, i, target, position, feedforward, dt, rate, measurement, out, error);
+    }
+}
+
+#ifdef PID_HAVE_X86
+
+// minpd / maxpd は (a < b ? a : b) / (a > b ? a : b) なので、スカラー版の比較と同じ値になる
+void pidStepSse2(const PidLanes& l, const double* target, const double* position, const double* feedforward,
+                 double dt, double rate, bool measurement, int16_t* out, double* error) {
+    const __m128d vdt = _mm_set1_pd(dt);
+    const __m128d vrate = _mm_set1_pd(rate);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d tiny = _mm_set1_pd(DBL_MIN);
+    size_t i = 0;
+    for (; i + 2 <= l.n; i += 2) {
+        __m128d p = _mm_loadu_pd(position + i);
+        __m128d e = _mm_sub_pd(_mm_loadu_pd(target + i), p);
+        __m128d x = measurement ? p : e;
+        __m128d raw = _mm_mul_pd(_mm_sub_pd(x, _mm_loadu_pd(l.previous + i)), vrate);
+        __m128d denom = _mm_max_pd(_mm_add_pd(_mm_loadu_pd(l.tau + i), vdt), tiny);
+        __m128d alpha = _mm_div_pd(vdt, denom);
+        __m128d d = _mm_loadu_pd(l.derivative + i);
+        d = _mm_add_pd(d, _mm_mul_pd(alpha, _mm_sub_pd(raw, d)));
+        __m128d integral =
+            _mm_add_pd(_mm_loadu_pd(l.integral + i), _mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(l.ki + i), e), vdt));
+        __m128d pd = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(l.kp + i), e), _mm_mul_pd(_mm_loadu_pd(l.kd + i), d));
+        pd = _mm_add_pd(pd, _mm_loadu_pd(feedforward + i));
+        __m128d max_out = _mm_loadu_pd(l.max_out + i);
+        __m128d min_out = _mm_loadu_pd(l.min_out + i);
+        __m128d hi = _mm_max_pd(_mm_sub_pd(max_out, pd), zero);
+        __m128d lo = _mm_min_pd(_mm_sub_pd(min_out, pd), zero);
+        integral = _mm_max_pd(_mm_min_pd(integral, hi), lo);
+        __m128d u = _mm_max_pd(_mm_min_pd(_mm_add_pd(pd, integral), max_out), min_out);
+        __m128i packed = _mm_packs_epi32(_mm_cvttpd_epi32(u), _mm_setzero_si128());
+        int32_t two = _mm_cvtsi128_si32(packed);
+        memcpy(out + i, &two, sizeof(two));
+        _mm_storeu_pd(l.integral + i, integral);
+        _mm_storeu_pd(l.derivative + i, d);
+        _mm_storeu_pd(l.previous + i, x);
+        _mm_storeu_pd(error + i, e);
+    }
+    for (; i < l.n; i++) {
+        pidLane(l, i, target, position, feedforward, dt, rate, measurement, out, error);
+    }
+}
+
+// FMA は有効にしない（有効にするとスカラー版と丸めが変わる）
+__attribute__((target("avx2")))
+void pidStepAvx2(const PidLanes& l, const double* target, const double* position, const double* feedforward,
+                 double dt, double rate, bool measurement, int16_t* out, double* error) {
+    const __m256d vdt = _mm256_set1_pd(dt);
+    const __m256d vrate = _mm256_set1_pd(rate);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d tiny = _mm256_set1_pd(DBL_MIN);
+    size_t i = 0;
+    for (; i + 4 <= l.n; i += 4) {
+        __m256d p = _mm256_loadu_pd(position + i);
+        __m256d e = _mm256_sub_pd(_mm256_loadu_pd(target + i), p);
+        __m256d x = measurement ? p : e;
+        __m256d raw = _mm256_mul_pd(_mm256_sub_pd(x, _mm256_loadu_pd(l.previous + i)), vrate);
+        __m256d denom = _mm256_max_pd(_mm256_add_pd(_mm256_loadu_pd(l.tau + i), vdt), tiny);
+        __m256d alpha = _mm256_div_pd(vdt, denom);
+        __m256d d = _mm256_loadu_pd(l.derivative + i);
+        d = _mm256_add_pd(d, _mm256_mul_pd(alpha, _mm256_sub_pd(raw, d)));
+        __m256d integral = _mm256_add_pd(_mm256_loadu_pd(l.integral + i),
+                                         _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(l.ki + i), e), vdt));
+        __m256d pd =
+            _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(l.kp + i), e), _mm256_mul_pd(_mm256_loadu_pd(l.kd + i), d));
+        pd = _mm256_add_pd(pd, _mm256_loadu_pd(feedforward + i));
+        __m256d max_out = _mm256_loadu_pd(l.max_out + i);
+        __m256d min_out = _mm256_loadu_pd(l.min_out + i);
+        __m256d hi = _mm256_max_pd(_mm256_sub_pd(max_out, pd), zero);
+        __m256d lo = _mm256_min_pd(_mm256_sub_pd(min_out, pd), zero);
+        integral = _mm256_max_pd(_mm256_min_pd(integral, hi), lo);
+        __m256d u = _mm256_max_pd(_mm256_min_pd(_mm256_add_pd(pd, integral), max_out), min_out);
+        __m128i packed = _mm_packs_epi32(_mm256_cvttpd_epi32(u), _mm_setzero_si128());
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), packed);
+        _mm256_storeu_pd(l.integral + i, integral);
+        _mm256_storeu_pd(l.derivative + i, d);
+        _mm256_storeu_pd(l.previous + i, x);
+        _mm256_storeu_pd(error + i, e);
+    }
+    for (; i < l.n; i++) {
+        pidLane(l, i, target, position, feedforward, dt, rate, measurement, out, error);
+    }
+}
+
+#else
+
+void pidStepSse2(const PidLanes& lanes, const double* target, const double* position, const double* feedforward,
+                 double dt, double rate, bool measurement, int16_t* out, double* error) {
+    pidStepScalar(lanes, target, position, feedforward, dt, rate, measurement, out, error);
+}
+
+void pidStepAvx2(const PidLanes& lanes, const double* target, const double* position, const double* feedforward,
+                 double dt, double rate, bool measurement, int16_t* out, double* error) {
+    pidStepScalar(lanes, target, position, feedforward, dt, rate, measurement, out, error);
+}
+
+#endif
+
+bool pidIsaSupported(PidIsa isa) {
+    switch (isa) {
+    case PidIsa::Scalar:
+        return true;
+#ifdef PID_HAVE_X86
+    case PidIsa::Sse2:
+        return __builtin_cpu_supports("sse2");
+    case PidIsa::Avx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* pidIsaName(PidIsa isa) {
+    switch (isa) {
+    case PidIsa::Sse2: return "sse2";
+    case PidIsa::Avx2: return "avx2";
+    default:           return "scalar";
+    }
+}
+
+PidIsa pidIsa(size_t n) {
+    PidIsa best = n < PID_MIN_SIMD_LANES        ? PidIsa::Scalar
+                : pidIsaSupported(PidIsa::Avx2) ? PidIsa::Avx2
+                : pidIsaSupported(PidIsa::Sse2) ? PidIsa::Sse2
+                                                : PidIsa::Scalar;
+    const char* env = getenv("DXL_PID_ISA");
+    if (env) {
+        for (PidIsa isa : {PidIsa::Scalar, PidIsa::Sse2, PidIsa::Avx2}) {
+            if (strcmp(env, pidIsaName(isa)) == 0 && pidIsaSupported(isa)) {
+                return isa;
+            }
+        }
+    }
+    return best;
+}
+
+void pidStep(PidIsa isa, const PidLanes& lanes, const double* target, const double* position,
+             const double* feedforward, double dt, double rate, bool measurement, int16_t* out, double* error) {
+    switch (isa) {
+    case PidIsa::Avx2:
+        pidStepAvx2(lanes, target, position, feedforward, dt, rate, measurement, out, error);
+        break;
+    case PidIsa::Sse2:
+        pidStepSse2(lanes, target, position, feedforward, dt, rate, measurement, out, error);
+        break;
+    default:
+        pidStepScalar(lanes, target, position, feedforward, dt, rate, measurement, out, error);
+        break;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef PID_KERNEL_H_
+#define PID_KERNEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 全関節のPIDを1回で計算するカーネル。1関節 = SIMDの1レーンで、状態は項目ごとの連続配列（SoA）に持つ。
+//
+//   e   = target - position
+//   x   = e（誤差微分）または position（測定値微分。rate に -1/dt を渡す）
+//   d   = d + alpha * ((x - x_prev) * rate - d)      alpha = dt / (tau + dt)  … 一次ローパス
+//   i   = i + ki * e * dt                             … 積分は出力の単位で持つ（ki を変えても出力が跳ねない）
+//   pd  = kp * e + kd * d + ff                        … ff は軌道から求めたフィードフォワード電流
+//   i   = clamp(i, min(min_out - pd, 0), max(max_out - pd, 0))   … 出力が飽和する分は積分しない
+//   out = clamp(pd + i, min_out, max_out) を0方向に丸めて int16
+//
+// AVX2 / SSE2 / スカラーのどれで計算しても結果はビット単位で一致する（同じ演算を同じ順で行い、
+// FMA への縮約はしない。pid_kernel.cpp は -ffp-contract=off でコンパイルする）。
+struct PidLanes {
+    size_t n;
+    const double* kp;
+    const double* ki;
+    const double* kd;
+    const double* tau;          // 微分フィルタの時定数 [s]（0 ならフィルタなし）
+    const double* min_out;
+    const double* max_out;
+    double* integral;
+    double* derivative;         // フィルタ後の微分
+    double* previous;           // 前回の x
+};
+
+enum class PidIsa {
+    Scalar,
+    Sse2,
+    Avx2,
+};
+
+// rate は微分の係数（誤差微分なら 1/dt、測定値微分なら -1/dt、初回は 0）
+// feedforward は pd に足す目標電流の補正（軌道の速度・加速度から求めたもの）
+void pidStepScalar(const PidLanes& lanes, const double* target, const double* position, const double* feedforward,
+                   double dt, double rate, bool measurement, int16_t* out, double* error);
+void pidStepSse2(const PidLanes& lanes, const double* target, const double* position, const double* feedforward,
+                 double dt, double rate, bool measurement, int16_t* out, double* error);
+void pidStepAvx2(const PidLanes& lanes, const double* target, const double* position, const double* feedforward,
+                 double dt, double rate, bool measurement, int16_t* out, double* error);
+
+// n 関節を計算するのに使う命令セット。このCPUで使える最速のものを選ぶが、
+// 1ベクトルに満たない関節数では呼び出しの手間の方が大きいのでスカラー版にする。
+// 環境変数 DXL_PID_ISA=scalar|sse2|avx2 で指定もできる（使えない命令セットなら無視）
+#define PID_MIN_SIMD_LANES            4
+PidIsa pidIsa(size_t n);
+bool pidIsaSupported(PidIsa isa);
+const char* pidIsaName(PidIsa isa);
+
+void pidStep(PidIsa isa, const PidLanes& lanes, const double* target, const double* position,
+             const double* feedforward, double dt, double rate, bool measurement, int16_t* out, double* error);
+
+#endif  // PID_KERNEL_H_
@@ -0,0 +1,359 @@
+// 走行ログの位置・電流を制御コードに流し込み、指令した目標電流を出す（実時間を待たずに CPU の速さで回す）
+//   ./replay [-m bus|law] [-n repeat] [-k kp,ki,kd,tau] [-l min,max] [-p period_ms] [-o out_dir] [-c ref_dir] log ...
+//   -m bus（既定）: ReplayPort 経由で AxisController の read / compute / write をそのまま回す（パケットの組み立て・解析込み）
+//   -m law        : 制御則（PidLaw）だけを呼ぶ（1ステップの計算時間を測る用）
+//   -n            : 同じログを繰り返す回数（ベンチマーク用。出力・比較は1回目だけ）
+//   -k / -l       : ゲインと電流の範囲（既定はログのレイアウトごとに current_control2 / current と同じ値）
+//   -p            : 制御則に渡す周期（既定 10ms。実機でも実行器の周期をそのまま渡すので、取りこぼしがあっても変えない）
+//   -o            : ログごとに out_dir/<ログ名>.csv（Time(s), Goal_Current_1, ...）を書く
+//   -c            : 前に -o で書いた ref_dir/<ログ名>.csv と比べ、違うステップ数（括弧内は最大差）を出す（制御則の版の比較）
+// 目標軌道は DXL_TRAJECTORY / DXL_FEEDFORWARD を制御プログラムと同じに解釈する。開始位置はログの最初の位置。
+// 記録された電流は Present Current なので、シミュレータのログなら 次の行の電流 = このステップの指令 になる（"vs log"）。
+#include "alloc_check.h"
+#include "axis_controller.h"
+#include "control_law.h"
+#include "feedforward.h"
+#include "replay_port.h"
+#include "run_analysis.h"
+#include "trajectory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// current_control2（angle_current のログ）と同じ設定
+#define ANGLE_GAINS                   {5.0, 0.0, 0.5, 0.0, 0, 500}
+#define ANGLE_DERIVATIVE              PdLaw::Derivative::Error
+// current（current_data のログ）と同じ設定
+#define CURRENT_GAINS                 {1.0, 0.0, 0.1, 0.03, -20, 20}
+#define CURRENT_DERIVATIVE            PdLaw::Derivative::Measurement
+#define REPLAY_PERIOD                 0.01    // どちらも 10ms 周期（DXL_PERIOD_MS で変えたログは -p で合わせる）
+
+struct ReplayOptions {
+    bool through_bus = true;
+    int repeat = 1;
+    bool gains_set = false;
+    PidLaw::Gains gains = ANGLE_GAINS;
+    bool limits_set = false;
+    int16_t min_current = 0;
+    int16_t max_current = 0;
+    double period_s = REPLAY_PERIOD;
+    std::string out_dir;
+    std::string ref_dir;
+};
+
+// 1本のログを流した結果
+struct ReplayResult {
+    size_t steps = 0;              // 1回分のステップ数
+    double seconds = 0.0;          // repeat 回分の所要時間
+    size_t clamped = 0;            // 指令が電流の上限・下限に張り付いたステップ
+    int max_jump = 0;              // 隣り合うステップの指令の差の最大（微分の跳ね）
+    size_t log_mismatch = 0;       // 指令と次の行の記録電流が違うステップ
+    size_t ref_mismatch = 0;       // 比較先と指令が違うステップ
+    int ref_max_diff = 0;
+    bool compared = false;
+};
+
+static double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static std::vector<double> parseList(const std::string& text) {
+    std::vector<double> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            values.push_back(atof(item.c_str()));
+        }
+    }
+    return values;
+}
+
+static std::string baseName(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.rfind('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+// ref_dir に書いた指令（Time(s), Goal_Current_1, ... の CSV）を読む。goals[k * n + i]
+static bool loadCommands(const std::string& path, size_t n, std::vector<int>& goals) {
+    FILE* fp = fopen(path.c_str(), "r");
+    if (!fp) {
+        return false;
+    }
+    char line[1024];
+    if (!fgets(line, sizeof(line), fp)) {
+        fclose(fp);
+        return false;
+    }
+    goals.clear();
+    while (fgets(line, sizeof(line), fp)) {
+        std::vector<double> values = parseList(line);
+        if (values.size() < n + 1) {
+            continue;
+        }
+        for (size_t i = 0; i < n; i++) {
+            goals.push_back(static_cast<int>(values[i + 1]));
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+static bool replayLog(const RunAnalyzer& log, const RunStats& stats, const ReplayOptions& options,
+                      ReplayResult& result) {
+    const std::vector<double>& time = log.times();
+    const size_t n = stats.num_motors;
+    const size_t steps = time.size();
+    if (steps < 2) {
+        std::cerr << stats.path << ": too few samples\n";
+        return false;
+    }
+
+    // 制御則と軌道はログのレイアウトに合わせる（制御プログラムと同じ目標）
+    bool angle = stats.layout == LAYOUT_ANGLE_CURRENT;
+    PidLaw::Gains gains = angle ? PidLaw::Gains ANGLE_GAINS : PidLaw::Gains CURRENT_GAINS;
+    if (options.gains_set) {
+        gains.kp = options.gains.kp;
+        gains.ki = options.gains.ki;
+        gains.kd = options.gains.kd;
+        gains.tau = options.gains.tau;
+    }
+    if (options.limits_set) {
+        gains.min_current = options.min_current;
+        gains.max_current = options.max_current;
+    }
+    PidLaw law(n, gains, angle ? ANGLE_DERIVATIVE : CURRENT_DERIVATIVE);
+
+    double duration = angle ? ANALYSIS_ANGLE_DURATION : ANALYSIS_CURRENT_DURATION;
+    std::vector<double> distances(n);
+    std::vector<double> origins(n);
+    for (size_t i = 0; i < n; i++) {
+        distances[i] = (angle && i % 2 == 1) ? -ANALYSIS_MOVE_TICKS : ANALYSIS_MOVE_TICKS;
+        origins[i] = log.positions(i)[0];
+    }
+    std::vector<FeedforwardModel> feedforward_models;
+    if (!feedforwardFromEnv(n, feedforward_models)) {
+        return false;
+    }
+    std::unique_ptr<Trajectory> trajectory = trajectoryFromEnv(distances, duration, feedforward_models, origins);
+    if (!trajectory) {
+        return false;
+    }
+
+    const double dt = options.period_s;
+
+    // 速度はログに無いので位置の差分から作る（制御則は使わないが、バス経由では一緒に返す）
+    std::vector<uint8_t> ids(n);
+    for (size_t i = 0; i < n; i++) {
+        ids[i] = static_cast<uint8_t>(i + 1);
+    }
+    std::vector<int16_t> frame_current(n);
+    std::vector<int32_t> frame_velocity(n);
+    std::vector<int32_t> frame_position(n);
+    std::vector<double> target(n);
+    std::vector<double> position(n);
+    std::vector<double> feedforward(n);
+    std::vector<TrajectoryPoint> points(n);
+    std::vector<int16_t> goals(steps * n);
+
+    ReplayPort port(ids);
+    AxisController axes(&port, nullptr, ids, law);
+
+    AllocCheck alloc_check(allocCheckFromEnv());
+    double start = nowSeconds();
+    for (int r = 0; r < options.repeat; r++) {
+        law.reset();
+        for (size_t k = 0; k < steps; k++) {
+            double elapsed = time[k];  // ログの時刻は制御開始からの経過時間
+            if (r == 0 && k == 1) {
+                alloc_check.arm();  // 1ステップ目の初回確保は数えない
+            }
+            trajectory->lookup(elapsed, points.data());
+            int16_t* goal = &goals[k * n];
+            if (options.through_bus) {
+                for (size_t i = 0; i < n; i++) {
+                    frame_current[i] = log.currents(i)[k];
+                    frame_position[i] = log.positions(i)[k];
+                    double ticks_per_s =
+                        k > 0 ? (log.positions(i)[k] - log.positions(i)[k - 1]) / (time[k] - time[k - 1]) : 0.0;
+                    frame_velocity[i] = static_cast<int32_t>(ticks_per_s * 60.0 / 4096.0 / xm430::PresentVelocity::unit);
+                }
+                port.setFrame(frame_current.data(), frame_velocity.data(), frame_position.data());
+                axes.read();
+                for (size_t i = 0; i < n; i++) {
+                    axes.setTarget(i, origins[i] + points[i].position);
+                    axes.setFeedforward(i, points[i].feedforward);
+                }
+                axes.compute(dt);
+                axes.write();
+                for (size_t i = 0; i < n; i++) {
+                    goal[i] = port.goalCurrent(i);
+                }
+            } else {
+                for (size_t i = 0; i < n; i++) {
+                    position[i] = log.positions(i)[k];
+                    target[i] = origins[i] + points[i].position;
+                    feedforward[i] = points[i].feedforward;
+                }
+                AxisState state = {n, target.data(), position.data(), feedforward.data()};
+                law.compute(state, dt, goal);
+            }
+        }
+    }
+    result.seconds = nowSeconds() - start;
+    alloc_check.disarm();
+    result.steps = steps;
+    if (!alloc_check.report(std::cout)) {
+        return false;
+    }
+
+    for (size_t k = 0; k < steps; k++) {
+        for (size_t i = 0; i < n; i++) {
+            int16_t goal = goals[k * n + i];
+            result.clamped += goal <= gains.min_current || goal >= gains.max_current;
+            if (k > 0) {
+                result.max_jump = std::max(result.max_jump, std::abs(goal - goals[(k - 1) * n + i]));
+            }
+            if (k + 1 < steps && goal != log.currents(i)[k + 1]) {
+                result.log_mismatch++;
+            }
+        }
+    }
+
+    std::string name = baseName(stats.path);
+    if (!options.ref_dir.empty()) {
+        std::vector<int> reference;
+        if (!loadCommands(options.ref_dir + "/" + name + ".csv", n, reference)) {
+            std::cerr << "Cannot read reference for " << name << std::endl;
+        } else {
+            result.compared = true;
+            size_t ref_steps = reference.size() / n;
+            size_t common = std::min(ref_steps, steps);
+            result.ref_mismatch = std::max(ref_steps, steps) - common;  // 長さが違う分は全部違うとみなす
+            for (size_t k = 0; k < common; k++) {
+                bool differs = false;
+                for (size_t i = 0; i < n; i++) {
+                    int diff = std::abs(reference[k * n + i] - goals[k * n + i]);
+                    result.ref_max_diff = std::max(result.ref_max_diff, diff);
+                    differs = differs || diff != 0;
+                }
+                result.ref_mismatch += differs;
+            }
+        }
+    }
+    if (!options.out_dir.empty()) {
+        std::string path = options.out_dir + "/" + name + ".csv";
+        FILE* fp = fopen(path.c_str(), "w");
+        if (!fp) {
+            std::cerr << "Failed to write " << path << std::endl;
+            return false;
+        }
+        fprintf(fp, "Time(s)");
+        for (size_t i = 0; i < n; i++) {
+            fprintf(fp, ",Goal_Current_%zu", i + 1);
+        }
+        fprintf(fp, "\n");
+        for (size_t k = 0; k < steps; k++) {
+            fprintf(fp, "%.6f", time[k]);
+            for (size_t i = 0; i < n; i++) {
+                fprintf(fp, ",%d", goals[k * n + i]);
+            }
+            fprintf(fp, "\n");
+        }
+        fclose(fp);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    ReplayOptions options;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:n:k:l:p:o:c:")) != -1) {
+        switch (opt) {
+        case 'm': options.through_bus = std::string(optarg) != "law"; break;
+        case 'n': options.repeat = std::max(1, atoi(optarg)); break;
+        case 'k': {
+            std::vector<double> k = parseList(optarg);
+            k.resize(4, 0.0);
+            options.gains = {k[0], k[1], k[2], k[3], 0, 0};
+            options.gains_set = true;
+            break;
+        }
+        case 'l': {
+            std::vector<double> l = parseList(optarg);
+            l.resize(2, 0.0);
+            options.min_current = static_cast<int16_t>(l[0]);
+            options.max_current = static_cast<int16_t>(l[1]);
+            options.limits_set = true;
+            break;
+        }
+        case 'p': options.period_s = atof(optarg) * 1e-3; break;
+        case 'o': options.out_dir = optarg; break;
+        case 'c': options.ref_dir = optarg; break;
+        default:
+            std::cerr << "Usage: " << argv[0]
+                      << " [-m bus|law] [-n repeat] [-k kp,ki,kd,tau] [-l min,max] [-p period_ms] [-o out_dir]"
+                         " [-c ref_dir] log ...\n";
+            return 1;
+        }
+    }
+    std::vector<std::string> args(argv + optind, argv + argc);
+    if (args.empty()) {
+        args = {"angle_current", "current_data"};
+    }
+    std::vector<std::string> paths = collectRunLogs(args);
+    if (paths.empty()) {
+        std::cerr << "No run logs found.\n";
+        return 1;
+    }
+
+    printf("%-40s %7s %8s %8s %8s %10s %12s %10s\n", "log", "steps", "clamped", "max_jump", "vs log", "vs ref",
+           "steps/s", "ns/step");
+    RunAnalyzer log{AnalysisOptions()};
+    size_t total_steps = 0, failed = 0, differing = 0;
+    double total_seconds = 0.0;
+    for (const std::string& path : paths) {
+        RunStats stats;
+        ReplayResult result;
+        if (!log.load(path, stats)) {
+            std::cerr << path << ": " << stats.error << std::endl;
+            failed++;
+            continue;
+        }
+        if (!replayLog(log, stats, options, result)) {
+            failed++;
+            continue;
+        }
+        double step_count = static_cast<double>(result.steps) * options.repeat;
+        std::string ref = result.compared ? std::to_string(result.ref_mismatch) : "-";
+        if (result.compared) {
+            ref += " (" + std::to_string(result.ref_max_diff) + ")";
+        }
+        printf("%-40s %7zu %8zu %8d %8zu %10s %12.0f %10.1f\n", baseName(path).c_str(), result.steps, result.clamped,
+               result.max_jump, result.log_mismatch, ref.c_str(), step_count / result.seconds,
+               result.seconds * 1e9 / step_count);
+        total_steps += static_cast<size_t>(step_count);
+        total_seconds += result.seconds;
+        differing += result.ref_mismatch;
+    }
+    if (total_seconds > 0.0) {
+        printf("\n%zu files (%zu failed), %zu controller steps (%s) in %.1f ms: %.2f M steps/s\n", paths.size(), failed,
+               total_steps, options.through_bus ? "bus" : "law", total_seconds * 1e3, total_steps / total_seconds / 1e6);
+    }
+    if (!options.ref_dir.empty()) {
+        printf("%zu steps differ from %s\n", differing, options.ref_dir.c_str());
+    }
+    return failed == 0 && differing == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+#include "replay_port.h"
+#include "xm430_registers.h"
+
+#include <string.h>
+
+using xm430::Telemetry;
+
+// 1台分のステータスパケットの上限（スタッフィングで少し伸びても収まる大きさ）
+#define REPLAY_STATUS_MAX             64
+
+static uint16_t get16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+ReplayPort::ReplayPort(const std::vector<uint8_t>& ids)
+    : ids_(ids),
+      current_(ids.size(), 0),
+      velocity_(ids.size(), 0),
+      position_(ids.size(), 0),
+      goal_current_(ids.size(), 0),
+      transactions_(0),
+      baudrate_(DEFAULT_BAUDRATE_),
+      rx_(ids.size() * REPLAY_STATUS_MAX + dxl_proto::PACKET_MAX_LEN),
+      rx_len_(0),
+      rx_pos_(0) {
+    memcpy(name_, "replay", 7);
+    for (int16_t& index : index_) {
+        index = -1;
+    }
+    for (size_t i = 0; i < ids_.size(); i++) {
+        index_[ids_[i]] = static_cast<int16_t>(i);
+    }
+}
+
+void ReplayPort::setFrame(const int16_t* current, const int32_t* velocity, const int32_t* position) {
+    for (size_t i = 0; i < ids_.size(); i++) {
+        current_[i] = current[i];
+        velocity_[i] = velocity[i];
+        position_[i] = position[i];
+    }
+}
+
+int ReplayPort::readPort(uint8_t* packet, int length) {
+    size_t n = rx_len_ - rx_pos_;
+    if (length >= 0 && n > static_cast<size_t>(length)) {
+        n = static_cast<size_t>(length);
+    }
+    memcpy(packet, &rx_[rx_pos_], n);
+    rx_pos_ += n;
+    return static_cast<int>(n);
+}
+
+int ReplayPort::writePort(uint8_t* packet, int length) {
+    parser_.reset();
+    parser_.feed(packet, static_cast<size_t>(length));
+    dxl_proto::Packet p;
+    while (parser_.next(p)) {
+        transactions_++;
+        switch (p.instruction) {
+        case dxl_proto::SYNC_READ:
+            handleSyncRead(p);
+            break;
+        case dxl_proto::SYNC_WRITE:
+            handleSyncWrite(p);
+            break;
+        case dxl_proto::READ:
+            if (p.param_len >= 4 && index_[p.id] >= 0) {
+                uint8_t zeros[dxl_proto::PACKET_MAX_LEN - REPLAY_STATUS_MAX] = {};
+                uint16_t len = get16(p.params + 2);
+                respond(p.id, zeros, len < sizeof(zeros) ? len : sizeof(zeros));
+            }
+            break;
+        case dxl_proto::WRITE:
+        case dxl_proto::PING:
+            if (index_[p.id] >= 0) {
+                respond(p.id, nullptr, 0);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return length;
+}
+
+void ReplayPort::respond(uint8_t id, const uint8_t* data, size_t data_len) {
+    if (rx_len_ + data_len + REPLAY_STATUS_MAX > rx_.size()) {
+        return;  // 用意できない分は応答しない（受信側はタイムアウトになる）
+    }
+    rx_len_ += dxl_proto::buildStatusPacket(&rx_[rx_len_], id, 0, data, data_len);
+}
+
+void ReplayPort::handleSyncRead(const dxl_proto::Packet& packet) {
+    if (packet.param_len < 5) {
+        return;
+    }
+    uint16_t address = get16(packet.params);
+    uint16_t length = get16(packet.params + 2);
+    if (address < Telemetry::address || address + length > Telemetry::address + Telemetry::length) {
+        return;  // 記録していない範囲は誰も応答しない
+    }
+    // 要求されたIDの順に応答する
+    for (size_t k = 4; k < packet.param_len; k++) {
+        int16_t i = index_[packet.params[k]];
+        if (i < 0) {
+            continue;
+        }
+        uint8_t block[Telemetry::length];
+        memcpy(block + Telemetry::offset<xm430::PresentCurrent>(), &current_[i], sizeof(int16_t));
+        memcpy(block + Telemetry::offset<xm430::PresentVelocity>(), &velocity_[i], sizeof(int32_t));
+        memcpy(block + Telemetry::offset<xm430::PresentPosition>(), &position_[i], sizeof(int32_t));
+        respond(packet.params[k], block + (address - Telemetry::address), length);
+    }
+}
+
+void ReplayPort::handleSyncWrite(const dxl_proto::Packet& packet) {
+    if (packet.param_len < 4) {
+        return;
+    }
+    uint16_t address = get16(packet.params);
+    uint16_t length = get16(packet.params + 2);
+    if (address != xm430::Command::address || length != xm430::Command::length) {
+        return;
+    }
+    for (size_t k = 4; k + 1 + length <= packet.param_len; k += 1 + length) {
+        int16_t i = index_[packet.params[k]];
+        if (i >= 0) {
+            goal_current_[i] = xm430::Command::decode<xm430::GoalCurrent>(packet.params + k + 1);
+        }
+    }
+}
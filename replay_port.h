@@ -0,0 +1,67 @@
+#ifndef REPLAY_PORT_H_
+#define REPLAY_PORT_H_
+
+#include "dynamixel_sdk.h"
+#include "dxl_protocol.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// 記録したテレメトリを返すだけのポート（実機もシミュレータも使わずに制御コードを回す）。
+// 書かれたインストラクションパケットをその場で解釈し、
+//   Sync Read（126..135） : setFrame() で渡した値のステータスパケットを ids の順に返す
+//   Sync Write（102）     : 目標電流を goalCurrent() に取っておく
+//   Read / Write          : エラーなし・データ0 の応答を返す（モーターの設定用）
+// 応答は writePort() の時点で全部用意するので待ち時間は無く、読み切ったら即タイムアウトにする。
+// 周期中はヒープ確保をしない。
+class ReplayPort : public dynamixel::PortHandler {
+public:
+    explicit ReplayPort(const std::vector<uint8_t>& ids);
+
+    // 次の Sync Read で返す値（ids の並び）
+    void setFrame(const int16_t* current, const int32_t* velocity, const int32_t* position);
+
+    // 直前の Sync Write で受け取った目標電流（ids の並び）
+    int16_t goalCurrent(size_t i) const { return goal_current_[i]; }
+    const int16_t* goalCurrents() const { return goal_current_.data(); }
+
+    // 受け取ったインストラクションパケットの数
+    uint64_t transactions() const { return transactions_; }
+
+    bool openPort() override { return true; }
+    void closePort() override {}
+    void clearPort() override { rx_len_ = rx_pos_ = 0; }
+    void setPortName(const char*) override {}
+    char* getPortName() override { return name_; }
+    bool setBaudRate(const int baudrate) override { baudrate_ = baudrate; return true; }
+    int getBaudRate() override { return baudrate_; }
+    int getBytesAvailable() override { return static_cast<int>(rx_len_ - rx_pos_); }
+    int readPort(uint8_t* packet, int length) override;
+    int writePort(uint8_t* packet, int length) override;
+    void setPacketTimeout(uint16_t) override {}
+    void setPacketTimeout(double) override {}
+    bool isPacketTimeout() override { return rx_pos_ >= rx_len_; }
+
+private:
+    void respond(uint8_t id, const uint8_t* data, size_t data_len);
+    void handleSyncRead(const dxl_proto::Packet& packet);
+    void handleSyncWrite(const dxl_proto::Packet& packet);
+
+    std::vector<uint8_t> ids_;
+    int16_t index_[256];                 // ID → ids_ の位置（無ければ -1）
+    std::vector<int16_t> current_;
+    std::vector<int32_t> velocity_;
+    std::vector<int32_t> position_;
+    std::vector<int16_t> goal_current_;
+    uint64_t transactions_;
+    int baudrate_;
+    char name_[8];
+
+    dxl_proto::PacketParser parser_;
+    std::vector<uint8_t> rx_;            // 用意した応答（ステータスパケットの列）
+    size_t rx_len_;
+    size_t rx_pos_;
+};
+
+#endif  // REPLAY_PORT_H_
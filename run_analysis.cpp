@@ -0,0 +1,431 @@
+#include "run_analysis.h"
+#include "trajectory.h"
+#include "xm430_registers.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <thread>
+
+namespace {
+
+const double POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// 10進数（符号・小数点・指数つき）を1つ読む。strtod と違いロケールを見ず、区切り文字の手前で止まる。
+// 仮数は19桁まで整数で持ち、10の累乗は |指数| <= 22 なら表から取るので、ログに出てくる値は正確に戻る。
+bool parseNumber(const char*& p, const char* end, double& value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    for (; p < end && isDigit(*p); p++, any = true) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && isDigit(*p); p++, any = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (!any) {
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool exp_negative = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            exp_negative = *q == '-';
+            q++;
+        }
+        if (q >= end || !isDigit(*q)) {
+            return false;
+        }
+        int e = 0;
+        for (; q < end && isDigit(*q); q++) {
+            if (e < 10000) e = e * 10 + (*q - '0');
+        }
+        exponent += exp_negative ? -e : e;
+        p = q;
+    }
+
+    double v = static_cast<double>(mantissa);
+    if (exponent >= 0 && exponent <= 22) {
+        v *= POW10[exponent];
+    } else if (exponent < 0 && exponent >= -22) {
+        v /= POW10[-exponent];
+    } else {
+        v *= std::pow(10.0, exponent);
+    }
+    value = negative ? -v : v;
+    return true;
+}
+
+// 1行分の数値を fields に読み、読めた列数を返す（max_fields を超える列は読み飛ばす）。
+// 数値として読めない列があれば bad を立てる。p は次の行の先頭に進める。
+int parseRow(const char*& p, const char* end, double* fields, int max_fields, bool& bad) {
+    int n = 0;
+    bad = false;
+    while (true) {
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        if (n < max_fields) {
+            if (!parseNumber(p, end, fields[n])) {
+                bad = true;
+                break;
+            }
+            n++;
+        } else {
+            while (p < end && *p != ',' && *p != '\n') p++;
+        }
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        if (p < end && *p == ',') {
+            p++;
+            continue;
+        }
+        if (p < end && *p != '\n') {
+            bad = true;
+        }
+        break;
+    }
+    const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+    p = nl ? nl + 1 : end;
+    return n;
+}
+
+bool startsWith(const char* p, const char* end, const char* prefix) {
+    size_t len = strlen(prefix);
+    return static_cast<size_t>(end - p) >= len && memcmp(p, prefix, len) == 0;
+}
+
+}  // namespace
+
+RunAnalyzer::RunAnalyzer(const AnalysisOptions& options) : options_(options) {}
+
+void RunAnalyzer::clearSamples(uint32_t num_motors) {
+    time_.clear();
+    for (uint32_t m = 0; m < num_motors; m++) {
+        position_[m].clear();
+        current_[m].clear();
+    }
+}
+
+bool RunAnalyzer::loadCsv(const std::string& path, RunStats& stats) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        stats.error = std::string("cannot open: ") + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        stats.error = std::string("cannot stat: ") + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    buffer_.resize(static_cast<size_t>(st.st_size));
+    size_t done = 0;
+    while (done < buffer_.size()) {
+        ssize_t n = ::read(fd, &buffer_[done], buffer_.size() - done);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    buffer_.resize(done);
+    stats.bytes = done;
+
+    const char* p = buffer_.data();
+    const char* end = p + buffer_.size();
+    const char* header_end = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (!header_end) header_end = end;
+
+    // 見出し行で列構成を決める（binlog.h の BinLogLayout と同じ2種類）
+    if (startsWith(p, header_end, "Time(s)")) {
+        stats.layout = LAYOUT_ANGLE_CURRENT;
+        size_t columns = 1 + std::count(p, header_end, ',');
+        stats.num_motors = static_cast<uint32_t>(std::min<size_t>((columns - 1) / 2, LOG_MAX_MOTORS));
+    } else if (startsWith(p, header_end, "Time (s)")) {
+        stats.layout = LAYOUT_CURRENT_DATA;
+        stats.num_motors = 1;
+    } else {
+        stats.error = "unknown header (expected angle_current or current_data columns)";
+        return false;
+    }
+    if (stats.num_motors == 0) {
+        stats.error = "no motor columns";
+        return false;
+    }
+    p = header_end < end ? header_end + 1 : end;
+
+    clearSamples(stats.num_motors);
+    const int expected = 1 + 2 * static_cast<int>(stats.num_motors);
+    double fields[1 + 2 * LOG_MAX_MOTORS];
+    while (p < end) {
+        if (*p == '\n' || *p == '\r') {
+            p++;
+            continue;
+        }
+        bool bad = false;
+        int n = parseRow(p, end, fields, expected, bad);
+        if (bad || n < expected) {
+            stats.bad_rows++;
+            continue;
+        }
+        double t = fields[0];
+        if (!time_.empty()) {
+            if (t == time_.back()) {
+                stats.duplicates++;
+                continue;
+            }
+            if (t < time_.back()) {
+                stats.bad_rows++;
+                continue;
+            }
+        }
+        time_.push_back(t);
+        for (uint32_t m = 0; m < stats.num_motors; m++) {
+            // current_data は 時刻, 電流, 位置 の順。電流はどちらも Present Current の生の値
+            double position = stats.layout == LAYOUT_CURRENT_DATA ? fields[2] : fields[1 + 2 * m];
+            double current = stats.layout == LAYOUT_CURRENT_DATA ? fields[1] : fields[2 + 2 * m];
+            position_[m].push_back(static_cast<int32_t>(position));
+            current_[m].push_back(static_cast<int16_t>(current));
+        }
+    }
+    return true;
+}
+
+bool RunAnalyzer::loadBin(const std::string& path, RunStats& stats) {
+    BinLogReader reader;
+    if (!reader.open(path)) {
+        stats.error = reader.error();
+        return false;
+    }
+    const BinLogHeader& header = reader.header();
+    stats.layout = static_cast<BinLogLayout>(header.layout);
+    stats.num_motors = header.num_motors;
+    stats.bytes = header.header_size + reader.size() * header.record_size;
+    if (stats.num_motors == 0) {
+        stats.error = "no motor columns";
+        return false;
+    }
+
+    clearSamples(stats.num_motors);
+    for (size_t i = 0; i < reader.size(); i++) {
+        BinLogReader::Record r = reader.record(i);
+        double t = r.t_ns * 1e-9;
+        if (!time_.empty() && t <= time_.back()) {
+            if (t == time_.back()) {
+                stats.duplicates++;
+            } else {
+                stats.bad_rows++;
+            }
+            continue;
+        }
+        time_.push_back(t);
+        for (uint32_t m = 0; m < stats.num_motors; m++) {
+            position_[m].push_back(r.position[m]);
+            current_[m].push_back(r.current[m]);
+        }
+    }
+    return true;
+}
+
+void RunAnalyzer::computeStats(RunStats& stats) {
+    const size_t n = time_.size();
+    stats.rows = n;
+
+    // サンプル間隔：中央値を公称周期とし、標準偏差をジッタ、中央値の ANALYSIS_GAP_FACTOR 倍を超えた分を取りこぼしとする
+    if (n >= 2) {
+        intervals_.clear();
+        double sum = 0.0;
+        double max_gap = 0.0;
+        for (size_t i = 1; i < n; i++) {
+            double dt = time_[i] - time_[i - 1];
+            intervals_.push_back(dt);
+            sum += dt;
+            max_gap = std::max(max_gap, dt);
+        }
+        double mean = sum / intervals_.size();
+        double var = 0.0;
+        for (double dt : intervals_) {
+            var += (dt - mean) * (dt - mean);
+        }
+        std::nth_element(intervals_.begin(), intervals_.begin() + intervals_.size() / 2, intervals_.end());
+        double median = intervals_[intervals_.size() / 2];
+        if (median > 0.0) {
+            for (double dt : intervals_) {
+                if (dt > ANALYSIS_GAP_FACTOR * median) {
+                    stats.dropped += static_cast<size_t>(std::lround(dt / median)) - 1;
+                }
+            }
+        }
+        stats.period_ms = median * 1e3;
+        stats.jitter_ms = std::sqrt(var / intervals_.size()) * 1e3;
+        stats.max_gap_ms = max_gap * 1e3;
+    }
+
+    // 追従誤差：最初のサンプルの位置を開始位置として、制御プログラムと同じ線形軌道を引き直す
+    const bool angle = stats.layout == LAYOUT_ANGLE_CURRENT;
+    const double duration =
+        options_.duration > 0.0 ? options_.duration : (angle ? ANALYSIS_ANGLE_DURATION : ANALYSIS_CURRENT_DURATION);
+    const int32_t move = options_.move_ticks != 0 ? options_.move_ticks : ANALYSIS_MOVE_TICKS;
+    const double band = options_.settle_band_deg / xm430::PresentPosition::unit;
+    for (uint32_t m = 0; m < stats.num_motors; m++) {
+        MotorStats& ms = stats.motor[m];
+        ms = MotorStats{0.0, 0.0, -1.0, 0.0};
+        if (n == 0) {
+            continue;
+        }
+        const std::vector<int32_t>& position = position_[m];
+        const std::vector<int16_t>& current = current_[m];
+        int32_t start = position[0];
+        int32_t goal = start + (angle && m % 2 == 1 ? -move : move);
+
+        double err_sq = 0.0;
+        double err_max = 0.0;
+        double cur_sq = 0.0;
+        size_t settled_from = 0;
+        for (size_t i = 0; i < n; i++) {
+            double err = position[i] - calculateTargetPosition(start, goal, time_[i], duration);
+            err_sq += err * err;
+            err_max = std::max(err_max, std::fabs(err));
+            cur_sq += static_cast<double>(current[i]) * current[i];
+            if (std::abs(position[i] - goal) > band) {
+                settled_from = i + 1;
+            }
+        }
+        ms.error_rms_deg = std::sqrt(err_sq / n) * xm430::PresentPosition::unit;
+        ms.error_max_deg = err_max * xm430::PresentPosition::unit;
+        ms.settle_s = settled_from < n ? time_[settled_from] : -1.0;
+        ms.current_rms_ma = std::sqrt(cur_sq / n) * xm430::PresentCurrent::unit;
+    }
+}
+
+bool RunAnalyzer::load(const std::string& path, RunStats& stats) {
+    stats = RunStats();
+    stats.path = path;
+    size_t dot = path.rfind('.');
+    bool binary = dot != std::string::npos && path.compare(dot, std::string::npos, ".bin") == 0;
+    stats.ok = binary ? loadBin(path, stats) : loadCsv(path, stats);
+    return stats.ok;
+}
+
+void RunAnalyzer::analyze(const std::string& path, RunStats& stats) {
+    if (load(path, stats)) {
+        computeStats(stats);
+    }
+}
+
+std::vector<std::string> collectRunLogs(const std::vector<std::string>& args) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> paths;
+    for (const std::string& arg : args) {
+        std::error_code ec;
+        if (!fs::is_directory(arg, ec)) {
+            paths.push_back(arg);
+            continue;
+        }
+        size_t first = paths.size();
+        for (const fs::directory_entry& entry : fs::directory_iterator(arg, ec)) {
+            std::string ext = entry.path().extension().string();
+            if (entry.is_regular_file(ec) && (ext == ".csv" || ext == ".bin")) {
+                paths.push_back(entry.path().string());
+            }
+        }
+        std::sort(paths.begin() + first, paths.end());
+    }
+    return paths;
+}
+
+void analyzeRuns(const std::vector<std::string>& paths, const AnalysisOptions& options, int threads,
+                 std::vector<RunStats>& results) {
+    results.assign(paths.size(), RunStats());
+    if (threads <= 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    threads = static_cast<int>(std::min<size_t>(threads, std::max<size_t>(paths.size(), 1)));
+
+    // ファイル単位で取り合う（ファイルごとの大きさがばらついても偏らない）
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        RunAnalyzer analyzer(options);
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            analyzer.analyze(paths[i], results[i]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : workers) {
+        t.join();
+    }
+}
+
+void printRunTable(FILE* fp, const std::vector<RunStats>& results) {
+    fprintf(fp, "%-40s %2s %6s %4s %4s %4s %10s %10s %8s %12s %12s %9s %9s\n", "run", "m", "rows", "dup", "drop",
+            "bad", "period[ms]", "jitter[ms]", "gap[ms]", "err_rms[deg]", "err_max[deg]", "settle[s]", "I_rms[mA]");
+    for (const RunStats& r : results) {
+        if (!r.ok) {
+            fprintf(fp, "%-40s error: %s\n", r.path.c_str(), r.error.c_str());
+            continue;
+        }
+        for (uint32_t m = 0; m < r.num_motors; m++) {
+            const MotorStats& ms = r.motor[m];
+            fprintf(fp, "%-40s %2u %6zu %4zu %4zu %4zu %10.2f %10.2f %8.2f %12.2f %12.2f ", r.path.c_str(), m + 1,
+                    r.rows, r.duplicates, r.dropped, r.bad_rows, r.period_ms, r.jitter_ms, r.max_gap_ms,
+                    ms.error_rms_deg, ms.error_max_deg);
+            if (ms.settle_s >= 0.0) {
+                fprintf(fp, "%9.3f", ms.settle_s);
+            } else {
+                fprintf(fp, "%9s", "-");
+            }
+            fprintf(fp, " %9.1f\n", ms.current_rms_ma);
+        }
+    }
+}
+
+bool writeRunCsv(const std::string& path, const std::vector<RunStats>& results) {
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        return false;
+    }
+    fprintf(fp, "run,motor,rows,duplicates,dropped,bad_rows,period_ms,jitter_ms,max_gap_ms,"
+                "error_rms_deg,error_max_deg,settle_s,current_rms_ma,error\n");
+    for (const RunStats& r : results) {
+        if (!r.ok) {
+            fprintf(fp, "%s,,,,,,,,,,,,,%s\n", r.path.c_str(), r.error.c_str());
+            continue;
+        }
+        for (uint32_t m = 0; m < r.num_motors; m++) {
+            const MotorStats& ms = r.motor[m];
+            fprintf(fp, "%s,%u,%zu,%zu,%zu,%zu,%g,%g,%g,%g,%g,%g,%g,\n", r.path.c_str(), m + 1, r.rows,
+                    r.duplicates, r.dropped, r.bad_rows, r.period_ms, r.jitter_ms, r.max_gap_ms, ms.error_rms_deg,
+                    ms.error_max_deg, ms.settle_s, ms.current_rms_ma);
+        }
+    }
+    return fclose(fp) == 0;
+}
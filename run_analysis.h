@@ -0,0 +1,91 @@
+#ifndef RUN_ANALYSIS_H_
+#define RUN_ANALYSIS_H_
+
+#include "async_logger.h"
+#include "binlog.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// 走行ログ（angle_current/*.csv, current_data/*.csv, DXL_LOG_FORMAT=binary の .bin）のオフライン解析。
+// 目標軌道は制御プログラムと同じ calculateTargetPosition で作り直して追従誤差を求める。
+//   angle_current : duration 1秒, 偶数番目のモーターは +1024, 奇数番目は -1024（current_control2）
+//   current_data  : duration 3秒, +1024（current）
+#define ANALYSIS_MOVE_TICKS           1024    // 90度
+#define ANALYSIS_ANGLE_DURATION       1.0
+#define ANALYSIS_CURRENT_DURATION     3.0
+#define ANALYSIS_SETTLE_BAND_DEG      1.0     // 目標位置からこの範囲に入ったまま出なければ整定とみなす
+#define ANALYSIS_GAP_FACTOR           1.5     // 周期の中央値のこの倍を超えた間隔は取りこぼしとみなす
+
+struct AnalysisOptions {
+    double duration = 0.0;             // 軌道の所要時間 [s]（0 ならレイアウトごとの既定値）
+    int32_t move_ticks = 0;            // 移動量（0 なら ANALYSIS_MOVE_TICKS）
+    double settle_band_deg = ANALYSIS_SETTLE_BAND_DEG;
+};
+
+struct MotorStats {
+    double error_rms_deg;              // 追従誤差（位置 - 目標位置）の二乗平均平方根
+    double error_max_deg;
+    double settle_s;                   // 整定時刻（最後まで整定しなければ -1）
+    double current_rms_ma;
+};
+
+struct RunStats {
+    std::string path;
+    bool ok = false;
+    std::string error;
+    BinLogLayout layout = LAYOUT_ANGLE_CURRENT;
+    uint32_t num_motors = 0;
+    size_t bytes = 0;
+    size_t rows = 0;                   // 解析に使った行数
+    size_t duplicates = 0;             // 直前の行と同じ時刻の行（読み飛ばす）
+    size_t dropped = 0;                // 間隔から推定した取りこぼしサンプル数
+    size_t bad_rows = 0;               // 列が足りない・数値でない・時刻が戻っている行
+    double period_ms = 0.0;            // サンプル間隔の中央値
+    double jitter_ms = 0.0;            // サンプル間隔の標準偏差
+    double max_gap_ms = 0.0;
+    MotorStats motor[LOG_MAX_MOTORS];
+};
+
+// 1ファイルずつ解析する。読み込み用のバッファを使い回すので、スレッドごとに1つ持つ
+class RunAnalyzer {
+public:
+    explicit RunAnalyzer(const AnalysisOptions& options);
+
+    void analyze(const std::string& path, RunStats& stats);
+
+    // 読み込むだけで統計は出さない（重複・不正な行は除いてある）。読めた標本は下のアクセサで参照する
+    bool load(const std::string& path, RunStats& stats);
+    const std::vector<double>& times() const { return time_; }
+    const std::vector<int32_t>& positions(size_t m) const { return position_[m]; }
+    const std::vector<int16_t>& currents(size_t m) const { return current_[m]; }
+
+private:
+    bool loadCsv(const std::string& path, RunStats& stats);
+    bool loadBin(const std::string& path, RunStats& stats);
+    void clearSamples(uint32_t num_motors);
+    void computeStats(RunStats& stats);
+
+    AnalysisOptions options_;
+    std::string buffer_;
+    std::vector<double> time_;
+    std::vector<int32_t> position_[LOG_MAX_MOTORS];
+    std::vector<int16_t> current_[LOG_MAX_MOTORS];
+    std::vector<double> intervals_;
+};
+
+// 引数のファイルとディレクトリ直下の .csv / .bin を集めて名前順に並べる
+std::vector<std::string> collectRunLogs(const std::vector<std::string>& args);
+
+// threads 本のワーカーで1ファイルずつ並列に解析する（results は paths と同じ順）
+void analyzeRuns(const std::vector<std::string>& paths, const AnalysisOptions& options, int threads,
+                 std::vector<RunStats>& results);
+
+// 1行1モーターのまとめ表
+void printRunTable(FILE* fp, const std::vector<RunStats>& results);
+bool writeRunCsv(const std::string& path, const std::vector<RunStats>& results);
+
+#endif  // RUN_ANALYSIS_H_
@@ -0,0 +1,208 @@
+#include "run_config.h"
+#include "axis_controller.h"  // parseIdList
+
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+bool parseDouble(const std::string& text, double& value) {
+    char* end = nullptr;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && end && *end == '\0';
+}
+
+bool parseCurrent(const std::string& text, int16_t& value) {
+    char* end = nullptr;
+    long v = strtol(text.c_str(), &end, 10);
+    if (text.empty() || !end || *end != '\0' || v < -2048 || v > 2047) {
+        return false;
+    }
+    value = static_cast<int16_t>(v);
+    return true;
+}
+
+}  // namespace
+
+bool applyRunSetting(RunConfig& config, const std::string& key, const std::string& value) {
+    if (key == "ids") {
+        config.ids = parseIdList(value);
+        return !config.ids.empty();
+    }
+    if (key == "max_current") return parseCurrent(value, config.max_current);
+    if (key == "min_current") return parseCurrent(value, config.min_current);
+
+    double* target = nullptr;
+    if (key == "kp") target = &config.kp;
+    else if (key == "ki") target = &config.ki;
+    else if (key == "kd") target = &config.kd;
+    else if (key == "tf") target = &config.tf;
+    else if (key == "duration") target = &config.duration;
+    else if (key == "amplitude_deg") target = &config.amplitude_deg;
+    else if (key == "period_ms") target = &config.period_ms;
+    else if (key == "return_s") target = &config.return_s;
+    if (!target) {
+        return false;
+    }
+    double v;
+    if (!parseDouble(value, v)) {
+        return false;
+    }
+    if ((key == "duration" && !(v > 0.0)) || ((key == "period_ms" || key == "return_s") && v < 0.0)) {
+        return false;
+    }
+    *target = v;
+    return true;
+}
+
+bool loadRunConfig(const std::string& path, RunConfig& base, std::vector<SweepAxis>& sweep) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open config file: " << path << std::endl;
+        return false;
+    }
+    sweep.clear();
+    std::string section = "run";
+    std::string line;
+    int number = 0;
+    while (std::getline(file, line)) {
+        number++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) {
+            line.erase(hash);
+        }
+        line = trim(line);
+        if (line.empty()) {
+            continue;
+        }
+        if (line.front() == '[' && line.back() == ']') {
+            section = trim(line.substr(1, line.size() - 2));
+            if (section != "run" && section != "sweep") {
+                std::cerr << path << ":" << number << ": unknown section [" << section << "]" << std::endl;
+                return false;
+            }
+            continue;
+        }
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            std::cerr << path << ":" << number << ": expected key = value" << std::endl;
+            return false;
+        }
+        std::string key = trim(line.substr(0, eq));
+        std::string value = trim(line.substr(eq + 1));
+
+        if (section == "run") {
+            if (!applyRunSetting(base, key, value)) {
+                std::cerr << path << ":" << number << ": bad setting '" << key << " = " << value << "'" << std::endl;
+                return false;
+            }
+            continue;
+        }
+
+        // [sweep]: 値ごとに試しに反映して、読めるか先に確かめる
+        SweepAxis axis;
+        axis.key = key;
+        std::stringstream ss(value);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            item = trim(item);
+            RunConfig probe = base;
+            if (key == "ids" || !applyRunSetting(probe, key, item)) {
+                std::cerr << path << ":" << number << ": bad sweep value '" << key << " = " << item << "'" << std::endl;
+                return false;
+            }
+            axis.values.push_back(item);
+        }
+        if (axis.values.empty()) {
+            std::cerr << path << ":" << number << ": no values for sweep key '" << key << "'" << std::endl;
+            return false;
+        }
+        sweep.push_back(axis);
+    }
+    return true;
+}
+
+std::vector<RunConfig> expandSweep(const RunConfig& base, const std::vector<SweepAxis>& sweep) {
+    size_t total = 1;
+    for (const SweepAxis& axis : sweep) {
+        total *= axis.values.size();
+    }
+    std::vector<RunConfig> runs;
+    runs.reserve(total);
+    for (size_t n = 0; n < total; n++) {
+        // n を各キーの値の番号に分ける（最後のキーが一番速く変わる）
+        RunConfig config = base;
+        std::string label;
+        size_t rest = n;
+        std::vector<size_t> index(sweep.size());
+        for (size_t k = sweep.size(); k-- > 0;) {
+            index[k] = rest % sweep[k].values.size();
+            rest /= sweep[k].values.size();
+        }
+        for (size_t k = 0; k < sweep.size(); k++) {
+            const std::string& value = sweep[k].values[index[k]];
+            applyRunSetting(config, sweep[k].key, value);
+            label += (label.empty() ? "" : "_") + sweep[k].key + value;
+        }
+        config.label = label;
+        runs.push_back(config);
+    }
+    return runs;
+}
+
+bool runConfigsFromEnv(const RunConfig& defaults, std::vector<RunConfig>& runs) {
+    runs.clear();
+    const char* env = getenv("DXL_CONFIG");
+    if (!env || !*env) {
+        runs.push_back(defaults);
+        return true;
+    }
+    RunConfig base = defaults;
+    std::vector<SweepAxis> sweep;
+    if (!loadRunConfig(env, base, sweep)) {
+        return false;
+    }
+    runs = expandSweep(base, sweep);
+    return true;
+}
+
+bool RunIndex::open(const std::string& path) {
+    file_.open(path);
+    if (!file_) {
+        return false;
+    }
+    file_ << "Run,Label,Log,IDs,Kp,Ki,Kd,Tf,MaxCurrent,MinCurrent,Duration,AmplitudeDeg,PeriodMs,"
+             "Cycles,Overruns,TrackingRmsDeg,TrackingMaxDeg,Stopped\n";
+    file_.flush();
+    return true;
+}
+
+void RunIndex::add(size_t run, const RunConfig& config, const RunResult& result) {
+    if (!file_) {
+        return;
+    }
+    std::string stopped = result.stop_reason;
+    for (char& c : stopped) {
+        if (c == ',') c = ';';
+    }
+    std::string ids;
+    for (uint8_t id : config.ids) {
+        ids += (ids.empty() ? "" : " ") + std::to_string(id);
+    }
+    file_ << run << "," << config.label << "," << result.log_path << "," << ids << "," << config.kp << ","
+          << config.ki << "," << config.kd << "," << config.tf << "," << config.max_current << ","
+          << config.min_current << "," << config.duration << "," << config.amplitude_deg << "," << config.period_ms
+          << "," << result.cycles << "," << result.overruns << "," << result.rms_deg << "," << result.max_deg << ","
+          << stopped << "\n";
+    file_.flush();
+}
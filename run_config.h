@@ -0,0 +1,80 @@
+#ifndef RUN_CONFIG_H_
+#define RUN_CONFIG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// 1回の走行の条件（ゲイン・電流の上限・動作時間・振幅・周期）。
+// 設定ファイル（INI 形式）の [run] に書いた値で既定値を上書きし、[sweep] に書いた値の全組み合わせを順に走らせる。
+//   [run]
+//   ids = 1,2
+//   kp = 5.0
+//   kd = 0.5
+//   max_current = 500
+//   duration = 1.0
+//   amplitude_deg = 90
+//
+//   [sweep]                  # 値はカンマ区切り。キーごとの値の直積を、後ろのキーから先に回す
+//   kp = 2, 5, 10
+//   max_current = 200, 500
+// キー: ids kp ki kd tf max_current min_current duration amplitude_deg period_ms return_s（ids は [sweep] に書けない）
+// # 以降は注釈。
+struct RunConfig {
+    std::string label;              // [sweep] の値を並べた名前（例: "kp5_max_current200"）。1回だけなら空
+    std::vector<uint8_t> ids;
+    double kp = 0.0;
+    double ki = 0.0;
+    double kd = 0.0;
+    double tf = 0.0;                // 微分フィルタの時定数 [s]
+    int16_t max_current = 0;
+    int16_t min_current = 0;
+    double duration = 1.0;          // 動作時間 [s]（軌道がこれより長ければ軌道の長さ）
+    double amplitude_deg = 90.0;    // 動かす角度（偶数番目は +、奇数番目は -）
+    double period_ms = 0.0;         // 制御周期 [ms]（0 なら DXL_PERIOD_MS・プログラムの既定）
+    double return_s = 1.0;          // 次の走行の前に開始位置へ戻す時間 [s]
+};
+
+// [sweep] の1行（キーと、順に試す値）
+struct SweepAxis {
+    std::string key;
+    std::vector<std::string> values;
+};
+
+// key = value を config に反映する。知らないキー・読めない値なら false
+bool applyRunSetting(RunConfig& config, const std::string& key, const std::string& value);
+
+// 設定ファイルを読み、[run] を base に反映して [sweep] を sweep に返す。
+// 読めない行があれば「ファイル名:行番号」をつけて std::cerr に出し false
+bool loadRunConfig(const std::string& path, RunConfig& base, std::vector<SweepAxis>& sweep);
+
+// sweep の全組み合わせ（sweep が空なら base の1つだけ）。各要素の label に組み合わせの名前を入れる
+std::vector<RunConfig> expandSweep(const RunConfig& base, const std::vector<SweepAxis>& sweep);
+
+// 環境変数 DXL_CONFIG=<file.ini> があれば読んで展開し、無ければ defaults の1回だけを runs に返す。
+// 読めなければ false
+bool runConfigsFromEnv(const RunConfig& defaults, std::vector<RunConfig>& runs);
+
+// 1回の走行の結果（スイープの一覧に書く）
+struct RunResult {
+    std::string log_path;
+    uint64_t cycles = 0;
+    uint64_t overruns = 0;
+    double rms_deg = 0.0;           // 追従誤差の二乗平均平方根
+    double max_deg = 0.0;
+    std::string stop_reason;        // 途中で止まったときの理由（最後まで走れば空）
+};
+
+// スイープの一覧（CSV。1行1走行で、条件・ログのパス・結果を並べる）。書くたびにフラッシュする
+class RunIndex {
+public:
+    bool open(const std::string& path);
+    void add(size_t run, const RunConfig& config, const RunResult& result);
+
+private:
+    std::ofstream file_;
+};
+
+#endif  // RUN_CONFIG_H_
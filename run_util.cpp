@@ -0,0 +1,31 @@
+#include "run_util.h"
+
+#include <termios.h>
+#include <unistd.h>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+std::string currentTimestamp() {
+    auto now = std::chrono::system_clock::now();
+    auto in_time_t = std::chrono::system_clock::to_time_t(now);
+    std::tm buf;
+    localtime_r(&in_time_t, &buf);
+
+    std::ostringstream oss;
+    oss << std::put_time(&buf, "%Y%m%d%H%M%S");
+    return oss.str();
+}
+
+void setTerminalMode(bool enable) {
+    static struct termios oldt, newt;
+    if (enable) {
+        tcgetattr(STDIN_FILENO, &oldt);
+        newt = oldt;
+        newt.c_lflag &= ~(ICANON | ECHO);
+        tcsetattr(STDIN_FILENO, TCSANOW, &newt);
+    } else {
+        tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
+    }
+}
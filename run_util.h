@@ -0,0 +1,12 @@
+#ifndef RUN_UTIL_H_
+#define RUN_UTIL_H_
+
+#include <string>
+
+// 現在時刻を YYYYMMDDHHMMSS 形式で返す（ログファイル名用）
+std::string currentTimestamp();
+
+// 端末をエコーなし・行バッファなしにする（false で元に戻す）。キー1つで ControlRuntime の停止要求になる
+void setTerminalMode(bool enable);
+
+#endif  // RUN_UTIL_H_
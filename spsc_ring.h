@@ -0,0 +1,90 @@
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+
+// 単一プロデューサ・単一コンシューマのロックフリーリングバッファ。
+// 容量は構築時に2のべき乗へ切り上げて確保し、以後メモリ確保は行わない。
+// push() は制御スレッド、pop()/popBatch() はロガースレッドからのみ呼ぶこと。
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity)
+        : capacity_(roundUpPow2(capacity < 2 ? 2 : capacity)),
+          mask_(capacity_ - 1),
+          buf_(new T[capacity_]),
+          head_(0),
+          cached_tail_(0),
+          tail_(0),
+          cached_head_(0) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // 満杯なら false（呼び出し側でドロップ扱いにする）
+    bool push(const T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - cached_tail_ >= capacity_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head - cached_tail_ >= capacity_) {
+                return false;
+            }
+        }
+        buf_[head & mask_] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        return popBatch(&item, 1) == 1;
+    }
+
+    // 最大 max_items 個をまとめて取り出し、取り出した数を返す
+    size_t popBatch(T* out, size_t max_items) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (cached_head_ == tail) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (cached_head_ == tail) {
+                return 0;
+            }
+        }
+        size_t n = cached_head_ - tail;
+        if (n > max_items) {
+            n = max_items;
+        }
+        for (size_t i = 0; i < n; i++) {
+            out[i] = buf_[(tail + i) & mask_];
+        }
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    static size_t roundUpPow2(size_t n) {
+        size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<T[]> buf_;
+
+    // プロデューサとコンシューマの変数は別キャッシュラインに置く（false sharing 防止）
+    alignas(64) std::atomic<size_t> head_;
+    size_t cached_tail_;
+    alignas(64) std::atomic<size_t> tail_;
+    size_t cached_head_;
+};
+
+#endif  // SPSC_RING_H_
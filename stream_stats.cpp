@@ -0,0 +1,238 @@
+#include "stream_stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+P2Quantile::P2Quantile(double p) : p_(p), count_(0) {
+    for (int i = 0; i < 5; i++) {
+        height_[i] = 0.0;
+        position_[i] = i + 1;
+    }
+    desired_[0] = 1.0;
+    desired_[1] = 1.0 + 2.0 * p;
+    desired_[2] = 1.0 + 4.0 * p;
+    desired_[3] = 3.0 + 2.0 * p;
+    desired_[4] = 5.0;
+    increment_[0] = 0.0;
+    increment_[1] = p / 2.0;
+    increment_[2] = p;
+    increment_[3] = (1.0 + p) / 2.0;
+    increment_[4] = 1.0;
+}
+
+double P2Quantile::parabolic(int i, double d) const {
+    const double* q = height_;
+    const double* n = position_;
+    return q[i] + d / (n[i + 1] - n[i - 1]) *
+                      ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                       (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+}
+
+double P2Quantile::linear(int i, double d) const {
+    int j = i + static_cast<int>(d);
+    return height_[i] + d * (height_[j] - height_[i]) / (position_[j] - position_[i]);
+}
+
+void P2Quantile::add(double x) {
+    // 最初の5標本は並べて目印の初期値にする
+    if (count_ < 5) {
+        height_[count_++] = x;
+        if (count_ == 5) {
+            std::sort(height_, height_ + 5);
+        }
+        return;
+    }
+    count_++;
+
+    // x の入る区間 k を探し、それより右の目印の位置を1つずつ進める（端を超えたら端を広げる）
+    int k;
+    if (x < height_[0]) {
+        height_[0] = x;
+        k = 0;
+    } else if (x >= height_[4]) {
+        height_[4] = x;
+        k = 3;
+    } else {
+        k = 0;
+        while (k < 3 && x >= height_[k + 1]) {
+            k++;
+        }
+    }
+    for (int i = k + 1; i < 5; i++) {
+        position_[i] += 1.0;
+    }
+    for (int i = 0; i < 5; i++) {
+        desired_[i] += increment_[i];
+    }
+
+    // 中の3つの目印が理想の位置から1以上ずれたら、放物線（だめなら直線）で高さを直して1つ動かす
+    for (int i = 1; i <= 3; i++) {
+        double d = desired_[i] - position_[i];
+        if ((d >= 1.0 && position_[i + 1] - position_[i] > 1.0) || (d <= -1.0 && position_[i - 1] - position_[i] < -1.0)) {
+            d = d > 0.0 ? 1.0 : -1.0;
+            double q = parabolic(i, d);
+            if (height_[i - 1] < q && q < height_[i + 1]) {
+                height_[i] = q;
+            } else {
+                height_[i] = linear(i, d);
+            }
+            position_[i] += d;
+        }
+    }
+}
+
+double P2Quantile::value() const {
+    if (count_ >= 5) {
+        return height_[2];
+    }
+    if (count_ == 0) {
+        return 0.0;
+    }
+    double sorted[5];
+    std::copy(height_, height_ + count_, sorted);
+    std::sort(sorted, sorted + count_);
+    return sorted[static_cast<size_t>(p_ * (count_ - 1) + 0.5)];
+}
+
+StreamLimits streamLimitsFromEnv() {
+    StreamLimits limits;
+    if (const char* value = getenv("DXL_STOP_CURRENT")) {
+        limits.max_current = atof(value);
+    }
+    if (const char* value = getenv("DXL_STOP_ERROR_DEG")) {
+        limits.max_error_deg = atof(value);
+    }
+    if (const char* value = getenv("DXL_STOP_CYCLE_MS")) {
+        limits.max_cycle_ms = atof(value);
+    }
+    if (const char* value = getenv("DXL_STOP_WARMUP")) {
+        limits.warmup_cycles = static_cast<uint64_t>(atoll(value));
+    }
+    if (const char* value = getenv("DXL_STATUS_HZ")) {
+        limits.status_hz = atof(value);
+    } else if (isatty(STDOUT_FILENO)) {
+        limits.status_hz = STATS_STATUS_HZ;
+    }
+    return limits;
+}
+
+LoopStats::LoopStats(const std::vector<uint8_t>& ids, const StreamLimits& limits)
+    : ids_(ids),
+      limits_(limits),
+      joints_(ids.size()),
+      cycle_ewma_(STATS_CYCLE_TAU),
+      cycles_(0),
+      next_status_(0.0),
+      status_open_(false) {
+    stop_reason_[0] = '\0';
+}
+
+void LoopStats::addJoint(size_t i, double current, double error_deg, double dt) {
+    Joint& j = joints_[i];
+    double magnitude = fabs(error_deg);
+    j.current.add(current);
+    j.current_p50.add(current);
+    j.current_p95.add(current);
+    j.error.add(magnitude);
+    j.error_p50.add(magnitude);
+    j.error_p95.add(magnitude);
+    j.error_ewma.add(magnitude, dt);
+    j.current_peak = std::max(j.current_peak, fabs(current));
+
+    // 電流のスパイクは平均を取らずに1標本で止める
+    if (limits_.max_current > 0.0 && fabs(current) > limits_.max_current && stop_reason_[0] == '\0') {
+        snprintf(stop_reason_, sizeof(stop_reason_), "motor %d current %.0f over the limit %.0f",
+                 static_cast<int>(ids_[i]), current, limits_.max_current);
+    }
+}
+
+void LoopStats::addCycle(double body_s, double dt) {
+    cycles_++;
+    cycle_.add(body_s);
+    cycle_ewma_.add(body_s, dt);
+}
+
+bool LoopStats::check() {
+    if (stop_reason_[0] != '\0') {
+        return false;
+    }
+    if (cycles_ < limits_.warmup_cycles) {
+        return true;
+    }
+    if (limits_.max_error_deg > 0.0) {
+        for (size_t i = 0; i < joints_.size(); i++) {
+            double error = joints_[i].error_ewma.value();
+            if (joints_[i].error.count() > 0 && error > limits_.max_error_deg) {
+                snprintf(stop_reason_, sizeof(stop_reason_), "motor %d tracking error %.1f deg over %.1f",
+                         static_cast<int>(ids_[i]), error, limits_.max_error_deg);
+                return false;
+            }
+        }
+    }
+    if (limits_.max_cycle_ms > 0.0 && cycle_ewma_.value() * 1e3 > limits_.max_cycle_ms) {
+        snprintf(stop_reason_, sizeof(stop_reason_), "cycle time %.2f ms over %.2f",
+                 cycle_ewma_.value() * 1e3, limits_.max_cycle_ms);
+        return false;
+    }
+    return true;
+}
+
+void LoopStats::printStatus(double elapsed) {
+    if (limits_.status_hz <= 0.0 || elapsed < next_status_) {
+        return;
+    }
+    next_status_ = elapsed + 1.0 / limits_.status_hz;
+
+    // 1行を固定長のバッファに組み立て、行頭に戻って上書きする（幅が縮んでも残らないよう行末を消す）
+    char line[512];
+    int n = snprintf(line, sizeof(line), "\r[%6.2f s] cycle %.2f ms", elapsed, cycle_ewma_.value() * 1e3);
+    size_t shown = std::min(joints_.size(), static_cast<size_t>(STATS_STATUS_JOINTS));
+    for (size_t i = 0; i < shown && n > 0 && n < static_cast<int>(sizeof(line)); i++) {
+        const Joint& j = joints_[i];
+        n += snprintf(line + n, sizeof(line) - n, " | ID%d I %.0f (pk %.0f) err %.1f (p95 %.1f) deg",
+                      static_cast<int>(ids_[i]), j.current.mean(), j.current_peak, j.error_ewma.value(),
+                      j.error_p95.value());
+    }
+    if (n > 0 && n < static_cast<int>(sizeof(line))) {
+        n += snprintf(line + n, sizeof(line) - n, "\033[K");
+    }
+    if (n > 0) {
+        fwrite(line, 1, std::min(static_cast<size_t>(n), sizeof(line) - 1), stdout);
+        fflush(stdout);
+        status_open_ = true;
+    }
+}
+
+void LoopStats::endStatus() {
+    if (status_open_) {
+        fputs("\n", stdout);
+        fflush(stdout);
+        status_open_ = false;
+    }
+}
+
+void LoopStats::printReport(std::ostream& os) const {
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(1);
+    if (cycle_.count() > 0) {
+        os << "Loop body  [ms]  EWMA: " << cycle_ewma_.value() * 1e3 << "  mean: " << cycle_.mean() * 1e3
+           << "  sd: " << cycle_.stddev() * 1e3 << "  max: " << cycle_.max() * 1e3 << "\n";
+    }
+    for (size_t i = 0; i < joints_.size(); i++) {
+        const Joint& j = joints_[i];
+        os << "Stats ID " << static_cast<int>(ids_[i]) << ": ";
+        if (j.current.count() == 0) {
+            os << "no samples\n";
+            continue;
+        }
+        os << "current mean " << j.current.mean() << " sd " << j.current.stddev() << " p50 " << j.current_p50.value()
+           << " p95 " << j.current_p95.value() << " peak " << j.current_peak << "; |error| mean " << j.error.mean()
+           << " sd " << j.error.stddev() << " p50 " << j.error_p50.value() << " p95 " << j.error_p95.value()
+           << " max " << j.error.max() << " deg\n";
+    }
+    os.flags(flags);
+}
@@ -0,0 +1,154 @@
+#ifndef STREAM_STATS_H_
+#define STREAM_STATS_H_
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+#define STATS_ERROR_TAU               0.1    // 追従誤差の指数移動平均の時定数 [s]（発散の判定に使う）
+#define STATS_CYCLE_TAU               0.5    // 周期の処理時間の指数移動平均の時定数 [s]
+#define STATS_WARMUP_CYCLES           10     // 最初のこの周期数は止める判定をしない（起動直後の過渡を除く）
+#define STATS_STATUS_HZ               2.0    // 端末のときの状態行の既定の更新頻度 [Hz]
+#define STATS_STATUS_JOINTS           4      // 状態行に出す関節の数
+
+// Welford 法の平均・分散（最小・最大つき）。標本を持たないので記憶量は一定
+class RunningStats {
+public:
+    void add(double x) {
+        count_++;
+        double delta = x - mean_;
+        mean_ += delta / count_;
+        m2_ += delta * (x - mean_);
+        if (count_ == 1 || x < min_) min_ = x;
+        if (count_ == 1 || x > max_) max_ = x;
+    }
+
+    uint64_t count() const { return count_; }
+    double mean() const { return mean_; }
+    double variance() const { return count_ > 1 ? m2_ / (count_ - 1) : 0.0; }
+    double stddev() const { return sqrt(variance()); }
+    double min() const { return min_; }
+    double max() const { return max_; }
+
+private:
+    uint64_t count_ = 0;
+    double mean_ = 0.0;
+    double m2_ = 0.0;
+    double min_ = 0.0;
+    double max_ = 0.0;
+};
+
+// 時定数 tau [s] の指数移動平均。係数を標本ごとの dt から決めるので、周期が揺れても時定数は変わらない
+class Ewma {
+public:
+    explicit Ewma(double tau) : tau_(tau) {}
+
+    void add(double x, double dt) {
+        if (!started_) {
+            value_ = x;
+            started_ = true;
+            return;
+        }
+        double alpha = dt / tau_;
+        value_ += (x - value_) * (alpha < 1.0 ? alpha : 1.0);
+    }
+
+    double value() const { return value_; }
+
+private:
+    double tau_;
+    double value_ = 0.0;
+    bool started_ = false;
+};
+
+// P² 法（Jain & Chlamtac）による分位点の推定。5つの目印の高さと位置だけを持ち、標本は持たない
+class P2Quantile {
+public:
+    // p は 0〜1（0.95 なら 95 パーセンタイル）
+    explicit P2Quantile(double p);
+
+    void add(double x);
+
+    uint64_t count() const { return count_; }
+    // 5標本未満のときは集めた標本から直接求める
+    double value() const;
+
+private:
+    double parabolic(int i, double d) const;
+    double linear(int i, double d) const;
+
+    double p_;
+    uint64_t count_;
+    double height_[5];     // 目印の高さ（推定値）
+    double position_[5];   // 目印の実際の位置（1 から）
+    double desired_[5];    // 目印の理想の位置
+    double increment_[5];  // 標本1つごとの理想の位置の増分
+};
+
+// 止める条件（どれも 0 なら判定しない）と状態行
+struct StreamLimits {
+    double max_current = 0.0;       // |Present Current| の上限 [生の値]。1周期でも超えたら止める
+    double max_error_deg = 0.0;     // 追従誤差の指数移動平均（STATS_ERROR_TAU）の上限 [deg]
+    double max_cycle_ms = 0.0;      // 処理時間の指数移動平均（STATS_CYCLE_TAU）の上限 [ms]
+    uint64_t warmup_cycles = STATS_WARMUP_CYCLES;
+    double status_hz = 0.0;         // 状態行の更新頻度 [Hz]（0 なら出さない）
+};
+
+// 環境変数 DXL_STOP_CURRENT / DXL_STOP_ERROR_DEG / DXL_STOP_CYCLE_MS / DXL_STOP_WARMUP で止める条件を、
+// DXL_STATUS_HZ で状態行の頻度を決める（既定は標準出力が端末なら STATS_STATUS_HZ、そうでなければ出さない）
+StreamLimits streamLimitsFromEnv();
+
+// 制御ループの中で関節ごとの電流・追従誤差と周期の処理時間を集計し、止める条件を調べる。
+//   - 電流・|追従誤差|: Welford の平均・標準偏差、ピーク、P² の p50 / p95
+//   - 追従誤差の指数移動平均（止める判定用）、処理時間の指数移動平均
+// どれも1標本 O(1)・確保なし。状態行は固定長のバッファに書いてから write(2) で1回で出す。
+class LoopStats {
+public:
+    LoopStats(const std::vector<uint8_t>& ids, const StreamLimits& limits);
+
+    size_t size() const { return ids_.size(); }
+
+    // 読めた関節の標本（current は生の値、error_deg は 目標 - 現在 [deg]）。dt はその周期 [s]
+    void addJoint(size_t i, double current, double error_deg, double dt);
+
+    // 周期の処理時間 [s]（周期の終わりに1回）
+    void addCycle(double body_s, double dt);
+
+    // 止める条件に当たれば false（理由は stopReason()。一度当たったらそのまま）
+    bool check();
+    const char* stopReason() const { return stop_reason_; }
+
+    // status_hz の間隔が空いていれば状態行を書き直す（elapsed は走行の経過時間 [s]）
+    void printStatus(double elapsed);
+    // 状態行を出していれば改行して閉じる（ループを抜けたあと、ほかの表示の前に呼ぶ）
+    void endStatus();
+
+    // 関節ごとの集計を表示する
+    void printReport(std::ostream& os) const;
+
+private:
+    struct Joint {
+        RunningStats current;
+        RunningStats error;           // |追従誤差| [deg]
+        P2Quantile current_p50{0.5};
+        P2Quantile current_p95{0.95};
+        P2Quantile error_p50{0.5};
+        P2Quantile error_p95{0.95};
+        Ewma error_ewma{STATS_ERROR_TAU};
+        double current_peak = 0.0;    // |電流| の最大
+    };
+
+    std::vector<uint8_t> ids_;
+    StreamLimits limits_;
+    std::vector<Joint> joints_;
+    RunningStats cycle_;              // 処理時間 [s]
+    Ewma cycle_ewma_;
+    uint64_t cycles_;
+    double next_status_;
+    bool status_open_;
+    char stop_reason_[128];
+};
+
+#endif  // STREAM_STATS_H_
@@ -0,0 +1,328 @@
+#include "sync_telemetry.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <iomanip>
+#include <iostream>
+
+using xm430::Command;
+using xm430::PackedTelemetry;
+using xm430::Telemetry;
+
+// Return Delay Time(9) の出荷時の値（250 × 2us）
+#define DEFAULT_RETURN_DELAY_US       500.0
+
+// rx_ のIDごとの間隔（詰めたブロックも同じ場所に置く）
+static const size_t RX_STRIDE = Telemetry::length;
+static_assert(PackedTelemetry::length <= RX_STRIDE, "packed telemetry must fit in the block stride");
+
+static int64_t monotonicNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+const char* telemetryModeName(TelemetryMode mode) {
+    switch (mode) {
+    case TelemetryMode::Block: return "block";
+    case TelemetryMode::Indirect: return "indirect";
+    case TelemetryMode::Fast: return "fast";
+    }
+    return "";
+}
+
+TelemetryMode telemetryModeFromEnv(TelemetryMode fallback) {
+    const char* value = getenv("DXL_TELEMETRY");
+    if (!value) {
+        return fallback;
+    }
+    for (TelemetryMode mode : {TelemetryMode::Block, TelemetryMode::Indirect, TelemetryMode::Fast}) {
+        if (strcmp(value, telemetryModeName(mode)) == 0) {
+            return mode;
+        }
+    }
+    std::cerr << "Ignoring DXL_TELEMETRY=" << value << " (block / indirect / fast)" << std::endl;
+    return fallback;
+}
+
+TelemetryWire telemetryWire(TelemetryMode mode, size_t count) {
+    const size_t length = mode == TelemetryMode::Block ? Telemetry::length : PackedTelemetry::length;
+    TelemetryWire wire;
+    wire.request_bytes = dxl_proto::PACKET_OVERHEAD + 4 + count;
+    if (mode == TelemetryMode::Fast) {
+        wire.status_packets = count > 0 ? 1 : 0;
+        wire.status_bytes =
+            count > 0 ? dxl_proto::FAST_STATUS_OVERHEAD + count * (length + dxl_proto::FAST_SEGMENT_OVERHEAD) : 0;
+    } else {
+        wire.status_packets = count;
+        wire.status_bytes = count * (dxl_proto::STATUS_PACKET_OVERHEAD + length);
+    }
+    wire.write_bytes = dxl_proto::PACKET_OVERHEAD + 4 + count * (1 + Command::length);
+    return wire;
+}
+
+double maxLoopRateHz(const TelemetryWire& wire, int baudrate, double return_delay_us) {
+    double us = dxl_proto::wireTimeUs(wire.total(), baudrate) + wire.status_packets * return_delay_us;
+    return us > 0.0 ? 1e6 / us : 0.0;
+}
+
+// packetHandler は他のクラスと引数をそろえるために受け取る（パケットは PacketIo で組み立てる）
+SyncTelemetry::SyncTelemetry(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler*,
+                             const std::vector<uint8_t>& ids)
+    : io_(portHandler),
+      trace_(nullptr),
+      monitor_(nullptr),
+      mode_(TelemetryMode::Block),
+      return_delay_us_(DEFAULT_RETURN_DELAY_US),
+      ids_(ids),
+      rx_(ids.size() * RX_STRIDE, 0),
+      fast_rx_(ids.size() * RX_STRIDE, 0),
+      fast_ids_(ids.size(), 0),
+      fast_errors_(ids.size(), 0),
+      tx_(ids.size() * (1 + Command::length), 0),
+      current_(ids.size(), 0),
+      velocity_(ids.size(), 0),
+      position_(ids.size(), 0),
+      error_(ids.size(), 0),
+      fresh_(ids.size(), 0) {
+    // 送信パケットのIDはここで一度だけ埋め、周期中は値の部分だけ書き換える
+    for (size_t i = 0; i < ids_.size(); i++) {
+        tx_[i * (1 + Command::length)] = ids_[i];
+    }
+    for (int16_t& index : index_) {
+        index = -1;
+    }
+    for (size_t i = 0; i < ids_.size(); i++) {
+        index_[ids_[i]] = static_cast<int16_t>(i);
+    }
+    missing_.reserve(ids_.size());
+}
+
+int SyncTelemetry::configure(TelemetryMode mode) {
+    uint8_t error = 0;
+    if (!ids_.empty()) {
+        uint8_t delay = 0;
+        int result = io_.read(ids_[0], xm430::ReturnDelayTime::address, 1, &delay, &error);
+        if (result != COMM_SUCCESS) {
+            return result;
+        }
+        return_delay_us_ = xm430::toUnit<xm430::ReturnDelayTime>(delay);
+    }
+
+    // Fast Sync Read は全IDが対応していないと応答が途中で切れる
+    if (mode == TelemetryMode::Fast) {
+        for (uint8_t id : ids_) {
+            uint8_t version = 0;
+            int result = io_.read(id, xm430::FirmwareVersion::address, 1, &version, &error);
+            if (result != COMM_SUCCESS) {
+                return result;
+            }
+            if (version < xm430::FAST_SYNC_READ_FIRMWARE) {
+                std::cerr << "Motor " << static_cast<int>(id) << " firmware v" << static_cast<int>(version)
+                          << " has no Fast Sync Read; using indirect Sync Read" << std::endl;
+                mode = TelemetryMode::Indirect;
+                break;
+            }
+        }
+    }
+
+    if (mode != TelemetryMode::Block) {
+        // Indirect Address 1.. に電流・位置の各バイトの元アドレスを書く（RAM 領域なので電源を入れるたびに要る）
+        uint16_t sources[PackedTelemetry::length];
+        PackedTelemetry::sourceAddresses(sources);
+        uint8_t data[sizeof(sources)];
+        memcpy(data, sources, sizeof(sources));
+        for (uint8_t id : ids_) {
+            int result = io_.write(id, xm430::IndirectAddress1::address, data, sizeof(data), &error);
+            if (result != COMM_SUCCESS) {
+                return result;
+            }
+            if (error & 0x7F) {
+                std::cerr << "Motor " << static_cast<int>(id) << " rejected the indirect address table (error "
+                          << static_cast<int>(error) << "); using block Sync Read" << std::endl;
+                return COMM_SUCCESS;
+            }
+        }
+    }
+    mode_ = mode;
+    return COMM_SUCCESS;
+}
+
+uint16_t SyncTelemetry::blockAddress() const {
+    return mode_ == TelemetryMode::Block ? Telemetry::address : PackedTelemetry::address;
+}
+
+uint16_t SyncTelemetry::blockLength() const {
+    return mode_ == TelemetryMode::Block ? Telemetry::length : PackedTelemetry::length;
+}
+
+void SyncTelemetry::store(size_t i, const uint8_t* block, uint8_t error) {
+    uint8_t* data = &rx_[i * RX_STRIDE];
+    memcpy(data, block, blockLength());
+    if (mode_ == TelemetryMode::Block) {
+        current_[i] = Telemetry::decode<xm430::PresentCurrent>(data);
+        velocity_[i] = Telemetry::decode<xm430::PresentVelocity>(data);
+        position_[i] = Telemetry::decode<xm430::PresentPosition>(data);
+    } else {
+        current_[i] = PackedTelemetry::decode<xm430::PresentCurrent>(data);
+        position_[i] = PackedTelemetry::decode<xm430::PresentPosition>(data);
+    }
+    error_[i] = error;
+    fresh_[i] = 1;
+}
+
+int SyncTelemetry::read() {
+    missing_.assign(ids_.begin(), ids_.end());
+    for (size_t i = 0; i < ids_.size(); i++) {
+        fresh_[i] = 0;
+        error_[i] = 0;
+    }
+
+    // 読めなかったIDだけを、期限に間に合う範囲で送り直す
+    int retries = 0;
+    while (true) {
+        int64_t start = monotonicNow();
+        int dxl_comm_result = readMissing(retries > 0);
+        if (missing_.empty()) {
+            return COMM_SUCCESS;
+        }
+        if (!monitor_ || !monitor_->shouldRetry(dxl_comm_result, retries, monotonicNow() - start)) {
+            if (monitor_) {
+                for (uint8_t id : missing_) {
+                    monitor_->fail(id);
+                }
+            }
+            return dxl_comm_result;
+        }
+        retries++;
+    }
+}
+
+int SyncTelemetry::readMissing(bool retry) {
+    // 送り直しは IDごとに応答する Sync Read で行う（Fast の応答は1台欠けると全IDが読めない）
+    const size_t count = missing_.size();
+    int dxl_comm_result = mode_ == TelemetryMode::Fast && !retry ? receiveFast(count) : receiveSync(count);
+
+    // 読めたIDを外して詰める（並びは要求の順のまま）
+    size_t k = 0;
+    for (size_t j = 0; j < count; j++) {
+        uint8_t id = missing_[j];
+        bool fresh = fresh_[index_[id]] != 0;
+        if (monitor_) {
+            monitor_->attempt(id, fresh ? COMM_SUCCESS : dxl_comm_result, retry);
+        }
+        if (!fresh) {
+            missing_[k++] = id;
+        }
+    }
+    missing_.resize(k);
+    return k == 0 ? COMM_SUCCESS : dxl_comm_result;
+}
+
+int SyncTelemetry::receiveSync(size_t count) {
+    // GroupSyncRead::txRxPacket と同じく要求1回に対して応答はID数。ただし届いた順にIDで振り分ける
+    const uint16_t length = blockLength();
+    int dxl_comm_result = io_.syncReadTx(blockAddress(), length, missing_.data(), count);
+    if (dxl_comm_result != COMM_SUCCESS) {
+        return dxl_comm_result;
+    }
+    uint32_t crc_base = io_.crcErrors();
+    size_t received = 0;
+    uint64_t t = trace_ ? trace_->begin() : 0;
+    while (received < count) {
+        uint8_t id = 0;
+        uint8_t error = 0;
+        uint8_t block[RX_STRIDE];
+        int result = io_.nextStatus(length, &id, block, &error);
+        if (result == COMM_SUCCESS) {
+            int16_t i = index_[id];
+            if (i < 0 || fresh_[i]) {
+                continue;  // 要求していないIDや重複した応答
+            }
+            store(static_cast<size_t>(i), block, error);
+            received++;
+            if (trace_) {
+                t = trace_->mark(PHASE_RX_STATUS, t, id);  // 前の応答（1台目は要求送信）からの時間
+            }
+            continue;
+        }
+        dxl_comm_result = result;
+        // 化けた応答の数で残りが尽きていれば、タイムアウトまで待たない
+        if (result != COMM_RX_CORRUPT || received + (io_.crcErrors() - crc_base) >= count) {
+            break;
+        }
+    }
+    return dxl_comm_result;
+}
+
+int SyncTelemetry::receiveFast(size_t count) {
+    const uint16_t length = blockLength();
+    int dxl_comm_result = io_.fastSyncReadTx(blockAddress(), length, missing_.data(), count);
+    if (dxl_comm_result != COMM_SUCCESS) {
+        return dxl_comm_result;
+    }
+    uint64_t t = trace_ ? trace_->begin() : 0;
+    dxl_comm_result =
+        io_.readFastStatus(length, count, fast_ids_.data(), fast_errors_.data(), fast_rx_.data(), RX_STRIDE);
+    if (dxl_comm_result != COMM_SUCCESS) {
+        return dxl_comm_result;
+    }
+    for (size_t k = 0; k < count; k++) {
+        int16_t i = index_[fast_ids_[k]];
+        if (i < 0 || fresh_[i]) {
+            continue;
+        }
+        store(static_cast<size_t>(i), &fast_rx_[k * RX_STRIDE], fast_errors_[k]);
+        if (trace_) {
+            t = trace_->mark(PHASE_RX_STATUS, t, fast_ids_[k]);  // 1台目に応答全体の時間が付く
+        }
+    }
+    return COMM_SUCCESS;
+}
+
+void SyncTelemetry::printWireReport(std::ostream& os, int baudrate) const {
+    TelemetryWire wire = telemetryWire(mode_, ids_.size());
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(1);
+    os << "Telemetry " << telemetryModeName(mode_) << ": " << wire.total() << " bytes/cycle for " << ids_.size()
+       << " motors (request " << wire.request_bytes << ", status " << wire.status_bytes << " in "
+       << wire.status_packets << " packets, write " << wire.write_bytes << "), wire limit "
+       << maxLoopRateHz(wire, baudrate, return_delay_us_) << " Hz at " << baudrate << " bps with "
+       << return_delay_us_ << " us return delay\n";
+    os.flags(flags);
+    os.flush();
+}
+
+uint16_t SyncTelemetry::staleMask() const {
+    uint16_t mask = 0;
+    for (size_t i = 0; i < ids_.size() && i < 16; i++) {
+        if (!fresh_[i]) {
+            mask |= static_cast<uint16_t>(1u << i);
+        }
+    }
+    return mask;
+}
+
+int SyncTelemetry::writeGoalCurrents(const int16_t* goal_currents) {
+    for (size_t i = 0; i < ids_.size(); i++) {
+        Command::encode<xm430::GoalCurrent>(goal_currents[i], &tx_[i * (1 + Command::length) + 1]);
+    }
+    int retries = 0;
+    while (true) {
+        int64_t start = monotonicNow();
+        int dxl_comm_result = io_.syncWriteTxOnly(Command::address, Command::length, tx_.data(), tx_.size());
+        if (!monitor_) {
+            return dxl_comm_result;
+        }
+        monitor_->attempt(BROADCAST_ID, dxl_comm_result, retries > 0);
+        if (dxl_comm_result == COMM_SUCCESS) {
+            return COMM_SUCCESS;
+        }
+        if (!monitor_->shouldRetry(dxl_comm_result, retries, monotonicNow() - start)) {
+            monitor_->fail(BROADCAST_ID);
+            return dxl_comm_result;
+        }
+        retries++;
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef SYNC_TELEMETRY_H_
+#define SYNC_TELEMETRY_H_
+
+#include "dynamixel_sdk.h"
+#include "cycle_trace.h"
+#include "link_monitor.h"
+#include "packet_io.h"
+#include "xm430_registers.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+// 周期ごとのテレメトリの読み方
+enum class TelemetryMode : uint8_t {
+    Block,      // Present Current〜Present Position（126..135）をそのまま Sync Read（応答はID数）
+    Indirect,   // Indirect Data に詰めた電流・位置（xm430::PackedTelemetry）を Sync Read（応答はID数）
+    Fast,       // 同じ詰めたブロックを Fast Sync Read（応答は全IDで1つ）
+};
+
+const char* telemetryModeName(TelemetryMode mode);
+// 環境変数 DXL_TELEMETRY（block / indirect / fast）で選ぶ。無ければ fallback
+TelemetryMode telemetryModeFromEnv(TelemetryMode fallback);
+
+// 1周期（読み1回 + 書き1回）でワイヤに乗るバイト数（バイトスタッフィングは含めない）
+struct TelemetryWire {
+    size_t request_bytes;   // Sync Read / Fast Sync Read の要求
+    size_t status_bytes;    // 応答の合計
+    size_t status_packets;  // 応答の数（それぞれの前にサーボの返送遅延が入る）
+    size_t write_bytes;     // 目標電流の Sync Write
+    size_t total() const { return request_bytes + status_bytes + write_bytes; }
+};
+
+// count 台を mode で読むときのバイト数
+TelemetryWire telemetryWire(TelemetryMode mode, size_t count);
+// ワイヤ上の時間と返送遅延だけで決まる周期の上限 [Hz]（計算・OSの遅延は含まない）
+double maxLoopRateHz(const TelemetryWire& wire, int baudrate, double return_delay_us);
+
+// 全モーターの現在電流(126)・現在速度(128)・現在位置(132)を1回のSync Readで取得し、
+// 目標電流(102)を1回のSync Writeで送信する。
+// 1周期あたりのやり取りは Sync Read 1回（応答はID数）+ Sync Write 1回（応答なし）になる。
+// configure() で Indirect / Fast にすると、電流と位置だけを Indirect Data に詰めて読み（速度は読まず 0 のまま）、
+// Fast では応答も1つにまとまる。Fast の応答が欠けたり化けたりしたときの送り直しは、IDごとに応答する Sync Read で行う。
+// パケットの配置は xm430::Telemetry / xm430::Command でコンパイル時に決まっており、
+// 周期中は固定の受信バッファから memcpy で取り出すだけ（GroupSyncRead/Write の map 引きや再確保をしない）。
+// 送受信は PacketIo で行うので、read() / writeGoalCurrents() はヒープ確保をしない。
+// 応答は届いた順にIDで振り分けるので、1台の応答が化けても他のIDの値は取れる。
+// setMonitor() すると、読めなかったIDだけを Sync Read し直し（周期の期限に間に合う範囲で）、失敗をIDごとに数える。
+class SyncTelemetry {
+public:
+    SyncTelemetry(dynamixel::PortHandler* portHandler, dynamixel::PacketHandler* packetHandler,
+                  const std::vector<uint8_t>& ids);
+
+    // 全IDのテレメトリを読む。読めなかったIDの値は前回値のまま残る（fresh(i) が false）。
+    // 戻り値は 全ID読めたら COMM_SUCCESS、それ以外は最後の失敗の COMM_*
+    int read();
+
+    // 読み方を mode にする（周期の外で、read() より前に1回呼ぶ）。Indirect / Fast なら各IDの Indirect Address に
+    // PackedTelemetry の並びを書く。Fast はファームウェアが FAST_SYNC_READ_FIRMWARE より古いIDがあれば Indirect にする。
+    // 返送遅延（Return Delay Time）もここで読む。失敗したら Block のまま。戻り値は COMM_*
+    int configure(TelemetryMode mode);
+    TelemetryMode mode() const { return mode_; }
+    double returnDelayUs() const { return return_delay_us_; }
+
+    // 今の読み方での1周期のバイト数と、baudrate での周期の上限を表示する
+    void printWireReport(std::ostream& os, int baudrate) const;
+
+    // 全IDの目標電流を送る（goal_currents はIDの並び順）。戻り値は COMM_*
+    int writeGoalCurrents(const int16_t* goal_currents);
+
+    // monitor を渡すと、read() / writeGoalCurrents() の失敗を monitor の方針で送り直して記録する。
+    // 周期の区切り（beginCycle / endCycle）は呼び出し側で行う
+    void setMonitor(LinkMonitor* monitor) { monitor_ = monitor; }
+
+    // trace を渡すと、read() の中でモーターごとの応答受信時間を記録する
+    void setTrace(CycleTrace* trace) { trace_ = trace; }
+
+    size_t size() const { return ids_.size(); }
+    uint8_t id(size_t i) const { return ids_[i]; }
+    int16_t current(size_t i) const { return current_[i]; }
+    int32_t velocity(size_t i) const { return velocity_[i]; }  // Block のときだけ読む（それ以外は 0 のまま）
+    int32_t position(size_t i) const { return position_[i]; }
+    uint8_t error(size_t i) const { return error_[i]; }
+    // 直前の read() で値が取れたか
+    bool fresh(size_t i) const { return fresh_[i] != 0; }
+    // 値が取れなかったIDのビット（先頭16個。ログの stale 列用）
+    uint16_t staleMask() const;
+
+private:
+    // missing_ に並べたIDを1回 Sync Read する。届いたIDは fresh_ を立てて missing_ から外す
+    int readMissing(bool retry);
+    // 要求・受信の部分。届いたIDは store() する
+    int receiveSync(size_t count);
+    int receiveFast(size_t count);
+    void store(size_t i, const uint8_t* block, uint8_t error);
+    uint16_t blockAddress() const;
+    uint16_t blockLength() const;
+
+    PacketIo io_;
+    CycleTrace* trace_;
+    LinkMonitor* monitor_;
+    TelemetryMode mode_;
+    double return_delay_us_;
+    std::vector<uint8_t> ids_;
+    std::vector<uint8_t> rx_;         // IDごとに xm430::Telemetry::length バイト（詰めたブロックも同じ間隔で置く）
+    std::vector<uint8_t> fast_rx_;    // Fast Sync Read の応答（要求順。間隔は rx_ と同じ）
+    std::vector<uint8_t> fast_ids_;
+    std::vector<uint8_t> fast_errors_;
+    std::vector<uint8_t> tx_;         // IDごとに [ID][xm430::Command::length バイト]
+    std::vector<int16_t> current_;
+    std::vector<int32_t> velocity_;
+    std::vector<int32_t> position_;
+    std::vector<uint8_t> error_;
+    std::vector<uint8_t> fresh_;
+    std::vector<uint8_t> missing_;    // まだ読めていないID（Sync Read の要求にそのまま使う）
+    int16_t index_[256];              // ID → ids_ の位置（無ければ -1）
+};
+
+#endif  // SYNC_TELEMETRY_H_
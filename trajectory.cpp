@@ -0,0 +1,456 @@
+#include "trajectory.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// .traj ファイルの先頭（リトルエンディアン）。続けて TrajectoryPoint が 標本 × 関節 の順に並ぶ
+struct TrajectoryFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t joints;
+    uint32_t reserved0;
+    uint64_t samples;
+    double sample_rate_hz;
+    uint8_t reserved[24];
+};
+
+static_assert(sizeof(TrajectoryFileHeader) == 64, "TrajectoryFileHeader layout changed");
+static_assert(sizeof(TrajectoryPoint) == 3 * sizeof(double), "TrajectoryPoint must be three packed doubles");
+
+static inline void interpolate(const TrajectoryPoint* a, const TrajectoryPoint* b, double frac, size_t joints,
+                               TrajectoryPoint* out) {
+    for (size_t j = 0; j < joints; j++) {
+        out[j].position = a[j].position + (b[j].position - a[j].position) * frac;
+        out[j].velocity = a[j].velocity + (b[j].velocity - a[j].velocity) * frac;
+        out[j].feedforward = a[j].feedforward + (b[j].feedforward - a[j].feedforward) * frac;
+    }
+}
+
+Profile Profile::linear(double distance, double duration) {
+    return Profile(Type::Linear, distance, duration);
+}
+
+Profile Profile::minimumJerk(double distance, double duration) {
+    return Profile(Type::MinimumJerk, distance, duration);
+}
+
+Profile Profile::trapezoid(double distance, double duration, double accel_fraction) {
+    Profile profile(Type::Trapezoid, distance, duration);
+    profile.accel_fraction_ = std::min(std::max(accel_fraction, 0.0), 0.5);
+    if (profile.accel_fraction_ == 0.0) {
+        profile.type_ = Type::Linear;
+    }
+    return profile;
+}
+
+Profile Profile::cubicSpline(const std::vector<Waypoint>& waypoints) {
+    // 両端の傾きを0に固定した3次スプライン（三重対角の連立方程式を前進消去・後退代入で解く）
+    const size_t n = waypoints.size() - 1;
+    double t0 = waypoints.empty() ? 0.0 : waypoints[0].t;
+    Profile profile(Type::CubicSpline, waypoints.empty() ? 0.0 : waypoints.back().position,
+                    waypoints.empty() ? 0.0 : waypoints.back().t - t0);
+    if (waypoints.size() < 2) {
+        double p = waypoints.empty() ? 0.0 : waypoints[0].position;
+        profile.segments_.push_back({0.0, p, 0.0, 0.0, 0.0});
+        return profile;
+    }
+
+    std::vector<double> h(n), alpha(n + 1), l(n + 1), mu(n + 1), z(n + 1), c(n + 1);
+    for (size_t i = 0; i < n; i++) {
+        h[i] = waypoints[i + 1].t - waypoints[i].t;
+    }
+    const auto a = [&](size_t i) { return waypoints[i].position; };
+    alpha[0] = 3.0 * (a(1) - a(0)) / h[0];
+    alpha[n] = -3.0 * (a(n) - a(n - 1)) / h[n - 1];
+    for (size_t i = 1; i < n; i++) {
+        alpha[i] = 3.0 / h[i] * (a(i + 1) - a(i)) - 3.0 / h[i - 1] * (a(i) - a(i - 1));
+    }
+    l[0] = 2.0 * h[0];
+    mu[0] = 0.5;
+    z[0] = alpha[0] / l[0];
+    for (size_t i = 1; i < n; i++) {
+        l[i] = 2.0 * (waypoints[i + 1].t - waypoints[i - 1].t) - h[i - 1] * mu[i - 1];
+        mu[i] = h[i] / l[i];
+        z[i] = (alpha[i] - h[i - 1] * z[i - 1]) / l[i];
+    }
+    l[n] = h[n - 1] * (2.0 - mu[n - 1]);
+    z[n] = (alpha[n] - h[n - 1] * z[n - 1]) / l[n];
+    c[n] = z[n];
+    profile.segments_.resize(n);
+    for (size_t j = n; j-- > 0;) {
+        c[j] = z[j] - mu[j] * c[j + 1];
+        double b = (a(j + 1) - a(j)) / h[j] - h[j] * (c[j + 1] + 2.0 * c[j]) / 3.0;
+        double d = (c[j + 1] - c[j]) / (3.0 * h[j]);
+        profile.segments_[j] = {waypoints[j].t - t0, a(j), b, c[j], d};
+    }
+    return profile;
+}
+
+void Profile::evaluate(double t, double& position, double& velocity, double& acceleration) const {
+    velocity = 0.0;
+    acceleration = 0.0;
+    if (type_ == Type::CubicSpline) {
+        t = std::min(std::max(t, 0.0), duration_);
+        size_t k = 0;
+        while (k + 1 < segments_.size() && segments_[k + 1].t0 <= t) {
+            k++;
+        }
+        const Segment& seg = segments_[k];
+        double s = t - seg.t0;
+        position = seg.a + s * (seg.b + s * (seg.c + s * seg.d));
+        velocity = seg.b + s * (2.0 * seg.c + s * 3.0 * seg.d);
+        acceleration = 2.0 * seg.c + 6.0 * seg.d * s;
+        return;
+    }
+    if (t <= 0.0 || duration_ <= 0.0) {
+        position = t <= 0.0 ? 0.0 : distance_;
+        return;
+    }
+    if (t >= duration_) {
+        position = distance_;
+        return;
+    }
+
+    const double T = duration_;
+    switch (type_) {
+    case Type::Linear:
+        position = distance_ * (t / T);
+        velocity = distance_ / T;
+        break;
+    case Type::MinimumJerk: {
+        // s(τ) = 10τ^3 - 15τ^4 + 6τ^5
+        double tau = t / T;
+        double tau2 = tau * tau;
+        position = distance_ * tau2 * tau * (10.0 - 15.0 * tau + 6.0 * tau2);
+        velocity = distance_ * 30.0 * tau2 * (1.0 - 2.0 * tau + tau2) / T;
+        acceleration = distance_ * 60.0 * tau * (1.0 - 3.0 * tau + 2.0 * tau2) / (T * T);
+        break;
+    }
+    case Type::Trapezoid: {
+        double ta = accel_fraction_ * T;
+        double vmax = distance_ / (T - ta);
+        double accel = vmax / ta;
+        if (t < ta) {
+            position = 0.5 * accel * t * t;
+            velocity = accel * t;
+            acceleration = accel;
+        } else if (t < T - ta) {
+            position = 0.5 * accel * ta * ta + vmax * (t - ta);
+            velocity = vmax;
+        } else {
+            double remaining = T - t;
+            position = distance_ - 0.5 * accel * remaining * remaining;
+            velocity = accel * remaining;
+            acceleration = -accel;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+TrajectoryTable::TrajectoryTable(const std::vector<Profile>& profiles, double sample_rate_hz,
+                                 const std::vector<FeedforwardModel>& feedforward, const std::vector<double>& origins)
+    : joints_(profiles.size()), rate_(sample_rate_hz) {
+    double duration = 0.0;
+    for (const Profile& profile : profiles) {
+        duration = std::max(duration, profile.duration());
+    }
+    samples_ = static_cast<size_t>(std::ceil(duration * rate_)) + 1;
+    samples_ = std::max<size_t>(samples_, 2);
+    points_.resize(samples_ * joints_);
+    for (size_t k = 0; k < samples_; k++) {
+        double t = k / rate_;
+        for (size_t j = 0; j < joints_; j++) {
+            double acceleration;
+            TrajectoryPoint& point = points_[k * joints_ + j];
+            profiles[j].evaluate(t, point.position, point.velocity, acceleration);
+            double origin = j < origins.size() ? origins[j] : 0.0;
+            point.feedforward =
+                j < feedforward.size() ? feedforward[j].current(origin + point.position, point.velocity, acceleration)
+                                       : 0.0;
+        }
+    }
+}
+
+void TrajectoryTable::lookup(double t, TrajectoryPoint* points) {
+    double x = t * rate_;
+    if (!(x > 0.0)) {
+        x = 0.0;
+    }
+    if (x >= samples_ - 1) {
+        const TrajectoryPoint* last = &points_[(samples_ - 1) * joints_];
+        std::copy(last, last + joints_, points);
+        return;
+    }
+    size_t k = static_cast<size_t>(x);
+    const TrajectoryPoint* a = &points_[k * joints_];
+    interpolate(a, a + joints_, x - k, joints_, points);
+}
+
+bool TrajectoryTable::save(const std::string& path) const {
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    TrajectoryFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRAJ_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRAJ_FILE_VERSION;
+    header.header_size = sizeof(header);
+    header.joints = static_cast<uint32_t>(joints_);
+    header.samples = samples_;
+    header.sample_rate_hz = rate_;
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(points_.data(), sizeof(TrajectoryPoint), points_.size(), fp) == points_.size();
+    return fclose(fp) == 0 && ok;
+}
+
+TrajectoryStream::TrajectoryStream(size_t chunk_samples)
+    : fd_(-1),
+      header_size_(0),
+      joints_(0),
+      samples_(0),
+      rate_(1.0),
+      chunk_samples_(std::max<size_t>(chunk_samples, 1)),
+      underruns_(0),
+      front_(0),
+      pending_(false),
+      back_ready_(false),
+      requested_(-1),
+      load_into_(1),
+      stop_(false) {}
+
+TrajectoryStream::~TrajectoryStream() {
+    close();
+}
+
+bool TrajectoryStream::open(const std::string& path) {
+    close();
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        error_ = "cannot open " + path + ": " + strerror(errno);
+        return false;
+    }
+    TrajectoryFileHeader header;
+    if (pread(fd_, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        memcmp(header.magic, TRAJ_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        error_ = path + " is not a trajectory file";
+        close();
+        return false;
+    }
+    struct stat st;
+    fstat(fd_, &st);
+    uint64_t expected = header.header_size + header.samples * header.joints * sizeof(TrajectoryPoint);
+    if (header.version > TRAJ_FILE_VERSION || header.header_size < sizeof(header) || header.joints == 0 ||
+        header.samples < 2 || !(header.sample_rate_hz > 0.0) || static_cast<uint64_t>(st.st_size) < expected) {
+        error_ = path + " has an unsupported or truncated header";
+        close();
+        return false;
+    }
+    header_size_ = header.header_size;
+    joints_ = header.joints;
+    samples_ = header.samples;
+    rate_ = header.sample_rate_hz;
+    underruns_ = 0;
+
+    // 隣の区間と1標本重ねるので chunk + 1 標本分
+    for (Chunk& chunk : chunks_) {
+        chunk.index = -1;
+        chunk.points.assign((chunk_samples_ + 1) * joints_, TrajectoryPoint{0.0, 0.0, 0.0});
+    }
+    front_ = 0;
+    if (!readChunk(0, chunks_[0])) {
+        error_ = "failed to read " + path;
+        close();
+        return false;
+    }
+    back_ready_ = false;
+    pending_ = false;
+    requested_ = -1;
+    stop_ = false;
+    loader_ = std::thread(&TrajectoryStream::loaderLoop, this);
+    requestChunk(1);
+    return true;
+}
+
+void TrajectoryStream::close() {
+    if (loader_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        loader_.join();
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool TrajectoryStream::readChunk(int64_t index, Chunk& chunk) {
+    size_t first = static_cast<size_t>(index) * chunk_samples_;
+    if (first >= samples_) {
+        return false;
+    }
+    size_t count = std::min(chunk_samples_ + 1, samples_ - first);
+    size_t bytes = count * joints_ * sizeof(TrajectoryPoint);
+    off_t offset = header_size_ + static_cast<off_t>(first * joints_ * sizeof(TrajectoryPoint));
+    char* dst = reinterpret_cast<char*>(chunk.points.data());
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t n = pread(fd_, dst + done, bytes - done, offset + done);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    chunk.index = index;
+    chunk.count = count;
+    return true;
+}
+
+void TrajectoryStream::requestChunk(int64_t index) {
+    if (static_cast<size_t>(index) * chunk_samples_ >= samples_ - 1) {
+        return;  // 最後の区間まで読み終えている
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        requested_ = index;
+        load_into_ = 1 - front_;
+    }
+    pending_ = true;
+    cv_.notify_one();
+}
+
+void TrajectoryStream::loaderLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return stop_ || requested_ >= 0; });
+        if (stop_) {
+            return;
+        }
+        int64_t index = requested_;
+        Chunk& chunk = chunks_[load_into_];
+        lock.unlock();
+        bool ok = readChunk(index, chunk);
+        lock.lock();
+        requested_ = -1;
+        if (!ok) {
+            chunk.index = -1;
+        }
+        back_ready_.store(true, std::memory_order_release);
+    }
+}
+
+void TrajectoryStream::lookup(double t, TrajectoryPoint* points) {
+    double x = t * rate_;
+    if (!(x > 0.0)) {
+        x = 0.0;
+    }
+    size_t k;
+    double frac;
+    if (x >= samples_ - 1) {
+        k = samples_ - 1;
+        frac = 0.0;
+    } else {
+        k = static_cast<size_t>(x);
+        frac = x - k;
+    }
+    const size_t needed = frac > 0.0 ? 2 : 1;
+    auto covers = [&](const Chunk& chunk) {
+        size_t first = static_cast<size_t>(chunk.index) * chunk_samples_;
+        return chunk.index >= 0 && k >= first && k + needed <= first + chunk.count;
+    };
+
+    if (!covers(chunks_[front_])) {
+        // 先読みが済んでいれば入れ替えて次を頼む。違う区間だった（時刻が飛んだ）なら読み直しを頼む
+        if (back_ready_.load(std::memory_order_acquire)) {
+            back_ready_.store(false, std::memory_order_relaxed);
+            pending_ = false;
+            if (covers(chunks_[1 - front_])) {
+                front_ = 1 - front_;
+                requestChunk(chunks_[front_].index + 1);
+            }
+        }
+        if (!covers(chunks_[front_])) {
+            if (!pending_) {
+                requestChunk(static_cast<int64_t>(k / chunk_samples_));
+            }
+            // 間に合わなければ読めている端の点に留まる
+            const Chunk& front = chunks_[front_];
+            size_t first = static_cast<size_t>(front.index) * chunk_samples_;
+            size_t hold = k < first ? 0 : front.count - 1;
+            const TrajectoryPoint* p = &front.points[hold * joints_];
+            std::copy(p, p + joints_, points);
+            underruns_++;
+            return;
+        }
+    }
+
+    const Chunk& front = chunks_[front_];
+    const TrajectoryPoint* a = &front.points[(k - static_cast<size_t>(front.index) * chunk_samples_) * joints_];
+    if (needed == 1) {
+        std::copy(a, a + joints_, points);
+    } else {
+        interpolate(a, a + joints_, frac, joints_, points);
+    }
+}
+
+bool makeProfile(const std::string& name, double distance, double duration, std::vector<Profile>& profiles) {
+    if (name == "linear") {
+        profiles.push_back(Profile::linear(distance, duration));
+    } else if (name == "minjerk") {
+        profiles.push_back(Profile::minimumJerk(distance, duration));
+    } else if (name == "trapezoid") {
+        profiles.push_back(Profile::trapezoid(distance, duration));
+    } else if (name == "spline") {
+        profiles.push_back(
+            Profile::cubicSpline({{0.0, 0.0}, {0.5 * duration, 0.5 * distance}, {duration, distance}}));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<Trajectory> trajectoryFromEnv(const std::vector<double>& distances, double duration,
+                                              const std::vector<FeedforwardModel>& feedforward,
+                                              const std::vector<double>& origins) {
+    const char* env = getenv("DXL_TRAJECTORY");
+    std::string name = env && *env ? env : "linear";
+
+    std::vector<Profile> profiles;
+    for (double distance : distances) {
+        if (!makeProfile(name, distance, duration, profiles)) {
+            break;
+        }
+    }
+    if (profiles.size() == distances.size()) {
+        return std::unique_ptr<Trajectory>(new TrajectoryTable(profiles, TRAJ_TABLE_RATE, feedforward, origins));
+    }
+
+    std::unique_ptr<TrajectoryStream> stream(new TrajectoryStream());
+    if (!stream->open(name)) {
+        std::cerr << "DXL_TRAJECTORY: " << stream->error()
+                  << " (use linear, minjerk, trapezoid, spline or a .traj file)" << std::endl;
+        return nullptr;
+    }
+    if (stream->joints() != distances.size()) {
+        std::cerr << "DXL_TRAJECTORY: " << name << " has " << stream->joints() << " joints but "
+                  << distances.size() << " motors are controlled" << std::endl;
+        return nullptr;
+    }
+    return std::unique_ptr<Trajectory>(stream.release());
+}
@@ -0,0 +1,203 @@
+#ifndef TRAJECTORY_H_
+#define TRAJECTORY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 目標位置の線形軌道生成関数（start_pos から goal_pos まで duration 秒で等速に動かす）
+// 制御プログラムとオフライン解析（analyze_runs）の両方で同じ軌道を使う。
+inline int32_t calculateTargetPosition(int32_t start_pos, int32_t goal_pos, double t, double duration) {
+    if (t >= duration) {
+        return goal_pos;
+    }
+    double ratio = t / duration;
+    return static_cast<int32_t>(start_pos + ratio * (goal_pos - start_pos));
+}
+
+#define TRAJ_TABLE_RATE               1000.0  // 表の標本化周波数 [Hz]（制御周期の間は線形補間する）
+#define TRAJ_TRAPEZOID_ACCEL          0.25    // 台形速度の加速・減速に使う時間の割合（片側）
+#define TRAJ_STREAM_CHUNK             4096    // ファイルから1回に読む標本数
+#define TRAJ_FILE_MAGIC               "DXLTRAJ"
+#define TRAJ_FILE_VERSION             1
+
+// 軌道上の1点（位置は開始位置からの変位 [tick]、速度 [tick/s]、フィードフォワード電流 [Goal Current の生の値]）
+struct TrajectoryPoint {
+    double position;
+    double velocity;
+    double feedforward;
+};
+
+// 通過点（時刻 [s] と変位 [tick]）
+struct Waypoint {
+    double t;
+    double position;
+};
+
+// 関節の力学モデルから目標電流の補正を求める（係数は fit_feedforward で走行ログから推定する）
+//   kv * v + ka * a + kc * sign(v) + gs * sin(θ) + gc * cos(θ)
+//   粘性・慣性・クーロン摩擦・重力。θ は Present Position の絶対角（4096 tick で1回転）
+struct FeedforwardModel {
+    double kv = 0.0;
+    double ka = 0.0;
+    double kc = 0.0;
+    double gs = 0.0;
+    double gc = 0.0;
+
+    double current(double position, double velocity, double acceleration) const {
+        double sign = velocity > 0.0 ? 1.0 : (velocity < 0.0 ? -1.0 : 0.0);
+        double theta = position * (2.0 * M_PI / 4096.0);
+        return kv * velocity + ka * acceleration + kc * sign + gs * std::sin(theta) + gc * std::cos(theta);
+    }
+};
+
+// 1関節分の軌道（開始位置からの変位）。表を作るときにだけ評価するので速さは問わない
+class Profile {
+public:
+    enum class Type {
+        Linear,        // 等速（従来の calculateTargetPosition と同じ）
+        MinimumJerk,   // 躍度最小（始点・終点で速度・加速度とも0）
+        Trapezoid,     // 台形速度（加速・等速・減速）
+        CubicSpline,   // 通過点を結ぶ3次スプライン（始点・終点で速度0）
+    };
+
+    static Profile linear(double distance, double duration);
+    static Profile minimumJerk(double distance, double duration);
+    static Profile trapezoid(double distance, double duration, double accel_fraction = TRAJ_TRAPEZOID_ACCEL);
+    // waypoints は時刻の昇順。最初の点の時刻を0とみなす
+    static Profile cubicSpline(const std::vector<Waypoint>& waypoints);
+
+    Type type() const { return type_; }
+    double duration() const { return duration_; }
+
+    // t < 0 は始点、t > duration は終点に留まる
+    void evaluate(double t, double& position, double& velocity, double& acceleration) const;
+
+private:
+    Profile(Type type, double distance, double duration) : type_(type), distance_(distance), duration_(duration) {}
+
+    // スプラインの区間 k： p(s) = a + b s + c s^2 + d s^3 （s は区間先頭からの時刻）
+    struct Segment {
+        double t0, a, b, c, d;
+    };
+
+    Type type_;
+    double distance_;
+    double duration_;
+    double accel_fraction_ = 0.0;
+    std::vector<Segment> segments_;
+};
+
+// 時刻から全関節の目標を引くインターフェース。lookup() は制御周期ごとに呼ばれるので、
+// 中でメモリ確保や入出力をしないこと。
+class Trajectory {
+public:
+    virtual ~Trajectory() {}
+
+    virtual size_t joints() const = 0;
+    virtual double duration() const = 0;
+
+    // points は joints() 個
+    virtual void lookup(double t, TrajectoryPoint* points) = 0;
+};
+
+// 時刻で標本化した 位置・速度・フィードフォワード電流 の表。引くのは O(1)（前後2点の線形補間）
+// feedforward は関節ごとのモデル（空なら補正なし）、origins は関節ごとの開始位置の絶対値（重力項に使う）
+class TrajectoryTable : public Trajectory {
+public:
+    TrajectoryTable(const std::vector<Profile>& profiles, double sample_rate_hz = TRAJ_TABLE_RATE,
+                    const std::vector<FeedforwardModel>& feedforward = {}, const std::vector<double>& origins = {});
+
+    size_t joints() const override { return joints_; }
+    double duration() const override { return (samples_ - 1) / rate_; }
+    size_t samples() const { return samples_; }
+    double sampleRate() const { return rate_; }
+
+    void lookup(double t, TrajectoryPoint* points) override;
+
+    // TrajectoryStream で読める .traj 形式で保存する
+    bool save(const std::string& path) const;
+
+private:
+    size_t joints_;
+    size_t samples_;
+    double rate_;
+    std::vector<TrajectoryPoint> points_;   // 標本 k の関節 j は points_[k * joints_ + j]
+};
+
+// .traj ファイル（TrajectoryTable::save で作る）を TRAJ_STREAM_CHUNK 標本ずつ読みながら引く。
+// 2つのバッファを交互に使い、次の区間は読み込み用スレッドが先に読んでおく（制御ループは入出力しない）。
+// 時刻は単調に進むものとし、先読みが間に合わなければ読めている最後の点に留まる（underruns() に数える）。
+class TrajectoryStream : public Trajectory {
+public:
+    explicit TrajectoryStream(size_t chunk_samples = TRAJ_STREAM_CHUNK);
+    ~TrajectoryStream();
+    TrajectoryStream(const TrajectoryStream&) = delete;
+    TrajectoryStream& operator=(const TrajectoryStream&) = delete;
+
+    // 失敗時は false を返し、error() に理由を入れる
+    bool open(const std::string& path);
+    void close();
+
+    size_t joints() const override { return joints_; }
+    double duration() const override { return samples_ > 0 ? (samples_ - 1) / rate_ : 0.0; }
+
+    void lookup(double t, TrajectoryPoint* points) override;
+
+    size_t underruns() const { return underruns_; }
+    const std::string& error() const { return error_; }
+
+private:
+    // 区間 index は標本 [index * chunk, index * chunk + chunk] を持つ（補間できるよう隣の区間と1標本重ねる）
+    struct Chunk {
+        int64_t index = -1;
+        size_t count = 0;
+        std::vector<TrajectoryPoint> points;
+    };
+
+    bool readChunk(int64_t index, Chunk& chunk);
+    void requestChunk(int64_t index);
+    void loaderLoop();
+
+    int fd_;
+    size_t header_size_;
+    size_t joints_;
+    size_t samples_;
+    double rate_;
+    size_t chunk_samples_;
+    size_t underruns_;
+    std::string error_;
+
+    Chunk chunks_[2];
+    int front_;                          // 制御ループが使っている方
+    bool pending_;                       // 読み込みを頼んで、まだ受け取っていない（制御ループ側だけが触る）
+    std::atomic<bool> back_ready_;       // 頼んだ区間の読み込みが終わった
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    int64_t requested_;                  // 読み込み待ちの区間（-1 なら無し）
+    int load_into_;                      // 読み込み先のバッファ
+    bool stop_;
+    std::thread loader_;
+};
+
+// 環境変数 DXL_TRAJECTORY で軌道を選ぶ。
+//   linear（既定）/ minjerk / trapezoid / spline : distances（関節ごとの変位）と duration から表を作る
+//   それ以外                                     : .traj ファイルのパスとみなして少しずつ読む
+//                                                  （フィードフォワードはファイルに入っているものを使う）
+// 失敗したら nullptr を返す（理由は std::cerr に出す）。
+std::unique_ptr<Trajectory> trajectoryFromEnv(const std::vector<double>& distances, double duration,
+                                              const std::vector<FeedforwardModel>& feedforward = {},
+                                              const std::vector<double>& origins = {});
+
+// "linear" / "minjerk" / "trapezoid" / "spline" の Profile を profiles に足す。名前が違えば false
+// （spline は 始点・中間点・終点 の3点を通るスプライン。中間点で半分だけ進む）
+bool makeProfile(const std::string& name, double distance, double duration, std::vector<Profile>& profiles);
+
+#endif  // TRAJECTORY_H_
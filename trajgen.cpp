@@ -0,0 +1,118 @@
+// 軌道の表を作って .traj ファイルに保存する（DXL_TRAJECTORY=<file.traj> で制御プログラムに渡す）
+//   ./trajgen [-p linear|minjerk|trapezoid|spline] [-t duration_s] [-r rate_hz] [-d dist1,dist2,...]
+//             [-w t:frac,t:frac,...] [-f kv,ka,kc[,gs,gc]] [-F model.txt] [-s start1,start2,...] out.traj
+//   -d は関節ごとの変位 [tick]（既定 1024,-1024 … current_control2 と同じ）
+//   -w は spline の通過点。frac は変位に対する割合（例 0:0,0.4:0.8,1:1）。指定すると -p spline になる
+//   -f はフィードフォワード電流の係数（kv * v + ka * a + kc * sign(v) + gs * sin(θ) + gc * cos(θ)、全関節共通）
+//   -F は fit_feedforward で作った関節ごとのモデル、-s は重力項に使う関節ごとの開始位置 [tick]
+#include "feedforward.h"
+#include "trajectory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::vector<double> parseList(const std::string& text) {
+    std::vector<double> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            values.push_back(atof(item.c_str()));
+        }
+    }
+    return values;
+}
+
+int main(int argc, char* argv[]) {
+    std::string profile_name = "linear";
+    double duration = 1.0;
+    double rate = TRAJ_TABLE_RATE;
+    std::vector<double> distances = {1024, -1024};
+    std::vector<Waypoint> fractions;
+    std::vector<FeedforwardModel> feedforward;
+    std::vector<double> origins;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:t:r:d:w:f:F:s:")) != -1) {
+        switch (opt) {
+        case 'p': profile_name = optarg; break;
+        case 't': duration = atof(optarg); break;
+        case 'r': rate = atof(optarg); break;
+        case 'd': distances = parseList(optarg); break;
+        case 'w': {
+            std::stringstream ss(optarg);
+            std::string item;
+            while (std::getline(ss, item, ',')) {
+                size_t colon = item.find(':');
+                if (colon != std::string::npos) {
+                    fractions.push_back({atof(item.substr(0, colon).c_str()), atof(item.substr(colon + 1).c_str())});
+                }
+            }
+            profile_name = "spline";
+            break;
+        }
+        case 'f': {
+            std::vector<double> k = parseList(optarg);
+            k.resize(5, 0.0);
+            FeedforwardModel model;
+            model.kv = k[0];
+            model.ka = k[1];
+            model.kc = k[2];
+            model.gs = k[3];
+            model.gc = k[4];
+            feedforward.assign(1, model);
+            break;
+        }
+        case 'F':
+            if (!loadFeedforward(optarg, feedforward)) {
+                std::cerr << "Failed to read feedforward model: " << optarg << std::endl;
+                return 1;
+            }
+            break;
+        case 's': origins = parseList(optarg); break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+    if (optind != argc - 1 || distances.empty() || !(rate > 0.0)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [-p linear|minjerk|trapezoid|spline] [-t duration_s] [-r rate_hz] [-d dist1,dist2,...]"
+                     " [-w t:frac,...] [-f kv,ka,kc[,gs,gc]] [-F model.txt] [-s start1,...] out.traj\n";
+        return 1;
+    }
+    std::string output = argv[optind];
+
+    std::vector<Profile> profiles;
+    for (double distance : distances) {
+        if (!fractions.empty()) {
+            std::vector<Waypoint> waypoints;
+            for (const Waypoint& w : fractions) {
+                waypoints.push_back({w.t, w.position * distance});
+            }
+            profiles.push_back(Profile::cubicSpline(waypoints));
+        } else if (!makeProfile(profile_name, distance, duration, profiles)) {
+            std::cerr << "Unknown profile: " << profile_name << std::endl;
+            return 1;
+        }
+    }
+
+    // -f は全関節に同じ係数、-F で足りない関節は補正なし
+    if (feedforward.size() == 1) {
+        feedforward.resize(distances.size(), feedforward[0]);
+    } else if (!feedforward.empty()) {
+        feedforward.resize(distances.size());
+    }
+    TrajectoryTable table(profiles, rate, feedforward, origins);
+    if (!table.save(output)) {
+        std::cerr << "Failed to write " << output << std::endl;
+        return 1;
+    }
+    printf("%s: %s, %zu joints, %zu samples at %g Hz (%.3f s)\n", output.c_str(), profile_name.c_str(),
+           table.joints(), table.samples(), table.sampleRate(), table.duration());
+    return 0;
+}
@@ -0,0 +1,180 @@
+#ifndef XM430_REGISTERS_H_
+#define XM430_REGISTERS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+// XM430（Protocol 2.0）の制御テーブルを型付きで表したもの。
+// レジスタごとにアドレス・幅・符号・単位・書き込み可否をコンパイル時に持ち、
+// 読み書きの幅（1/2/4バイト）やSync Read/Writeのバイト配置はすべてコンパイル時に決まる。
+namespace xm430 {
+
+enum class Access {
+    ReadOnly,    // 読み取り専用
+    ReadWrite,   // RAM 領域（いつでも書ける）
+    Eeprom,      // EEPROM 領域（トルクOFF中だけ書ける）
+};
+
+// Address: 先頭アドレス, T: 値の型（幅と符号を兼ねる）
+template <uint16_t Address, typename T, Access A>
+struct Register {
+    static_assert(std::is_integral<T>::value && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4),
+                  "register must be a 1, 2 or 4 byte integer");
+    using value_type = T;
+    static constexpr uint16_t address = Address;
+    static constexpr uint16_t width = sizeof(T);
+    static constexpr Access access = A;
+    static constexpr bool writable = A != Access::ReadOnly;
+};
+
+// unit は生の値1あたりの物理量（name は表示用）
+#define XM430_REGISTER(Name, Address, Type, AccessRight, Unit, Label)           \
+    struct Name : Register<Address, Type, Access::AccessRight> {                \
+        static constexpr double unit = Unit;                                    \
+        static constexpr const char* name = Label;                              \
+    }
+
+// EEPROM 領域
+XM430_REGISTER(ModelNumber,         0,   uint16_t, ReadOnly,  1.0,   "Model Number");
+XM430_REGISTER(FirmwareVersion,     6,   uint8_t,  ReadOnly,  1.0,   "Firmware Version");
+XM430_REGISTER(Id,                  7,   uint8_t,  Eeprom,    1.0,   "ID");
+XM430_REGISTER(BaudRate,            8,   uint8_t,  Eeprom,    1.0,   "Baud Rate");
+XM430_REGISTER(ReturnDelayTime,     9,   uint8_t,  Eeprom,    2.0,   "Return Delay Time");      // [us]
+XM430_REGISTER(OperatingMode,       11,  uint8_t,  Eeprom,    1.0,   "Operating Mode");
+XM430_REGISTER(CurrentLimit,        38,  uint16_t, Eeprom,    2.69,  "Current Limit");          // [mA]
+
+// RAM 領域
+XM430_REGISTER(TorqueEnable,        64,  uint8_t,  ReadWrite, 1.0,   "Torque Enable");
+XM430_REGISTER(StatusReturnLevel,   68,  uint8_t,  ReadWrite, 1.0,   "Status Return Level");
+XM430_REGISTER(HardwareErrorStatus, 70,  uint8_t,  ReadOnly,  1.0,   "Hardware Error Status");
+XM430_REGISTER(GoalCurrent,         102, int16_t,  ReadWrite, 2.69,  "Goal Current");           // [mA]
+XM430_REGISTER(PresentCurrent,      126, int16_t,  ReadOnly,  2.69,  "Present Current");        // [mA]
+XM430_REGISTER(PresentVelocity,     128, int32_t,  ReadOnly,  0.229, "Present Velocity");       // [rpm]
+XM430_REGISTER(PresentPosition,     132, int32_t,  ReadOnly,  0.088, "Present Position");       // [deg]
+XM430_REGISTER(PresentInputVoltage, 144, uint16_t, ReadOnly,  0.1,   "Present Input Voltage");  // [V]
+XM430_REGISTER(PresentTemperature,  146, uint8_t,  ReadOnly,  1.0,   "Present Temperature");    // [degC]
+XM430_REGISTER(IndirectAddress1,    168, uint16_t, ReadWrite, 1.0,   "Indirect Address 1");     // 〜 Indirect Address 28 (222)
+XM430_REGISTER(IndirectData1,       224, uint8_t,  ReadWrite, 1.0,   "Indirect Data 1");        // 〜 Indirect Data 28 (251)
+
+#undef XM430_REGISTER
+
+// 生の値を物理量に直す
+template <class Reg>
+constexpr double toUnit(typename Reg::value_type raw) {
+    return raw * Reg::unit;
+}
+
+// 連続したレジスタをまとめて1回で読み書きするときのバイト配置。
+// Regs はアドレスの昇順で並べる（間に使わないレジスタがあっても良い。その分は読み飛ばす）。
+//   using Telemetry = RegisterBlock<PresentCurrent, PresentVelocity, PresentPosition>;
+//   Telemetry::address == 126, Telemetry::length == 10, Telemetry::offset<PresentPosition>() == 6
+template <class First, class... Rest>
+struct RegisterBlock {
+private:
+    template <class Reg>
+    static constexpr uint16_t end() { return Reg::address + Reg::width; }
+
+    template <class... Regs>
+    struct Last;
+    template <class Reg>
+    struct Last<Reg> { using type = Reg; };
+    template <class Reg, class Next, class... Regs>
+    struct Last<Reg, Next, Regs...> { using type = typename Last<Next, Regs...>::type; };
+
+    template <class A>
+    static constexpr bool ascending() { return true; }
+    template <class A, class B, class... Regs>
+    static constexpr bool ascending() { return end<A>() <= B::address && ascending<B, Regs...>(); }
+
+    template <class Reg>
+    static constexpr bool contains() {
+        return std::is_same<Reg, First>::value || (std::is_same<Reg, Rest>::value || ...);
+    }
+
+public:
+    static_assert(ascending<First, Rest...>(), "registers must be in ascending, non-overlapping order");
+
+    static constexpr uint16_t address = First::address;
+    static constexpr uint16_t length = end<typename Last<First, Rest...>::type>() - First::address;
+
+    // ブロック先頭からのバイト位置
+    template <class Reg>
+    static constexpr uint16_t offset() {
+        static_assert(contains<Reg>(), "register is not part of this block");
+        return Reg::address - address;
+    }
+
+    // data はブロック先頭（アドレス address の位置）を指す
+    template <class Reg>
+    static typename Reg::value_type decode(const uint8_t* data) {
+        typename Reg::value_type value;
+        memcpy(&value, data + offset<Reg>(), sizeof(value));
+        return value;
+    }
+
+    template <class Reg>
+    static void encode(typename Reg::value_type value, uint8_t* data) {
+        static_assert(Reg::writable, "register is read-only");
+        memcpy(data + offset<Reg>(), &value, sizeof(value));
+    }
+};
+
+// Indirect Address 1〜28 で Indirect Data 1〜28 に割り当てられるバイト数
+constexpr uint16_t INDIRECT_SLOTS = 28;
+// Fast Sync Read に応答するファームウェアの版
+constexpr uint8_t FAST_SYNC_READ_FIRMWARE = 45;
+
+// 離れたレジスタを Indirect Address で Indirect Data 1 (224) からの連続領域に詰めたときのバイト配置。
+// Regs の順に詰める（アドレス順でなくても良い）。Indirect Address n にはそのバイトの元アドレスを書く。
+//   using Packed = IndirectBlock<PresentCurrent, PresentPosition>;
+//   Packed::address == 224, Packed::length == 6, Packed::offset<PresentPosition>() == 2
+template <class... Regs>
+struct IndirectBlock {
+    static constexpr uint16_t address = IndirectData1::address;
+    static constexpr uint16_t length = (Regs::width + ...);
+    static_assert(length <= INDIRECT_SLOTS, "indirect block does not fit in Indirect Data 1-28");
+
+    template <class Reg>
+    static constexpr uint16_t offset() {
+        static_assert((std::is_same<Reg, Regs>::value || ...), "register is not part of this block");
+        uint16_t position = 0;
+        bool found = false;
+        ((found = found || std::is_same<Reg, Regs>::value, position += found ? 0 : Regs::width), ...);
+        return position;
+    }
+
+    // Indirect Address 1 から順に書く値（length 個。リトルエンディアンの2バイトずつ並べれば書き込みのデータになる）
+    static void sourceAddresses(uint16_t* out) {
+        size_t k = 0;
+        ((fill(out, k, Regs::address, Regs::width)), ...);
+    }
+
+    template <class Reg>
+    static typename Reg::value_type decode(const uint8_t* data) {
+        typename Reg::value_type value;
+        memcpy(&value, data + offset<Reg>(), sizeof(value));
+        return value;
+    }
+
+private:
+    static void fill(uint16_t* out, size_t& k, uint16_t source, uint16_t width) {
+        for (uint16_t b = 0; b < width; b++) {
+            out[k++] = static_cast<uint16_t>(source + b);
+        }
+    }
+};
+
+// 制御周期で読むテレメトリ（126..135）と送る指令（102..103）
+using Telemetry = RegisterBlock<PresentCurrent, PresentVelocity, PresentPosition>;
+using Command = RegisterBlock<GoalCurrent>;
+// 制御に使う電流と位置だけを Indirect Data に詰めたもの（間の Present Velocity を読まない）
+using PackedTelemetry = IndirectBlock<PresentCurrent, PresentPosition>;
+
+// 制御テーブルはリトルエンディアンなので、memcpy で読めるのはリトルエンディアンのホストだけ
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "RegisterBlock assumes a little-endian host");
+
+}  // namespace xm430
+
+#endif  // XM430_REGISTERS_H_